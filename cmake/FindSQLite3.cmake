@@ -0,0 +1,41 @@
+# - Find the SQLite 3 library
+# This module looks for the SQLite 3 embedded database library.
+# It defines the following values:
+#    SQLITE3_INCLUDE_DIR: where to find sqlite3.h.
+#    SQLITE3_LIBRARIES: the libraries to link against.
+#    SQLITE3_FOUND: True if SQLite 3 has been found.
+
+#=============================================================================
+# Copyright 2010 Přemysl Janouch
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are met:
+#     * Redistributions of source code must retain the above copyright
+#       notice, this list of conditions and the following disclaimer.
+#     * Redistributions in binary form must reproduce the above copyright
+#       notice, this list of conditions and the following disclaimer in the
+#       documentation and/or other materials provided with the distribution.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+# THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+# PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE
+# FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+# DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+# OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+# HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+# LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+# OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+# OF SUCH DAMAGE.
+#=============================================================================
+
+find_path (SQLITE3_INCLUDE_DIR sqlite3.h)
+find_library (SQLITE3_LIBRARY NAMES sqlite3)
+
+set (SQLITE3_FOUND FALSE)
+if (SQLITE3_INCLUDE_DIR AND SQLITE3_LIBRARY)
+	set (SQLITE3_FOUND TRUE)
+	set (SQLITE3_LIBRARIES ${SQLITE3_LIBRARY})
+endif (SQLITE3_INCLUDE_DIR AND SQLITE3_LIBRARY)
+
+mark_as_advanced (SQLITE3_INCLUDE_DIR SQLITE3_LIBRARY)
@@ -0,0 +1,245 @@
+/**
+ *  @file acmatch.c
+ *  @brief Multiple pattern matching over UTF-16 text.
+ *
+ *  Copyright Přemysl Janouch 2010. All rights reserved.
+ *  See the file LICENSE for licensing information.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "configure.h"
+
+#include "xalloc.h"
+#include "datastruct.h"
+#include "acmatch.h"
+
+
+/** The number of distinct UTF-16 code units. */
+#define AC_UNITS 0x10000
+
+/** The root state of the automaton. */
+#define AC_ROOT 0
+
+
+struct AcMatcher
+{
+	/** Whether to ignore the case of Latin letters. */
+	int foldCase;
+	/** Patterns added so far, each prefixed with its length. */
+	Buffer patterns;
+
+	/** Maps code units to input classes. Class 0 stands for any code unit
+	 *  that doesn't appear in the patterns. */
+	uint16_t *classes;
+	/** The number of input classes, i.e. the width of @a delta. */
+	size_t nClasses;
+	/** The transition function, a row of @a nClasses states per state. */
+	uint32_t *delta;
+	/** For each state, whether a pattern ends in it. */
+	unsigned char *accepts;
+	/** The number of states. */
+	size_t nStates;
+};
+
+
+
+/** Add a new state with all transitions leading to the root. */
+static uint32_t addState (AcMatcher m);
+
+
+AcMatcher acCreateMatcher (int foldCase)
+{
+	AcMatcher m;
+
+	m = xmalloc(sizeof(struct AcMatcher));
+	m->foldCase = foldCase;
+	bufferInit(&m->patterns);
+
+	m->classes = NULL;
+	m->nClasses = 0;
+	m->delta = NULL;
+	m->accepts = NULL;
+	m->nStates = 0;
+	return m;
+}
+
+void acAddPattern (AcMatcher m, const uint16_t *pattern, size_t length)
+{
+	uint32_t len32;
+
+	if (!length)
+		return;
+
+	len32 = length;
+	bufferAppend(&m->patterns, &len32, sizeof(len32), 0);
+	bufferAppend(&m->patterns, pattern, length * sizeof(uint16_t), 0);
+}
+
+uint16_t acFoldUnit (uint16_t c)
+{
+	/* Basic Latin and the Latin-1 Supplement, except for the multiplication
+	 * sign, map to lower case by adding 0x20 to upper case letters. */
+	if ((c >= 'A' && c <= 'Z') || (c >= 0xC0 && c <= 0xDE && c != 0xD7))
+		return c + 0x20;
+	/* Latin Extended-A mostly alternates upper and lower case. */
+	if (c >= 0x100 && c <= 0x137 && !(c & 1))
+		return c + 1;
+	if (c >= 0x139 && c <= 0x148 && (c & 1))
+		return c + 1;
+	if (c >= 0x14A && c <= 0x177 && !(c & 1))
+		return c + 1;
+	return c;
+}
+
+static uint32_t addState (AcMatcher m)
+{
+	size_t i;
+
+	/* Grow the tables by doubling whenever the count hits a power of two. */
+	if (!(m->nStates & (m->nStates - 1)))
+	{
+		size_t alloc = m->nStates ? m->nStates << 1 : 1;
+
+		m->delta = xrealloc(m->delta,
+			alloc * m->nClasses * sizeof(uint32_t));
+		m->accepts = xrealloc(m->accepts, alloc);
+	}
+
+	for (i = 0; i < m->nClasses; i++)
+		m->delta[m->nStates * m->nClasses + i] = AC_ROOT;
+	m->accepts[m->nStates] = 0;
+	return m->nStates++;
+}
+
+void acCompile (AcMatcher m)
+{
+	const char *p, *end;
+	uint32_t len32, state, *fail, *queue;
+	size_t i, head, tail, cls;
+	uint16_t unit;
+
+	/* Assign input classes to code units used by the patterns. */
+	m->classes = xmalloc(AC_UNITS * sizeof(uint16_t));
+	memset(m->classes, 0, AC_UNITS * sizeof(uint16_t));
+	m->nClasses = 1;
+
+	end = (const char *) m->patterns.data + m->patterns.used;
+	for (p = m->patterns.data; p < end; p += len32 * sizeof(uint16_t))
+	{
+		memcpy(&len32, p, sizeof(len32));
+		p += sizeof(len32);
+		for (i = 0; i < len32; i++)
+		{
+			memcpy(&unit, p + i * sizeof(uint16_t), sizeof(unit));
+			if (m->foldCase)
+				unit = acFoldUnit(unit);
+			if (!m->classes[unit])
+				m->classes[unit] = m->nClasses++;
+		}
+	}
+
+	/* Upper case letters go to the same classes as lower case ones. */
+	if (m->foldCase)
+		for (i = 0; i < AC_UNITS; i++)
+			m->classes[i] = m->classes[acFoldUnit(i)];
+
+	/* Build a trie of the patterns. */
+	addState(m);
+	for (p = m->patterns.data; p < end; p += len32 * sizeof(uint16_t))
+	{
+		memcpy(&len32, p, sizeof(len32));
+		p += sizeof(len32);
+
+		state = AC_ROOT;
+		for (i = 0; i < len32; i++)
+		{
+			uint32_t *next;
+
+			memcpy(&unit, p + i * sizeof(uint16_t), sizeof(unit));
+			cls = m->classes[unit];
+			next = &m->delta[state * m->nClasses + cls];
+			if (*next == AC_ROOT)
+			{
+				uint32_t added = addState(m);
+
+				/* addState() might have moved the table. */
+				m->delta[state * m->nClasses + cls] = added;
+				state = added;
+			}
+			else
+				state = *next;
+		}
+		m->accepts[state] = 1;
+	}
+	bufferEmpty(&m->patterns);
+
+	/* Compute failure links in breadth-first order and fill in
+	 * the missing transitions, turning the trie into a DFA.
+	 */
+	fail = xmalloc(m->nStates * sizeof(uint32_t));
+	queue = xmalloc(m->nStates * sizeof(uint32_t));
+	head = tail = 0;
+
+	for (cls = 0; cls < m->nClasses; cls++)
+	{
+		state = m->delta[AC_ROOT * m->nClasses + cls];
+		if (state != AC_ROOT)
+		{
+			fail[state] = AC_ROOT;
+			queue[tail++] = state;
+		}
+	}
+
+	while (head < tail)
+	{
+		uint32_t from = queue[head++];
+
+		m->accepts[from] |= m->accepts[fail[from]];
+		for (cls = 0; cls < m->nClasses; cls++)
+		{
+			uint32_t *next = &m->delta[from * m->nClasses + cls];
+			uint32_t fallback = m->delta[fail[from] * m->nClasses + cls];
+
+			/* Trie edges only ever lead away from the root. */
+			if (*next == AC_ROOT)
+				*next = fallback;
+			else
+			{
+				fail[*next] = fallback;
+				queue[tail++] = *next;
+			}
+		}
+	}
+
+	free(fail);
+	free(queue);
+}
+
+int acSearch (AcMatcher m, const uint16_t *text, size_t length)
+{
+	const uint16_t *classes = m->classes;
+	const uint32_t *delta = m->delta;
+	const unsigned char *accepts = m->accepts;
+	size_t width = m->nClasses;
+	uint32_t state = AC_ROOT;
+
+	while (length--)
+	{
+		state = delta[state * width + classes[*text++]];
+		if (accepts[state])
+			return 1;
+	}
+	return 0;
+}
+
+void acDestroyMatcher (AcMatcher m)
+{
+	bufferDestroy(&m->patterns);
+	free(m->classes);
+	free(m->delta);
+	free(m->accepts);
+	free(m);
+}
@@ -0,0 +1,59 @@
+/**
+ *  @file acmatch.h
+ *  @brief Multiple pattern matching over UTF-16 text.
+ *
+ *  Copyright Přemysl Janouch 2010. All rights reserved.
+ *  See the file LICENSE for licensing information.
+ *
+ *  This is the Aho-Corasick algorithm, compiled into a deterministic
+ *  automaton over the code units that appear in the patterns. Searching
+ *  costs a single table lookup per code unit regardless of the number
+ *  of patterns.
+ *
+ */
+
+#ifndef ACMATCH_H_INCLUDED
+#define ACMATCH_H_INCLUDED
+
+/** A multiple pattern matcher. */
+typedef struct AcMatcher *AcMatcher;
+
+/** Create a matcher with no patterns.
+ *  @param[in] foldCase  Whether to ignore the case of Latin letters.
+ *  @return A new matcher.
+ */
+AcMatcher acCreateMatcher (int foldCase);
+
+/** Add a pattern. This must not be called after acCompile().
+ *  @param[in,out] m  A matcher.
+ *  @param[in] pattern  The pattern in UTF-16.
+ *  @param[in] length  The length of @a pattern in code units.
+ *  	Empty patterns are ignored.
+ */
+void acAddPattern (AcMatcher m, const uint16_t *pattern, size_t length);
+
+/** Build the automaton. This has to be called before searching.
+ *  @param[in,out] m  A matcher.
+ */
+void acCompile (AcMatcher m);
+
+/** Find out whether any of the patterns occurs in the text.
+ *  @param[in] m  A compiled matcher.
+ *  @param[in] text  The text in UTF-16, in the byte order of this machine.
+ *  @param[in] length  The length of @a text in code units.
+ *  @return Non-zero if there is a match.
+ */
+int acSearch (AcMatcher m, const uint16_t *text, size_t length);
+
+/** Fold the case of a Latin letter the way matchers ignoring case do.
+ *  @param[in] c  A UTF-16 code unit.
+ *  @return The code unit in lower case.
+ */
+uint16_t acFoldUnit (uint16_t c);
+
+/** Destroy a matcher.
+ *  @param[in] m  A matcher.
+ */
+void acDestroyMatcher (AcMatcher m);
+
+#endif /* ! ACMATCH_H_INCLUDED */
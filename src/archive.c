@@ -0,0 +1,690 @@
+/**
+ *  @file archive.c
+ *  @brief Reading .evt files out of tar and zip archives.
+ *
+ *  Copyright Přemysl Janouch 2010. All rights reserved.
+ *  See the file LICENSE for licensing information.
+ *
+ */
+
+/* strnlen */
+#define _XOPEN_SOURCE 700
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "configure.h"
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif /* HAVE_ZLIB */
+
+#include "xalloc.h"
+#include "datastruct.h"
+#include "mapfile.h"
+#include "archive.h"
+
+
+/** The size of blocks in tar archives. */
+#define TAR_BLOCK_SIZE 512
+/** The size of chunks members of gzipped archives are read in. */
+#define TAR_CHUNK_SIZE (1 << 20)
+/** The largest entry giving a long name that we read. */
+#define TAR_MAX_LONG_NAME (1 << 20)
+
+/** The largest member that we read. Offsets in logs are 32-bit. */
+#define ARCHIVE_MAX_MEMBER 0xffffffffULL
+
+/** Signatures of parts of zip archives. */
+#define ZIP_LOCAL_HEADER  0x04034b50
+#define ZIP_CENTRAL_ENTRY 0x02014b50
+#define ZIP_END_RECORD    0x06054b50
+
+/** Sizes of the fixed parts of zip records. */
+#define ZIP_LOCAL_HEADER_SIZE  30
+#define ZIP_CENTRAL_ENTRY_SIZE 46
+#define ZIP_END_RECORD_SIZE    22
+
+/** How many times deflate may make data smaller at most. */
+#define ZIP_MAX_RATIO 1032
+
+/** Compression methods of zip members. */
+enum
+{
+	ZIP_STORED = 0,
+	ZIP_DEFLATED = 8
+};
+
+struct ArchiveEntry
+{
+	/** The name of the member. */
+	char *name;
+	/** The offset of the data of the member in the archive. */
+	size_t offset;
+	/** The length of the data as stored in the archive. */
+	size_t storedLength;
+	/** The length of the member. */
+	size_t length;
+	/** The compression method, one of the ZIP_ values. */
+	int method;
+};
+
+
+/** Check whether a file name ends with ".evt", ignoring case. */
+static int isLogName (const char *name);
+
+/** Read a little endian number. */
+static uint32_t readLE16 (const unsigned char *p);
+/** Read a little endian number. */
+static uint32_t readLE32 (const unsigned char *p);
+
+/** Add an entry to the table of members. */
+static void addEntry (Archive *__restrict ar, const char *__restrict name,
+	size_t nameLength, size_t offset, size_t storedLength, size_t length,
+	int method);
+
+/** Check whether a block is a valid tar header. */
+static int isTarHeader (const unsigned char *block);
+/** Check whether a block consists of zeros, which ends a tar archive. */
+static int isZeroBlock (const unsigned char *block);
+/** Read a number from a tar header.
+ *  @return 0 on success, -1 if the field is invalid.
+ */
+static int parseTarNumber (const unsigned char *field, size_t length,
+	unsigned long long *value);
+/** Get the name of a member from a tar header, unless it's been given
+ *  by a preceding GNU long name entry.
+ *  @param[in] block  The header.
+ *  @param[in,out] name  The name. If it's empty, the header is used.
+ */
+static void getTarName (const unsigned char *__restrict block,
+	Buffer *__restrict name);
+/** Check whether a tar header describes a regular file. */
+static int isTarFile (const unsigned char *block);
+/** Check whether a tar header precedes another one, giving it a name
+ *  that doesn't fit in the header, in the GNU or pax way. */
+static int isTarLongName (const unsigned char *block);
+/** Get the name of the following member from a long name entry.
+ *  @param[in] block  The header of the entry.
+ *  @param[in] data  The contents of the entry.
+ *  @param[in] length  The length of @a data.
+ *  @param[out] name  The name. It's left empty if the entry doesn't have it.
+ */
+static void parseTarLongName (const unsigned char *__restrict block,
+	const char *__restrict data, size_t length, Buffer *__restrict name);
+
+/** Build the table of members of a mapped tar archive.
+ *  @return 0 on success, -1 on failure. An error message is printed.
+ */
+static int scanTar (Archive *ar);
+/** Build the table of members of a mapped zip archive.
+ *  @return 0 on success, -1 on failure. An error message is printed.
+ */
+static int scanZip (Archive *ar);
+
+#ifdef HAVE_ZLIB
+/** Open a gzipped tar archive.
+ *  @return 0 on success, 1 if it isn't a tar archive, -1 on failure.
+ */
+static int openTarGz (Archive *ar);
+/** Read the next member of a gzipped tar archive, see archiveNext(). */
+static int nextTarGz (Archive *__restrict ar,
+	ArchiveMember *__restrict member);
+/** Skip data in a gzipped tar archive.
+ *  @return 0 on success, -1 on failure.
+ */
+static int skipTarGz (Archive *ar, unsigned long long length);
+/** Read data from a gzipped tar archive into @a ar->storage. The buffer
+ *  only grows as the data really arrive, whatever the header says.
+ *  @return 0 on success, -1 on failure.
+ */
+static int readTarGz (Archive *ar, unsigned long long length);
+#endif /* HAVE_ZLIB */
+
+
+static int isLogName (const char *name)
+{
+	size_t length;
+
+	length = strlen(name);
+	return length > 4 && name[length - 4] == '.'
+		&& (name[length - 3] == 'e' || name[length - 3] == 'E')
+		&& (name[length - 2] == 'v' || name[length - 2] == 'V')
+		&& (name[length - 1] == 't' || name[length - 1] == 'T');
+}
+
+static uint32_t readLE16 (const unsigned char *p)
+{
+	return p[0] | (uint32_t) p[1] << 8;
+}
+
+static uint32_t readLE32 (const unsigned char *p)
+{
+	return p[0] | (uint32_t) p[1] << 8
+		| (uint32_t) p[2] << 16 | (uint32_t) p[3] << 24;
+}
+
+int archiveOpen (Archive *__restrict ar, const char *__restrict path)
+{
+	const unsigned char *data;
+	int ret = 1;
+
+	ar->path = path;
+	ar->format = ARCHIVE_TAR;
+	ar->entries = NULL;
+	ar->count = 0;
+	ar->next = 0;
+	ar->stream = NULL;
+	bufferInit(&ar->name);
+	bufferInit(&ar->storage);
+
+	if (mapFileOpen(&ar->file, path))
+	{
+		fprintf(stderr, _("Error: Failed to open %s for reading.\n"), path);
+		return -1;
+	}
+
+	data = ar->file.data;
+	if (ar->file.length >= 2 && data[0] == 0x1f && data[1] == 0x8b)
+	{
+		/* Gzipped files are read through zlib instead. */
+		mapFileClose(&ar->file);
+#ifdef HAVE_ZLIB
+		ar->format = ARCHIVE_TAR_GZ;
+		ret = openTarGz(ar);
+#else /* ! HAVE_ZLIB */
+		fprintf(stderr, _("Error: %s is compressed, which is not supported.\n"),
+			path);
+		ret = -1;
+#endif /* ! HAVE_ZLIB */
+	}
+	else if (ar->file.length >= 4
+		&& (readLE32(data) == ZIP_LOCAL_HEADER
+		|| readLE32(data) == ZIP_END_RECORD))
+	{
+		ar->format = ARCHIVE_ZIP;
+		ret = scanZip(ar);
+	}
+	else if (ar->file.length >= TAR_BLOCK_SIZE && isTarHeader(data))
+	{
+		ar->format = ARCHIVE_TAR;
+		ret = scanTar(ar);
+	}
+
+	if (ret)
+		archiveClose(ar);
+	return ret;
+}
+
+void archiveClose (Archive *ar)
+{
+	size_t i;
+
+	for (i = 0; i < ar->count; i++)
+		free(ar->entries[i].name);
+	free(ar->entries);
+	ar->entries = NULL;
+	ar->count = 0;
+
+#ifdef HAVE_ZLIB
+	if (ar->stream)
+		gzclose(ar->stream);
+	ar->stream = NULL;
+#endif /* HAVE_ZLIB */
+	if (ar->format != ARCHIVE_TAR_GZ)
+		mapFileClose(&ar->file);
+
+	bufferDestroy(&ar->name);
+	bufferDestroy(&ar->storage);
+}
+
+static void addEntry (Archive *__restrict ar, const char *__restrict name,
+	size_t nameLength, size_t offset, size_t storedLength, size_t length,
+	int method)
+{
+	ArchiveEntry *entry;
+
+	/* Grow by powers of two. */
+	if (!(ar->count & (ar->count - 1)))
+		ar->entries = xrealloc(ar->entries,
+			(ar->count ? ar->count * 2 : 1) * sizeof(ArchiveEntry));
+
+	entry = &ar->entries[ar->count++];
+	entry->name = xmalloc(nameLength + 1);
+	memcpy(entry->name, name, nameLength);
+	entry->name[nameLength] = '\0';
+	entry->offset = offset;
+	entry->storedLength = storedLength;
+	entry->length = length;
+	entry->method = method;
+}
+
+int archiveNext (Archive *__restrict ar, ArchiveMember *__restrict member)
+{
+#ifdef HAVE_ZLIB
+	if (ar->format == ARCHIVE_TAR_GZ)
+		return nextTarGz(ar, member);
+#endif /* HAVE_ZLIB */
+
+	if (ar->next >= ar->count)
+		return 0;
+	return archiveExtract(ar, ar->next++, member, &ar->storage) ? -1 : 1;
+}
+
+int archiveExtract (const Archive *__restrict ar, size_t index,
+	ArchiveMember *__restrict member, Buffer *__restrict storage)
+{
+	const ArchiveEntry *entry = &ar->entries[index];
+	const char *data = (const char *) ar->file.data + entry->offset;
+#ifdef HAVE_ZLIB
+	z_stream z;
+	int status;
+#endif /* HAVE_ZLIB */
+
+	member->name = entry->name;
+	member->length = entry->length;
+
+	if (entry->method == ZIP_STORED)
+	{
+		if (entry->storedLength != entry->length)
+			goto archiveExtract_corrupted;
+
+		/* Zip archives don't align their members in any way. */
+		member->data = data;
+		if ((size_t) data % sizeof(uint32_t))
+		{
+			bufferClear(storage);
+			bufferAppend(storage, data, entry->length, 0);
+			member->data = storage->data;
+		}
+		return 0;
+	}
+
+#ifdef HAVE_ZLIB
+	if (entry->method == ZIP_DEFLATED)
+	{
+		bufferClear(storage);
+		bufferAppend(storage, NULL, entry->length, 0);
+		member->data = storage->data;
+
+		/* Zip archives contain raw deflate streams without a header. */
+		memset(&z, 0, sizeof(z));
+		if (inflateInit2(&z, -MAX_WBITS) != Z_OK)
+			goto archiveExtract_corrupted;
+		z.next_in = (Bytef *) data;
+		z.avail_in = entry->storedLength;
+		z.next_out = storage->data;
+		z.avail_out = entry->length;
+		status = inflate(&z, Z_FINISH);
+		inflateEnd(&z);
+		if (status != Z_STREAM_END || z.total_out != entry->length)
+			goto archiveExtract_corrupted;
+		return 0;
+	}
+#endif /* HAVE_ZLIB */
+
+	fprintf(stderr, _("Error: %s in %s is compressed in an unsupported way.\n"),
+		entry->name, ar->path);
+	return -1;
+
+archiveExtract_corrupted:
+	fprintf(stderr, _("Error: %s in %s is corrupted.\n"),
+		entry->name, ar->path);
+	return -1;
+}
+
+/* ===== Tar ================================================================ */
+
+static int isTarHeader (const unsigned char *block)
+{
+	unsigned long long expected;
+	unsigned long sum = 0;
+	int i;
+
+	/* The checksum is computed as if the field itself was blank. */
+	if (parseTarNumber(block + 148, 8, &expected))
+		return 0;
+	for (i = 0; i < TAR_BLOCK_SIZE; i++)
+		sum += i >= 148 && i < 156 ? ' ' : block[i];
+	return sum == expected;
+}
+
+static int isZeroBlock (const unsigned char *block)
+{
+	int i;
+
+	for (i = 0; i < TAR_BLOCK_SIZE; i++)
+		if (block[i])
+			return 0;
+	return 1;
+}
+
+static int parseTarNumber (const unsigned char *field, size_t length,
+	unsigned long long *value)
+{
+	size_t i = 0;
+
+	*value = 0;
+
+	/* GNU tar stores large numbers in binary, marked by the top bit. */
+	if (field[0] & 0x80)
+	{
+		*value = field[0] & 0x7f;
+		for (i = 1; i < length; i++)
+			*value = *value << 8 | field[i];
+		return 0;
+	}
+
+	while (i < length && field[i] == ' ')
+		i++;
+	if (i == length || field[i] < '0' || field[i] > '7')
+		return -1;
+	for (; i < length && field[i] >= '0' && field[i] <= '7'; i++)
+		*value = *value << 3 | (field[i] - '0');
+	return i < length && field[i] != ' ' && field[i] ? -1 : 0;
+}
+
+static void getTarName (const unsigned char *__restrict block,
+	Buffer *__restrict name)
+{
+	const char *header = (const char *) block;
+
+	if (name->used)
+		return;
+
+	/* The ustar format may split long names in two. */
+	if (!memcmp(header + 257, "ustar", 5) && header[345])
+	{
+		bufferAppend(name, header + 345, strnlen(header + 345, 155), 0);
+		bufferAppendChar(name, '/');
+	}
+	bufferAppend(name, header, strnlen(header, 100), 0);
+	bufferAppendChar(name, '\0');
+}
+
+static int isTarFile (const unsigned char *block)
+{
+	return block[156] == '0' || block[156] == '\0' || block[156] == '7';
+}
+
+static int isTarLongName (const unsigned char *block)
+{
+	return block[156] == 'L' || block[156] == 'x';
+}
+
+static void parseTarLongName (const unsigned char *__restrict block,
+	const char *__restrict data, size_t length, Buffer *__restrict name)
+{
+	const char *p = data, *end = data + length, *record;
+	size_t recordLength;
+
+	bufferClear(name);
+	if (block[156] == 'L')
+	{
+		bufferAppend(name, data, strnlen(data, length), 0);
+		bufferAppendChar(name, '\0');
+		return;
+	}
+
+	/* Pax records look like "length keyword=value\n". */
+	while (p < end)
+	{
+		for (record = p, recordLength = 0;
+			record < end && *record >= '0' && *record <= '9'; record++)
+			recordLength = recordLength * 10 + (*record - '0');
+		if (record == end || *record++ != ' '
+			|| recordLength > (size_t) (end - p)
+			|| recordLength < (size_t) (record - p) + 1)
+			break;
+
+		if (p + recordLength - record > 5 && !memcmp(record, "path=", 5))
+		{
+			bufferClear(name);
+			bufferAppend(name, record + 5, p + recordLength - 1
+				- (record + 5), 0);
+			bufferAppendChar(name, '\0');
+		}
+		p += recordLength;
+	}
+}
+
+static int scanTar (Archive *ar)
+{
+	const unsigned char *data = ar->file.data, *block;
+	unsigned long long length;
+	size_t offset = 0, start;
+
+	for (; offset + TAR_BLOCK_SIZE <= ar->file.length; )
+	{
+		block = data + offset;
+		if (isZeroBlock(block))
+			return 0;
+		if (!isTarHeader(block) || parseTarNumber(block + 124, 12, &length)
+			|| length > ar->file.length - offset - TAR_BLOCK_SIZE)
+			break;
+
+		start = offset + TAR_BLOCK_SIZE;
+		offset = start + (length + TAR_BLOCK_SIZE - 1)
+			/ TAR_BLOCK_SIZE * TAR_BLOCK_SIZE;
+
+		if (isTarLongName(block))
+		{
+			parseTarLongName(block, (const char *) data + start,
+				length, &ar->name);
+			continue;
+		}
+
+		getTarName(block, &ar->name);
+		if (isTarFile(block) && isLogName(ar->name.data))
+			addEntry(ar, ar->name.data, ar->name.used - 1,
+				start, length, length, ZIP_STORED);
+		bufferClear(&ar->name);
+	}
+
+	/* Archives may also end without the terminating blocks. */
+	if (offset == ar->file.length)
+		return 0;
+	fprintf(stderr, _("Error: %s is corrupted.\n"), ar->path);
+	return -1;
+}
+
+#ifdef HAVE_ZLIB
+static int openTarGz (Archive *ar)
+{
+	unsigned char block[TAR_BLOCK_SIZE];
+
+	if (!(ar->stream = gzopen(ar->path, "rb")))
+	{
+		fprintf(stderr, _("Error: Failed to open %s for reading.\n"),
+			ar->path);
+		return -1;
+	}
+
+	/* Anything else that has been gzipped isn't our business. */
+	if (gzread(ar->stream, block, TAR_BLOCK_SIZE) != TAR_BLOCK_SIZE
+		|| !isTarHeader(block))
+		return 1;
+	if (gzrewind(ar->stream))
+	{
+		fprintf(stderr, _("Error: Failed to read %s.\n"), ar->path);
+		return -1;
+	}
+	return 0;
+}
+
+static int skipTarGz (Archive *ar, unsigned long long length)
+{
+	char buff[BUFSIZ];
+	int got;
+
+	for (; length; length -= got)
+	{
+		got = length < sizeof(buff) ? (int) length : (int) sizeof(buff);
+		if (gzread(ar->stream, buff, got) != got)
+			return -1;
+	}
+	return 0;
+}
+
+static int readTarGz (Archive *ar, unsigned long long length)
+{
+	size_t chunk;
+
+	bufferClear(&ar->storage);
+	for (; length; length -= chunk)
+	{
+		chunk = length < TAR_CHUNK_SIZE ? length : TAR_CHUNK_SIZE;
+		bufferAppend(&ar->storage, NULL, chunk, 0);
+		if (gzread(ar->stream, (char *) ar->storage.data
+			+ ar->storage.used - chunk, chunk) != (int) chunk)
+			return -1;
+	}
+	return 0;
+}
+
+static int nextTarGz (Archive *__restrict ar,
+	ArchiveMember *__restrict member)
+{
+	unsigned char block[TAR_BLOCK_SIZE];
+	unsigned long long length, padding;
+	int got;
+
+	while (1)
+	{
+		if (!(got = gzread(ar->stream, block, TAR_BLOCK_SIZE))
+			|| (got == TAR_BLOCK_SIZE && isZeroBlock(block)))
+			return 0;
+		if (got != TAR_BLOCK_SIZE || !isTarHeader(block)
+			|| parseTarNumber(block + 124, 12, &length))
+			break;
+		padding = (TAR_BLOCK_SIZE - length % TAR_BLOCK_SIZE)
+			% TAR_BLOCK_SIZE;
+
+		if (isTarLongName(block))
+		{
+			if (length > TAR_MAX_LONG_NAME
+				|| readTarGz(ar, length) || skipTarGz(ar, padding))
+				break;
+			parseTarLongName(block, ar->storage.data, length, &ar->name);
+			continue;
+		}
+
+		getTarName(block, &ar->name);
+		if (!isTarFile(block) || !isLogName(ar->name.data))
+		{
+			bufferClear(&ar->name);
+			if (skipTarGz(ar, length + padding))
+				break;
+			continue;
+		}
+
+		if (length > ARCHIVE_MAX_MEMBER
+			|| readTarGz(ar, length) || skipTarGz(ar, padding))
+			break;
+
+		/* The name stays there until the next call. */
+		member->name = ar->name.data;
+		member->data = ar->storage.data;
+		member->length = length;
+		bufferClear(&ar->name);
+		return 1;
+	}
+
+	fprintf(stderr, _("Error: %s is corrupted.\n"), ar->path);
+	return -1;
+}
+#endif /* HAVE_ZLIB */
+
+/* ===== Zip ================================================================ */
+
+static int scanZip (Archive *ar)
+{
+	const unsigned char *data = ar->file.data, *end = NULL, *p, *local;
+	size_t length = ar->file.length, limit, offset, nameLength, dataOffset;
+	uint32_t nEntries, i, method, storedLength, memberLength;
+
+	if (length < ZIP_END_RECORD_SIZE)
+		goto scanZip_corrupted;
+
+	/* The end record is followed by a comment of up to 64 kB. */
+	limit = length > ZIP_END_RECORD_SIZE + 0xffff
+		? length - ZIP_END_RECORD_SIZE - 0xffff : 0;
+	for (offset = length - ZIP_END_RECORD_SIZE + 1; offset-- > limit; )
+		if (readLE32(data + offset) == ZIP_END_RECORD)
+		{
+			end = data + offset;
+			break;
+		}
+	if (!end)
+		goto scanZip_corrupted;
+
+	nEntries = readLE16(end + 10);
+	offset = readLE32(end + 16);
+	if (offset == 0xffffffff || nEntries == 0xffff)
+	{
+		fprintf(stderr, _("Error: %s is a zip64 archive, which is not "
+			"supported.\n"), ar->path);
+		return -1;
+	}
+
+	for (i = 0; i < nEntries; i++)
+	{
+		if (offset > length || length - offset < ZIP_CENTRAL_ENTRY_SIZE)
+			goto scanZip_corrupted;
+		p = data + offset;
+		if (readLE32(p) != ZIP_CENTRAL_ENTRY)
+			goto scanZip_corrupted;
+
+		method = readLE16(p + 10);
+		storedLength = readLE32(p + 20);
+		memberLength = readLE32(p + 24);
+		nameLength = readLE16(p + 28);
+		offset += ZIP_CENTRAL_ENTRY_SIZE + nameLength
+			+ readLE16(p + 30) + readLE16(p + 32);
+		if (offset > length)
+			goto scanZip_corrupted;
+
+		bufferClear(&ar->name);
+		bufferAppend(&ar->name, p + ZIP_CENTRAL_ENTRY_SIZE, nameLength, 0);
+		bufferAppendChar(&ar->name, '\0');
+		if (!isLogName(ar->name.data))
+			continue;
+
+		/* Encrypted members can't be read. */
+		if (readLE16(p + 8) & 1)
+		{
+			fprintf(stderr, _("Warning: Skipping %s in %s, "
+				"which is encrypted.\n"), (char *) ar->name.data, ar->path);
+			continue;
+		}
+
+		/* The data follow the local header, whose extra field
+		 * may differ from the one in the central directory. */
+		dataOffset = readLE32(p + 42);
+		if (dataOffset > length
+			|| length - dataOffset < ZIP_LOCAL_HEADER_SIZE)
+			goto scanZip_corrupted;
+		local = data + dataOffset;
+		if (readLE32(local) != ZIP_LOCAL_HEADER)
+			goto scanZip_corrupted;
+		dataOffset += ZIP_LOCAL_HEADER_SIZE
+			+ readLE16(local + 26) + readLE16(local + 28);
+		if (dataOffset > length || length - dataOffset < storedLength)
+			goto scanZip_corrupted;
+
+		/* Don't let the header alone decide how much memory we take. */
+		if (method == ZIP_DEFLATED && memberLength
+			> (unsigned long long) storedLength * ZIP_MAX_RATIO)
+			goto scanZip_corrupted;
+
+		addEntry(ar, ar->name.data, nameLength,
+			dataOffset, storedLength, memberLength, method);
+	}
+	bufferClear(&ar->name);
+	return 0;
+
+scanZip_corrupted:
+	fprintf(stderr, _("Error: %s is corrupted.\n"), ar->path);
+	return -1;
+}
@@ -0,0 +1,113 @@
+/**
+ *  @file archive.h
+ *  @brief Reading .evt files out of tar and zip archives.
+ *
+ *  Copyright Přemysl Janouch 2010. All rights reserved.
+ *  See the file LICENSE for licensing information.
+ *
+ *  Tar and zip archives are mapped into memory and a table of their
+ *  members is built when they are opened, so that members may be
+ *  extracted in any order and from several threads at once. Members that
+ *  aren't compressed are handed out right from the mapping. Gzipped tar
+ *  archives can only be read one member after another.
+ *
+ *  Only regular files whose names end with ".evt" are considered members.
+ *  Compressed archives require zlib.
+ *
+ */
+
+#ifndef ARCHIVE_H_INCLUDED
+#define ARCHIVE_H_INCLUDED
+
+/** Formats of archives. */
+typedef enum
+{
+	ARCHIVE_TAR,
+	ARCHIVE_TAR_GZ,
+	ARCHIVE_ZIP
+}
+ArchiveFormat;
+
+/** Where to find a member in the archive. */
+typedef struct ArchiveEntry ArchiveEntry;
+
+/** An archive opened for reading. */
+typedef struct
+{
+	/** The path to the archive. */
+	const char *path;
+	/** The format of the archive. */
+	ArchiveFormat format;
+	/** The mapped archive, unless it's gzipped. */
+	MappedFile file;
+	/** The table of members, or NULL if the archive is read as a stream. */
+	ArchiveEntry *entries;
+	/** The number of @a entries. */
+	size_t count;
+	/** The next member to be read by archiveNext(). */
+	size_t next;
+	/** The decompressed stream of a gzipped archive. */
+	void *stream;
+	/** The name of the member last read from a stream. */
+	Buffer name;
+	/** Storage for members read by archiveNext(). */
+	Buffer storage;
+}
+Archive;
+
+/** A member of an archive. */
+typedef struct
+{
+	/** The name of the member. */
+	const char *name;
+	/** The contents of the member. */
+	const void *data;
+	/** The length of @a data in bytes. */
+	size_t length;
+}
+ArchiveMember;
+
+
+/** Open a file if it's an archive.
+ *  @param[out] ar  An Archive structure to be filled.
+ *  @param[in] path  The path to the file. It has to stay valid.
+ *  @return 0 on success, 1 if the file isn't an archive, -1 on failure.
+ *  	An error message is printed on failure.
+ */
+int archiveOpen (Archive *__restrict ar, const char *__restrict path);
+
+/** Find out whether members of an archive may be read by archiveExtract().
+ *  @param[in] ar  An opened archive.
+ *  @return Non-zero if the archive has a table of members.
+ */
+static inline int archiveIsSeekable (const Archive *ar)
+{
+	return ar->entries != NULL;
+}
+
+/** Read the next member of an archive.
+ *  @param[in,out] ar  An opened archive.
+ *  @param[out] member  The member. It stays valid until the next call.
+ *  @return 1 if a member has been read, 0 at the end of the archive,
+ *  	-1 on failure. An error message is printed on failure.
+ */
+int archiveNext (Archive *__restrict ar, ArchiveMember *__restrict member);
+
+/** Read a member of a seekable archive. This may be called from several
+ *  threads at once, as long as each one uses its own storage.
+ *  @param[in] ar  An opened archive.
+ *  @param[in] index  The number of the member, less than @a ar->count.
+ *  @param[out] member  The member. It stays valid until @a storage
+ *  	is changed.
+ *  @param[in,out] storage  Where to decompress the member if needed.
+ *  @return 0 on success, -1 on failure. An error message is printed.
+ */
+int archiveExtract (const Archive *__restrict ar, size_t index,
+	ArchiveMember *__restrict member, Buffer *__restrict storage);
+
+/** Close an archive.
+ *  @param[in,out] ar  An opened archive.
+ */
+void archiveClose (Archive *ar);
+
+#endif /* ! ARCHIVE_H_INCLUDED */
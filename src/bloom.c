@@ -0,0 +1,64 @@
+/**
+ *  @file bloom.c
+ *  @brief Bloom filters.
+ *
+ *  Copyright Přemysl Janouch 2010. All rights reserved.
+ *  See the file LICENSE for licensing information.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "configure.h"
+
+#include "xalloc.h"
+#include "hash.h"
+#include "bloom.h"
+
+
+void bloomInit (BloomFilter *filter, size_t nKeys)
+{
+	uint32_t bitsPerKey;
+
+	filter->nBits = 8;
+	while (filter->nBits < nKeys * BLOOM_BITS_PER_KEY
+		&& filter->nBits < 0x80000000U)
+		filter->nBits <<= 1;
+
+	/* The optimal count is ln 2 times the number of bits per key.
+	 * Rounding the size up only gives us more bits to spend. */
+	bitsPerKey = nKeys ? filter->nBits / nKeys : BLOOM_BITS_PER_KEY;
+	filter->nHashes = bitsPerKey * 69 / 100;
+	if (filter->nHashes < 1)
+		filter->nHashes = 1;
+	if (filter->nHashes > 16)
+		filter->nHashes = 16;
+
+	filter->bits = xmalloc(filter->nBits / 8);
+	memset(filter->bits, 0, filter->nBits / 8);
+}
+
+void bloomAdd (BloomFilter *__restrict filter,
+	const void *__restrict key, size_t length)
+{
+	uint64_t hash = hash64(key, length, 0);
+	uint32_t h = (uint32_t) hash, delta = (uint32_t) (hash >> 32) | 1;
+	uint32_t mask = filter->nBits - 1, i;
+
+	for (i = 0; i < filter->nHashes; i++, h += delta)
+		filter->bits[(h & mask) >> 3] |= 1 << (h & 7);
+}
+
+int bloomTest (const BloomFilter *__restrict filter,
+	const void *__restrict key, size_t length)
+{
+	uint64_t hash = hash64(key, length, 0);
+	uint32_t h = (uint32_t) hash, delta = (uint32_t) (hash >> 32) | 1;
+	uint32_t mask = filter->nBits - 1, i;
+
+	for (i = 0; i < filter->nHashes; i++, h += delta)
+		if (!(filter->bits[(h & mask) >> 3] & (1 << (h & 7))))
+			return 0;
+	return 1;
+}
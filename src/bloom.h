@@ -0,0 +1,66 @@
+/**
+ *  @file bloom.h
+ *  @brief Bloom filters.
+ *
+ *  Copyright Přemysl Janouch 2010. All rights reserved.
+ *  See the file LICENSE for licensing information.
+ *
+ *  A Bloom filter answers whether a key might have been added to a set,
+ *  with false positives but no false negatives. The bits to set for a key
+ *  are derived from a single 64-bit hash by double hashing.
+ *
+ */
+
+#ifndef BLOOM_H_INCLUDED
+#define BLOOM_H_INCLUDED
+
+/** The number of bits used per expected key, giving about 1 % of false
+ *  positives with the optimal number of hash functions. */
+#define BLOOM_BITS_PER_KEY 10
+
+/** A Bloom filter. */
+typedef struct
+{
+	/** The bit array. */
+	unsigned char *bits;
+	/** The number of bits, always a power of two and at least 8. */
+	uint32_t nBits;
+	/** The number of bits to set per key. */
+	uint32_t nHashes;
+}
+BloomFilter;
+
+
+/** Initialize an empty Bloom filter.
+ *  @param[out] filter  A BloomFilter object.
+ *  @param[in] nKeys  How many keys are going to be added.
+ */
+void bloomInit (BloomFilter *filter, size_t nKeys);
+
+/** Add a key to a Bloom filter.
+ *  @param[in,out] filter  A Bloom filter.
+ *  @param[in] key  The key.
+ *  @param[in] length  The length of the key in bytes.
+ */
+void bloomAdd (BloomFilter *__restrict filter,
+	const void *__restrict key, size_t length);
+
+/** Test whether a key might be in a Bloom filter.
+ *  @param[in] filter  A Bloom filter.
+ *  @param[in] key  The key.
+ *  @param[in] length  The length of the key in bytes.
+ *  @return Zero if the key certainly hasn't been added.
+ */
+int bloomTest (const BloomFilter *__restrict filter,
+	const void *__restrict key, size_t length);
+
+/** Destroy a @a BloomFilter object.
+ *  @param[in,out] filter  A Bloom filter.
+ */
+static inline void bloomDestroy (BloomFilter *filter)
+{
+	free(filter->bits);
+	filter->bits = NULL;
+}
+
+#endif /* ! BLOOM_H_INCLUDED */
@@ -0,0 +1,400 @@
+/**
+ *  @file cache.c
+ *  @brief A cache of conversion outputs shared between processes.
+ *
+ *  Copyright Přemysl Janouch 2010. All rights reserved.
+ *  See the file LICENSE for licensing information.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <utime.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "configure.h"
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif /* HAVE_ZLIB */
+
+#include "xalloc.h"
+#include "mapfile.h"
+#include "hash.h"
+#include "cache.h"
+
+
+/** The number of hexadecimal digits in the name of an entry. */
+#define CACHE_KEY_DIGITS 32
+/** The suffix of the name of an entry. */
+#ifdef HAVE_ZLIB
+#define CACHE_SUFFIX ".gz"
+#else /* ! HAVE_ZLIB */
+#define CACHE_SUFFIX ""
+#endif /* ! HAVE_ZLIB */
+/** The prefix of the names of temporary files. */
+#define CACHE_TEMP_PREFIX "tmp."
+/** The name of the file locked while trimming the cache. */
+#define CACHE_LOCK_NAME "lock"
+/** How old temporary files have to be, in seconds, to be considered
+ *  left behind by a process that has crashed. */
+#define CACHE_TEMP_MAX_AGE 86400
+/** The size of the buffer for copying entries. */
+#define CACHE_BUFFER_SIZE (64 << 10)
+
+/** An entry found in the cache directory. */
+typedef struct
+{
+	/** The path to the entry. */
+	char *path;
+	/** The size of the entry in bytes. */
+	unsigned long long size;
+	/** When the entry has last been used. */
+	time_t mtime;
+}
+CacheFile;
+
+
+/** Get the path to the entry for the key. The result has to be freed. */
+static char *getEntryPath (const Cache *cache);
+/** Find out whether a file in the cache directory is an entry. */
+static int isEntryName (const char *name);
+/** Compare entries by the time they've last been used, for qsort(). */
+static int compareFiles (const void *a, const void *b);
+/** Remove the least recently used entries until the cache fits its limit,
+ *  along with temporary files that have been left behind.
+ *  @return 0 on success, -1 on failure. An error message is printed.
+ */
+static int trimCache (const Cache *cache);
+
+
+int cacheInit (Cache *__restrict cache, const char *__restrict dir,
+	unsigned long long limit)
+{
+	if (mkdir(dir, 0777) && errno != EEXIST)
+	{
+		fprintf(stderr, _("Error: Failed to create %s: %s.\n"),
+			dir, strerror(errno));
+		return -1;
+	}
+
+	cache->dir = dir;
+	cache->limit = limit;
+	cache->fileHash = 0;
+	cache->stringHash = 0;
+	return 0;
+}
+
+int cacheAddFile (Cache *__restrict cache, const char *__restrict path)
+{
+	MappedFile map;
+
+	if (mapFileOpen(&map, path))
+	{
+		fprintf(stderr, _("Error: Failed to open %s for reading: %s.\n"),
+			path, strerror(errno));
+		return -1;
+	}
+	cache->fileHash = hash64Wide(map.data ? map.data : "", map.length,
+		cache->fileHash);
+	mapFileClose(&map);
+	return 0;
+}
+
+void cacheAddString (Cache *__restrict cache, const char *__restrict str)
+{
+	/* The terminator keeps consecutive strings apart. */
+	cache->stringHash = hash64(str, strlen(str) + 1, cache->stringHash);
+}
+
+static char *getEntryPath (const Cache *cache)
+{
+	char *path;
+
+	path = xmalloc(strlen(cache->dir)
+		+ 1 + CACHE_KEY_DIGITS + sizeof(CACHE_SUFFIX));
+	sprintf(path, "%s/%016llx%016llx" CACHE_SUFFIX, cache->dir,
+		(unsigned long long) cache->fileHash,
+		(unsigned long long) cache->stringHash);
+	return path;
+}
+
+int cacheFetch (const Cache *__restrict cache, FILE *__restrict output)
+{
+#ifdef HAVE_ZLIB
+	gzFile in;
+	int length;
+#else /* ! HAVE_ZLIB */
+	FILE *in;
+	size_t length;
+#endif /* ! HAVE_ZLIB */
+	char *path, *buff;
+	int fd, ret = 1;
+
+	path = getEntryPath(cache);
+	if ((fd = open(path, O_RDONLY)) == -1)
+	{
+		if (errno == ENOENT)
+			ret = 0;
+		else
+		{
+			fprintf(stderr, _("Error: Failed to open %s for reading: %s.\n"),
+				path, strerror(errno));
+			ret = -1;
+		}
+		free(path);
+		return ret;
+	}
+
+	/* Once open, the entry can be read even if it's removed meanwhile. */
+#ifdef HAVE_ZLIB
+	in = gzdopen(fd, "rb");
+#else /* ! HAVE_ZLIB */
+	in = fdopen(fd, "rb");
+#endif /* ! HAVE_ZLIB */
+	if (!in)
+	{
+		fprintf(stderr, _("Error: Failed to open %s for reading.\n"), path);
+		close(fd);
+		free(path);
+		return -1;
+	}
+
+	/* Mark the entry as recently used. It's fine if we may not. */
+	utime(path, NULL);
+
+	buff = xmalloc(CACHE_BUFFER_SIZE);
+#ifdef HAVE_ZLIB
+	while ((length = gzread(in, buff, CACHE_BUFFER_SIZE)) > 0)
+		if (fwrite(buff, 1, length, output) != (size_t) length)
+			break;
+	if (gzclose(in) != Z_OK || length < 0)
+#else /* ! HAVE_ZLIB */
+	while ((length = fread(buff, 1, CACHE_BUFFER_SIZE, in)))
+		if (fwrite(buff, 1, length, output) != length)
+			break;
+	if (ferror(in) | fclose(in))
+#endif /* ! HAVE_ZLIB */
+	{
+		/* It's broken, let it be created anew next time. */
+		fprintf(stderr, _("Error: Failed to read %s.\n"), path);
+		remove(path);
+		ret = -1;
+	}
+	else if (ferror(output))
+	{
+		fputs(_("Error: Failed to write the output.\n"), stderr);
+		ret = -1;
+	}
+
+	free(buff);
+	free(path);
+	return ret;
+}
+
+int cacheStore (const Cache *__restrict cache, FILE *__restrict input)
+{
+#ifdef HAVE_ZLIB
+	gzFile out;
+#else /* ! HAVE_ZLIB */
+	FILE *out;
+#endif /* ! HAVE_ZLIB */
+	char *tmpPath, *path, *buff;
+	size_t length;
+	mode_t mask;
+	int fd, ret = -1;
+
+	/* The cache is meant to be shared, so the umask decides who may read
+	 * the entry rather than mkstemp(). */
+	tmpPath = xmalloc(strlen(cache->dir)
+		+ sizeof("/" CACHE_TEMP_PREFIX "XXXXXX"));
+	sprintf(tmpPath, "%s/" CACHE_TEMP_PREFIX "XXXXXX", cache->dir);
+	if ((fd = mkstemp(tmpPath)) == -1)
+	{
+		fprintf(stderr, _("Error: Failed to create a file in %s: %s.\n"),
+			cache->dir, strerror(errno));
+		free(tmpPath);
+		return -1;
+	}
+	mask = umask(0);
+	umask(mask);
+	fchmod(fd, 0666 & ~mask);
+
+#ifdef HAVE_ZLIB
+	out = gzdopen(fd, "wb1");
+#else /* ! HAVE_ZLIB */
+	out = fdopen(fd, "wb");
+#endif /* ! HAVE_ZLIB */
+	if (!out)
+	{
+		fprintf(stderr, _("Error: Failed to open %s for writing.\n"),
+			tmpPath);
+		close(fd);
+		remove(tmpPath);
+		free(tmpPath);
+		return -1;
+	}
+
+	buff = xmalloc(CACHE_BUFFER_SIZE);
+	while ((length = fread(buff, 1, CACHE_BUFFER_SIZE, input)))
+	{
+#ifdef HAVE_ZLIB
+		if (gzwrite(out, buff, length) != (int) length)
+#else /* ! HAVE_ZLIB */
+		if (fwrite(buff, 1, length, out) != length)
+#endif /* ! HAVE_ZLIB */
+			goto cacheStore_end;
+	}
+	if (!ferror(input))
+		ret = 0;
+
+cacheStore_end:
+#ifdef HAVE_ZLIB
+	if (gzclose(out) != Z_OK)
+#else /* ! HAVE_ZLIB */
+	if (fclose(out))
+#endif /* ! HAVE_ZLIB */
+		ret = -1;
+	free(buff);
+
+	if (ret)
+	{
+		fprintf(stderr, _("Error: Failed to write to %s.\n"), tmpPath);
+		remove(tmpPath);
+		free(tmpPath);
+		return -1;
+	}
+
+	/* Another process may have stored the same entry meanwhile,
+	 * in which case it's simply replaced. */
+	path = getEntryPath(cache);
+	if (rename(tmpPath, path))
+	{
+		fprintf(stderr, _("Error: Failed to rename %s to %s: %s.\n"),
+			tmpPath, path, strerror(errno));
+		remove(tmpPath);
+		ret = -1;
+	}
+	free(path);
+	free(tmpPath);
+
+	if (!ret)
+		ret = trimCache(cache);
+	return ret;
+}
+
+static int isEntryName (const char *name)
+{
+	size_t length;
+
+	length = strspn(name, "0123456789abcdef");
+	return length == CACHE_KEY_DIGITS && !strcmp(name + length, CACHE_SUFFIX);
+}
+
+static int compareFiles (const void *a, const void *b)
+{
+	const CacheFile *fa = a, *fb = b;
+
+	if (fa->mtime != fb->mtime)
+		return fa->mtime < fb->mtime ? -1 : 1;
+	return strcmp(fa->path, fb->path);
+}
+
+static int trimCache (const Cache *cache)
+{
+	DIR *dir;
+	struct dirent *entry;
+	struct stat st;
+	struct flock lock;
+	CacheFile *files = NULL;
+	size_t nFiles = 0, alloc = 0, i;
+	unsigned long long total = 0;
+	char *path;
+	time_t now;
+	int lockFd;
+
+	/* Processes that would trim the cache at the same time wait for each
+	 * other; the lock is released when the descriptor is closed. */
+	path = xmalloc(strlen(cache->dir) + sizeof("/" CACHE_LOCK_NAME));
+	sprintf(path, "%s/" CACHE_LOCK_NAME, cache->dir);
+	if ((lockFd = open(path, O_RDWR | O_CREAT, 0666)) == -1)
+	{
+		fprintf(stderr, _("Error: Failed to open %s for writing: %s.\n"),
+			path, strerror(errno));
+		free(path);
+		return -1;
+	}
+	free(path);
+
+	memset(&lock, 0, sizeof(lock));
+	lock.l_type = F_WRLCK;
+	lock.l_whence = SEEK_SET;
+	while (fcntl(lockFd, F_SETLKW, &lock) == -1 && errno == EINTR)
+		;
+
+	if (!(dir = opendir(cache->dir)))
+	{
+		fprintf(stderr, _("Error: Failed to open %s: %s.\n"),
+			cache->dir, strerror(errno));
+		close(lockFd);
+		return -1;
+	}
+
+	now = time(NULL);
+	while ((entry = readdir(dir)))
+	{
+		int isEntry = isEntryName(entry->d_name);
+
+		if (!isEntry && strncmp(entry->d_name, CACHE_TEMP_PREFIX,
+			sizeof(CACHE_TEMP_PREFIX) - 1))
+			continue;
+
+		path = xmalloc(strlen(cache->dir) + strlen(entry->d_name) + 2);
+		sprintf(path, "%s/%s", cache->dir, entry->d_name);
+
+		/* Files may disappear under our hands, which is fine. */
+		if (stat(path, &st) || !S_ISREG(st.st_mode))
+			free(path);
+		else if (!isEntry)
+		{
+			if (now - st.st_mtime > CACHE_TEMP_MAX_AGE)
+				remove(path);
+			free(path);
+		}
+		else
+		{
+			if (nFiles == alloc)
+			{
+				alloc = alloc ? alloc << 1 : 64;
+				files = xrealloc(files, alloc * sizeof(CacheFile));
+			}
+			files[nFiles].path = path;
+			files[nFiles].size = st.st_size;
+			files[nFiles].mtime = st.st_mtime;
+			total += st.st_size;
+			nFiles++;
+		}
+	}
+	closedir(dir);
+
+	if (total > cache->limit)
+	{
+		qsort(files, nFiles, sizeof(CacheFile), compareFiles);
+		for (i = 0; i < nFiles && total > cache->limit; i++)
+			if (!remove(files[i].path) || errno == ENOENT)
+				total -= files[i].size;
+	}
+
+	for (i = 0; i < nFiles; i++)
+		free(files[i].path);
+	free(files);
+	close(lockFd);
+	return 0;
+}
@@ -0,0 +1,82 @@
+/**
+ *  @file cache.h
+ *  @brief A cache of conversion outputs shared between processes.
+ *
+ *  Copyright Přemysl Janouch 2010. All rights reserved.
+ *  See the file LICENSE for licensing information.
+ *
+ *  Outputs are stored in a directory, each in a file named after a key
+ *  made of hashes of the inputs and of everything else that affects
+ *  the output, such as options and the version of the program. They're
+ *  compressed with gzip where zlib is available.
+ *
+ *  Entries are written into temporary files that are renamed into place
+ *  once complete, so that other processes never see them half-written.
+ *  The modification time of an entry is updated on every hit. When the
+ *  entries grow over the size limit, the least recently used ones are
+ *  removed, with the directory locked so that processes don't trim
+ *  the cache at the same time.
+ *
+ */
+
+#ifndef CACHE_H_INCLUDED
+#define CACHE_H_INCLUDED
+
+/** A cache of outputs. */
+typedef struct
+{
+	/** The directory holding the entries. */
+	const char *dir;
+	/** How many bytes the entries may take up together. */
+	unsigned long long limit;
+	/** A hash of the files making up the key. */
+	uint64_t fileHash;
+	/** A hash of the strings making up the key. */
+	uint64_t stringHash;
+}
+Cache;
+
+/** The default size limit of a cache. */
+#define CACHE_DEFAULT_LIMIT (1ULL << 30)
+
+
+/** Initialize a cache with an empty key.
+ *  @param[out] cache  A Cache structure to be filled.
+ *  @param[in] dir  The directory holding the cache. It has to stay valid.
+ *  	It's created if it doesn't exist.
+ *  @param[in] limit  How many bytes the entries may take up together.
+ *  @return 0 on success, -1 on failure. An error message is printed.
+ */
+int cacheInit (Cache *__restrict cache, const char *__restrict dir,
+	unsigned long long limit);
+
+/** Add the contents of a file to the key.
+ *  @param[in,out] cache  A cache.
+ *  @param[in] path  The path to the file.
+ *  @return 0 on success, -1 on failure. An error message is printed.
+ */
+int cacheAddFile (Cache *__restrict cache, const char *__restrict path);
+
+/** Add a string to the key.
+ *  @param[in,out] cache  A cache.
+ *  @param[in] str  The string.
+ */
+void cacheAddString (Cache *__restrict cache, const char *__restrict str);
+
+/** Copy the entry for the key into a stream.
+ *  @param[in] cache  A cache.
+ *  @param[in] output  The stream to write the entry to.
+ *  @return 1 on a hit, 0 on a miss, -1 on failure, in which case a part
+ *  	of the entry may have been written. An error message is printed.
+ */
+int cacheFetch (const Cache *__restrict cache, FILE *__restrict output);
+
+/** Store the rest of a stream as the entry for the key, and remove the least
+ *  recently used entries if the cache has grown over its limit.
+ *  @param[in] cache  A cache.
+ *  @param[in] input  The stream to read the entry from.
+ *  @return 0 on success, -1 on failure. An error message is printed.
+ */
+int cacheStore (const Cache *__restrict cache, FILE *__restrict input);
+
+#endif /* ! CACHE_H_INCLUDED */
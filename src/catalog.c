@@ -0,0 +1,397 @@
+/**
+ *  @file catalog.c
+ *  @brief A catalog of event log files.
+ *
+ *  Copyright Přemysl Janouch 2010. All rights reserved.
+ *  See the file LICENSE for licensing information.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "configure.h"
+
+#include "xalloc.h"
+#include "datastruct.h"
+#include "evt.h"
+#include "csv.h"
+#include "hash.h"
+#include "mapfile.h"
+#include "evtlog.h"
+#include "widechar.h"
+#include "timeconv.h"
+#include "catalog.h"
+
+
+/** The number of fields in a catalog record. */
+#define CATALOG_FIELDS (11 + CATALOG_TYPE_COUNT)
+
+
+/** Reset an entry to hold no information. */
+static void clearEntry (CatalogEntry *entry);
+/** Fill in an entry from fields of a catalog record. */
+static int parseEntry (CatalogEntry *__restrict entry, char **fields);
+/** Write an entry as a catalog record. */
+static int writeEntry (CsvWriter __restrict wrt,
+	const CatalogEntry *__restrict entry);
+/** Get the counter index for an event type. */
+static int typeIndex (unsigned int type);
+
+
+void catalogInit (Catalog *catalog)
+{
+	stringTableInit(&catalog->paths);
+	catalog->entries = NULL;
+	catalog->alloc = 0;
+}
+
+static void clearEntry (CatalogEntry *entry)
+{
+	int i;
+
+	free(entry->host);
+	entry->host = NULL;
+	entry->size = 0;
+	entry->mtime = 0;
+	entry->hash = 0;
+	entry->minTimeGenerated = entry->maxTimeGenerated = 0;
+	entry->oldestRecordNumber = entry->currentRecordNumber = 0;
+	entry->flags = 0;
+	entry->recordCount = 0;
+	for (i = 0; i < CATALOG_TYPE_COUNT; i++)
+		entry->typeCounts[i] = 0;
+}
+
+CatalogEntry *catalogFind (Catalog *__restrict catalog,
+	const char *__restrict path)
+{
+	unsigned int id;
+
+	if (!(id = stringTableFind(&catalog->paths, path)))
+		return NULL;
+	return &catalog->entries[id - 1];
+}
+
+CatalogEntry *catalogAdd (Catalog *__restrict catalog,
+	const char *__restrict path)
+{
+	CatalogEntry *entry;
+	unsigned int id;
+	int added;
+
+	id = stringTableIntern(&catalog->paths, path, &added);
+	if (!added)
+		return &catalog->entries[id - 1];
+
+	if (catalog->paths.count > catalog->alloc)
+	{
+		catalog->alloc = catalog->alloc ? catalog->alloc << 1 : 16;
+		catalog->entries = xrealloc(catalog->entries,
+			catalog->alloc * sizeof(CatalogEntry));
+	}
+
+	entry = &catalog->entries[id - 1];
+	entry->path = stringTableGet(&catalog->paths, id);
+	entry->host = NULL;
+	clearEntry(entry);
+	return entry;
+}
+
+static int parseEntry (CatalogEntry *__restrict entry, char **fields)
+{
+	char *end;
+	int i;
+
+	clearEntry(entry);
+	entry->size = strtoull(fields[1], &end, 10);
+	if (*end)
+		return -1;
+	entry->mtime = strtoll(fields[2], &end, 10);
+	if (*end)
+		return -1;
+	entry->hash = strtoull(fields[3], &end, 16);
+	if (*end)
+		return -1;
+
+	if (*fields[4])
+	{
+		entry->host = xmalloc(strlen(fields[4]) + 1);
+		strcpy(entry->host, fields[4]);
+	}
+	if (*fields[5] && *fields[6])
+	{
+		entry->minTimeGenerated = parseTime(fields[5]);
+		entry->maxTimeGenerated = parseTime(fields[6]);
+	}
+
+	entry->oldestRecordNumber = strtoul(fields[7], NULL, 10);
+	entry->currentRecordNumber = strtoul(fields[8], NULL, 10);
+	entry->flags = strtoul(fields[9], NULL, 10);
+	entry->recordCount = strtoul(fields[10], NULL, 10);
+	for (i = 0; i < CATALOG_TYPE_COUNT; i++)
+		entry->typeCounts[i] = strtoul(fields[11 + i], NULL, 10);
+	return 0;
+}
+
+int catalogLoad (Catalog *__restrict catalog, const char *__restrict path)
+{
+	FILE *input;
+	CsvReader rdr;
+	CsvReadStatus status;
+	char *fields[CATALOG_FIELDS], *field;
+	int nFields = 0, line = 1, ret = 0, i;
+
+	if (!(input = fopen(path, "rb")))
+	{
+		if (errno == ENOENT)
+			return 0;
+		fprintf(stderr, _("Error: Failed to open %s for reading.\n"), path);
+		return -1;
+	}
+
+	rdr = csvCreateReader(input);
+	while (!ret && (status = csvRead(rdr, &field)) != CSV_EOF)
+	{
+		switch (status)
+		{
+		case CSV_FIELD:
+			if (nFields == CATALOG_FIELDS)
+			{
+				free(field);
+				ret = -1;
+			}
+			else
+				fields[nFields++] = field;
+			break;
+		case CSV_EOR:
+			/* Empty lines, including the one at the end, are skipped. */
+			if (nFields == 1 && !*fields[0])
+				;
+			else if (nFields != CATALOG_FIELDS
+				|| parseEntry(catalogAdd(catalog, fields[0]), fields))
+				ret = -1;
+			for (i = 0; i < nFields; i++)
+				free(fields[i]);
+			nFields = 0;
+			line++;
+			break;
+		default:
+			ret = -1;
+		}
+	}
+
+	for (i = 0; i < nFields; i++)
+		free(fields[i]);
+	csvDestroyReader(rdr);
+	fclose(input);
+
+	if (ret)
+		fprintf(stderr, _("Error: Record %d of the catalog is invalid.\n"),
+			line);
+	return ret;
+}
+
+static int writeEntry (CsvWriter __restrict wrt,
+	const CatalogEntry *__restrict entry)
+{
+	time_t t;
+	/* Yes, the buffer is large enough. */
+	char buff[40];
+	int i;
+
+	csvWrite(wrt, entry->path);
+	snprintf(buff, sizeof(buff), "%llu", entry->size);
+	csvWrite(wrt, buff);
+	snprintf(buff, sizeof(buff), "%lld", entry->mtime);
+	csvWrite(wrt, buff);
+	snprintf(buff, sizeof(buff), "%016llx", (unsigned long long) entry->hash);
+	csvWrite(wrt, buff);
+	csvWrite(wrt, entry->host ? entry->host : "");
+
+	/* Empty logs have no time range. */
+	if (!entry->recordCount)
+	{
+		csvWrite(wrt, "");
+		csvWrite(wrt, "");
+	}
+	else
+	{
+		t = entry->minTimeGenerated;
+		strftime(buff, sizeof(buff), "%Y-%m-%d %H:%M:%S", gmtime(&t));
+		csvWrite(wrt, buff);
+		t = entry->maxTimeGenerated;
+		strftime(buff, sizeof(buff), "%Y-%m-%d %H:%M:%S", gmtime(&t));
+		csvWrite(wrt, buff);
+	}
+
+	snprintf(buff, sizeof(buff), "%u", entry->oldestRecordNumber);
+	csvWrite(wrt, buff);
+	snprintf(buff, sizeof(buff), "%u", entry->currentRecordNumber);
+	csvWrite(wrt, buff);
+	snprintf(buff, sizeof(buff), "%u", entry->flags);
+	csvWrite(wrt, buff);
+	snprintf(buff, sizeof(buff), "%u", entry->recordCount);
+	csvWrite(wrt, buff);
+	for (i = 0; i < CATALOG_TYPE_COUNT; i++)
+	{
+		snprintf(buff, sizeof(buff), "%u", entry->typeCounts[i]);
+		csvWrite(wrt, buff);
+	}
+	return csvWrite(wrt, NULL);
+}
+
+int catalogSave (const Catalog *__restrict catalog,
+	const char *__restrict path)
+{
+	FILE *output;
+	CsvWriter wrt;
+	char *tmpPath;
+	size_t i;
+	int ret = 0;
+
+	/* Write a new file and move it over the old one, so that readers
+	 * never see the catalog half-written. */
+	tmpPath = xmalloc(strlen(path) + 5);
+	strcpy(tmpPath, path);
+	strcat(tmpPath, ".tmp");
+
+	if (!(output = fopen(tmpPath, "wb")))
+	{
+		fprintf(stderr, _("Error: Failed to open %s for writing.\n"),
+			tmpPath);
+		free(tmpPath);
+		return -1;
+	}
+
+	wrt = csvCreateWriter(output);
+	for (i = 0; i < catalogCount(catalog) && !ret; i++)
+		if (writeEntry(wrt, &catalog->entries[i]))
+			ret = -1;
+	csvDestroyWriter(wrt);
+
+	if (fclose(output))
+		ret = -1;
+	if (ret)
+		fprintf(stderr, _("Error: Failed to write to %s.\n"), tmpPath);
+#ifdef _WIN32
+	/* rename() doesn't replace existing files on Windows. */
+	else if (remove(path) && errno != ENOENT)
+		ret = -1;
+#endif /* _WIN32 */
+	if (!ret && rename(tmpPath, path))
+	{
+		fprintf(stderr, _("Error: Failed to rename %s to %s.\n"),
+			tmpPath, path);
+		ret = -1;
+	}
+	if (ret)
+		remove(tmpPath);
+
+	free(tmpPath);
+	return ret;
+}
+
+int catalogIsCurrent (const CatalogEntry *entry)
+{
+	struct stat st;
+
+	if (stat(entry->path, &st))
+		return 0;
+	return (unsigned long long) st.st_size == entry->size
+		&& (long long) st.st_mtime == entry->mtime;
+}
+
+static int typeIndex (unsigned int type)
+{
+	switch (type)
+	{
+	case EVT_ERROR_TYPE:
+		return CATALOG_ERROR;
+	case EVT_WARNING_TYPE:
+		return CATALOG_WARNING;
+	case EVT_INFORMATION_TYPE:
+		return CATALOG_INFORMATION;
+	case EVT_AUDIT_SUCCESS:
+		return CATALOG_AUDIT_SUCCESS;
+	case EVT_AUDIT_FAILURE:
+		return CATALOG_AUDIT_FAILURE;
+	default:
+		return CATALOG_OTHER;
+	}
+}
+
+int catalogScan (CatalogEntry *entry)
+{
+	EvtLog log;
+	EvtLogRecord record;
+	EvtLogStatus status;
+	struct stat st;
+	int offset;
+	char *s;
+
+	clearEntry(entry);
+	if (stat(entry->path, &st))
+	{
+		fprintf(stderr, _("Error: Failed to open %s for reading.\n"),
+			entry->path);
+		return -1;
+	}
+	if (evtLogOpen(&log, entry->path))
+		return -1;
+
+	entry->size = st.st_size;
+	entry->mtime = st.st_mtime;
+	entry->hash = hash64(log.file.data, log.file.length, 0);
+	entry->oldestRecordNumber = log.hdr->oldestRecordNumber;
+	entry->currentRecordNumber = log.hdr->currentRecordNumber;
+	entry->flags = log.hdr->flags;
+
+	while ((status = evtLogNext(&log, &record)) == EVT_LOG_RECORD)
+	{
+		const EvtRecord *rec = record.rec;
+
+		if (!entry->recordCount++)
+			entry->minTimeGenerated = entry->maxTimeGenerated
+				= rec->timeGenerated;
+		else if (rec->timeGenerated < entry->minTimeGenerated)
+			entry->minTimeGenerated = rec->timeGenerated;
+		else if (rec->timeGenerated > entry->maxTimeGenerated)
+			entry->maxTimeGenerated = rec->timeGenerated;
+		entry->typeCounts[typeIndex(rec->eventType)]++;
+
+		/* The computer name follows the source name. */
+		if (entry->host)
+			continue;
+		if (!(offset = decodeWideString(record.nonFixed,
+			record.nonFixedLength, &s)))
+			continue;
+		free(s);
+		if (decodeWideString((const uint16_t *) ((const char *)
+			record.nonFixed + offset), record.nonFixedLength - offset, &s))
+			entry->host = s;
+	}
+
+	evtLogClose(&log);
+	if (status != EVT_LOG_END)
+	{
+		fprintf(stderr, _("Error: Failed to read %s.\n"), entry->path);
+		return -1;
+	}
+	return 0;
+}
+
+void catalogDestroy (Catalog *catalog)
+{
+	size_t i;
+
+	for (i = 0; i < catalogCount(catalog); i++)
+		free(catalog->entries[i].host);
+	free(catalog->entries);
+	stringTableDestroy(&catalog->paths);
+}
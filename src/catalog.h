@@ -0,0 +1,139 @@
+/**
+ *  @file catalog.h
+ *  @brief A catalog of event log files.
+ *
+ *  Copyright Přemysl Janouch 2010. All rights reserved.
+ *  See the file LICENSE for licensing information.
+ *
+ *  The catalog keeps metadata of many .evt files, so that files of interest
+ *  can be selected without opening every one of them. It's stored as CSV,
+ *  one file per record, with fields in the order of @a CatalogEntry.
+ *  Size and modification time of each file are kept to find out whether
+ *  the file has to be scanned again.
+ *
+ */
+
+#ifndef CATALOG_H_INCLUDED
+#define CATALOG_H_INCLUDED
+
+/** Counters of records by their type. */
+enum
+{
+	CATALOG_ERROR,
+	CATALOG_WARNING,
+	CATALOG_INFORMATION,
+	CATALOG_AUDIT_SUCCESS,
+	CATALOG_AUDIT_FAILURE,
+	/** Records of an unknown type. */
+	CATALOG_OTHER,
+	CATALOG_TYPE_COUNT
+};
+
+/** Metadata of an event log file. */
+typedef struct
+{
+	/** The path to the file, as given when it was scanned. */
+	const char *path;
+	/** The size of the file in bytes. */
+	unsigned long long size;
+	/** The time of last modification of the file. */
+	long long mtime;
+	/** A hash of the contents of the file, see hash.h. */
+	uint64_t hash;
+	/** The computer name in the oldest record. */
+	char *host;
+	/** The earliest time generated among the records. */
+	uint32_t minTimeGenerated;
+	/** The latest time generated among the records. */
+	uint32_t maxTimeGenerated;
+	/** The number of the oldest record, from the header. */
+	uint32_t oldestRecordNumber;
+	/** The number of the next record, from the header. */
+	uint32_t currentRecordNumber;
+	/** Flags of the log, from the header. */
+	uint32_t flags;
+	/** The number of records in the log. */
+	uint32_t recordCount;
+	/** The number of records of each type. */
+	uint32_t typeCounts[CATALOG_TYPE_COUNT];
+}
+CatalogEntry;
+
+/** A catalog of event log files. */
+typedef struct
+{
+	/** Paths of the files. Their identifiers index @a entries plus one. */
+	StringTable paths;
+	/** The entries. */
+	CatalogEntry *entries;
+	/** How many entries have been allocated. */
+	size_t alloc;
+}
+Catalog;
+
+
+/** Initialize an empty catalog.
+ *  @param[out] catalog  A Catalog object.
+ */
+void catalogInit (Catalog *catalog);
+
+/** The number of entries in a catalog.
+ *  @param[in] catalog  A catalog.
+ *  @return The number of entries.
+ */
+static inline size_t catalogCount (const Catalog *catalog)
+{
+	return catalog->paths.count;
+}
+
+/** Load entries from a file. A file that doesn't exist counts
+ *  as an empty catalog.
+ *  @param[in,out] catalog  A catalog.
+ *  @param[in] path  The path to the catalog file.
+ *  @return 0 on success, -1 on failure. An error message is printed.
+ */
+int catalogLoad (Catalog *__restrict catalog, const char *__restrict path);
+
+/** Save a catalog into a file. The file is replaced atomically.
+ *  @param[in] catalog  A catalog.
+ *  @param[in] path  The path to the catalog file.
+ *  @return 0 on success, -1 on failure. An error message is printed.
+ */
+int catalogSave (const Catalog *__restrict catalog,
+	const char *__restrict path);
+
+/** Find the entry for a file.
+ *  @param[in] catalog  A catalog.
+ *  @param[in] path  The path to the file.
+ *  @return The entry, or NULL if there's none.
+ */
+CatalogEntry *catalogFind (Catalog *__restrict catalog,
+	const char *__restrict path);
+
+/** Get the entry for a file, creating an empty one if there's none.
+ *  @param[in,out] catalog  A catalog.
+ *  @param[in] path  The path to the file.
+ *  @return The entry. It's only valid until the next call.
+ */
+CatalogEntry *catalogAdd (Catalog *__restrict catalog,
+	const char *__restrict path);
+
+/** Find out whether an entry is up to date with its file, judging by
+ *  the size and modification time of the file.
+ *  @param[in] entry  An entry.
+ *  @return Non-zero if the file doesn't need to be scanned again.
+ */
+int catalogIsCurrent (const CatalogEntry *entry);
+
+/** Scan an event log file and fill in its entry.
+ *  @param[in,out] entry  The entry of the file.
+ *  @return 0 on success, -1 on failure. An error message is printed.
+ */
+int catalogScan (CatalogEntry *entry);
+
+/** Destroy a catalog.
+ *  @param[in,out] catalog  A catalog.
+ */
+void catalogDestroy (Catalog *catalog);
+
+#endif /* ! CATALOG_H_INCLUDED */
@@ -0,0 +1,254 @@
+/**
+ *  @file convert.c
+ *  @brief Passing records of logs to a sink.
+ *
+ *  Copyright Přemysl Janouch 2010. All rights reserved.
+ *  See the file LICENSE for licensing information.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "configure.h"
+
+#include "xalloc.h"
+#include "datastruct.h"
+#include "evt.h"
+#include "widechar.h"
+#include "mapfile.h"
+#include "evtlog.h"
+#include "acmatch.h"
+#include "fpset.h"
+#include "record.h"
+#include "sink.h"
+#include "scan.h"
+#include "filter.h"
+#include "convert.h"
+
+
+/** Find out whether the insertion strings of a record match. */
+static int recordMatches (AcMatcher matcher, const EvtRecord *__restrict rec,
+	const void *__restrict nonFixed, size_t nonFixedLength);
+/** Pass a record to the sink unless it's a duplicate or doesn't match.
+ *  @return 0 on success, -1 on failure.
+ */
+static int passRecord (Conversion *__restrict conv,
+	const EvtLogRecord *__restrict record);
+/** Read records in batches and pass those that get through the filter. */
+static int runBatches (Conversion *__restrict conv, EvtLog *__restrict log,
+	EvtLogStatus (*next) (EvtLog *__restrict, EvtLogRecord *__restrict));
+
+
+void conversionInit (Conversion *conv)
+{
+	conv->sink = NULL;
+	recordFieldsInit(&conv->fields);
+	conv->matcher = NULL;
+	conv->seen = NULL;
+	scanFilterInit(&conv->filter);
+	conv->batch = NULL;
+	conv->plan = NULL;
+	conv->reverse = 0;
+	conv->last = 0;
+	conv->records = 0;
+}
+
+void conversionDestroy (Conversion *conv)
+{
+	recordFieldsDestroy(&conv->fields);
+	if (conv->matcher)
+		acDestroyMatcher(conv->matcher);
+	if (conv->seen)
+		fpSetDestroy(conv->seen);
+	scanFilterDestroy(&conv->filter);
+	if (conv->batch)
+		scanBatchDestroy(conv->batch);
+	if (conv->plan)
+		filterDestroy(conv->plan);
+}
+
+AcMatcher conversionLoadPatterns (const char *path, int foldCase)
+{
+	MappedFile file;
+	Buffer line, wide;
+	AcMatcher matcher;
+	const char *p, *end, *eol;
+	int offset;
+
+	if (mapFileOpen(&file, path))
+	{
+		fprintf(stderr, _("Error: Failed to open %s for reading.\n"), path);
+		return NULL;
+	}
+
+	matcher = acCreateMatcher(foldCase);
+	bufferInit(&line);
+	bufferInit(&wide);
+
+	p = file.data;
+	end = p + file.length;
+	for (; p < end; p = eol + 1)
+	{
+		if (!(eol = memchr(p, '\n', end - p)))
+			eol = end;
+
+		bufferClear(&line);
+		bufferAppend(&line, p, eol - p, 0);
+		if (line.used && ((char *) line.data)[line.used - 1] == '\r')
+			bufferShrink(&line, 1);
+		if (!line.used)
+			continue;
+		bufferAppendChar(&line, '\0');
+
+		bufferClear(&wide);
+		if ((offset = encodeMBStringToBuffer(line.data, &wide)) == -1)
+		{
+			fprintf(stderr, _("Error: Failed to convert a pattern "
+				"in %s.\n"), path);
+			acDestroyMatcher(matcher);
+			matcher = NULL;
+			break;
+		}
+		/* Leave out the terminating NULL char. */
+		acAddPattern(matcher, (uint16_t *) ((char *) wide.data + offset),
+			(wide.used - offset) / sizeof(uint16_t) - 1);
+	}
+
+	bufferDestroy(&line);
+	bufferDestroy(&wide);
+	mapFileClose(&file);
+
+	if (matcher)
+		acCompile(matcher);
+	return matcher;
+}
+
+static int recordMatches (AcMatcher matcher, const EvtRecord *__restrict rec,
+	const void *__restrict nonFixed, size_t nonFixedLength)
+{
+	size_t start, end;
+
+	/* The strings end where the data begins, or else at the trailing
+	 * length field. Patterns contain no NULL chars, so no match can span
+	 * two strings, but whatever lies between the last string and the end,
+	 * such as padding, is searched as well.
+	 */
+	if (rec->stringOffset < sizeof(EvtRecord) || !rec->numStrings
+		|| nonFixedLength < sizeof(uint32_t))
+		return 0;
+	start = rec->stringOffset - sizeof(EvtRecord);
+	end = nonFixedLength - sizeof(uint32_t);
+	if (rec->dataOffset >= rec->stringOffset
+		&& rec->dataOffset - sizeof(EvtRecord) < end)
+		end = rec->dataOffset - sizeof(EvtRecord);
+	if (start >= end)
+		return 0;
+
+	return acSearch(matcher, (const uint16_t *) ((const char *) nonFixed
+		+ start), (end - start) / sizeof(uint16_t));
+}
+
+int conversionRun (Conversion *__restrict conv, EvtLog *__restrict log)
+{
+	EvtLogRecord record;
+	EvtLogStatus status = EVT_LOG_RECORD;
+	EvtLogStatus (*next) (EvtLog *__restrict, EvtLogRecord *__restrict);
+	unsigned long count;
+
+	if (conv->sink->begin(conv->sink, log->hdr, log->file.length))
+		return -1;
+
+	/* Going backwards, the count limits the loop below. Otherwise
+	 * we find where the last records begin and go forward from there. */
+	if ((conv->reverse || conv->last) && evtLogSeekEnd(log))
+		return -1;
+	if (conv->last && !conv->reverse)
+	{
+		for (count = 0; count < conv->last
+			&& (status = evtLogPrev(log, &record)) == EVT_LOG_RECORD; )
+			count++;
+		if (status == EVT_LOG_ERROR)
+			return -1;
+		evtLogSeek(log, log->offset);
+	}
+
+	next = conv->reverse ? evtLogPrev : evtLogNext;
+	if (!scanFilterIsEmpty(&conv->filter))
+		return runBatches(conv, log, next);
+
+	for (count = 0; !(conv->reverse && conv->last && count >= conv->last)
+		&& (status = next(log, &record)) == EVT_LOG_RECORD; count++)
+		if (passRecord(conv, &record))
+			return -1;
+	return status == EVT_LOG_ERROR ? -1 : 0;
+}
+
+static int runBatches (Conversion *__restrict conv, EvtLog *__restrict log,
+	EvtLogStatus (*next) (EvtLog *__restrict, EvtLogRecord *__restrict))
+{
+	EvtLogStatus status;
+	unsigned long count = 0;
+	size_t limit, i;
+
+	if (!conv->batch)
+		conv->batch = scanBatchCreate();
+
+	do
+	{
+		limit = SCAN_BATCH_SIZE;
+		if (conv->reverse && conv->last)
+		{
+			if (count >= conv->last)
+				break;
+			if (conv->last - count < limit)
+				limit = conv->last - count;
+		}
+
+		status = scanBatchRead(conv->batch, log, next, limit);
+		count += conv->batch->count;
+
+		/* Only the selected records are looked at any further. */
+		scanBatchSelect(conv->batch, &conv->filter);
+		for (i = 0; i < conv->batch->count; i++)
+			if (conv->batch->selected[i]
+				&& passRecord(conv, &conv->batch->records[i]))
+				return -1;
+	}
+	while (status == EVT_LOG_RECORD);
+	return status == EVT_LOG_ERROR ? -1 : 0;
+}
+
+static int passRecord (Conversion *__restrict conv,
+	const EvtLogRecord *__restrict record)
+{
+	if (conv->plan && !filterMatches(conv->plan, record))
+		return 0;
+
+	if (conv->seen)
+	{
+		Fingerprint fp;
+		int seen;
+
+		/* The computer name is a part of the hashed data. */
+		fp.hash = evtLogHashRecord(record);
+		fp.recordNumber = record->rec->recordNumber;
+		fp.timeGenerated = record->rec->timeGenerated;
+		if ((seen = fpSetAdd(conv->seen, &fp)) == -1)
+			return -1;
+		if (seen)
+			return 0;
+	}
+
+	if (conv->matcher && !recordMatches(conv->matcher,
+		record->rec, record->nonFixed, record->nonFixedLength))
+		return 0;
+
+	recordDecode(&conv->fields, record->rec,
+		record->nonFixed, record->nonFixedLength);
+	if (conv->sink->write(conv->sink, &conv->fields))
+		return -1;
+	conv->records++;
+	return 0;
+}
@@ -0,0 +1,70 @@
+/**
+ *  @file convert.h
+ *  @brief Passing records of logs to a sink.
+ *
+ *  Copyright Přemysl Janouch 2010. All rights reserved.
+ *  See the file LICENSE for licensing information.
+ *
+ */
+
+#ifndef CONVERT_H_INCLUDED
+#define CONVERT_H_INCLUDED
+
+/** How much memory to use for recognizing duplicate records. */
+#define CONVERSION_DEDUPE_MEMORY (64 << 20)
+
+/** The settings and state of a conversion. */
+typedef struct
+{
+	/** Where the records go. */
+	Sink *sink;
+	/** The current record, decoded. */
+	RecordFields fields;
+	/** If not NULL, only records with matching strings are written. */
+	AcMatcher matcher;
+	/** If not NULL, records that have already been seen are dropped. */
+	FingerprintSet seen;
+	/** Only records passing this filter are written. Unless it's empty,
+	 *  records are read and filtered in batches. */
+	ScanFilter filter;
+	/** The batch of records being filtered, or NULL if none yet. */
+	ScanBatch *batch;
+	/** If not NULL, only records matching the rest of a compiled filter
+	 *  expression are written. */
+	FilterPlan *plan;
+	/** Whether to go from the newest record to the oldest one. */
+	int reverse;
+	/** If not zero, only this many of the newest records are read. */
+	unsigned long last;
+	/** How many records have been written. */
+	unsigned long long records;
+}
+Conversion;
+
+
+/** Initialize a conversion. All the settings are off and there's no sink.
+ *  @param[out] conv  A Conversion structure.
+ */
+void conversionInit (Conversion *conv);
+
+/** Pass the records of a log to the sink.
+ *  @param[in,out] conv  A conversion.
+ *  @param[in,out] log  An opened log.
+ *  @return 0 on success, -1 on failure. An error message is printed.
+ */
+int conversionRun (Conversion *__restrict conv, EvtLog *__restrict log);
+
+/** Free the resources of a conversion, including the matcher, the set
+ *  of fingerprints and the filters. The sink is left alone.
+ *  @param[in,out] conv  A conversion.
+ */
+void conversionDestroy (Conversion *conv);
+
+/** Load patterns from a file, one per line, into a new matcher.
+ *  @param[in] path  The path to the file.
+ *  @param[in] foldCase  Whether to ignore case.
+ *  @return The matcher, or NULL on failure. An error message is printed.
+ */
+AcMatcher conversionLoadPatterns (const char *path, int foldCase);
+
+#endif /* ! CONVERT_H_INCLUDED */
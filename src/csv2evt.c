@@ -7,7 +7,7 @@
  *
  */
 
-/* strptime, ftruncate */
+/* ftruncate */
 #define _XOPEN_SOURCE 700
 
 #include <stdio.h>
@@ -18,16 +18,21 @@
 #include "configure.h"
 
 #include "xalloc.h"
+#include "datastruct.h"
 #include "csv.h"
 #include "evt.h"
-#include "base64.h"
-#include "sid.h"
-#include "widechar.h"
-#include "datastruct.h"
+#include "options.h"
+#include "mapfile.h"
+#include "encode.h"
 
 
 /** Reindex log records. */
 #define CSV2EVT_REINDEX 1
+/** Append records to an existing log. */
+#define CSV2EVT_APPEND 2
+
+/** The size of the stream buffer for files of a split log. */
+#define CSV2EVT_SPLIT_BUFFER_SIZE (1 << 20)
 
 /** The first field in a record was empty. */
 #define RECORD_EMPTY_FIRST_FIELD 1
@@ -35,6 +40,11 @@
 /** An error happened, don't output the record. */
 #define RECORD_IGNORE 2
 
+/** We're at the end of a record. */
+#define FIELD_END RECORD_FIELD_COUNT
+/** Ignore the fields. */
+#define FIELD_IGNORE (RECORD_FIELD_COUNT + 1)
+
 
 /** A conversion context to be passed to various functions. */
 typedef struct
@@ -50,6 +60,16 @@ typedef struct
 
 	/** The output file. */
 	FILE *output;
+	/** If not NULL, the log is split into several files instead of
+	 *  wrapping, and their paths are made from this one. */
+	const char *splitPath;
+	/** The number of the current file of a split log. */
+	unsigned splitCount;
+	/** The current offset in a file of a split log. */
+	long splitOffset;
+	/** The file event data are referenced in, or NULL if they're
+	 *  stored directly in the CSV, encoded in base64. */
+	const MappedFile *blob;
 	/** Options related to log processing. See CSV2EVT_*. */
 	int options;
 	/** Current line number. */
@@ -69,36 +89,45 @@ typedef struct
 	 *  See the RECORD_* defines.
 	 */
 	int recFlags;
-	/** The current field we're parsing. The order in which
-	 *  the fields are parsed may be changed by swapping
-	 *  the order in which the enumeration items appear. */
-	enum
-	{
-		FIELD_RECORD_NO,
-		FIELD_TIME_GEN,
-		FIELD_TIME_WRI,
-		FIELD_EVENT_ID,
-		FIELD_EVENT_TYPE,
-		FIELD_EVENT_CAT,
-		FIELD_SOURCE_NAME,
-		FIELD_COMPUTER_NAME,
-		FIELD_SID,
-		FIELD_STRINGS,
-		FIELD_DATA,
-		/* We're at the end. */
-		FIELD_END,
-		/* Ignore the fields. */
-		FIELD_IGNORE
-	}
+	/** The current field we're parsing, see RecordField,
+	 *  or one of FIELD_END and FIELD_IGNORE. */
+	int
 	field;
 }
 ConvCtx;
 
 
-/** Process the input file and output the result into the output file. */
+/** Print usage information. */
+static void printUsage (FILE *stream);
+
+/** Process the input file and output the result into the output file,
+ *  or into several files if @a splitPath isn't NULL. */
 static void processFile (FILE *__restrict input, FILE *__restrict output,
+	const char *__restrict splitPath, const MappedFile *__restrict blob,
 	int options);
 
+/** Reset the header and the EOF record for a new, empty log.
+ *  @param[in,out] ctx  A conversion context.
+ */
+static void resetLog (ConvCtx *ctx);
+
+/** Restore the state of an existing log to continue writing into it.
+ *  @param[in,out] ctx  A conversion context.
+ *  @return -1 on error, 0 on success. An error message is printed.
+ */
+static int loadLog (ConvCtx *ctx);
+
+/** Start writing into the next file of a split log.
+ *  @param[in,out] ctx  A conversion context.
+ */
+static void startSplitFile (ConvCtx *ctx);
+
+/** Write the EOF record and the header, finishing the output file.
+ *  Files of a split log are also closed.
+ *  @param[in,out] ctx  A conversion context.
+ */
+static void finishOutput (ConvCtx *ctx);
+
 /** Tell the position in the file specified by @a stream and call exit()
  *  if the operation fails.
  */
@@ -121,13 +150,6 @@ static int readFilesizeRecord
 /** Process a field from the input file. */
 static void processField (ConvCtx *ctx);
 
-/** Parse a time token.
- *  @param[in] token  The string to be parsed.
- *  @return -1 on error, otherwise a time_t value that corresponds
- *          to the time the token represents.
- */
-static time_t parseTime (const char *token);
-
 /** Write a record to the output file.
  *  @param[in,out] ctx  A conversion context.
  */
@@ -158,10 +180,24 @@ static int getMoreSpace (ConvCtx *ctx, long newRecordOffset);
 static void resetRecord (ConvCtx *ctx);
 
 
+/** Command line options. */
+static const OptionSpec optionSpecs[] =
+{
+	{'b', "blob", 1},
+	{'s', "split", 0},
+	{'a', "append", 0},
+	{'h', "help", 0},
+	{0, NULL, 0}
+};
+
+
 int main (int argc, char *argv[])
 {
-	FILE *output, *input;
-	int options;
+	OptionsState opts = OPTIONS_INITIALIZER;
+	MappedFile blob;
+	FILE *output = NULL, *input;
+	const char *blobPath = NULL, *splitPath = NULL;
+	int options, opt, split = 0;
 
 #ifdef HAVE_GETTEXT
     /* All we want is localized messages. */
@@ -178,37 +214,89 @@ int main (int argc, char *argv[])
 	/* TODO: An option (-i) to reindex entries. */
 	options = 0;
 
-	if (argc == 1 || argc > 3)
+	while ((opt = optionsNext(&opts, argc, argv, optionSpecs)) != OPTIONS_END)
 	{
-		fputs(_("Usage: csv2evt input-file [output-file]\n"), stderr);
+		switch (opt)
+		{
+		case 'b':
+			blobPath = opts.arg;
+			break;
+		case 's':
+			split = 1;
+			break;
+		case 'a':
+			options |= CSV2EVT_APPEND;
+			break;
+		case 'h':
+			printUsage(stdout);
+			exit(EXIT_SUCCESS);
+		default:
+			printUsage(stderr);
+			exit(EXIT_FAILURE);
+		}
+	}
+	argc -= opts.index;
+	argv += opts.index;
+
+	/* A split log can't go to the standard output, neither can
+	 * an existing log be appended to there. */
+	if (argc < 1 || argc > 2 || ((split || (options & CSV2EVT_APPEND))
+		&& (argc != 2 || !*argv[1] || !strcmp(argv[1], "-")))
+		|| (split && (options & CSV2EVT_APPEND)))
+	{
+		printUsage(stderr);
 		exit(EXIT_FAILURE);
 	}
 
-	if (!strcmp(argv[1], "-"))
+	if (!strcmp(argv[0], "-"))
 		input = stdin;
-	else if (!(input = fopen(argv[1], "rb")))
+	else if (!(input = fopen(argv[0], "rb")))
 	{
-		fprintf(stderr, _("Failed to open %s for reading.\n"), argv[1]);
+		fprintf(stderr, _("Failed to open %s for reading.\n"), argv[0]);
 		exit(EXIT_FAILURE);
 	}
 
-	output = stdout;
-	if (argc == 3 && *argv[2] && strcmp(argv[2], "-")
-		&& !(output = fopen(argv[2], "w+b")))
+	if (split)
+		splitPath = argv[1];
+	else
+	{
+		output = stdout;
+		if (argc == 2 && *argv[1] && strcmp(argv[1], "-")
+			&& !(output = fopen(argv[1],
+			(options & CSV2EVT_APPEND) ? "r+b" : "w+b")))
+		{
+			fprintf(stderr, _("Failed to open %s for writing.\n"), argv[1]);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	if (blobPath && mapFileOpen(&blob, blobPath))
 	{
-		fprintf(stderr, _("Failed to open %s for writing.\n"), argv[2]);
+		fprintf(stderr, _("Failed to open %s for reading.\n"), blobPath);
 		exit(EXIT_FAILURE);
 	}
 
-	processFile(input, output, options);
+	processFile(input, output, splitPath, blobPath ? &blob : NULL, options);
 
 	fclose(input);
-	fclose(output);
+	if (output)
+		fclose(output);
+	if (blobPath)
+		mapFileClose(&blob);
 
 	return 0;
 }
 
+static void printUsage (FILE *stream)
+{
+	fputs(_("Usage: csv2evt [-b blob-file] input-file [output-file]\n"
+		"       csv2evt -s [-b blob-file] input-file output-file\n"
+		"       csv2evt -a [-b blob-file] input-file output-file\n"),
+		stream);
+}
+
 static void processFile (FILE *__restrict input, FILE *__restrict output,
+	const char *__restrict splitPath, const MappedFile *__restrict blob,
 	int options)
 {
 	CsvReader rdr;
@@ -219,57 +307,55 @@ static void processFile (FILE *__restrict input, FILE *__restrict output,
 	ConvCtx ctx;
 	int inputEOF = 0;
 
-	hdr.headerSize = 0x30;
-	hdr.endHeaderSize = 0x30;
-	hdr.signature = EVT_SIGNATURE;
-	hdr.majorVersion = 1;
-	hdr.minorVersion = 1;
-	hdr.startOffset = sizeof(hdr);
-	hdr.endOffset = sizeof(hdr);
-	hdr.oldestRecordNumber = 0;
-	hdr.currentRecordNumber = 1;
-	hdr.flags = 0;
-	hdr.retention = 0;
-
-	eof.recordSizeBeginning = 0x28;
-	eof.recordSizeEnd = 0x28;
-	eof.one = 0x11111111;
-	eof.two = 0x22222222;
-	eof.three = 0x33333333;
-	eof.four = 0x44444444;
-	eof.beginRecord = sizeof(hdr);
-	eof.endRecord = sizeof(hdr);
-	eof.oldestRecordNumber = 0;
-	eof.currentRecordNumber = 1;
-
-	/* Create a CSV reader object. */
-	rdr = csvCreateReader(input);
-
-	/* Read the output file size and set it on the output file. */
-	if (readFilesizeRecord(&hdr, rdr))
-		exit(EXIT_FAILURE);
-	if (ftruncate(fileno(output), hdr.maxSize) == -1)
-	{
-		fputs(_("Error: Failed to set the size of the output file."), stderr);
-		exit(EXIT_FAILURE);
-	}
-
-	/* We'll write the header in later. */
-	xfseek(output, sizeof(hdr), SEEK_CUR);
-
 	ctx.hdr = &hdr;
 	ctx.eof = &eof;
 	ctx.rec = &rec;
 	ctx.nonFixed = &nonFixed;
 
 	ctx.output = output;
+	ctx.splitPath = splitPath;
+	ctx.splitCount = 0;
+	ctx.blob = blob;
 	ctx.options = options;
 	ctx.lineNo = 2;
-	ctx.firstRecRead = 0;
-	ctx.firstRecLength = 0;
 	ctx.field = 0;
 	ctx.recFlags = 0;
-	ctx.tailSpace = hdr.maxSize - sizeof(EvtHeader);
+
+	/* Create a CSV reader object. */
+	rdr = csvCreateReader(input);
+
+	/* Read the output file size and set it on the output file. */
+	if (readFilesizeRecord(&hdr, rdr))
+		exit(EXIT_FAILURE);
+	resetLog(&ctx);
+
+	/* The size of the existing log is kept. */
+	if (options & CSV2EVT_APPEND)
+	{
+		if (loadLog(&ctx))
+			exit(EXIT_FAILURE);
+	}
+	else if (splitPath)
+	{
+		if (hdr.maxSize < sizeof(EvtHeader) + sizeof(EvtEOF))
+		{
+			fputs(_("Error: The log is too small to be split.\n"), stderr);
+			exit(EXIT_FAILURE);
+		}
+		startSplitFile(&ctx);
+	}
+	else
+	{
+		if (ftruncate(fileno(output), hdr.maxSize) == -1)
+		{
+			fputs(_("Error: Failed to set the size of the output file.\n"),
+				stderr);
+			exit(EXIT_FAILURE);
+		}
+
+		/* We'll write the header in later. */
+		xfseek(output, sizeof(hdr), SEEK_CUR);
+	}
 
 	resetRecord(&ctx);
 
@@ -278,19 +364,22 @@ static void processFile (FILE *__restrict input, FILE *__restrict output,
 		switch (csvRead(rdr, &ctx.token))
 		{
 			const char *p;
+			long lines;
 
 		case CSV_FIELD:
-			if (ctx.field != FIELD_IGNORE)
-				processField(&ctx);
-
-			for (p = ctx.token; *p; p++)
+			/* Count the lines first, processField() may cut the token. */
+			for (p = ctx.token, lines = 0; *p; p++)
 			{
 				if (p[0] == '\r' || p[0] == '\n')
-					ctx.lineNo++;
+					lines++;
 				if (p[0] == '\r' && p[1] == '\n')
 					p++;
 			}
 
+			if (ctx.field != FIELD_IGNORE)
+				processField(&ctx);
+
+			ctx.lineNo += lines;
 			free(ctx.token);
 			break;
 		case CSV_EOR:
@@ -310,14 +399,7 @@ static void processFile (FILE *__restrict input, FILE *__restrict output,
 			ctx.lineNo++;
 			break;
 		case CSV_EOF:
-			/* TODO: Probably move to writeBlock. */
-			ctx.hdr->endOffset = ctx.eof->endRecord = xftell(output);
-
-			/* Write the EOF record and the header. */
-			writeBlock(&ctx, &eof, sizeof(EvtEOF), 0);
-			xfseek(output, 0, SEEK_SET);
-			fwrite(&hdr, sizeof(hdr), 1, output);
-
+			finishOutput(&ctx);
 			inputEOF = 1;
 			break;
 		case CSV_ERROR:
@@ -329,6 +411,182 @@ static void processFile (FILE *__restrict input, FILE *__restrict output,
 	csvDestroyReader(rdr);
 }
 
+static void resetLog (ConvCtx *ctx)
+{
+	EvtHeader *hdr = ctx->hdr;
+	EvtEOF *eof = ctx->eof;
+
+	hdr->headerSize = 0x30;
+	hdr->endHeaderSize = 0x30;
+	hdr->signature = EVT_SIGNATURE;
+	hdr->majorVersion = 1;
+	hdr->minorVersion = 1;
+	hdr->startOffset = sizeof(EvtHeader);
+	hdr->endOffset = sizeof(EvtHeader);
+	hdr->oldestRecordNumber = 0;
+	hdr->currentRecordNumber = 1;
+	hdr->flags = 0;
+	hdr->retention = 0;
+
+	eof->recordSizeBeginning = 0x28;
+	eof->recordSizeEnd = 0x28;
+	eof->one = 0x11111111;
+	eof->two = 0x22222222;
+	eof->three = 0x33333333;
+	eof->four = 0x44444444;
+	eof->beginRecord = sizeof(EvtHeader);
+	eof->endRecord = sizeof(EvtHeader);
+	eof->oldestRecordNumber = 0;
+	eof->currentRecordNumber = 1;
+
+	ctx->firstRecRead = 0;
+	ctx->firstRecLength = 0;
+	ctx->tailSpace = hdr->maxSize - sizeof(EvtHeader);
+}
+
+static int loadLog (ConvCtx *ctx)
+{
+	EvtHeader *hdr = ctx->hdr;
+	EvtEOF *eof = ctx->eof;
+	EvtRecord rec;
+	long length;
+
+	xfseek(ctx->output, 0, SEEK_SET);
+	if (!fread(hdr, sizeof(EvtHeader), 1, ctx->output))
+	{
+		fputs(_("Error: Failed to read ELF header.\n"), stderr);
+		return -1;
+	}
+	if (hdr->signature != EVT_SIGNATURE)
+	{
+		fputs(_("Error: ELF signature doesn't match.\n"), stderr);
+		return -1;
+	}
+	/* Windows keeps the header up to date only when the log is closed. */
+	if (hdr->flags & EVT_HEADER_DIRTY)
+	{
+		fputs(_("Error: The log file is marked dirty.\n"), stderr);
+		return -1;
+	}
+
+	length = filelength(fileno(ctx->output));
+	if (hdr->headerSize != sizeof(EvtHeader) || hdr->maxSize != length
+		|| hdr->startOffset < sizeof(EvtHeader) || hdr->startOffset >= length
+		|| hdr->endOffset < sizeof(EvtHeader)
+		|| hdr->endOffset + sizeof(EvtEOF) > (unsigned long) length)
+	{
+		fputs(_("Error: The header is corrupted.\n"), stderr);
+		return -1;
+	}
+
+	xfseek(ctx->output, hdr->endOffset, SEEK_SET);
+	if (!fread(eof, sizeof(EvtEOF), 1, ctx->output)
+		|| eof->one != 0x11111111 || eof->two != 0x22222222
+		|| eof->three != 0x33333333 || eof->four != 0x44444444)
+	{
+		fputs(_("Error: The header doesn't point to the EOF record.\n"),
+			stderr);
+		return -1;
+	}
+
+	/* getMoreSpace() needs to know about the oldest record. */
+	ctx->firstRecRead = hdr->oldestRecordNumber != 0;
+	ctx->firstRecLength = 0;
+	if (ctx->firstRecRead)
+	{
+		xfseek(ctx->output, hdr->startOffset, SEEK_SET);
+		if (!fread(&rec, sizeof(EvtRecord), 1, ctx->output)
+			|| rec.recordNumber != hdr->oldestRecordNumber)
+		{
+			fputs(_("Error: The header doesn't point to "
+				"the oldest record.\n"), stderr);
+			return -1;
+		}
+		ctx->firstRecLength = rec.length;
+	}
+
+	/* The free space goes from the EOF record to the oldest record. */
+	if (!ctx->firstRecRead)
+		ctx->tailSpace = hdr->maxSize - sizeof(EvtHeader);
+	else if (hdr->endOffset < hdr->startOffset)
+		ctx->tailSpace = hdr->startOffset - hdr->endOffset;
+	else
+		ctx->tailSpace = (hdr->maxSize - hdr->endOffset)
+			+ (hdr->startOffset - sizeof(EvtHeader));
+
+	/* New records overwrite the EOF record. */
+	xfseek(ctx->output, hdr->endOffset, SEEK_SET);
+	return 0;
+}
+
+static void startSplitFile (ConvCtx *ctx)
+{
+	char *path;
+	size_t baseLength;
+
+	/* log.evt becomes log.001.evt, log.002.evt and so on. */
+	baseLength = strlen(ctx->splitPath);
+	if (baseLength >= 4 && !strcmp(ctx->splitPath + baseLength - 4, ".evt"))
+		baseLength -= 4;
+	path = xmalloc(baseLength + sizeof(".4294967295.evt"));
+	sprintf(path, "%.*s.%03u.evt", (int) baseLength, ctx->splitPath,
+		++ctx->splitCount);
+
+	if (!(ctx->output = fopen(path, "w+b")))
+	{
+		fprintf(stderr, _("Failed to open %s for writing.\n"), path);
+		exit(EXIT_FAILURE);
+	}
+	setvbuf(ctx->output, NULL, _IOFBF, CSV2EVT_SPLIT_BUFFER_SIZE);
+	if (ftruncate(fileno(ctx->output), ctx->hdr->maxSize) == -1)
+	{
+		fputs(_("Error: Failed to set the size of the output file.\n"),
+			stderr);
+		exit(EXIT_FAILURE);
+	}
+	free(path);
+
+	/* We'll write the header in later. */
+	xfseek(ctx->output, sizeof(EvtHeader), SEEK_SET);
+	ctx->splitOffset = sizeof(EvtHeader);
+}
+
+static void finishOutput (ConvCtx *ctx)
+{
+	long offset;
+
+	/* There's always space left for the EOF record in a split log. */
+	if (ctx->splitPath)
+	{
+		ctx->hdr->endOffset = ctx->eof->endRecord = ctx->splitOffset;
+		if (!fwrite(ctx->eof, sizeof(EvtEOF), 1, ctx->output))
+			goto finishOutput_fail;
+	}
+	else
+	{
+		/* The EOF record is never split. If it doesn't fit at the end
+		 * of the file, writeBlock() puts it right after the header. */
+		offset = xftell(ctx->output);
+		if (ctx->hdr->maxSize - offset < (long) sizeof(EvtEOF))
+			offset = sizeof(EvtHeader);
+		ctx->hdr->endOffset = ctx->eof->endRecord = offset;
+		if (writeBlock(ctx, ctx->eof, sizeof(EvtEOF), 0))
+			exit(EXIT_FAILURE);
+	}
+
+	xfseek(ctx->output, 0, SEEK_SET);
+	if (!fwrite(ctx->hdr, sizeof(EvtHeader), 1, ctx->output))
+		goto finishOutput_fail;
+
+	if (ctx->splitPath && fclose(ctx->output))
+		goto finishOutput_fail;
+	return;
+
+finishOutput_fail:
+	fputs(_("Error: Failed to write to the output file.\n"), stderr);
+	exit(EXIT_FAILURE);
+}
+
 static int readFilesizeRecord
 	(EvtHeader *__restrict hdr, CsvReader __restrict rdr)
 {
@@ -369,19 +627,12 @@ static int readFilesizeRecord
 
 static void processField (ConvCtx *ctx)
 {
-	switch (ctx->field++)
-	{
-		/* An anonymous union would be great. */
-		char *p;
-		time_t myTime;
-		long bytes, offset;
-		uint16_t *utfStr;
-		void *sid, *b64buff;
-		size_t length;
-		Buffer buf;
-		base64_decodestate b64state;
-
-	case FIELD_RECORD_NO:
+	const char *error;
+	char *p;
+
+	switch (ctx->field)
+	{
+	case RECORD_FIELD_NUMBER:
 		/* Empty lines are scanned as a single zero-length field.
 		 * Therefore, if we get an empty string here,
 		 * we'll wait for the next field before we error out.
@@ -392,200 +643,91 @@ static void processField (ConvCtx *ctx)
 			break;
 		}
 
-		offset = strtol(ctx->token, &p, 10);
-
 		if (ctx->options & CSV2EVT_REINDEX)
 		{
+			strtol(ctx->token, &p, 10);
 			if (*p)
 				ERROR_WARNING(_("Invalid record number"));
 			ctx->rec->recordNumber = ctx->hdr->currentRecordNumber;
-		}
-		else
-		{
-			if (*p)
-				ERROR_SKIP_RECORD(_("Invalid record number"));
-			if (offset <= 0)
-				ERROR_SKIP_RECORD(_(
-					"A record with a non-positive record number"));
-			if (ctx->firstRecRead)
-			{
-				/* TODO: It is allowed to overflow to 0 etc. */
-				if (offset > ctx->hdr->currentRecordNumber)
-					ERROR_WARNING(_("Discontiguous record"));
-				else if (offset < ctx->hdr->currentRecordNumber)
-					ERROR_SKIP_RECORD(_("A record with a record number that is"
-						" less than or equal to the previous record"));
-			}
-			ctx->rec->recordNumber = offset;
-		}
-		break;
-	case FIELD_TIME_GEN:
-		if (ctx->recFlags & RECORD_EMPTY_FIRST_FIELD)
-			ERROR_SKIP_RECORD(_("A record without a record number. You"
-				" can prevent this error with the -i option"));
-
-		if ((myTime = parseTime(ctx->token)) == -1)
-			ERROR_SKIP_RECORD(
-				_("Failed to parse generation time in a record"));
-		ctx->rec->timeGenerated = (uint32_t) myTime;
-		break;
-	case FIELD_TIME_WRI:
-		if ((myTime = parseTime(ctx->token)) == -1)
-			ERROR_SKIP_RECORD(
-				_("Failed to parse written time in a record"));
-		ctx->rec->timeWritten = (uint32_t) myTime;
-		break;
-	case FIELD_EVENT_ID:
-		ctx->rec->eventID = strtol(ctx->token, &p, 10);
-		if (*p)
-			ERROR_SKIP_RECORD(_("Failed to parse event ID"));
-		break;
-	case FIELD_EVENT_TYPE:
-		if (!strcmp(ctx->token, "Information"))
-			ctx->rec->eventType = EVT_INFORMATION_TYPE;
-		else if (!strcmp(ctx->token, "Warning"))
-			ctx->rec->eventType = EVT_WARNING_TYPE;
-		else if (!strcmp(ctx->token, "Error"))
-			ctx->rec->eventType = EVT_ERROR_TYPE;
-		else if (!strcmp(ctx->token, "Audit Success"))
-			ctx->rec->eventType = EVT_AUDIT_SUCCESS;
-		else if (!strcmp(ctx->token, "Audit Failure"))
-			ctx->rec->eventType = EVT_AUDIT_FAILURE;
-		else
-		{
-			ctx->rec->eventType = strtol(ctx->token, &p, 10);
-			if (*p)
-				ERROR_SKIP_RECORD(_("Failed to parse event type in a record"));
-		}
-		break;
-	case FIELD_EVENT_CAT:
-		ctx->rec->eventCategory = strtol(ctx->token, &p, 10);
-		if (*p)
-			ERROR_SKIP_RECORD(_("Failed to parse event category"));
-		break;
-	case FIELD_SOURCE_NAME:
-		if (!(bytes = encodeMBString(ctx->token, &utfStr)))
-			ERROR_SKIP_RECORD(_("Failed to decode the event source name"));
-		bufferAppend(ctx->nonFixed, utfStr, bytes, 0);
-		free(utfStr);
-		break;
-	case FIELD_COMPUTER_NAME:
-		if (!(bytes = encodeMBString(ctx->token, &utfStr)))
-			ERROR_SKIP_RECORD(_("Failed to decode the computer name"));
-		bufferAppend(ctx->nonFixed, utfStr, bytes, 0);
-		free(utfStr);
-		break;
-	case FIELD_SID:
-		if (!*ctx->token)
-		{
-			ctx->rec->userSidLength = 0;
-			ctx->rec->userSidOffset = 0;
 			break;
 		}
-		if (!(sid = sidToBinary(ctx->token, &length)))
-			ERROR_SKIP_RECORD(_("Failed to decode SID"));
-
-		/* The SID should be aligned on a DWORD (4-byte) boundary. */
-		ctx->rec->userSidOffset = sizeof(EvtRecord)
-			+ bufferAppend(ctx->nonFixed, sid, length, 4);
-		ctx->rec->userSidLength = length;
-		free(sid);
-		break;
-	case FIELD_STRINGS:
-		bufferInit(&buf);
-		for (p = ctx->token; ; p++)
-		{
-			int quoted = 0;
-
-			if (*p == '\\')
-			{
-				quoted = 1;
-				p++;
-			}
 
-			/* End of token OR unquoted end of string mark. */
-			if (!*p || (p[0] == '|' && !quoted))
-			{
-				bufferAppendChar(&buf, '\0');
-
-				if (!(bytes = encodeMBString(buf.data, &utfStr)))
-				{
-					bufferDestroy(&buf);
-					ERROR_SKIP_RECORD(_("Failed to decode strings"));
-				}
-				offset = bufferAppend(ctx->nonFixed, utfStr, bytes, 0);
-				free(utfStr);
-
-				if (!ctx->rec->numStrings)
-					ctx->rec->stringOffset = sizeof(EvtRecord) + offset;
-				ctx->rec->numStrings++;
-
-				/* End of string -> reset our current string. */
-				if (*p)
-					bufferEmpty(&buf);
-				/* End of token  -> stop processing. */
-				else
-					break;
-			}
-			else
-				bufferAppendChar(&buf, *p);
+		if ((error = recordEncodeField(ctx->rec, ctx->nonFixed,
+			RECORD_FIELD_NUMBER, ctx->token, ctx->blob)))
+			ERROR_SKIP_RECORD(error);
+		if (ctx->firstRecRead)
+		{
+			/* TODO: It is allowed to overflow to 0 etc. */
+			if (ctx->rec->recordNumber > ctx->hdr->currentRecordNumber)
+				ERROR_WARNING(_("Discontiguous record"));
+			else if (ctx->rec->recordNumber < ctx->hdr->currentRecordNumber)
+				ERROR_SKIP_RECORD(_("A record with a record number that is"
+					" less than or equal to the previous record"));
 		}
-		bufferDestroy(&buf);
-		break;
-	case FIELD_DATA:
-		base64_init_decodestate(&b64state);
-		b64buff = xmalloc(BASE64_DECODED_BUFFER_SIZE(strlen(ctx->token)));
-		ctx->rec->dataLength = base64_decode_block(ctx->token,
-			strlen(ctx->token), b64buff, &b64state);
-		ctx->rec->dataOffset = sizeof(EvtRecord) + bufferAppend(ctx->nonFixed,
-			b64buff, ctx->rec->dataLength, 0);
-		free(b64buff);
 		break;
 	case FIELD_END:
 		ERROR_WARNING(_("Extraneous field(s) in a record"));
 		break;
+	case FIELD_IGNORE:
+		return;
+	case RECORD_FIELD_TIME_GENERATED:
+		if (ctx->recFlags & RECORD_EMPTY_FIRST_FIELD)
+			ERROR_SKIP_RECORD(_("A record without a record number. You"
+				" can prevent this error with the -i option"));
+		/* Fall through. */
 	default:
+		if ((error = recordEncodeField(ctx->rec, ctx->nonFixed,
+			ctx->field, ctx->token, ctx->blob)))
+			ERROR_SKIP_RECORD(error);
 		break;
 	}
-}
-
-static time_t parseTime (const char *token)
-{
-	struct tm tm;
-
-	/* Initialize the structure. */
-	memset(&tm, 0, sizeof(struct tm));
-
-#ifdef HAVE_STRPTIME
-	strptime(token, "%Y-%m-%d %H:%M:%S", &tm);
-#else /* ! HAVE_STRPTIME */
-	sscanf(token, "%4d-%2d-%2d %2d:%2d:%2d",
-		&tm.tm_year, &tm.tm_mon, &tm.tm_mday,
-		&tm.tm_hour, &tm.tm_min, &tm.tm_sec);
-#endif /* ! HAVE_STRPTIME */
-
-#ifdef HAVE__MKGMTIME
-	return _mkgmtime(&tm);
-#else /* ! HAVE__MKGMTIME */
-	return mktime(&tm);
-#endif /* ! HAVE__MKGMTIME */
+	ctx->field++;
 }
 
 static void writeRecord (ConvCtx *ctx)
 {
 	long offset;
 
-	/* The record has to be aligned on a DWORD (4-byte) boundary. */
-	offset = bufferAppend(ctx->nonFixed, NULL, sizeof(ctx->rec->length), 4);
-	*(uint32_t *) ((char *) ctx->nonFixed->data + offset) = ctx->rec->length
-		= sizeof(EvtRecord) + ctx->nonFixed->used;
+	recordEncodeEnd(ctx->rec, ctx->nonFixed);
 
-	offset = xftell(ctx->output);
+	if (ctx->splitPath)
+	{
+		/* Continue in another file if there's no space left in this one.
+		 * Records never wrap and none have to be dropped. */
+		if (ctx->splitOffset + ctx->rec->length + sizeof(EvtEOF)
+			> ctx->hdr->maxSize)
+		{
+			if (!ctx->firstRecRead)
+			{
+				fputs(_("Error: Failed to write a record; "
+					"not enough space."), stderr);
+				exit(EXIT_FAILURE);
+			}
 
-	/* Write the record. */
-	if (writeBlock(ctx, ctx->rec, sizeof(EvtRecord), 0)
-		|| writeBlock(ctx, ctx->nonFixed->data, ctx->nonFixed->used, 1))
-		exit(EXIT_FAILURE);
+			finishOutput(ctx);
+			resetLog(ctx);
+			startSplitFile(ctx);
+		}
+
+		offset = ctx->splitOffset;
+		if (!fwrite(ctx->rec, sizeof(EvtRecord), 1, ctx->output)
+			|| !fwrite(ctx->nonFixed->data, ctx->nonFixed->used, 1,
+			ctx->output))
+		{
+			fputs(_("Error: Failed to write to the output file.\n"), stderr);
+			exit(EXIT_FAILURE);
+		}
+		ctx->splitOffset += ctx->rec->length;
+	}
+	else
+	{
+		offset = xftell(ctx->output);
+
+		/* Write the record. */
+		if (writeBlock(ctx, ctx->rec, sizeof(EvtRecord), 0)
+			|| writeBlock(ctx, ctx->nonFixed->data, ctx->nonFixed->used, 1))
+			exit(EXIT_FAILURE);
+	}
 
 	if (!ctx->firstRecRead)
 	{
@@ -760,8 +902,6 @@ static int xfseek (FILE *fp, long offset, int whence)
 
 static void resetRecord (ConvCtx *ctx)
 {
-	bufferEmpty(ctx->nonFixed);
-	memset(ctx->rec, 0, sizeof(EvtRecord));
-	ctx->rec->reserved = EVT_SIGNATURE;
+	recordEncodeBegin(ctx->rec, ctx->nonFixed);
 }
 
@@ -0,0 +1,221 @@
+/**
+ *  @file csvsink.c
+ *  @brief A sink writing records in CSV.
+ *
+ *  Copyright Přemysl Janouch 2010. All rights reserved.
+ *  See the file LICENSE for licensing information.
+ *
+ */
+
+/* gmtime_r */
+#define _XOPEN_SOURCE 700
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "configure.h"
+
+#include "xalloc.h"
+#include "datastruct.h"
+#include "evt.h"
+#include "csv.h"
+#include "base64.h"
+#include "record.h"
+#include "sink.h"
+
+
+/** A sink writing records in CSV. */
+typedef struct
+{
+	/** The methods. */
+	Sink sink;
+	/** The output file stream. */
+	FILE *output;
+	/** The CSV writer for the output. */
+	CsvWriter wrt;
+	/** Where to write event data instead of putting them in the CSV
+	 *  in base64, or NULL. */
+	FILE *blob;
+	/** How many bytes have been written to @a blob so far. */
+	unsigned long long blobLength;
+	/** Whether the file size record has been written. */
+	int begun;
+}
+CsvSink;
+
+
+static int csvSinkBegin (Sink *__restrict self,
+	const EvtHeader *__restrict hdr, unsigned long fileSize);
+static int csvSinkWrite (Sink *__restrict self,
+	const RecordFields *__restrict fields);
+static int csvSinkClose (Sink *self);
+
+/** Format a time the way it is written in CSV. */
+static void formatTime (char *buff, size_t size, time_t t);
+/** Write a CSV field in base64. */
+static int writeFieldBase64 (CsvWriter __restrict wrt,
+	const void *__restrict field, size_t length);
+/** Write data to the blob file and a reference to them as a CSV field. */
+static int writeFieldBlob (CsvSink *__restrict sink,
+	const void *__restrict field, size_t length);
+
+
+Sink *sinkCreateCsv (FILE *__restrict output, FILE *__restrict blob)
+{
+	CsvSink *self;
+
+	self = xmalloc(sizeof(CsvSink));
+	self->sink.begin = csvSinkBegin;
+	self->sink.write = csvSinkWrite;
+	self->sink.close = csvSinkClose;
+
+	self->output = output;
+	self->wrt = csvCreateWriter(output);
+	self->blob = blob;
+	self->blobLength = 0;
+	self->begun = 0;
+	return &self->sink;
+}
+
+static int csvSinkBegin (Sink *__restrict self,
+	const EvtHeader *__restrict hdr, unsigned long fileSize)
+{
+	CsvSink *sink = (CsvSink *) self;
+
+	(void) hdr;
+
+	/* Write out a special header record with file size.
+	 * (The only non-record value that is really useful
+	 * for reconstructing the .evt.)
+	 */
+	if (!sink->begun)
+		fprintf(sink->output, "%lu\n", fileSize);
+	sink->begun = 1;
+	return 0;
+}
+
+static int csvSinkWrite (Sink *__restrict self,
+	const RecordFields *__restrict fields)
+{
+	CsvSink *sink = (CsvSink *) self;
+	CsvWriter wrt = sink->wrt;
+	const EvtRecord *rec = fields->rec;
+	const char *typeName;
+	/* Yes, the buffer is large enough. */
+	char buff[40];
+
+	/* First field: record number. */
+	snprintf(buff, sizeof(buff), "%d", rec->recordNumber);
+	csvWrite(wrt, buff);
+
+	/* Second field: time generated (GMT). */
+	formatTime(buff, sizeof(buff), rec->timeGenerated);
+	csvWrite(wrt, buff);
+
+	/* Third field: time written (GMT). */
+	formatTime(buff, sizeof(buff), rec->timeWritten);
+	csvWrite(wrt, buff);
+
+	/* Fourth field: event ID. */
+	snprintf(buff, sizeof(buff), "%u", rec->eventID);
+	csvWrite(wrt, buff);
+
+	/* Fifth field: event type. Unknown types are expressed with a number. */
+	if ((typeName = recordTypeName(rec->eventType)))
+		csvWrite(wrt, typeName);
+	else
+	{
+		snprintf(buff, sizeof(buff), "%u", rec->eventType);
+		csvWrite(wrt, buff);
+	}
+
+	/* Sixth field: event category. */
+	snprintf(buff, sizeof(buff), "%d", rec->eventCategory);
+	csvWrite(wrt, buff);
+
+	/* Seventh field: source name (in UTF-8). */
+	csvWrite(wrt, fields->sourceName ? fields->sourceName : "");
+
+	/* Eighth field: computer name (in UTF-8). */
+	csvWrite(wrt, fields->computerName ? fields->computerName : "");
+
+	/* Nineth field: SID. */
+	csvWrite(wrt, fields->sid ? fields->sid : "");
+
+	/* Tenth field: strings (in UTF-8). */
+	csvWrite(wrt, fields->strings);
+
+	/* Eleventh field: data (in base64 or a reference to the blob file). */
+	if (!fields->data)
+		csvWrite(wrt, "");
+	else if (sink->blob)
+	{
+		if (writeFieldBlob(sink, fields->data, fields->dataLength))
+		{
+			fputs(_("Error: Failed to write to the blob file.\n"), stderr);
+			return 1;
+		}
+	}
+	else if (writeFieldBase64(wrt, fields->data, fields->dataLength))
+		csvWrite(wrt, "");
+
+	/* End of record. */
+	csvWrite(wrt, NULL);
+	return 0;
+}
+
+static int csvSinkClose (Sink *self)
+{
+	CsvSink *sink = (CsvSink *) self;
+
+	csvDestroyWriter(sink->wrt);
+	free(sink);
+	return 0;
+}
+
+static void formatTime (char *buff, size_t size, time_t t)
+{
+#ifdef HAVE_GMTIME_R
+	/* The sink may be used from several threads at once. */
+	struct tm tm;
+
+	strftime(buff, size, "%Y-%m-%d %H:%M:%S", gmtime_r(&t, &tm));
+#else /* ! HAVE_GMTIME_R */
+	strftime(buff, size, "%Y-%m-%d %H:%M:%S", gmtime(&t));
+#endif /* ! HAVE_GMTIME_R */
+}
+
+static int writeFieldBase64 (CsvWriter __restrict wrt,
+	const void *__restrict field, size_t length)
+{
+	base64_encodestate state;
+	char *buff;
+	int offset, ret;
+
+	base64_init_encodestate(&state);
+	buff = xmalloc(BASE64_ENCODED_BUFFER_SIZE(length));
+
+	offset = base64_encode_block(field, length, buff, &state);
+	base64_encode_blockend(buff + offset, &state);
+	ret = csvWrite(wrt, buff);
+	free(buff);
+	return ret;
+}
+
+static int writeFieldBlob (CsvSink *__restrict sink,
+	const void *__restrict field, size_t length)
+{
+	/* Yes, the buffer is large enough. */
+	char buff[48];
+
+	if (!length)
+		return csvWrite(sink->wrt, "");
+	if (!fwrite(field, length, 1, sink->blob))
+		return 1;
+
+	snprintf(buff, sizeof(buff), "%llu:%lu",
+		sink->blobLength, (unsigned long) length);
+	sink->blobLength += length;
+	return csvWrite(sink->wrt, buff);
+}
@@ -65,3 +65,87 @@ int bufferAppendChar (Buffer *buf, char c)
 	return bufferAppend(buf, &c, sizeof(char), 0);
 }
 
+
+
+/** Hash a string with FNV-1a. */
+static unsigned int hashString (const char *s)
+{
+	uint32_t hash = 2166136261U;
+
+	while (*s)
+	{
+		hash ^= (unsigned char) *s++;
+		hash *= 16777619U;
+	}
+	return hash;
+}
+
+/** Find the slot where a string is or where it should go. */
+static size_t findSlot (const StringTable *__restrict table,
+	const char *__restrict s)
+{
+	size_t i, mask = table->nSlots - 1;
+
+	for (i = hashString(s) & mask; table->slots[i]; i = (i + 1) & mask)
+		if (!strcmp(table->strings[table->slots[i] - 1], s))
+			break;
+	return i;
+}
+
+unsigned int stringTableFind (const StringTable *__restrict table,
+	const char *__restrict s)
+{
+	if (!table->nSlots)
+		return 0;
+	return table->slots[findSlot(table, s)];
+}
+
+unsigned int stringTableIntern (StringTable *__restrict table,
+	const char *__restrict s, int *__restrict added)
+{
+	size_t i, length;
+
+	if (added)
+		*added = 0;
+	if (table->nSlots && table->slots[i = findSlot(table, s)])
+		return table->slots[i];
+
+	/* Keep the table at most half full. */
+	if ((table->count + 1) * 2 > table->nSlots)
+	{
+		unsigned int *old = table->slots;
+		size_t oldSlots = table->nSlots;
+
+		table->nSlots = oldSlots ? oldSlots << 1 : 64;
+		table->slots = xmalloc(table->nSlots * sizeof(unsigned int));
+		memset(table->slots, 0, table->nSlots * sizeof(unsigned int));
+		table->strings = xrealloc(table->strings,
+			table->nSlots / 2 * sizeof(char *));
+
+		for (i = 0; i < oldSlots; i++)
+			if (old[i])
+				table->slots[findSlot(table,
+					table->strings[old[i] - 1])] = old[i];
+		free(old);
+	}
+
+	length = strlen(s) + 1;
+	table->strings[table->count] = xmalloc(length);
+	memcpy(table->strings[table->count], s, length);
+	table->slots[findSlot(table, s)] = ++table->count;
+
+	if (added)
+		*added = 1;
+	return table->count;
+}
+
+void stringTableDestroy (StringTable *table)
+{
+	size_t i;
+
+	for (i = 0; i < table->count; i++)
+		free(table->strings[i]);
+	free(table->strings);
+	free(table->slots);
+	stringTableInit(table);
+}
@@ -16,6 +16,9 @@
 /** You can initialize the Buffer structure with this. */
 #define BUFFER_INITIALIZER {NULL, 0, 0, 0}
 
+/** You can initialize the StringTable structure with this. */
+#define STRING_TABLE_INITIALIZER {NULL, 0, NULL, 0}
+
 
 /** A simple buffer. The fields are not private, but take
  *  care of what you're doing with them.
@@ -68,6 +71,18 @@ int bufferAppend (Buffer *__restrict buf,
  */
 int bufferAppendChar (Buffer *buf, char c);
 
+/** Give back space at the end of a @a Buffer object, typically the unused
+ *  part of a reservation made by calling bufferAppend() with NULL data.
+ *  @param[in,out] buf  A buffer object.
+ *  @param[in] length  How many bytes to take off the end of the buffer.
+ */
+static inline void bufferShrink (Buffer *buf, size_t length)
+{
+	buf->cursor -= length;
+	if (buf->used > buf->cursor)
+		buf->used = buf->cursor;
+}
+
 /** Destroy a @a Buffer object.
  *  @param[in,out] buf  A buffer object.
  */
@@ -86,5 +101,74 @@ static inline void bufferEmpty (Buffer *buf)
 	bufferInit(buf);
 }
 
+/** Empty a @a Buffer object, keeping its memory allocated for reuse.
+ *  @param[in,out] buf  A buffer object.
+ */
+static inline void bufferClear (Buffer *buf)
+{
+	buf->used = buf->cursor = 0;
+}
+
+
+/** A set of unique strings. Each of them is identified by a number,
+ *  starting from 1 in the order in which they have been added.
+ */
+typedef struct
+{
+	/** An open addressing hash table of identifiers, 0 meaning empty. */
+	unsigned int *slots;
+	/** The number of slots, always a power of two. */
+	size_t nSlots;
+	/** The strings, indexed by their identifier minus one. */
+	char **strings;
+	/** The number of strings in the table. */
+	size_t count;
+}
+StringTable;
+
+
+/** Initialize a @a StringTable object.
+ *  @param[out] table  A StringTable object.
+ */
+static inline void stringTableInit (StringTable *table)
+{
+	table->slots = NULL;
+	table->strings = NULL;
+	table->nSlots = table->count = 0;
+}
+
+/** Find a string in the table.
+ *  @param[in] table  A string table.
+ *  @param[in] s  The string to look for.
+ *  @return The identifier of the string, or 0 if it's not present.
+ */
+unsigned int stringTableFind (const StringTable *__restrict table,
+	const char *__restrict s);
+
+/** Find a string in the table, adding a copy of it if it's not present.
+ *  @param[in,out] table  A string table.
+ *  @param[in] s  The string to look for.
+ *  @param[out] added  If not NULL, set to whether the string has been added.
+ *  @return The identifier of the string.
+ */
+unsigned int stringTableIntern (StringTable *__restrict table,
+	const char *__restrict s, int *__restrict added);
+
+/** Get a string by its identifier.
+ *  @param[in] table  A string table.
+ *  @param[in] id  The identifier of a string present in the table.
+ *  @return The string.
+ */
+static inline const char *stringTableGet (const StringTable *table,
+	unsigned int id)
+{
+	return table->strings[id - 1];
+}
+
+/** Destroy a @a StringTable object.
+ *  @param[in,out] table  A string table.
+ */
+void stringTableDestroy (StringTable *table);
+
 #endif /* ! DATASTRUCT_H_INCLUDED */
 
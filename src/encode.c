@@ -0,0 +1,209 @@
+/**
+ *  @file encode.c
+ *  @brief Encoding of event log records from text.
+ *
+ *  Copyright Přemysl Janouch 2010. All rights reserved.
+ *  See the file LICENSE for licensing information.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "configure.h"
+
+#include "datastruct.h"
+#include "evt.h"
+#include "base64.h"
+#include "sid.h"
+#include "escape.h"
+#include "mapfile.h"
+#include "widechar.h"
+#include "timeconv.h"
+#include "encode.h"
+
+
+/** Parse a reference to event data in the blob file.
+ *  @param[in] token  The string to be parsed.
+ *  @param[in] blob  The blob file.
+ *  @param[out] offset  The offset of the data in the blob file.
+ *  @param[out] length  The length of the data.
+ *  @return -1 on error, 0 on success.
+ */
+static int parseBlobReference (const char *__restrict token,
+	const MappedFile *__restrict blob, size_t *__restrict offset,
+	size_t *__restrict length);
+
+
+void recordEncodeBegin (EvtRecord *__restrict rec, Buffer *__restrict nonFixed)
+{
+	bufferClear(nonFixed);
+	memset(rec, 0, sizeof(EvtRecord));
+	rec->reserved = EVT_SIGNATURE;
+}
+
+const char *recordEncodeField (EvtRecord *__restrict rec,
+	Buffer *__restrict nonFixed, RecordField field, char *__restrict token,
+	const MappedFile *__restrict blob)
+{
+	switch (field)
+	{
+		/* An anonymous union would be great. */
+		char *p;
+		time_t myTime;
+		long offset;
+		size_t length, reserved;
+		base64_decodestate b64state;
+
+	case RECORD_FIELD_NUMBER:
+		offset = strtol(token, &p, 10);
+		if (*p)
+			return _("Invalid record number");
+		if (offset <= 0)
+			return _("A record with a non-positive record number");
+		rec->recordNumber = offset;
+		break;
+	case RECORD_FIELD_TIME_GENERATED:
+		if ((myTime = parseTime(token)) == -1)
+			return _("Failed to parse generation time in a record");
+		rec->timeGenerated = (uint32_t) myTime;
+		break;
+	case RECORD_FIELD_TIME_WRITTEN:
+		if ((myTime = parseTime(token)) == -1)
+			return _("Failed to parse written time in a record");
+		rec->timeWritten = (uint32_t) myTime;
+		break;
+	case RECORD_FIELD_EVENT_ID:
+		rec->eventID = strtol(token, &p, 10);
+		if (*p)
+			return _("Failed to parse event ID");
+		break;
+	case RECORD_FIELD_EVENT_TYPE:
+		if (!strcmp(token, "Information"))
+			rec->eventType = EVT_INFORMATION_TYPE;
+		else if (!strcmp(token, "Warning"))
+			rec->eventType = EVT_WARNING_TYPE;
+		else if (!strcmp(token, "Error"))
+			rec->eventType = EVT_ERROR_TYPE;
+		else if (!strcmp(token, "Audit Success"))
+			rec->eventType = EVT_AUDIT_SUCCESS;
+		else if (!strcmp(token, "Audit Failure"))
+			rec->eventType = EVT_AUDIT_FAILURE;
+		else
+		{
+			rec->eventType = strtol(token, &p, 10);
+			if (*p)
+				return _("Failed to parse event type in a record");
+		}
+		break;
+	case RECORD_FIELD_EVENT_CATEGORY:
+		rec->eventCategory = strtol(token, &p, 10);
+		if (*p)
+			return _("Failed to parse event category");
+		break;
+	case RECORD_FIELD_SOURCE_NAME:
+		if (encodeMBStringToBuffer(token, nonFixed) == -1)
+			return _("Failed to decode the event source name");
+		break;
+	case RECORD_FIELD_COMPUTER_NAME:
+		if (encodeMBStringToBuffer(token, nonFixed) == -1)
+			return _("Failed to decode the computer name");
+		break;
+	case RECORD_FIELD_SID:
+		if (!*token)
+		{
+			rec->userSidLength = 0;
+			rec->userSidOffset = 0;
+			break;
+		}
+		/* The SID should be aligned on a DWORD (4-byte) boundary. */
+		if ((offset = sidToBinaryBuffer(token, nonFixed, 4)) == -1)
+			return _("Failed to decode SID");
+
+		rec->userSidOffset = sizeof(EvtRecord) + offset;
+		rec->userSidLength = nonFixed->used - offset;
+		break;
+	case RECORD_FIELD_STRINGS:
+		/* The token is ours, so the strings may be unescaped in place. */
+		p = token;
+		do
+		{
+			if ((offset = encodeMBStringToBuffer(escapeCutNext(&p),
+				nonFixed)) == -1)
+				return _("Failed to decode strings");
+
+			if (!rec->numStrings)
+				rec->stringOffset = sizeof(EvtRecord) + offset;
+			rec->numStrings++;
+		}
+		while (p);
+		break;
+	case RECORD_FIELD_DATA:
+		if (blob)
+		{
+			if (parseBlobReference(token, blob, &reserved, &length))
+				return _("Invalid reference to the blob file");
+
+			/* Copy the data straight from the mapped file. */
+			rec->dataLength = length;
+			rec->dataOffset = sizeof(EvtRecord) + bufferAppend(nonFixed,
+				(const char *) blob->data + reserved, length, 0);
+			break;
+		}
+
+		/* Decode right into the record, giving back what we don't need. */
+		length = strlen(token);
+		reserved = BASE64_DECODED_BUFFER_SIZE(length);
+		offset = bufferAppend(nonFixed, NULL, reserved, 0);
+
+		base64_init_decodestate(&b64state);
+		rec->dataLength = base64_decode_block(token, length,
+			(char *) nonFixed->data + offset, &b64state);
+		rec->dataOffset = sizeof(EvtRecord) + offset;
+		bufferShrink(nonFixed, reserved - rec->dataLength);
+		break;
+	default:
+		break;
+	}
+	return NULL;
+}
+
+void recordEncodeEnd (EvtRecord *__restrict rec, Buffer *__restrict nonFixed)
+{
+	long offset;
+
+	/* The record has to be aligned on a DWORD (4-byte) boundary. */
+	offset = bufferAppend(nonFixed, NULL, sizeof(rec->length), 4);
+	*(uint32_t *) ((char *) nonFixed->data + offset) = rec->length
+		= sizeof(EvtRecord) + nonFixed->used;
+}
+
+static int parseBlobReference (const char *__restrict token,
+	const MappedFile *__restrict blob, size_t *__restrict offset,
+	size_t *__restrict length)
+{
+	char *p;
+	long long o, l;
+
+	/* An empty field means there are no data. */
+	*offset = *length = 0;
+	if (!*token)
+		return 0;
+
+	o = strtoll(token, &p, 10);
+	if (*p != ':' || o < 0)
+		return -1;
+	l = strtoll(p + 1, &p, 10);
+	if (*p || l < 0)
+		return -1;
+
+	if ((unsigned long long) o > blob->length
+		|| (unsigned long long) l > blob->length - o)
+		return -1;
+
+	*offset = o;
+	*length = l;
+	return 0;
+}
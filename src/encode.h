@@ -0,0 +1,63 @@
+/**
+ *  @file encode.h
+ *  @brief Encoding of event log records from text.
+ *
+ *  Copyright Přemysl Janouch 2010. All rights reserved.
+ *  See the file LICENSE for licensing information.
+ *
+ *  This is the reverse of record.h: fields in the format they take
+ *  in CSV files are put together into a binary record.
+ *
+ */
+
+#ifndef ENCODE_H_INCLUDED
+#define ENCODE_H_INCLUDED
+
+/** Fields of a record in the order they appear in CSV files. */
+typedef enum
+{
+	RECORD_FIELD_NUMBER,
+	RECORD_FIELD_TIME_GENERATED,
+	RECORD_FIELD_TIME_WRITTEN,
+	RECORD_FIELD_EVENT_ID,
+	RECORD_FIELD_EVENT_TYPE,
+	RECORD_FIELD_EVENT_CATEGORY,
+	RECORD_FIELD_SOURCE_NAME,
+	RECORD_FIELD_COMPUTER_NAME,
+	RECORD_FIELD_SID,
+	RECORD_FIELD_STRINGS,
+	RECORD_FIELD_DATA,
+	/** The number of fields. */
+	RECORD_FIELD_COUNT
+}
+RecordField;
+
+
+/** Start encoding a new record.
+ *  @param[out] rec  The fixed-length part of the record.
+ *  @param[out] nonFixed  A buffer for the rest of the record.
+ */
+void recordEncodeBegin (EvtRecord *__restrict rec, Buffer *__restrict nonFixed);
+
+/** Encode a field of a record. The fields have to be encoded
+ *  in the order of RecordField. Unless _mkgmtime() is available,
+ *  setutctimezone() has to be called beforehand, see timeconv.h.
+ *  @param[in,out] rec  The fixed-length part of the record.
+ *  @param[in,out] nonFixed  The rest of the record.
+ *  @param[in] field  Which field it is.
+ *  @param[in] token  The field. It may get modified.
+ *  @param[in] blob  The file event data are referenced in, or NULL if
+ *  	they are encoded in base64.
+ *  @return NULL on success, otherwise a message describing the problem.
+ */
+const char *recordEncodeField (EvtRecord *__restrict rec,
+	Buffer *__restrict nonFixed, RecordField field, char *__restrict token,
+	const MappedFile *__restrict blob);
+
+/** Finish encoding a record, appending its length to it.
+ *  @param[in,out] rec  The fixed-length part of the record.
+ *  @param[in,out] nonFixed  The rest of the record.
+ */
+void recordEncodeEnd (EvtRecord *__restrict rec, Buffer *__restrict nonFixed);
+
+#endif /* ! ENCODE_H_INCLUDED */
@@ -0,0 +1,75 @@
+/**
+ *  @file escape.c
+ *  @brief Escaping of the list of description strings in CSV.
+ *
+ *  Copyright Přemysl Janouch 2010. All rights reserved.
+ *  See the file LICENSE for licensing information.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "configure.h"
+
+#include "datastruct.h"
+#include "escape.h"
+
+
+/** Characters that stop copying of a clean span of text. */
+static const char specialChars[] = {ESCAPE_SEPARATOR, ESCAPE_CHAR, '\0'};
+
+
+/* Most of the text needs no escaping at all. Let the C library search
+ * for special characters, which it usually does a word or a vector
+ * at a time, and copy the clean spans in between as a whole.
+ */
+void escapeAppend (Buffer *__restrict buf, const char *__restrict in)
+{
+	size_t span;
+
+	while (1)
+	{
+		span = strcspn(in, specialChars);
+		if (span)
+			bufferAppend(buf, in, span, 0);
+		if (!in[span])
+			break;
+
+		in += span;
+		bufferAppend(buf, NULL, 2, 0);
+		((char *) buf->data)[buf->cursor - 2] = ESCAPE_CHAR;
+		((char *) buf->data)[buf->cursor - 1] = *in++;
+	}
+}
+
+char *escapeCutNext (char **cursor)
+{
+	char *start, *in, *out;
+	size_t span;
+
+	start = in = out = *cursor;
+	while (1)
+	{
+		span = strcspn(in, specialChars);
+		if (out != in)
+			memmove(out, in, span);
+		in += span;
+		out += span;
+
+		if (*in == ESCAPE_SEPARATOR)
+		{
+			*out = '\0';
+			*cursor = in + 1;
+			return start;
+		}
+		if (!*in || !*++in)
+			break;
+
+		/* Take the escaped character literally. */
+		*out++ = *in++;
+	}
+	*out = '\0';
+	*cursor = NULL;
+	return start;
+}
@@ -0,0 +1,36 @@
+/**
+ *  @file escape.h
+ *  @brief Escaping of the list of description strings in CSV.
+ *
+ *  Copyright Přemysl Janouch 2010. All rights reserved.
+ *  See the file LICENSE for licensing information.
+ *
+ *  The strings are separated by '|' chars. Both this separator
+ *  and the escape character itself may be escaped with '\'.
+ *
+ */
+
+#ifndef ESCAPE_H_INCLUDED
+#define ESCAPE_H_INCLUDED
+
+/** The character separating strings in the list. */
+#define ESCAPE_SEPARATOR '|'
+
+/** The character escaping the following character. */
+#define ESCAPE_CHAR '\\'
+
+/** Append a string to a list in a buffer, escaping any special characters.
+ *  The separator is not added, neither is the terminating NULL char.
+ *  @param[in,out] buf  The buffer to append the string to.
+ *  @param[in] in  A NULL-terminated string.
+ */
+void escapeAppend (Buffer *__restrict buf, const char *__restrict in);
+
+/** Cut the next string off a list, unescaping it in place.
+ *  @param[in,out] cursor  Points to where the list continues. It is set
+ *  	to NULL once the last string has been cut off.
+ *  @return The unescaped, NULL-terminated string.
+ */
+char *escapeCutNext (char **cursor);
+
+#endif /* ! ESCAPE_H_INCLUDED */
@@ -11,37 +11,186 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
-#include <errno.h>
 
 #include "configure.h"
 
 #include "xalloc.h"
-#include "evt.h"
-#include "csv.h"
-#include "widechar.h"
-#include "base64.h"
-#include "sid.h"
 #include "datastruct.h"
+#include "evt.h"
+#include "mapfile.h"
+#include "evtlog.h"
+#include "acmatch.h"
+#include "fpset.h"
+#include "options.h"
+#include "timeconv.h"
+#include "record.h"
+#include "sink.h"
+#include "scan.h"
+#include "filter.h"
+#include "convert.h"
+#include "archive.h"
+#include "workers.h"
+#ifdef HAVE_DIRENT_H
+#include "cache.h"
+#endif /* HAVE_DIRENT_H */
+
+
+/** An additional output written from the same records. */
+typedef struct
+{
+	/** The path to the file, or NULL if the output isn't requested. */
+	const char *path;
+	/** The open file. */
+	FILE *fp;
+	/** Create a sink writing into the file. */
+	Sink *(*create) (FILE *output);
+}
+SideOutput;
+
+/** Additional outputs. */
+enum
+{
+	EVT2CSV_SIDE_SUMMARY,
+	EVT2CSV_SIDE_JSON,
+	EVT2CSV_SIDE_STATS,
+	EVT2CSV_SIDE_COUNT
+};
 
 
-/** Process an .evt file. */
-static int processFile (FILE *__restrict input, FILE *__restrict output);
-/** Handle read() failure in proccessFile(). */
-static inline int handleReadRecordFailure
-	(FILE *__restrict input, EvtHeader *__restrict hdr, int wraps);
+/** Members of an archive being extracted at once. */
+typedef struct
+{
+	/** The archive. */
+	const Archive *ar;
+	/** The number of the first member. */
+	size_t first;
+	/** The extracted members. */
+	ArchiveMember *members;
+	/** Storage for each of the members. */
+	Buffer *storage;
+	/** Whether extracting each of the members has failed. */
+	int *failed;
+}
+ExtractBatch;
 
-/** Process a record. */
-static void processRecord (EvtRecord *__restrict rec,
-	const void *__restrict nonFixed, size_t nonFixedLength,
-	CsvWriter __restrict wrt);
-/** Write a CSV field in base64. */
-static int writeFieldBase64 (CsvWriter __restrict wrt,
-	const void *__restrict field, size_t length);
+
+/** Print usage information. */
+static void printUsage (FILE *stream);
+
+/** Convert a log, or all logs in an archive.
+ *  @return 0 on success, -1 on failure. An error message is printed.
+ */
+static int convertInput (Conversion *__restrict conv,
+	const char *__restrict path);
+/** Convert logs in a seekable archive, extracting several at once. */
+static int convertSeekable (Conversion *__restrict conv,
+	const Archive *__restrict ar);
+/** Extract a member of an archive, to be run by workersRun(). */
+static void extractJob (void *batch, size_t index);
+/** Convert a log extracted from an archive. */
+static int convertMember (Conversion *__restrict conv,
+	const Archive *__restrict ar, const ArchiveMember *__restrict member);
+
+/** Build the filter from the event IDs and the time range.
+ *  @param[out] filter  An empty filter.
+ *  @param[in] eventIDs  Event IDs, any of which may match.
+ *  @param[in] nEventIDs  The number of @a eventIDs.
+ *  @param[in] after  The earliest time generated, or -1.
+ *  @param[in] before  The latest time generated, or -1.
+ */
+static void buildFilter (ScanFilter *__restrict filter,
+	const uint32_t *__restrict eventIDs, int nEventIDs,
+	time_t after, time_t before);
+/** Clamp a time into the range of the fields of records. */
+static uint32_t clampTime (time_t t);
+
+/** Parse the argument of the shard option. */
+static int parseShardKey (const char *__restrict spec,
+	ShardKey *__restrict key, unsigned long *__restrict param);
+
+#ifdef HAVE_DIRENT_H
+/** Make up the cache key from the inputs and everything that affects
+ *  the output. Paths of the inputs don't matter, only their contents.
+ *  @return 0 on success, -1 on failure. An error message is printed.
+ */
+static int makeCacheKey (Cache *__restrict cache,
+	const Conversion *__restrict conv, int dedupe,
+	const char *__restrict patternsPath, int foldCase,
+	const char *__restrict expression, char *inputs[], int nInputs);
+/** Parse the argument of the cache size option. */
+static int parseCacheSize (const char *__restrict spec,
+	unsigned long long *__restrict limit);
+/** Copy the rest of a stream into another one.
+ *  @return 0 on success, -1 on failure.
+ */
+static int copyStream (FILE *__restrict in, FILE *__restrict out);
+#endif /* HAVE_DIRENT_H */
+
+
+/** Command line options. */
+static const OptionSpec optionSpecs[] =
+{
+	{'o', "output", 1},
+	{'D', "dedupe", 0},
+	{'r', "reverse", 0},
+	{'l', "last", 1},
+	{'b', "blob", 1},
+	{'k', "shard", 1},
+#ifdef HAVE_ZLIB
+	{'z', "gzip", 0},
+#endif /* HAVE_ZLIB */
+	{'S', "summary", 1},
+	{'j', "json", 1},
+	{'T', "stats", 1},
+	{'m', "match", 1},
+	{'i', "ignore-case", 0},
+	{'e', "event-id", 1},
+	{'a', "after", 1},
+	{'B', "before", 1},
+	{'f', "filter", 1},
+#ifdef HAVE_DIRENT_H
+	{'c', "cache", 1},
+	{'C', "cache-size", 1},
+#endif /* HAVE_DIRENT_H */
+#ifdef HAVE_SQLITE3
+	{'s', "sqlite", 1},
+#endif /* HAVE_SQLITE3 */
+	{'h', "help", 0},
+	{0, NULL, 0}
+};
 
 
 int main (int argc, char *argv[])
 {
-	FILE *output, *input;
+	OptionsState opts = OPTIONS_INITIALIZER;
+	Conversion conv;
+	FILE *output = NULL, *blob = NULL, *csvOutput;
+	const char *blobPath = NULL, *sqlitePath = NULL, *patternsPath = NULL;
+	const char *outputPath = NULL, *expression = NULL;
+	SideOutput sides[EVT2CSV_SIDE_COUNT] =
+	{
+		{NULL, NULL, sinkCreateSummary},
+		{NULL, NULL, sinkCreateJson},
+		{NULL, NULL, sinkCreateStats}
+	};
+	Sink *sinks[1 + EVT2CSV_SIDE_COUNT];
+	size_t nSinks = 0;
+	int opt, ret = 0, foldCase = 0, dedupe = 0, relative, nInputs, i;
+	int shard = 0, compress = 0;
+	ShardKey shardKey = SHARD_BY_SOURCE;
+	unsigned long shardParam = 0;
+	uint32_t *eventIDs;
+	int nEventIDs = 0;
+	time_t after = -1, before = -1;
+	unsigned long id;
+	char *end;
+#ifdef HAVE_DIRENT_H
+	const char *cachePath = NULL;
+	unsigned long long cacheLimit = CACHE_DEFAULT_LIMIT;
+	int cacheLimitSet = 0, hasSides = 0, hit;
+	Cache cache;
+	FILE *cached = NULL;
+#endif /* HAVE_DIRENT_H */
 
 #ifdef HAVE_GETTEXT
     /* All we want is localized messages. */
@@ -51,333 +200,562 @@ int main (int argc, char *argv[])
     textdomain(GETTEXT_DOMAIN);
 #endif
 
-	if (argc == 1 || argc > 3)
+#ifndef HAVE__MKGMTIME
+	setutctimezone();
+#endif
+
+	conversionInit(&conv);
+	eventIDs = xmalloc(argc * sizeof(uint32_t));
+
+	while ((opt = optionsNext(&opts, argc, argv, optionSpecs)) != OPTIONS_END)
 	{
-		fputs(_("Usage: evt2csv input-file [output-file]\n"), stderr);
-		exit(EXIT_FAILURE);
+		switch (opt)
+		{
+		case 'o':
+			outputPath = opts.arg;
+			break;
+		case 'D':
+			dedupe = 1;
+			break;
+		case 'r':
+			conv.reverse = 1;
+			break;
+		case 'l':
+			conv.last = strtoul(opts.arg, &end, 10);
+			if (!*opts.arg || *end || !conv.last)
+			{
+				fprintf(stderr, _("Error: Invalid record count: %s.\n"),
+					opts.arg);
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case 'b':
+			blobPath = opts.arg;
+			break;
+		case 'k':
+			if (parseShardKey(opts.arg, &shardKey, &shardParam))
+			{
+				fprintf(stderr, _("Error: Invalid shard key: %s.\n"),
+					opts.arg);
+				exit(EXIT_FAILURE);
+			}
+			shard = 1;
+			break;
+		case 'z':
+			compress = 1;
+			break;
+		case 's':
+			sqlitePath = opts.arg;
+			break;
+		case 'S':
+			sides[EVT2CSV_SIDE_SUMMARY].path = opts.arg;
+			break;
+		case 'j':
+			sides[EVT2CSV_SIDE_JSON].path = opts.arg;
+			break;
+		case 'T':
+			sides[EVT2CSV_SIDE_STATS].path = opts.arg;
+			break;
+		case 'm':
+			patternsPath = opts.arg;
+			break;
+		case 'i':
+			foldCase = 1;
+			break;
+		case 'e':
+			id = strtoul(opts.arg, &end, 10);
+			if (!*opts.arg || *end || id > UINT32_MAX)
+			{
+				fprintf(stderr, _("Error: Invalid event ID: %s.\n"),
+					opts.arg);
+				exit(EXIT_FAILURE);
+			}
+			eventIDs[nEventIDs++] = id;
+			break;
+		case 'f':
+			expression = opts.arg;
+			break;
+		case 'a':
+		case 'B':
+			if (parseTime(opts.arg) == -1)
+			{
+				fprintf(stderr, _("Error: Invalid time: %s.\n"), opts.arg);
+				exit(EXIT_FAILURE);
+			}
+			if (opt == 'a')
+				after = parseTime(opts.arg);
+			else
+				before = parseTime(opts.arg);
+			break;
+#ifdef HAVE_DIRENT_H
+		case 'c':
+			cachePath = opts.arg;
+			break;
+		case 'C':
+			if (parseCacheSize(opts.arg, &cacheLimit))
+			{
+				fprintf(stderr, _("Error: Invalid cache size: %s.\n"),
+					opts.arg);
+				exit(EXIT_FAILURE);
+			}
+			cacheLimitSet = 1;
+			break;
+#endif /* HAVE_DIRENT_H */
+		case 'h':
+			printUsage(stdout);
+			exit(EXIT_SUCCESS);
+		default:
+			printUsage(stderr);
+			exit(EXIT_FAILURE);
+		}
 	}
+	argc -= opts.index;
+	argv += opts.index;
 
-	if (!(input = fopen(argv[1], "rb")))
-	{
-		fprintf(stderr, _("Error: Failed to open %s for reading.\n"), argv[1]);
+	buildFilter(&conv.filter, eventIDs, nEventIDs, after, before);
+	free(eventIDs);
+	if (expression
+		&& !(conv.plan = filterCompile(expression, &conv.filter)))
 		exit(EXIT_FAILURE);
+	relative = conv.plan && filterIsRelative(conv.plan);
+	if (conv.plan && filterIsEmpty(conv.plan))
+	{
+		filterDestroy(conv.plan);
+		conv.plan = NULL;
 	}
 
-	output = stdout;
-	if (argc == 3 && *argv[2] && strcmp(argv[2], "-")
-		&& !(output = fopen(argv[2], "wb")))
+	/* When loading into a database, there's no CSV output. */
+	if (argc < 1 || (sqlitePath && (blobPath || outputPath || shard))
+		|| (!sqlitePath && !outputPath && argc > 2)
+		|| (shard && blobPath) || (compress && !shard))
 	{
-		fprintf(stderr, _("Error: Failed to open %s for writing.\n"), argv[2]);
+		printUsage(stderr);
 		exit(EXIT_FAILURE);
 	}
 
-	if (processFile(input, output))
-		exit(EXIT_FAILURE);
-
-	fclose(input);
-	fclose(output);
-
-	return 0;
-}
-
-static int processFile (FILE *__restrict input, FILE *__restrict output)
-{
-	EvtHeader hdr;
-	union
+	/* Unless the output is given by an option, there's just one input. */
+	nInputs = argc;
+	if (!sqlitePath && !outputPath)
 	{
-		EvtEOF eof;
-		EvtRecord fixed;
+		nInputs = 1;
+		if (argc == 2)
+			outputPath = argv[1];
 	}
-	rec;
-	CsvWriter wrt;
-	long fileSize;
-	int wraps, ret = -1;
-
-	/* FIXME: Shuffle the bits on big endian machines. */
 
-	if (!fread(&hdr, sizeof(hdr), 1, input))
+	/* The summary has to describe the whole of a single log, otherwise
+	 * evtprobe would skip logs that do contain what's being looked for. */
+	if (sides[EVT2CSV_SIDE_SUMMARY].path && (nInputs > 1 || dedupe
+		|| conv.last || patternsPath || !scanFilterIsEmpty(&conv.filter)
+		|| conv.plan))
 	{
-		fputs(_("Error: Failed to read ELF header.\n"), stderr);
-		return -1;
-	}
-	if (hdr.signature != EVT_SIGNATURE)
-	{
-		fputs(_("Error: ELF signature doesn't match.\n"), stderr);
-		return -1;
+		fputs(_("Error: A summary can only be written for a single log"
+			" converted as a whole.\n"), stderr);
+		exit(EXIT_FAILURE);
 	}
-	if (hdr.flags & EVT_HEADER_DIRTY)
-		fputs(_("Warning: The log file is marked dirty.\n"), stderr);
-	wraps = hdr.flags & EVT_HEADER_WRAP;
 
-	/* This should cut out the case when stdin is given as the input. */
-	if (fseek(input, hdr.startOffset, SEEK_SET))
+	/* Shards are written into files whose paths begin with the output. */
+	if (shard && (!outputPath || !*outputPath || !strcmp(outputPath, "-")))
 	{
-		fprintf(stderr, _("Error: fseek: %s.\n"), strerror(errno));
-		return -1;
+		printUsage(stderr);
+		exit(EXIT_FAILURE);
 	}
-	if ((fileSize = filelength(fileno(input))) == -1)
+
+#ifdef HAVE_DIRENT_H
+	/* Only the plain CSV output is cached. */
+	for (i = 0; i < EVT2CSV_SIDE_COUNT; i++)
+		if (sides[i].path)
+			hasSides = 1;
+	if ((cacheLimitSet && !cachePath) || (cachePath
+		&& (sqlitePath || shard || blobPath || hasSides)))
 	{
-		fputs(_("Error: Failed to get file size.\n"), stderr);
-		return -1;
+		printUsage(stderr);
+		exit(EXIT_FAILURE);
 	}
 
-	/* Write out a special header record with file size.
-	 * (The only non-record value that is really useful
-	 * for reconstructing the .evt.)
-	 */
-	fprintf(output, "%lu\n", fileSize);
+	/* What a relative time selects changes from second to second,
+	 * so the entry would never be used again. */
+	if (relative)
+		cachePath = NULL;
+#endif /* HAVE_DIRENT_H */
 
-	wrt = csvCreateWriter(output);
-	while (1)
-	{
-		void *nonFixed;
-		uint32_t nonFixedLength;
+	if (patternsPath
+		&& !(conv.matcher = conversionLoadPatterns(patternsPath, foldCase)))
+		exit(EXIT_FAILURE);
+	if (dedupe)
+		conv.seen = fpSetCreate(CONVERSION_DEDUPE_MEMORY);
 
-		if (!fread(&rec, sizeof(rec.eof), 1, input))
+	if (shard)
+		conv.sink = sinkCreateShard(outputPath, shardKey, shardParam, compress);
+	else if (!sqlitePath)
+	{
+		output = stdout;
+		if (outputPath && *outputPath && strcmp(outputPath, "-")
+			&& !(output = fopen(outputPath, "wb")))
 		{
-			if (handleReadRecordFailure(input, &hdr, wraps))
-				break;
-			else
-				continue;
+			fprintf(stderr, _("Error: Failed to open %s for writing.\n"),
+				outputPath);
+			exit(EXIT_FAILURE);
 		}
-
-		if (rec.eof.one == 0x11111111 && rec.eof.two == 0x22222222
-			&& rec.eof.three == 0x33333333 && rec.eof.four == 0x44444444)
+		if (blobPath && !(blob = fopen(blobPath, "wb")))
 		{
-			ret = 0;
-			break;
+			fprintf(stderr, _("Error: Failed to open %s for writing.\n"),
+				blobPath);
+			exit(EXIT_FAILURE);
 		}
-
-		/* Not an EOF record (which is shorter), so let's read the rest. */
-		if (!fread((char *) &rec + sizeof(rec.eof),
-				sizeof(rec.fixed) - sizeof(rec.eof), 1, input))
+		csvOutput = output;
+#ifdef HAVE_DIRENT_H
+		if (cachePath)
 		{
-			if (handleReadRecordFailure(input, &hdr, wraps))
-				break;
-			else
-				continue;
+			if (cacheInit(&cache, cachePath, cacheLimit)
+				|| makeCacheKey(&cache, &conv, dedupe, patternsPath,
+					foldCase, expression, argv, nInputs))
+				exit(EXIT_FAILURE);
+			if ((hit = cacheFetch(&cache, output)))
+			{
+				if (hit < 0 || fclose(output))
+					exit(EXIT_FAILURE);
+				exit(EXIT_SUCCESS);
+			}
+
+			/* The output is kept aside to be stored in the cache. */
+			if (!(csvOutput = cached = tmpfile()))
+			{
+				fputs(_("Error: Failed to create a temporary file.\n"),
+					stderr);
+				exit(EXIT_FAILURE);
+			}
 		}
+#endif /* HAVE_DIRENT_H */
+		conv.sink = sinkCreateCsv(csvOutput, blob);
+	}
+#ifdef HAVE_SQLITE3
+	else if (!(conv.sink = sinkCreateSqlite(sqlitePath)))
+		exit(EXIT_FAILURE);
+#endif /* HAVE_SQLITE3 */
 
-		nonFixedLength = rec.fixed.length - sizeof(rec.fixed);
-		if (nonFixedLength > (unsigned) fileSize)
+	/* All the outputs are fed from a single pass over the records. */
+	sinks[nSinks++] = conv.sink;
+	for (i = 0; i < EVT2CSV_SIDE_COUNT; i++)
+	{
+		if (!sides[i].path)
+			continue;
+		if (!(sides[i].fp = fopen(sides[i].path, "wb")))
 		{
-			fprintf(stderr, _("Error: Record %u is longer than "
-				"the whole file.\n"), rec.fixed.recordNumber);
-			break;
+			fprintf(stderr, _("Error: Failed to open %s for writing.\n"),
+				sides[i].path);
+			exit(EXIT_FAILURE);
 		}
-		nonFixed = xmalloc(nonFixedLength);
+		sinks[nSinks++] = sides[i].create(sides[i].fp);
+	}
+	if (nSinks > 1)
+		conv.sink = sinkCreateTee(sinks, nSinks);
 
-		/* FIXME: These functions are not checked for errors. */
-		if (wraps)
-		{
-			long pos;
+	for (i = 0; i < nInputs && !ret; i++)
+		ret = convertInput(&conv, argv[i]);
+	conversionDestroy(&conv);
+	if (conv.sink->close(conv.sink) || ret)
+		exit(EXIT_FAILURE);
 
-			pos = ftell(input);
-			if (pos + nonFixedLength > (unsigned) fileSize)
-			{
-				fread(nonFixed, fileSize - pos, 1, input);
-				/* Wrap around the end of file and read the rest. */
-				fseek(input, hdr.headerSize, SEEK_SET);
-				fread(nonFixed, nonFixedLength - (fileSize - pos), 1, input);
-			}
-			else
-				fread(nonFixed, nonFixedLength, 1, input);
+#ifdef HAVE_DIRENT_H
+	/* Failing to store the output doesn't make the conversion fail. */
+	if (cached)
+	{
+		if (fseek(cached, 0, SEEK_SET) || copyStream(cached, output))
+		{
+			fputs(_("Error: Failed to write the output.\n"), stderr);
+			exit(EXIT_FAILURE);
 		}
-		else
-			fread(nonFixed, nonFixedLength, 1, input);
+		if (!fseek(cached, 0, SEEK_SET))
+			cacheStore(&cache, cached);
+		fclose(cached);
+	}
+#endif /* HAVE_DIRENT_H */
 
-		processRecord(&rec.fixed, nonFixed, nonFixedLength, wrt);
-		free(nonFixed);
+	if (output)
+		fclose(output);
+	if (blob && fclose(blob))
+	{
+		fprintf(stderr, _("Error: Failed to write to %s.\n"), blobPath);
+		exit(EXIT_FAILURE);
 	}
-	csvDestroyWriter(wrt);
-	return ret;
+	for (i = 0; i < EVT2CSV_SIDE_COUNT; i++)
+	{
+		if (sides[i].fp && fclose(sides[i].fp))
+		{
+			fprintf(stderr, _("Error: Failed to write to %s.\n"),
+				sides[i].path);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	return 0;
 }
 
-static inline int handleReadRecordFailure
-	(FILE *__restrict input, EvtHeader *__restrict hdr, int wraps)
+static void printUsage (FILE *stream)
 {
-	if (ferror(input))
-		fprintf(stderr, _("Error: fread: %s\n"), strerror(errno));
-	else if (wraps)
+	fputs(_("Usage: evt2csv [option]... input-file [output-file]\n"
+		"       evt2csv -o output-file [option]... input-file...\n"
+		"       evt2csv -k shard-key [-z] [option]... input-file output-prefix\n"
+		"       evt2csv -o output-prefix -k shard-key [-z] [option]... "
+		"input-file...\n"), stream);
+#ifdef HAVE_SQLITE3
+	fputs(_("       evt2csv -s database [option]... input-file...\n"), stream);
+#endif /* HAVE_SQLITE3 */
+	fputs(_("Options: [-D] [-r] [-l count] [-b blob-file] [-m patterns-file [-i]]\n"
+		"         [-e event-id]... [-a time] [-B time] [-f expression]\n"
+		"         [-S summary-file] [-j json-file] [-T stats-file]\n"), stream);
+#ifdef HAVE_DIRENT_H
+	fputs(_("         [-c cache-dir [-C cache-size]]\n"), stream);
+#endif /* HAVE_DIRENT_H */
+	fputs(_("Shard keys: source, id, type, time=seconds[mhd], "
+		"size=bytes[kMG]\n"), stream);
+}
+
+static int convertInput (Conversion *__restrict conv,
+	const char *__restrict path)
+{
+	Archive ar;
+	ArchiveMember member;
+	EvtLog log;
+	int ret;
+
+	if ((ret = archiveOpen(&ar, path)) == 1)
 	{
-		/* Wrap around the end of file. */
-		fseek(input, hdr->headerSize, SEEK_SET);
-		return 0;
+		if (evtLogOpen(&log, path))
+			return -1;
+		ret = conversionRun(conv, &log);
+		evtLogClose(&log);
+		return ret;
 	}
+	if (ret)
+		return -1;
+
+	/* Streams can only be read one member after another. */
+	if (archiveIsSeekable(&ar))
+		ret = convertSeekable(conv, &ar);
 	else
-		fputs(_("Error: Unexpected end of file.\n"), stderr);
-	return 1;
+	{
+		while ((ret = archiveNext(&ar, &member)) == 1)
+			if (convertMember(conv, &ar, &member))
+				break;
+		ret = ret ? -1 : 0;
+	}
+
+	archiveClose(&ar);
+	return ret;
 }
 
-static void processRecord (EvtRecord *__restrict rec,
-	const void *__restrict nonFixed, size_t nonFixedLength,
-	CsvWriter __restrict wrt)
+static int convertSeekable (Conversion *__restrict conv,
+	const Archive *__restrict ar)
 {
-	time_t timeGenerated, timeWritten;
-	/* Yes, the buffer is large enough. */
-	char buff[40], *s, *sCur;
-	Buffer final = BUFFER_INITIALIZER;
-	int offset, len;
-
-	/* First field: record number. */
-	snprintf(buff, sizeof(buff), "%d", rec->recordNumber);
-	csvWrite(wrt, buff);
-
-	/* Second field: time generated (GMT). */
-	timeGenerated = rec->timeGenerated;
-	strftime(buff, sizeof(buff), "%Y-%m-%d %H:%M:%S", gmtime(&timeGenerated));
-	csvWrite(wrt, buff);
-
-	/* Third field: time written (GMT). */
-	timeWritten = rec->timeWritten;
-	strftime(buff, sizeof(buff), "%Y-%m-%d %H:%M:%S", gmtime(&timeWritten));
-	csvWrite(wrt, buff);
-
-	/* Fourth field: event ID. */
-	snprintf(buff, sizeof(buff), "%u", rec->eventID);
-	csvWrite(wrt, buff);
-
-	/* Fifth field: event type. */
-	switch (rec->eventType)
+	ExtractBatch batch;
+	unsigned nThreads;
+	size_t n, i;
+	int ret = 0;
+
+	/* Members are decompressed in parallel, yet converted in order. */
+	nThreads = workersDefaultCount();
+	batch.ar = ar;
+	batch.members = xmalloc(nThreads * sizeof(ArchiveMember));
+	batch.storage = xmalloc(nThreads * sizeof(Buffer));
+	batch.failed = xmalloc(nThreads * sizeof(int));
+	for (i = 0; i < nThreads; i++)
+		bufferInit(&batch.storage[i]);
+
+	for (batch.first = 0; batch.first < ar->count && !ret; batch.first += n)
 	{
-		case EVT_INFORMATION_TYPE:
-			csvWrite(wrt, "Information");
-			break;
-		case EVT_WARNING_TYPE:
-			csvWrite(wrt, "Warning");
-			break;
-		case EVT_ERROR_TYPE:
-			csvWrite(wrt, "Error");
-			break;
-		case EVT_AUDIT_SUCCESS:
-			csvWrite(wrt, "Audit Success");
-			break;
-		case EVT_AUDIT_FAILURE:
-			csvWrite(wrt, "Audit Failure");
-			break;
-		default:
-			/* Unknown type: express with a number. */
-			snprintf(buff, sizeof(buff), "%u", rec->eventType);
-			csvWrite(wrt, buff);
+		n = ar->count - batch.first;
+		if (n > nThreads)
+			n = nThreads;
+
+		workersRun(extractJob, &batch, n, nThreads);
+		for (i = 0; i < n && !ret; i++)
+			if (batch.failed[i]
+				|| convertMember(conv, ar, &batch.members[i]))
+				ret = -1;
 	}
 
-	/* Sixth field: event category. */
-	snprintf(buff, sizeof(buff), "%d", rec->eventCategory);
-	csvWrite(wrt, buff);
+	for (i = 0; i < nThreads; i++)
+		bufferDestroy(&batch.storage[i]);
+	free(batch.members);
+	free(batch.storage);
+	free(batch.failed);
+	return ret;
+}
 
-	/* Seventh field: source name (in UTF-8). */
-	if ((offset = decodeWideString((uint16_t *) nonFixed,
-		nonFixedLength, &s)))
-	{
-		csvWrite(wrt, s);
-		free(s);
-	}
-	else
+static void extractJob (void *batch, size_t index)
+{
+	ExtractBatch *b = batch;
+
+	b->failed[index] = archiveExtract(b->ar, b->first + index,
+		&b->members[index], &b->storage[index]);
+}
+
+static int convertMember (Conversion *__restrict conv,
+	const Archive *__restrict ar, const ArchiveMember *__restrict member)
+{
+	EvtLog log;
+	int ret;
+
+	if (evtLogOpenMemory(&log, member->data, member->length))
 	{
-		fprintf(stderr, _("Warning: Failed to decode the source name string "
-			"in record %u.\n"), rec->recordNumber);
-		csvWrite(wrt, s);
+		fprintf(stderr, _("Error: Failed to read %s in %s.\n"),
+			member->name, ar->path);
+		return -1;
 	}
+	ret = conversionRun(conv, &log);
+	evtLogClose(&log);
+	return ret;
+}
+
+static void buildFilter (ScanFilter *__restrict filter,
+	const uint32_t *__restrict eventIDs, int nEventIDs,
+	time_t after, time_t before)
+{
+	int i;
 
-	/* Eighth field: computer name (in UTF-8). */
-	if ((decodeWideString((uint16_t *) ((char *) nonFixed + offset),
-		nonFixedLength - offset, &s)))
+	for (i = 0; i < nEventIDs; i++)
 	{
-		csvWrite(wrt, s);
-		free(s);
+		scanFilterTest(filter, SCAN_EVENT_ID, SCAN_EQ, eventIDs[i]);
+		if (i)
+			scanFilterOperator(filter, SCAN_OR);
 	}
-	else
+	if (after != -1)
 	{
-		fprintf(stderr, _("Warning: Failed to decode the computer name string "
-			"in record %u.\n"), rec->recordNumber);
-		csvWrite(wrt, s);
+		scanFilterTest(filter, SCAN_TIME_GENERATED, SCAN_GE,
+			clampTime(after));
+		if (nEventIDs)
+			scanFilterOperator(filter, SCAN_AND);
 	}
-
-	/* Nineth field: SID. */
-	if (rec->userSidOffset + rec->userSidLength > rec->length)
+	if (before != -1)
 	{
-		fprintf(stderr, _("Warning: Record %u has overflowing SID field. "
-			"I'm not reading it.\n"), rec->recordNumber);
-		csvWrite(wrt, "");
+		scanFilterTest(filter, SCAN_TIME_GENERATED, SCAN_LE,
+			clampTime(before));
+		if (nEventIDs || after != -1)
+			scanFilterOperator(filter, SCAN_AND);
 	}
-	else if (!rec->userSidLength)
-		csvWrite(wrt, "");
-	else
+}
+
+static uint32_t clampTime (time_t t)
+{
+	if (t < 0)
+		return 0;
+	if ((unsigned long long) t > UINT32_MAX)
+		return UINT32_MAX;
+	return t;
+}
+
+static int parseShardKey (const char *__restrict spec,
+	ShardKey *__restrict key, unsigned long *__restrict param)
+{
+	static const struct
 	{
-		if ((s = sidToString((char *) nonFixed + rec->userSidOffset
-			- sizeof(EvtRecord), rec->userSidLength)))
-		{
-			csvWrite(wrt, s);
-			free(s);
-		}
-		else
-		{
-			fprintf(stderr, _("Error: SID decoding failed in record %u.\n"),
-				rec->recordNumber);
-			csvWrite(wrt, "");
-		}
+		const char *name;
+		ShardKey key;
+		/** The units that may follow the parameter, or NULL if none. */
+		const char *units;
+		unsigned long multipliers[3];
 	}
-
-	/* Tenth field: strings (in UTF-8). */
-	offset = rec->stringOffset - sizeof(EvtRecord);
-	while (rec->numStrings--)
+	keys[] =
 	{
-		if (!(len = decodeWideString((uint16_t *) ((char *) nonFixed + offset),
-			nonFixedLength - offset, &s)))
-		{
-			fprintf(stderr, _("Error: String decoding failed in record %u.\n"),
-				rec->recordNumber);
+		{"source", SHARD_BY_SOURCE, NULL, {0, 0, 0}},
+		{"id",     SHARD_BY_EVENT_ID, NULL, {0, 0, 0}},
+		{"type",   SHARD_BY_TYPE, NULL, {0, 0, 0}},
+		{"time",   SHARD_BY_TIME, "mhd", {60, 3600, 86400}},
+		{"size",   SHARD_BY_SIZE, "kMG", {1UL << 10, 1UL << 20, 1UL << 30}}
+	};
+	const char *unit;
+	char *end;
+	size_t i, nameLength;
+
+	nameLength = strcspn(spec, "=");
+	for (i = 0; i < sizeof(keys) / sizeof(keys[0]); i++)
+		if (strlen(keys[i].name) == nameLength
+			&& !strncmp(keys[i].name, spec, nameLength))
 			break;
-		}
-		offset += len;
+	if (i == sizeof(keys) / sizeof(keys[0]))
+		return -1;
 
-		/* The strings are separated by '|' chars.
-		 * This separator may be escaped with '\'.
-		 */
-		for (sCur = s; *sCur; sCur++)
-		{
-			if (*sCur == '|' || *sCur == '\\')
-				bufferAppendChar(&final, '\\');
-			bufferAppendChar(&final, *sCur);
-		}
-		if (rec->numStrings)
-			bufferAppendChar(&final, '|');
-		free(s);
+	*key = keys[i].key;
+	*param = 0;
+	if (!keys[i].units)
+		return spec[nameLength] ? -1 : 0;
+	if (spec[nameLength] != '=')
+		return -1;
+
+	spec += nameLength + 1;
+	*param = strtoul(spec, &end, 10);
+	if (end == spec || !*param)
+		return -1;
+	if (*end && (unit = strchr(keys[i].units, *end)))
+	{
+		*param *= keys[i].multipliers[unit - keys[i].units];
+		end++;
 	}
-	s = NULL;
-	bufferAppendChar(&final, '\0');
-	csvWrite(wrt, final.data);
-	bufferDestroy(&final);
+	return *end ? -1 : 0;
+}
+
+#ifdef HAVE_DIRENT_H
+static int makeCacheKey (Cache *__restrict cache,
+	const Conversion *__restrict conv, int dedupe,
+	const char *__restrict patternsPath, int foldCase,
+	const char *__restrict expression, char *inputs[], int nInputs)
+{
+	char options[128];
+	int i;
+
+	snprintf(options, sizeof(options), "evt2csv %s D%d r%d l%lu m%d i%d",
+		PROJECT_VERSION, dedupe, conv->reverse, (unsigned long) conv->last,
+		patternsPath != NULL, foldCase);
+	cacheAddString(cache, options);
 
-	/* Eleventh field: data (in base64). */
-	if (rec->dataOffset + rec->dataLength > rec->length)
+	for (i = 0; i < (int) conv->filter.count; i++)
 	{
-		fprintf(stderr, _("Warning: Record %u has overflowing data field. "
-			"I'm not reading it.\n"), rec->recordNumber);
-		csvWrite(wrt, "");
+		const ScanStep *step = &conv->filter.steps[i];
+
+		snprintf(options, sizeof(options), "%d %d %d %lu",
+			(int) step->op, (int) step->field, (int) step->compare,
+			(unsigned long) step->value);
+		cacheAddString(cache, options);
 	}
-	else if (writeFieldBase64(wrt, (char *) nonFixed + rec->dataOffset
-		- sizeof(EvtRecord), rec->dataLength))
-		csvWrite(wrt, "");
+	/* Fixed conditions of the expression are among the steps. */
+	if (expression)
+		cacheAddString(cache, expression);
 
-	/* End of record. */
-	csvWrite(wrt, NULL);
+	if (patternsPath && cacheAddFile(cache, patternsPath))
+		return -1;
+	for (i = 0; i < nInputs; i++)
+		if (cacheAddFile(cache, inputs[i]))
+			return -1;
+	return 0;
 }
 
-static int writeFieldBase64 (CsvWriter __restrict wrt,
-	const void *__restrict field, size_t length)
+static int parseCacheSize (const char *__restrict spec,
+	unsigned long long *__restrict limit)
 {
-	base64_encodestate state;
-	char *buff;
-	int offset, ret;
+	static const char units[] = "kMG";
+	const char *unit;
+	char *end;
 
-	base64_init_encodestate(&state);
-	buff = xmalloc(BASE64_ENCODED_BUFFER_SIZE(length));
-
-	offset = base64_encode_block(field, length, buff, &state);
-	base64_encode_blockend(buff + offset, &state);
-	ret = csvWrite(wrt, buff);
-	free(buff);
-	return ret;
+	*limit = strtoull(spec, &end, 10);
+	if (end == spec || !*limit)
+		return -1;
+	if (*end && (unit = strchr(units, *end)))
+	{
+		*limit <<= 10 * (unit - units + 1);
+		end++;
+	}
+	return *end ? -1 : 0;
 }
 
+static int copyStream (FILE *__restrict in, FILE *__restrict out)
+{
+	char buff[BUFSIZ];
+	size_t length;
+
+	while ((length = fread(buff, 1, sizeof(buff), in)))
+		if (fwrite(buff, 1, length, out) != length)
+			return -1;
+	return ferror(in) || fflush(out) ? -1 : 0;
+}
+#endif /* HAVE_DIRENT_H */
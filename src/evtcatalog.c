@@ -0,0 +1,182 @@
+/**
+ *  @file evtcatalog.c
+ *  @brief Maintenance and querying of event log catalogs
+ *
+ *  Copyright Přemysl Janouch 2010. All rights reserved.
+ *  See the file LICENSE for licensing information.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "configure.h"
+
+#include "xalloc.h"
+#include "datastruct.h"
+#include "options.h"
+#include "timeconv.h"
+#include "catalog.h"
+
+
+/** Print usage information. */
+static void printUsage (FILE *stream);
+
+/** Compare two strings, ignoring the case of ASCII letters. */
+static int compareHosts (const char *a, const char *b);
+
+/** Add files to the catalog or update their entries. */
+static int updateCatalog (Catalog *__restrict catalog,
+	int nFiles, char *files[], int force);
+
+
+/** Command line options. */
+static const OptionSpec optionSpecs[] =
+{
+	{'u', "update", 0},
+	{'f', "force", 0},
+	{'H', "host", 1},
+	{'a', "after", 1},
+	{'B', "before", 1},
+	{'h', "help", 0},
+	{0, NULL, 0}
+};
+
+
+int main (int argc, char *argv[])
+{
+	OptionsState opts = OPTIONS_INITIALIZER;
+	Catalog catalog;
+	const char *host = NULL;
+	time_t after = -1, before = -1;
+	int opt, update = 0, force = 0, ret = 0;
+	size_t i;
+
+#ifdef HAVE_GETTEXT
+    /* All we want is localized messages. */
+    setlocale(LC_MESSAGES, "");
+
+    bindtextdomain(GETTEXT_DOMAIN, GETTEXT_DIRNAME);
+    textdomain(GETTEXT_DOMAIN);
+#endif
+
+#ifndef HAVE__MKGMTIME
+	setutctimezone();
+#endif
+
+	while ((opt = optionsNext(&opts, argc, argv, optionSpecs)) != OPTIONS_END)
+	{
+		switch (opt)
+		{
+		case 'u':
+			update = 1;
+			break;
+		case 'f':
+			force = 1;
+			break;
+		case 'H':
+			host = opts.arg;
+			break;
+		case 'a':
+		case 'B':
+			if (parseTime(opts.arg) == -1)
+			{
+				fprintf(stderr, _("Error: Invalid time: %s\n"), opts.arg);
+				exit(EXIT_FAILURE);
+			}
+			if (opt == 'a')
+				after = parseTime(opts.arg);
+			else
+				before = parseTime(opts.arg);
+			break;
+		case 'h':
+			printUsage(stdout);
+			exit(EXIT_SUCCESS);
+		default:
+			printUsage(stderr);
+			exit(EXIT_FAILURE);
+		}
+	}
+	argc -= opts.index;
+	argv += opts.index;
+
+	if (update ? argc < 2 : argc != 1)
+	{
+		printUsage(stderr);
+		exit(EXIT_FAILURE);
+	}
+
+	catalogInit(&catalog);
+	if (catalogLoad(&catalog, argv[0]))
+		exit(EXIT_FAILURE);
+
+	if (update)
+	{
+		ret = updateCatalog(&catalog, argc - 1, argv + 1, force);
+		if (catalogSave(&catalog, argv[0]))
+			ret = -1;
+	}
+	else for (i = 0; i < catalogCount(&catalog); i++)
+	{
+		const CatalogEntry *entry = &catalog.entries[i];
+
+		/* Keep only files that might contain records in the time range. */
+		if (host && (!entry->host || compareHosts(entry->host, host)))
+			continue;
+		if ((after != -1 || before != -1) && !entry->recordCount)
+			continue;
+		if (after != -1 && (time_t) entry->maxTimeGenerated < after)
+			continue;
+		if (before != -1 && (time_t) entry->minTimeGenerated > before)
+			continue;
+		puts(entry->path);
+	}
+
+	catalogDestroy(&catalog);
+	return ret ? EXIT_FAILURE : 0;
+}
+
+static void printUsage (FILE *stream)
+{
+	fputs(_("Usage: evtcatalog -u [-f] catalog file...\n"
+		"       evtcatalog [-H host] [-a after] [-B before] catalog\n"),
+		stream);
+}
+
+static int compareHosts (const char *a, const char *b)
+{
+	int ca, cb;
+
+	do
+	{
+		ca = (unsigned char) *a++;
+		cb = (unsigned char) *b++;
+		if (ca >= 'A' && ca <= 'Z')
+			ca += 'a' - 'A';
+		if (cb >= 'A' && cb <= 'Z')
+			cb += 'a' - 'A';
+	}
+	while (ca && ca == cb);
+	return ca - cb;
+}
+
+static int updateCatalog (Catalog *__restrict catalog,
+	int nFiles, char *files[], int force)
+{
+	CatalogEntry *entry;
+	int i, ret = 0;
+
+	for (i = 0; i < nFiles; i++)
+	{
+		if (!force && (entry = catalogFind(catalog, files[i]))
+			&& catalogIsCurrent(entry))
+			continue;
+
+		/* Keep the entry even if the file is broken, so that we know. */
+		if (catalogScan(catalogAdd(catalog, files[i])))
+			ret = -1;
+	}
+	return ret;
+}
@@ -0,0 +1,312 @@
+/**
+ *  @file evtcheck.c
+ *  @brief Checking .evt files for damage
+ *
+ *  Copyright Přemysl Janouch 2010. All rights reserved.
+ *  See the file LICENSE for licensing information.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+#include "configure.h"
+
+#include "xalloc.h"
+#include "datastruct.h"
+#include "evt.h"
+#include "mapfile.h"
+#include "evtlog.h"
+#include "options.h"
+#include "workers.h"
+
+
+/** The result of checking a file. */
+typedef struct
+{
+	/** The path to the file. */
+	const char *path;
+	/** Whether the file is fine. */
+	int ok;
+	/** Whether the log is marked dirty, so the header hasn't been checked. */
+	int dirty;
+	/** The number of records in the log. */
+	unsigned long records;
+	/** What is wrong with the file. */
+	char problem[256];
+}
+CheckResult;
+
+
+/** Print usage information. */
+static void printUsage (FILE *stream);
+
+/** Check a file, to be run by workersRun(). */
+static void checkJob (void *results, size_t index);
+/** Check a log.
+ *  @return 0 if the log is fine, -1 otherwise.
+ */
+static int checkLog (const MappedFile *__restrict file,
+	CheckResult *__restrict result);
+/** Describe the problem with a file.
+ *  @return -1, so that checkLog() may simply return it.
+ */
+static int fail (CheckResult *__restrict result,
+	const char *__restrict format, ...) ATTRIBUTE_FORMAT(printf, 2, 3);
+/** Check that a part of a record lies within the record. */
+static int isWithin (uint32_t offset, uint32_t length, uint32_t bodyLength);
+
+
+/** Command line options. */
+static const OptionSpec optionSpecs[] =
+{
+	{'j', "jobs", 1},
+	{'q', "quiet", 0},
+	{'h', "help", 0},
+	{0, NULL, 0}
+};
+
+
+int main (int argc, char *argv[])
+{
+	OptionsState opts = OPTIONS_INITIALIZER;
+	CheckResult *results;
+	unsigned nThreads;
+	int opt, quiet = 0, ret = EXIT_SUCCESS, i;
+	char *end;
+
+#ifdef HAVE_GETTEXT
+    /* All we want is localized messages. */
+    setlocale(LC_MESSAGES, "");
+
+    bindtextdomain(GETTEXT_DOMAIN, GETTEXT_DIRNAME);
+    textdomain(GETTEXT_DOMAIN);
+#endif
+
+	nThreads = workersDefaultCount();
+	while ((opt = optionsNext(&opts, argc, argv, optionSpecs)) != OPTIONS_END)
+	{
+		switch (opt)
+		{
+		case 'j':
+			nThreads = strtoul(opts.arg, &end, 10);
+			if (!*opts.arg || *end || !nThreads)
+			{
+				fprintf(stderr, _("Error: Invalid number of jobs: %s.\n"),
+					opts.arg);
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case 'q':
+			quiet = 1;
+			break;
+		case 'h':
+			printUsage(stdout);
+			exit(EXIT_SUCCESS);
+		default:
+			printUsage(stderr);
+			exit(EXIT_FAILURE);
+		}
+	}
+	argc -= opts.index;
+	argv += opts.index;
+
+	if (argc < 1)
+	{
+		printUsage(stderr);
+		exit(EXIT_FAILURE);
+	}
+
+	results = xmalloc(argc * sizeof(CheckResult));
+	for (i = 0; i < argc; i++)
+		results[i].path = argv[i];
+	workersRun(checkJob, results, argc, nThreads);
+
+	/* The results are printed in order once all files have been checked. */
+	for (i = 0; i < argc; i++)
+	{
+		if (!results[i].ok)
+		{
+			printf(_("%s: %s\n"), results[i].path, results[i].problem);
+			ret = EXIT_FAILURE;
+		}
+		else if (!quiet)
+		{
+			printf(N_("%s: OK, %lu record", "%s: OK, %lu records",
+				results[i].records), results[i].path, results[i].records);
+			fputs(results[i].dirty ? _(" (marked dirty)\n") : "\n", stdout);
+		}
+	}
+
+	free(results);
+	return ret;
+}
+
+static void printUsage (FILE *stream)
+{
+	fputs(_("Usage: evtcheck [-q] [-j jobs] file...\n"), stream);
+}
+
+static void checkJob (void *results, size_t index)
+{
+	CheckResult *result = (CheckResult *) results + index;
+	MappedFile file;
+
+	result->ok = 0;
+	result->dirty = 0;
+	result->records = 0;
+	if (mapFileOpen(&file, result->path))
+	{
+		fail(result, _("failed to open the file for reading"));
+		return;
+	}
+
+	result->ok = !checkLog(&file, result);
+	mapFileClose(&file);
+}
+
+static int fail (CheckResult *__restrict result,
+	const char *__restrict format, ...)
+{
+	va_list ap;
+
+	va_start(ap, format);
+	vsnprintf(result->problem, sizeof(result->problem), format, ap);
+	va_end(ap);
+	result->ok = 0;
+	return -1;
+}
+
+static int isWithin (uint32_t offset, uint32_t length, uint32_t bodyLength)
+{
+	return offset >= sizeof(EvtRecord) && offset <= bodyLength
+		&& length <= bodyLength - offset;
+}
+
+static int checkLog (const MappedFile *__restrict file,
+	CheckResult *__restrict result)
+{
+	const char *data = file->data;
+	size_t length = file->length, headerSize, offset, walked, trailer;
+	EvtHeader hdr;
+	EvtEOF eof;
+	EvtRecord rec;
+	uint32_t trailing, body, first = 0, previous = 0;
+	int wraps;
+
+	if (length < sizeof(EvtHeader))
+		return fail(result, _("the file is too short to contain a header"));
+	memcpy(&hdr, data, sizeof(hdr));
+
+	if (hdr.signature != EVT_SIGNATURE)
+		return fail(result, _("the header signature doesn't match"));
+	if (hdr.headerSize != sizeof(EvtHeader)
+		|| hdr.endHeaderSize != hdr.headerSize)
+		return fail(result, _("the header has an invalid size"));
+	if (hdr.majorVersion != 1 || hdr.minorVersion != 1)
+		return fail(result, _("unsupported version %u.%u"),
+			hdr.majorVersion, hdr.minorVersion);
+	if (length > hdr.maxSize)
+		return fail(result, _("the file is larger than the maximum size"));
+
+	headerSize = hdr.headerSize;
+	if (hdr.startOffset < headerSize || hdr.startOffset >= length
+		|| hdr.endOffset < headerSize
+		|| hdr.endOffset + sizeof(EvtEOF) > length)
+		return fail(result, _("the header points outside of the file"));
+
+	/* The header of a dirty log isn't up to date, except for the start. */
+	result->dirty = hdr.flags & EVT_HEADER_DIRTY;
+	wraps = hdr.flags & EVT_HEADER_WRAP;
+
+	offset = hdr.startOffset;
+	walked = 0;
+	while (1)
+	{
+		/* A fixed size part never gets split. When it doesn't fit
+		 * at the end of the file, it's written after the header. */
+		if (offset + sizeof(EvtEOF) <= length
+			&& evtLogIsEofRecord(data + offset))
+			break;
+		if (offset + sizeof(EvtRecord) > length)
+		{
+			if (!wraps)
+				return fail(result, _("the records reach the end of file, "
+					"but the log doesn't wrap"));
+			walked += length - offset;
+			offset = headerSize;
+			if (walked > length - headerSize)
+				return fail(result, _("there is no EOF record"));
+			continue;
+		}
+
+		memcpy(&rec, data + offset, sizeof(rec));
+		if (rec.reserved != EVT_SIGNATURE)
+			return fail(result, _("the record at offset %lu has an invalid "
+				"signature"), (unsigned long) offset);
+		if (rec.length < sizeof(EvtRecord) + sizeof(trailing)
+			|| rec.length % sizeof(trailing)
+			|| rec.length > length - headerSize)
+			return fail(result, _("record %u has an invalid length"),
+				rec.recordNumber);
+
+		/* The length is repeated at the end of the record, which may
+		 * be found after the header when the record wraps. */
+		trailer = offset + rec.length - sizeof(trailing);
+		if (trailer + sizeof(trailing) > length)
+		{
+			if (!wraps)
+				return fail(result, _("record %u reaches past the end of file, "
+					"but the log doesn't wrap"), rec.recordNumber);
+			trailer = trailer - length + headerSize;
+		}
+		memcpy(&trailing, data + trailer, sizeof(trailing));
+		if (trailing != rec.length)
+			return fail(result, _("the lengths at both ends of record %u "
+				"don't match"), rec.recordNumber);
+
+		if (result->records ? rec.recordNumber <= previous
+			: (!result->dirty && rec.recordNumber != hdr.oldestRecordNumber))
+			return fail(result, _("record %u is out of order"), rec.recordNumber);
+
+		body = rec.length - sizeof(trailing);
+		if (rec.userSidLength
+			&& !isWithin(rec.userSidOffset, rec.userSidLength, body))
+			return fail(result, _("the SID of record %u is out of bounds"),
+				rec.recordNumber);
+		if (rec.numStrings && !isWithin(rec.stringOffset, 0, body))
+			return fail(result, _("the strings of record %u are out of bounds"),
+				rec.recordNumber);
+		if (rec.dataLength
+			&& !isWithin(rec.dataOffset, rec.dataLength, body))
+			return fail(result, _("the data of record %u are out of bounds"),
+				rec.recordNumber);
+
+		walked += rec.length;
+		if (walked > length - headerSize)
+			return fail(result, _("there is no EOF record"));
+		offset += rec.length;
+		if (offset > length)
+			offset = offset - length + headerSize;
+
+		if (!result->records++)
+			first = rec.recordNumber;
+		previous = rec.recordNumber;
+	}
+
+	memcpy(&eof, data + offset, sizeof(eof));
+	if (eof.recordSizeBeginning != sizeof(EvtEOF)
+		|| eof.recordSizeEnd != sizeof(EvtEOF))
+		return fail(result, _("the EOF record has an invalid length"));
+	if (eof.beginRecord != hdr.startOffset || eof.endRecord != offset
+		|| (result->records && (eof.oldestRecordNumber != first
+		|| eof.currentRecordNumber != previous + 1)))
+		return fail(result, _("the EOF record doesn't match the records"));
+	if (!result->dirty && (hdr.endOffset != offset
+		|| hdr.currentRecordNumber != eof.currentRecordNumber))
+		return fail(result, _("the header doesn't match the records"));
+
+	return 0;
+}
@@ -0,0 +1,436 @@
+/**
+ *  @file evtd.c
+ *  @brief A daemon converting .evt files to CSV on request
+ *
+ *  Copyright Přemysl Janouch 2010. All rights reserved.
+ *  See the file LICENSE for licensing information.
+ *
+ *  Clients connect to a Unix domain socket and send jobs, one per line,
+ *  as evt2csv arguments separated by tabs. Each job is answered by a line
+ *  that begins either with "OK" and is followed by the number of records,
+ *  the number of bytes written and the time taken in milliseconds, or
+ *  with "ERROR" and a description of the problem. All fields are separated
+ *  by tabs.
+ *
+ *  Every worker thread accepts connections on its own and keeps its
+ *  buffers between jobs, so that they don't have to be set up again.
+ *
+ */
+
+/* fdopen, sigaction */
+#define _XOPEN_SOURCE 700
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include "configure.h"
+
+#include "xalloc.h"
+#include "datastruct.h"
+#include "evt.h"
+#include "mapfile.h"
+#include "evtlog.h"
+#include "acmatch.h"
+#include "fpset.h"
+#include "options.h"
+#include "record.h"
+#include "sink.h"
+#include "scan.h"
+#include "filter.h"
+#include "convert.h"
+#include "workers.h"
+#include "listener.h"
+
+
+/** The size of the stream buffer for output files. */
+#define EVTD_BUFFER_SIZE (1 << 20)
+/** The maximum number of arguments of a job. */
+#define EVTD_MAX_ARGS 32
+
+/** The state a worker keeps between jobs. */
+typedef struct
+{
+	/** The conversion, which keeps the decoded record buffers. */
+	Conversion conv;
+	/** The stream buffer for output files. */
+	char *outputBuffer;
+	/** The request being read. */
+	Buffer line;
+}
+Worker;
+
+/** An output file of a job. */
+typedef struct
+{
+	/** The path to the file. */
+	const char *path;
+	/** The open file. */
+	FILE *fp;
+	/** Create a sink writing into the file, or NULL for the main output. */
+	Sink *(*create) (FILE *output);
+}
+JobOutput;
+
+/** Output files of a job. */
+enum
+{
+	EVTD_OUTPUT_CSV,
+	EVTD_OUTPUT_BLOB,
+	EVTD_OUTPUT_SUMMARY,
+	EVTD_OUTPUT_JSON,
+	EVTD_OUTPUT_STATS,
+	EVTD_OUTPUT_COUNT
+};
+
+
+/** Print usage information. */
+static void printUsage (FILE *stream);
+
+/** Remove the socket and exit on a signal. */
+static void onTerminate (int sig);
+
+/** Serve connections until the process exits, to be run by workersRun(). */
+static void serveJob (void *listener, size_t index);
+
+/** Serve jobs sent over a connection. */
+static void serveConnection (Worker *worker, int fd);
+
+/** Run a job and write the reply.
+ *  @param[in,out] worker  The worker running the job.
+ *  @param[in] argc  The number of arguments.
+ *  @param[in] argv  The arguments, the first of which is ignored.
+ *  @param[out] reply  The stream to write the reply to.
+ */
+static void runJob (Worker *__restrict worker, int argc, char *argv[],
+	FILE *__restrict reply);
+
+
+/** Options of the daemon. */
+static const OptionSpec optionSpecs[] =
+{
+	{'j', "jobs", 1},
+	{'h', "help", 0},
+	{0, NULL, 0}
+};
+
+/** Options of a job, a subset of those of evt2csv. */
+static const OptionSpec jobSpecs[] =
+{
+	{'D', "dedupe", 0},
+	{'r', "reverse", 0},
+	{'l', "last", 1},
+	{'b', "blob", 1},
+	{'S', "summary", 1},
+	{'j', "json", 1},
+	{'T', "stats", 1},
+	{'m', "match", 1},
+	{'i', "ignore-case", 0},
+	{0, NULL, 0}
+};
+
+/** The path to the socket, to be removed on exit. */
+static const char *socketPath;
+
+
+int main (int argc, char *argv[])
+{
+	OptionsState opts = OPTIONS_INITIALIZER;
+	struct sigaction sa;
+	unsigned nThreads;
+	int opt, listener;
+	char *end;
+
+#ifdef HAVE_GETTEXT
+    /* All we want is localized messages. */
+    setlocale(LC_MESSAGES, "");
+
+    bindtextdomain(GETTEXT_DOMAIN, GETTEXT_DIRNAME);
+    textdomain(GETTEXT_DOMAIN);
+#endif
+
+	nThreads = workersDefaultCount();
+	while ((opt = optionsNext(&opts, argc, argv, optionSpecs)) != OPTIONS_END)
+	{
+		switch (opt)
+		{
+		case 'j':
+			nThreads = strtoul(opts.arg, &end, 10);
+			if (!*opts.arg || *end || !nThreads)
+			{
+				fprintf(stderr, _("Error: Invalid number of jobs: %s.\n"),
+					opts.arg);
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case 'h':
+			printUsage(stdout);
+			exit(EXIT_SUCCESS);
+		default:
+			printUsage(stderr);
+			exit(EXIT_FAILURE);
+		}
+	}
+	argc -= opts.index;
+	argv += opts.index;
+
+	if (argc != 1)
+	{
+		printUsage(stderr);
+		exit(EXIT_FAILURE);
+	}
+
+	if ((listener = listenerOpen(argv[0])) == -1)
+		exit(EXIT_FAILURE);
+	socketPath = argv[0];
+
+	/* Clients going away mustn't take the daemon with them. */
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = SIG_IGN;
+	sigaction(SIGPIPE, &sa, NULL);
+	sa.sa_handler = onTerminate;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+
+	/* The workers never finish. */
+	workersRun(serveJob, &listener, nThreads, nThreads);
+	return 0;
+}
+
+static void printUsage (FILE *stream)
+{
+	fputs(_("Usage: evtd [-j jobs] socket\n"
+		"Jobs: [option]...<TAB>input-file<TAB>output-file\n"
+		"Options: [-D] [-r] [-l count] [-b blob-file] [-m patterns-file [-i]]\n"
+		"         [-S summary-file] [-j json-file] [-T stats-file]\n"), stream);
+}
+
+static void onTerminate (int sig)
+{
+	(void) sig;
+
+	unlink(socketPath);
+	_exit(EXIT_SUCCESS);
+}
+
+static void serveJob (void *listener, size_t index)
+{
+	Worker worker;
+	int fd;
+
+	(void) index;
+
+	conversionInit(&worker.conv);
+	worker.outputBuffer = xmalloc(EVTD_BUFFER_SIZE);
+	bufferInit(&worker.line);
+
+	while (1)
+	{
+		if ((fd = listenerAccept(*(int *) listener)) != -1)
+			serveConnection(&worker, fd);
+	}
+}
+
+static void serveConnection (Worker *worker, int fd)
+{
+	FILE *in, *out;
+	char *args[EVTD_MAX_ARGS], *p;
+	int argc, status;
+
+	if (!(in = fdopen(fd, "rb")))
+	{
+		close(fd);
+		return;
+	}
+	if ((fd = dup(fd)) == -1 || !(out = fdopen(fd, "wb")))
+	{
+		if (fd != -1)
+			close(fd);
+		fclose(in);
+		return;
+	}
+
+	while (!(status = listenerReadLine(in, &worker->line)))
+	{
+		/* The first argument is skipped by the option parser. */
+		args[0] = "evtd";
+		for (argc = 1, p = worker->line.data; p; argc++)
+		{
+			if (argc == EVTD_MAX_ARGS)
+				break;
+			args[argc] = p;
+			if ((p = strchr(p, '\t')))
+				*p++ = '\0';
+		}
+
+		if (argc == EVTD_MAX_ARGS)
+			fputs("ERROR\tToo many arguments\n", out);
+		else
+			runJob(worker, argc, args, out);
+		if (fflush(out))
+			break;
+	}
+
+	/* There's no telling where the next line would begin. */
+	if (status == 1)
+		fputs("ERROR\tLine too long\n", out);
+
+	fclose(out);
+	fclose(in);
+}
+
+static void runJob (Worker *__restrict worker, int argc, char *argv[],
+	FILE *__restrict reply)
+{
+	OptionsState opts = OPTIONS_INITIALIZER;
+	Conversion *conv = &worker->conv;
+	JobOutput outputs[EVTD_OUTPUT_COUNT] =
+	{
+		{NULL, NULL, NULL},
+		{NULL, NULL, NULL},
+		{NULL, NULL, sinkCreateSummary},
+		{NULL, NULL, sinkCreateJson},
+		{NULL, NULL, sinkCreateStats}
+	};
+	Sink *sinks[EVTD_OUTPUT_COUNT];
+	size_t nSinks = 0;
+	const char *patternsPath = NULL, *error = NULL;
+	struct timeval start, end;
+	EvtLog log;
+	long bytes = 0;
+	int opt, foldCase = 0, dedupe = 0, i;
+	char *p;
+
+	gettimeofday(&start, NULL);
+
+	/* Only the settings are reset, the buffers stay. */
+	conv->sink = NULL;
+	conv->matcher = NULL;
+	conv->seen = NULL;
+	conv->reverse = 0;
+	conv->last = 0;
+	conv->records = 0;
+
+	while ((opt = optionsNext(&opts, argc, argv, jobSpecs)) != OPTIONS_END)
+	{
+		switch (opt)
+		{
+		case 'D':
+			dedupe = 1;
+			break;
+		case 'r':
+			conv->reverse = 1;
+			break;
+		case 'l':
+			conv->last = strtoul(opts.arg, &p, 10);
+			if (!*opts.arg || *p || !conv->last)
+				error = "Invalid record count";
+			break;
+		case 'b':
+			outputs[EVTD_OUTPUT_BLOB].path = opts.arg;
+			break;
+		case 'S':
+			outputs[EVTD_OUTPUT_SUMMARY].path = opts.arg;
+			break;
+		case 'j':
+			outputs[EVTD_OUTPUT_JSON].path = opts.arg;
+			break;
+		case 'T':
+			outputs[EVTD_OUTPUT_STATS].path = opts.arg;
+			break;
+		case 'm':
+			patternsPath = opts.arg;
+			break;
+		case 'i':
+			foldCase = 1;
+			break;
+		default:
+			error = "Invalid options";
+		}
+		if (error)
+			goto runJob_reply;
+	}
+	if (argc - opts.index != 2)
+	{
+		error = "An input and an output file are required";
+		goto runJob_reply;
+	}
+	outputs[EVTD_OUTPUT_CSV].path = argv[opts.index + 1];
+
+	/* The summary has to describe the whole log, as with evt2csv. */
+	if (outputs[EVTD_OUTPUT_SUMMARY].path
+		&& (dedupe || conv->last || patternsPath))
+	{
+		error = "A summary can't be combined with filters";
+		goto runJob_reply;
+	}
+
+	if (patternsPath
+		&& !(conv->matcher = conversionLoadPatterns(patternsPath, foldCase)))
+	{
+		error = "Failed to load the patterns";
+		goto runJob_reply;
+	}
+	if (dedupe)
+		conv->seen = fpSetCreate(CONVERSION_DEDUPE_MEMORY);
+
+	/* Don't touch the outputs of a job that can't be done. */
+	if (evtLogOpen(&log, argv[opts.index]))
+	{
+		error = "Failed to open the log";
+		goto runJob_reply;
+	}
+
+	for (i = 0; i < EVTD_OUTPUT_COUNT; i++)
+	{
+		if (!outputs[i].path)
+			continue;
+		if (!(outputs[i].fp = fopen(outputs[i].path, "wb")))
+		{
+			error = "Failed to open an output file";
+			for (; nSinks; nSinks--)
+				sinks[nSinks - 1]->close(sinks[nSinks - 1]);
+			goto runJob_close;
+		}
+		if (outputs[i].create)
+			sinks[nSinks++] = outputs[i].create(outputs[i].fp);
+	}
+	setvbuf(outputs[EVTD_OUTPUT_CSV].fp, worker->outputBuffer,
+		_IOFBF, EVTD_BUFFER_SIZE);
+
+	/* The CSV goes first, as with evt2csv. */
+	memmove(sinks + 1, sinks, nSinks * sizeof(Sink *));
+	sinks[0] = sinkCreateCsv(outputs[EVTD_OUTPUT_CSV].fp,
+		outputs[EVTD_OUTPUT_BLOB].fp);
+	conv->sink = ++nSinks > 1 ? sinkCreateTee(sinks, nSinks) : sinks[0];
+
+	if (conversionRun(conv, &log))
+		error = "Failed to convert the log";
+	if (conv->sink->close(conv->sink) && !error)
+		error = "Failed to write the output";
+	bytes = ftell(outputs[EVTD_OUTPUT_CSV].fp);
+
+runJob_close:
+	evtLogClose(&log);
+	for (i = 0; i < EVTD_OUTPUT_COUNT; i++)
+		if (outputs[i].fp && fclose(outputs[i].fp) && !error)
+			error = "Failed to write the output";
+
+runJob_reply:
+	/* Keep the decoded record buffers for the next job. */
+	if (conv->matcher)
+		acDestroyMatcher(conv->matcher);
+	if (conv->seen)
+		fpSetDestroy(conv->seen);
+
+	gettimeofday(&end, NULL);
+	if (error)
+		fprintf(reply, "ERROR\t%s\n", error);
+	else
+		fprintf(reply, "OK\t%llu\t%ld\t%ld\n", conv->records, bytes,
+			(end.tv_sec - start.tv_sec) * 1000L
+			+ (end.tv_usec - start.tv_usec) / 1000L);
+}
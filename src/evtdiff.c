@@ -0,0 +1,205 @@
+/**
+ *  @file evtdiff.c
+ *  @brief Differences between two copies of an event log
+ *
+ *  Copyright Přemysl Janouch 2010. All rights reserved.
+ *  See the file LICENSE for licensing information.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "configure.h"
+
+#include "xalloc.h"
+#include "datastruct.h"
+#include "evt.h"
+#include "mapfile.h"
+#include "evtlog.h"
+#include "options.h"
+#include "record.h"
+#include "sink.h"
+
+
+/** Print usage information. */
+static void printUsage (FILE *stream);
+
+/** Find records of the new copy that are missing in the old one.
+ *  @return The number of records common to both copies, or -1 if the copies
+ *  	don't share their history.
+ */
+static long findCommon (EvtLog *__restrict older, EvtLog *__restrict newer);
+
+/** Write out the remaining records of a log. */
+static int writeRecords (EvtLog *__restrict log, Sink *__restrict sink,
+	unsigned long *__restrict count);
+
+
+/** Command line options. */
+static const OptionSpec optionSpecs[] =
+{
+	{'h', "help", 0},
+	{0, NULL, 0}
+};
+
+
+int main (int argc, char *argv[])
+{
+	OptionsState opts = OPTIONS_INITIALIZER;
+	EvtLog older, newer;
+	FILE *output;
+	Sink *sink;
+	long common;
+	unsigned long added = 0;
+	uint32_t oldOldest, oldCurrent, newOldest;
+	int opt, ret = 0;
+
+#ifdef HAVE_GETTEXT
+    /* All we want is localized messages. */
+    setlocale(LC_MESSAGES, "");
+
+    bindtextdomain(GETTEXT_DOMAIN, GETTEXT_DIRNAME);
+    textdomain(GETTEXT_DOMAIN);
+#endif
+
+	while ((opt = optionsNext(&opts, argc, argv, optionSpecs)) != OPTIONS_END)
+	{
+		switch (opt)
+		{
+		case 'h':
+			printUsage(stdout);
+			exit(EXIT_SUCCESS);
+		default:
+			printUsage(stderr);
+			exit(EXIT_FAILURE);
+		}
+	}
+	argc -= opts.index;
+	argv += opts.index;
+
+	if (argc < 2 || argc > 3)
+	{
+		printUsage(stderr);
+		exit(EXIT_FAILURE);
+	}
+
+	if (evtLogOpen(&older, argv[0]) || evtLogOpen(&newer, argv[1]))
+		exit(EXIT_FAILURE);
+
+	output = stdout;
+	if (argc == 3 && *argv[2] && strcmp(argv[2], "-")
+		&& !(output = fopen(argv[2], "wb")))
+	{
+		fprintf(stderr, _("Error: Failed to open %s for writing.\n"),
+			argv[2]);
+		exit(EXIT_FAILURE);
+	}
+
+	/* Records that the new copy has lost to wrapping. */
+	oldOldest = older.hdr->oldestRecordNumber;
+	oldCurrent = older.hdr->currentRecordNumber;
+	newOldest = newer.hdr->oldestRecordNumber;
+	if (oldOldest && oldOldest < oldCurrent && oldOldest < newOldest)
+		fprintf(stderr, _("Records %u to %u have been overwritten.\n"),
+			oldOldest, (newOldest < oldCurrent ? newOldest : oldCurrent) - 1);
+
+	if ((common = findCommon(&older, &newer)) == -1)
+	{
+		fputs(_("Warning: The logs don't share their history, "
+			"writing out all records.\n"), stderr);
+		evtLogRewind(&newer);
+	}
+
+	sink = sinkCreateCsv(output, NULL);
+	if (sink->begin(sink, newer.hdr, newer.file.length)
+		|| writeRecords(&newer, sink, &added))
+		ret = -1;
+	if (sink->close(sink))
+		ret = -1;
+
+	if (!ret)
+		fprintf(stderr, _("%lu records in common, %lu new records.\n"),
+			common == -1 ? 0 : (unsigned long) common, added);
+
+	evtLogClose(&older);
+	evtLogClose(&newer);
+	if (fclose(output))
+		ret = -1;
+	return ret ? EXIT_FAILURE : 0;
+}
+
+static void printUsage (FILE *stream)
+{
+	fputs(_("Usage: evtdiff old.evt new.evt [output-file]\n"), stream);
+}
+
+static long findCommon (EvtLog *__restrict older, EvtLog *__restrict newer)
+{
+	EvtLogRecord oldRecord, newRecord;
+	EvtLogStatus oldStatus;
+	uint32_t oldCurrent = older->hdr->currentRecordNumber;
+	size_t lastCommon;
+	long common = 0;
+
+	/* Nothing can be in common when the ranges of record numbers given
+	 * by the headers don't overlap. */
+	if (!newer->hdr->oldestRecordNumber
+		|| newer->hdr->oldestRecordNumber >= oldCurrent)
+		return 0;
+
+	/* Skip records of the old copy that are older than the new one. */
+	do
+		oldStatus = evtLogNext(older, &oldRecord);
+	while (oldStatus == EVT_LOG_RECORD && oldRecord.rec->recordNumber
+		< newer->hdr->oldestRecordNumber);
+
+	/* Compare the rest of the old copy with the beginning of the new one,
+	 * which should be the same, record after record. */
+	lastCommon = newer->offset;
+	for (; oldStatus == EVT_LOG_RECORD;
+		oldStatus = evtLogNext(older, &oldRecord))
+	{
+		if (evtLogNext(newer, &newRecord) != EVT_LOG_RECORD
+			|| newRecord.rec->recordNumber != oldRecord.rec->recordNumber
+			|| newRecord.rec->length != oldRecord.rec->length
+			|| evtLogHashRecord(&newRecord) != evtLogHashRecord(&oldRecord))
+			return -1;
+
+		lastCommon = newer->offset;
+		common++;
+	}
+	if (oldStatus != EVT_LOG_END)
+		return -1;
+
+	/* Continue right after the last record in common. */
+	evtLogSeek(newer, lastCommon);
+	return common;
+}
+
+static int writeRecords (EvtLog *__restrict log, Sink *__restrict sink,
+	unsigned long *__restrict count)
+{
+	EvtLogRecord record;
+	EvtLogStatus status;
+	RecordFields fields;
+	int ret = 0;
+
+	recordFieldsInit(&fields);
+	while ((status = evtLogNext(log, &record)) == EVT_LOG_RECORD)
+	{
+		recordDecode(&fields, record.rec,
+			record.nonFixed, record.nonFixedLength);
+		if (sink->write(sink, &fields))
+		{
+			ret = -1;
+			break;
+		}
+		(*count)++;
+	}
+	if (!ret && status != EVT_LOG_END)
+		ret = -1;
+	recordFieldsDestroy(&fields);
+	return ret;
+}
@@ -0,0 +1,348 @@
+/**
+ *  @file evtindex.c
+ *  @brief Full-text indexing and searching of event logs
+ *
+ *  Copyright Přemysl Janouch 2010. All rights reserved.
+ *  See the file LICENSE for licensing information.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "configure.h"
+
+#include "xalloc.h"
+#include "datastruct.h"
+#include "evt.h"
+#include "mapfile.h"
+#include "evtlog.h"
+#include "token.h"
+#include "options.h"
+#include "invindex.h"
+#include "record.h"
+#include "sink.h"
+
+
+/** A posting with the position of its record in the log. */
+typedef struct
+{
+	/** The offset of the record. */
+	uint32_t offset;
+	/** How far the record is from the oldest one, in bytes. */
+	uint32_t age;
+}
+Hit;
+
+
+/** Print usage information. */
+static void printUsage (FILE *stream);
+
+/** Build an index of files. */
+static int buildIndex (const char *__restrict path,
+	int nFiles, char *files[]);
+/** Print records containing all tokens of the query as CSV. */
+static int queryIndex (const char *__restrict path,
+	int nWords, char *words[]);
+/** Intersect a sorted array of postings with another one. */
+static size_t intersectPostings (IndexPosting *__restrict a, size_t nA,
+	const IndexPosting *__restrict b, size_t nB);
+/** Print records from a file. */
+static int printHits (const char *__restrict path,
+	Hit *__restrict hits, size_t nHits, Sink *__restrict sink);
+
+/** Compare two postings for qsort(). */
+static int comparePostings (const void *a, const void *b);
+/** Compare two hits for qsort(). */
+static int compareHits (const void *a, const void *b);
+
+
+/** Command line options. */
+static const OptionSpec optionSpecs[] =
+{
+	{'c', "create", 0},
+	{'h', "help", 0},
+	{0, NULL, 0}
+};
+
+
+int main (int argc, char *argv[])
+{
+	OptionsState opts = OPTIONS_INITIALIZER;
+	int opt, create = 0, ret;
+
+#ifdef HAVE_GETTEXT
+    /* All we want is localized messages. */
+    setlocale(LC_MESSAGES, "");
+
+    bindtextdomain(GETTEXT_DOMAIN, GETTEXT_DIRNAME);
+    textdomain(GETTEXT_DOMAIN);
+#endif
+
+	while ((opt = optionsNext(&opts, argc, argv, optionSpecs)) != OPTIONS_END)
+	{
+		switch (opt)
+		{
+		case 'c':
+			create = 1;
+			break;
+		case 'h':
+			printUsage(stdout);
+			exit(EXIT_SUCCESS);
+		default:
+			printUsage(stderr);
+			exit(EXIT_FAILURE);
+		}
+	}
+	argc -= opts.index;
+	argv += opts.index;
+
+	if (argc < 2)
+	{
+		printUsage(stderr);
+		exit(EXIT_FAILURE);
+	}
+
+	if (create)
+		ret = buildIndex(argv[0], argc - 1, argv + 1);
+	else
+		ret = queryIndex(argv[0], argc - 1, argv + 1);
+	return ret ? EXIT_FAILURE : 0;
+}
+
+static void printUsage (FILE *stream)
+{
+	fputs(_("Usage: evtindex -c index file.evt...\n"
+		"       evtindex index word...\n"), stream);
+}
+
+static int buildIndex (const char *__restrict path,
+	int nFiles, char *files[])
+{
+	IndexBuilder builder;
+	RecordFields fields;
+	Buffer token;
+	EvtLog log;
+	EvtLogRecord record;
+	EvtLogStatus status;
+	const char *cursor;
+	FILE *output;
+	int i, ret = 0;
+
+	builder = indexCreateBuilder();
+	recordFieldsInit(&fields);
+	bufferInit(&token);
+
+	for (i = 0; i < nFiles; i++)
+	{
+		if (evtLogOpen(&log, files[i]))
+		{
+			ret = -1;
+			continue;
+		}
+
+		/* Postings have to be ordered by file, and just once at that. */
+		if (indexAddFile(builder, files[i]))
+		{
+			fprintf(stderr, _("Warning: Skipping %s, "
+				"it has already been indexed.\n"), files[i]);
+			evtLogClose(&log);
+			continue;
+		}
+		while ((status = evtLogNext(&log, &record)) == EVT_LOG_RECORD)
+		{
+			recordDecode(&fields, record.rec,
+				record.nonFixed, record.nonFixedLength);
+			for (cursor = fields.strings; tokenNext(&cursor, &token); )
+				indexAddToken(builder, token.data, record.offset);
+		}
+		if (status != EVT_LOG_END)
+		{
+			fprintf(stderr, _("Error: Failed to read %s.\n"), files[i]);
+			ret = -1;
+		}
+		evtLogClose(&log);
+	}
+
+	recordFieldsDestroy(&fields);
+	bufferDestroy(&token);
+
+	if (!(output = fopen(path, "wb")))
+	{
+		fprintf(stderr, _("Error: Failed to open %s for writing.\n"), path);
+		ret = -1;
+	}
+	else if (indexWrite(builder, output) | fclose(output))
+	{
+		fprintf(stderr, _("Error: Failed to write to %s.\n"), path);
+		ret = -1;
+	}
+
+	indexDestroyBuilder(builder);
+	return ret;
+}
+
+static int comparePostings (const void *a, const void *b)
+{
+	const IndexPosting *pa = a, *pb = b;
+
+	if (pa->file != pb->file)
+		return pa->file < pb->file ? -1 : 1;
+	if (pa->offset != pb->offset)
+		return pa->offset < pb->offset ? -1 : 1;
+	return 0;
+}
+
+static size_t intersectPostings (IndexPosting *__restrict a, size_t nA,
+	const IndexPosting *__restrict b, size_t nB)
+{
+	size_t i = 0, k = 0, n = 0;
+	int cmp;
+
+	while (i < nA && k < nB)
+	{
+		if (!(cmp = comparePostings(&a[i], &b[k])))
+		{
+			a[n++] = a[i++];
+			k++;
+		}
+		else if (cmp < 0)
+			i++;
+		else
+			k++;
+	}
+	return n;
+}
+
+static int queryIndex (const char *__restrict path,
+	int nWords, char *words[])
+{
+	Index index;
+	Buffer token;
+	IndexPosting *result = NULL, *postings;
+	Hit *hits;
+	const IndexToken *entry;
+	const char *cursor;
+	size_t nResult = 0, i, k;
+	int word, first = 1, ret = 0;
+	Sink *sink;
+
+	if (indexOpen(&index, path))
+		return -1;
+
+	/* Intersect postings of all tokens in the query. */
+	bufferInit(&token);
+	for (word = 0; word < nWords && (first || nResult); word++)
+	{
+		for (cursor = words[word]; tokenNext(&cursor, &token); )
+		{
+			if (!(entry = indexFind(&index, token.data)))
+			{
+				nResult = 0;
+				first = 0;
+				break;
+			}
+
+			postings = xmalloc((entry->count + 1) * sizeof(IndexPosting));
+			if (indexDecode(&index, entry, postings))
+			{
+				fprintf(stderr, _("Error: %s is corrupted.\n"), path);
+				free(postings);
+				ret = -1;
+				nResult = 0;
+				first = 0;
+				break;
+			}
+			qsort(postings, entry->count, sizeof(IndexPosting),
+				comparePostings);
+
+			if (first)
+			{
+				result = postings;
+				nResult = entry->count;
+				first = 0;
+				continue;
+			}
+			nResult = intersectPostings(result, nResult,
+				postings, entry->count);
+			free(postings);
+			if (!nResult)
+				break;
+		}
+	}
+	bufferDestroy(&token);
+
+	/* Fetch the records, one file after another. */
+	sink = sinkCreateCsv(stdout, NULL);
+	hits = xmalloc((nResult + 1) * sizeof(Hit));
+	for (i = 0; i < nResult; i = k)
+	{
+		for (k = i; k < nResult && result[k].file == result[i].file; k++)
+			hits[k - i].offset = result[k].offset;
+		if (printHits(indexFilePath(&index, result[i].file),
+			hits, k - i, sink))
+			ret = -1;
+	}
+	if (sink->close(sink))
+		ret = -1;
+
+	free(hits);
+	free(result);
+	indexClose(&index);
+	return ret;
+}
+
+static int compareHits (const void *a, const void *b)
+{
+	const Hit *ha = a, *hb = b;
+
+	if (ha->age != hb->age)
+		return ha->age < hb->age ? -1 : 1;
+	return 0;
+}
+
+static int printHits (const char *__restrict path,
+	Hit *__restrict hits, size_t nHits, Sink *__restrict sink)
+{
+	EvtLog log;
+	EvtLogRecord record;
+	RecordFields fields;
+	size_t i;
+	int ret = 0;
+
+	if (evtLogOpen(&log, path))
+		return -1;
+
+	/* Records in a wrapped log start in the middle of the file. */
+	for (i = 0; i < nHits; i++)
+		hits[i].age = hits[i].offset >= log.hdr->startOffset
+			? hits[i].offset - log.hdr->startOffset
+			: hits[i].offset + (log.file.length - log.hdr->startOffset);
+	qsort(hits, nHits, sizeof(Hit), compareHits);
+
+	recordFieldsInit(&fields);
+	if (sink->begin(sink, log.hdr, log.file.length))
+		ret = -1;
+	for (i = 0; i < nHits && !ret; i++)
+	{
+		evtLogSeek(&log, hits[i].offset);
+		if (evtLogNext(&log, &record) != EVT_LOG_RECORD
+			|| record.rec->reserved != EVT_SIGNATURE)
+		{
+			fprintf(stderr, _("Error: The index is out of date for %s.\n"),
+				path);
+			ret = -1;
+			break;
+		}
+
+		recordDecode(&fields, record.rec,
+			record.nonFixed, record.nonFixedLength);
+		if (sink->write(sink, &fields))
+			ret = -1;
+	}
+
+	recordFieldsDestroy(&fields);
+	evtLogClose(&log);
+	return ret;
+}
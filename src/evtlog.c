@@ -0,0 +1,328 @@
+/**
+ *  @file evtlog.c
+ *  @brief Reading records from .evt files.
+ *
+ *  Copyright Přemysl Janouch 2010. All rights reserved.
+ *  See the file LICENSE for licensing information.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "configure.h"
+
+#include "xalloc.h"
+#include "datastruct.h"
+#include "evt.h"
+#include "hash.h"
+#include "mapfile.h"
+#include "evtlog.h"
+
+
+/** Check the header of a log whose file has been filled in.
+ *  @return 0 on success, -1 on failure. An error message is printed.
+ */
+static int checkHeader (EvtLog *log);
+/** Read a record whose fixed size part is at the given offset.
+ *  @param[out] end  The offset following the record.
+ */
+static EvtLogStatus readRecord (EvtLog *__restrict log, size_t offset,
+	EvtLogRecord *__restrict record, size_t *__restrict end);
+
+
+int evtLogOpen (EvtLog *__restrict log, const char *__restrict path)
+{
+	if (mapFileOpen(&log->file, path))
+	{
+		fprintf(stderr, _("Error: Failed to open %s for reading.\n"), path);
+		return -1;
+	}
+
+	log->borrowed = 0;
+	if (checkHeader(log))
+	{
+		mapFileClose(&log->file);
+		return -1;
+	}
+	return 0;
+}
+
+int evtLogOpenMemory (EvtLog *__restrict log,
+	const void *__restrict data, size_t length)
+{
+	log->file.data = data;
+	log->file.length = length;
+	log->file.mapped = 0;
+	log->borrowed = 1;
+	return checkHeader(log);
+}
+
+static int checkHeader (EvtLog *log)
+{
+	/* FIXME: Shuffle the bits on big endian machines. */
+
+	if (log->file.length < sizeof(EvtHeader))
+	{
+		fputs(_("Error: Failed to read ELF header.\n"), stderr);
+		return -1;
+	}
+	log->hdr = log->file.data;
+	if (log->hdr->signature != EVT_SIGNATURE)
+	{
+		fputs(_("Error: ELF signature doesn't match.\n"), stderr);
+		return -1;
+	}
+	if (log->hdr->headerSize < sizeof(EvtHeader)
+		|| log->hdr->headerSize > log->file.length
+		|| log->hdr->startOffset < log->hdr->headerSize
+		|| log->hdr->startOffset > log->file.length)
+	{
+		fputs(_("Error: The header is corrupted.\n"), stderr);
+		return -1;
+	}
+	if (log->hdr->flags & EVT_HEADER_DIRTY)
+		fputs(_("Warning: The log file is marked dirty.\n"), stderr);
+
+	log->wraps = log->hdr->flags & EVT_HEADER_WRAP;
+	bufferInit(&log->scratch);
+	evtLogRewind(log);
+	return 0;
+}
+
+int evtLogIsEofRecord (const void *p)
+{
+	EvtEOF eof;
+
+	memcpy(&eof, p, sizeof(eof));
+	return eof.recordSizeBeginning == sizeof(EvtEOF)
+		&& eof.recordSizeEnd == sizeof(EvtEOF)
+		&& eof.one == 0x11111111 && eof.two == 0x22222222
+		&& eof.three == 0x33333333 && eof.four == 0x44444444;
+}
+
+static EvtLogStatus readRecord (EvtLog *__restrict log, size_t offset,
+	EvtLogRecord *__restrict record, size_t *__restrict end)
+{
+	const char *data = log->file.data;
+	size_t fileSize = log->file.length, head;
+	uint32_t nonFixedLength;
+
+	record->offset = offset;
+	record->rec = (const EvtRecord *) (data + offset);
+
+	nonFixedLength = record->rec->length - sizeof(EvtRecord);
+	if (record->rec->length < sizeof(EvtRecord)
+		|| nonFixedLength > fileSize)
+	{
+		fprintf(stderr, _("Error: Record %u is longer than "
+			"the whole file.\n"), record->rec->recordNumber);
+		return EVT_LOG_ERROR;
+	}
+	record->nonFixedLength = nonFixedLength;
+
+	offset += sizeof(EvtRecord);
+	head = fileSize - offset;
+	if (nonFixedLength <= head)
+	{
+		record->nonFixed = data + offset;
+		*end = offset + nonFixedLength;
+	}
+	else if (!log->wraps || log->hdr->headerSize
+		+ (nonFixedLength - head) > fileSize)
+	{
+		fputs(_("Error: Unexpected end of file.\n"), stderr);
+		return EVT_LOG_ERROR;
+	}
+	else
+	{
+		/* Wrap around the end of file and put the parts together. */
+		bufferClear(&log->scratch);
+		bufferAppend(&log->scratch, data + offset, head, 0);
+		bufferAppend(&log->scratch, data + log->hdr->headerSize,
+			nonFixedLength - head, 0);
+
+		record->nonFixed = log->scratch.data;
+		*end = log->hdr->headerSize + (nonFixedLength - head);
+	}
+	return EVT_LOG_RECORD;
+}
+
+EvtLogStatus evtLogNext (EvtLog *__restrict log,
+	EvtLogRecord *__restrict record)
+{
+	const char *data = log->file.data;
+	size_t fileSize = log->file.length;
+
+	if (log->offset > fileSize)
+	{
+		fputs(_("Error: Unexpected end of file.\n"), stderr);
+		return EVT_LOG_ERROR;
+	}
+
+	while (1)
+	{
+		/* A fixed size part never gets split. When it doesn't fit
+		 * at the end of the file, it's written after the header. */
+		if (log->offset + sizeof(EvtEOF) <= fileSize
+			&& evtLogIsEofRecord(data + log->offset))
+			return EVT_LOG_END;
+		if (log->offset + sizeof(EvtRecord) <= fileSize)
+			break;
+
+		if (!log->wraps)
+		{
+			fputs(_("Error: Unexpected end of file.\n"), stderr);
+			return EVT_LOG_ERROR;
+		}
+
+		/* Wrap around the end of file. */
+		log->walked += fileSize - log->offset;
+		log->offset = log->hdr->headerSize;
+		if (log->walked > fileSize)
+		{
+			fputs(_("Error: The log has no end.\n"), stderr);
+			return EVT_LOG_ERROR;
+		}
+	}
+
+	if (readRecord(log, log->offset, record, &log->offset)
+		== EVT_LOG_ERROR)
+		return EVT_LOG_ERROR;
+
+	log->walked += record->rec->length;
+	if (log->walked > fileSize)
+	{
+		fputs(_("Error: The log has no end.\n"), stderr);
+		return EVT_LOG_ERROR;
+	}
+	return EVT_LOG_RECORD;
+}
+
+int evtLogSeekEnd (EvtLog *log)
+{
+	EvtLogRecord record;
+	EvtLogStatus status;
+	size_t endOffset = log->hdr->endOffset;
+
+	if (endOffset >= log->hdr->headerSize
+		&& endOffset + sizeof(EvtEOF) <= log->file.length
+		&& evtLogIsEofRecord((const char *) log->file.data + endOffset))
+	{
+		evtLogSeek(log, endOffset);
+		return 0;
+	}
+
+	/* The header is out of date, probably because the log is dirty.
+	 * Go through all the records to find the real end. */
+	fputs(_("Warning: The header doesn't point to the EOF record.\n"),
+		stderr);
+	evtLogRewind(log);
+	while ((status = evtLogNext(log, &record)) == EVT_LOG_RECORD)
+		;
+	if (status == EVT_LOG_ERROR)
+		return -1;
+
+	evtLogSeek(log, log->offset);
+	return 0;
+}
+
+EvtLogStatus evtLogPrev (EvtLog *__restrict log,
+	EvtLogRecord *__restrict record)
+{
+	const char *data = log->file.data;
+	size_t fileSize = log->file.length, headerSize = log->hdr->headerSize;
+	size_t start, end = log->offset, unused;
+	uint32_t length;
+
+	if (end == log->hdr->startOffset)
+		return EVT_LOG_END;
+	if (end < headerSize || end > fileSize)
+	{
+		fputs(_("Error: Unexpected end of file.\n"), stderr);
+		return EVT_LOG_ERROR;
+	}
+
+	if (end == headerSize)
+	{
+		if (!log->wraps)
+		{
+			fputs(_("Error: The log has no beginning.\n"), stderr);
+			return EVT_LOG_ERROR;
+		}
+
+		/* Wrap around the end of file, skipping the space that has been
+		 * left unused because a fixed size part wouldn't fit in there.
+		 * It's filled with 0x00000027, which can't be a record length. */
+		end = fileSize;
+		while (end - headerSize >= sizeof(length))
+		{
+			memcpy(&length, data + end - sizeof(length), sizeof(length));
+			if (length != 0x27)
+				break;
+			end -= sizeof(length);
+		}
+
+		log->walked += fileSize - end;
+		if (end == log->hdr->startOffset)
+			return EVT_LOG_END;
+	}
+
+	/* The length is stored at both ends of a record. */
+	if (end - headerSize < sizeof(length))
+	{
+		fputs(_("Error: Unexpected end of file.\n"), stderr);
+		return EVT_LOG_ERROR;
+	}
+	memcpy(&length, data + end - sizeof(length), sizeof(length));
+	if (length < sizeof(EvtRecord) || length > fileSize - headerSize)
+	{
+		fprintf(stderr, _("Error: Invalid record length "
+			"before offset %lu.\n"), (unsigned long) end);
+		return EVT_LOG_ERROR;
+	}
+
+	if (end - headerSize >= length)
+		start = end - length;
+	else if (!log->wraps)
+	{
+		fputs(_("Error: The log has no beginning.\n"), stderr);
+		return EVT_LOG_ERROR;
+	}
+	else
+		start = fileSize - (length - (end - headerSize));
+
+	if (start < headerSize || start + sizeof(EvtRecord) > fileSize
+		|| ((const EvtRecord *) (data + start))->length != length)
+	{
+		fprintf(stderr, _("Error: Record lengths don't match "
+			"before offset %lu.\n"), (unsigned long) end);
+		return EVT_LOG_ERROR;
+	}
+
+	if (readRecord(log, start, record, &unused) == EVT_LOG_ERROR)
+		return EVT_LOG_ERROR;
+	log->offset = start;
+
+	log->walked += length;
+	if (log->walked > fileSize)
+	{
+		fputs(_("Error: The log has no beginning.\n"), stderr);
+		return EVT_LOG_ERROR;
+	}
+	return EVT_LOG_RECORD;
+}
+
+uint64_t evtLogHashRecord (const EvtLogRecord *record)
+{
+	return hash64(record->nonFixed, record->nonFixedLength,
+		hash64(record->rec, sizeof(EvtRecord), 0));
+}
+
+void evtLogClose (EvtLog *log)
+{
+	bufferDestroy(&log->scratch);
+	if (!log->borrowed)
+		mapFileClose(&log->file);
+}
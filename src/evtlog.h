@@ -0,0 +1,147 @@
+/**
+ *  @file evtlog.h
+ *  @brief Reading records from .evt files.
+ *
+ *  Copyright Přemysl Janouch 2010. All rights reserved.
+ *  See the file LICENSE for licensing information.
+ *
+ *  The file is mapped into memory and records are handed out right from
+ *  the mapping. Only records that wrap around the end of the file are
+ *  copied, so that they can be presented as a contiguous block.
+ *
+ */
+
+#ifndef EVTLOG_H_INCLUDED
+#define EVTLOG_H_INCLUDED
+
+/** An .evt file opened for reading. */
+typedef struct
+{
+	/** The mapped file. */
+	MappedFile file;
+	/** Whether the contents of @a file belong to someone else. */
+	int borrowed;
+	/** The header of the log, in the mapping. */
+	const EvtHeader *hdr;
+	/** Whether the records wrap around the end of the file. */
+	int wraps;
+	/** The offset of the next record, or the one following
+	 *  the previous record when reading backwards. */
+	size_t offset;
+	/** How many bytes have been gone through, to detect cycles. */
+	size_t walked;
+	/** Storage for records wrapping around the end of the file. */
+	Buffer scratch;
+}
+EvtLog;
+
+/** A record read from an .evt file. */
+typedef struct
+{
+	/** The offset of the record in the file. */
+	size_t offset;
+	/** The fixed part of the record. */
+	const EvtRecord *rec;
+	/** The rest of the record, following the fixed part. */
+	const void *nonFixed;
+	/** The length of @a nonFixed in bytes. */
+	size_t nonFixedLength;
+}
+EvtLogRecord;
+
+/** What has been read. */
+typedef enum
+{
+	/** A record. */
+	EVT_LOG_RECORD,
+	/** The EOF record, there are no more records. */
+	EVT_LOG_END,
+	/** An error has occured. An error message has been printed. */
+	EVT_LOG_ERROR
+}
+EvtLogStatus;
+
+
+/** Open an .evt file and check its header.
+ *  @param[out] log  An EvtLog structure to be filled.
+ *  @param[in] path  The path to the file.
+ *  @return 0 on success, -1 on failure. An error message is printed.
+ */
+int evtLogOpen (EvtLog *__restrict log, const char *__restrict path);
+
+/** Open an .evt file that is already in memory, such as a member
+ *  of an archive. The memory has to stay valid until the log is closed.
+ *  @param[out] log  An EvtLog structure to be filled.
+ *  @param[in] data  The contents of the file.
+ *  @param[in] length  The length of the file in bytes.
+ *  @return 0 on success, -1 on failure. An error message is printed.
+ */
+int evtLogOpenMemory (EvtLog *__restrict log,
+	const void *__restrict data, size_t length);
+
+/** Start reading records from the oldest one again.
+ *  @param[in,out] log  An opened log.
+ */
+static inline void evtLogRewind (EvtLog *log)
+{
+	log->offset = log->hdr->startOffset;
+	log->walked = 0;
+}
+
+/** Continue reading records at the given offset.
+ *  @param[in,out] log  An opened log.
+ *  @param[in] offset  The offset of a record, as found in @a EvtLogRecord.
+ */
+static inline void evtLogSeek (EvtLog *log, size_t offset)
+{
+	log->offset = offset;
+	log->walked = 0;
+}
+
+/** Read the next record, oldest first.
+ *  @param[in,out] log  An opened log.
+ *  @param[out] record  Where to store the record. It stays valid
+ *  	until the next call on @a log.
+ *  @return The status.
+ */
+EvtLogStatus evtLogNext (EvtLog *__restrict log,
+	EvtLogRecord *__restrict record);
+
+/** Prepare for reading records from the newest one backwards.
+ *  The end is looked up in the header, and if it's out of date,
+ *  found by going through all of the records.
+ *  @param[in,out] log  An opened log.
+ *  @return 0 on success, -1 on failure. An error message is printed.
+ */
+int evtLogSeekEnd (EvtLog *log);
+
+/** Read the previous record, newest first. The length at the end of each
+ *  record tells where it begins. The oldest record is followed by
+ *  @a EVT_LOG_END.
+ *  @param[in,out] log  An opened log.
+ *  @param[out] record  Where to store the record. It stays valid
+ *  	until the next call on @a log.
+ *  @return The status.
+ */
+EvtLogStatus evtLogPrev (EvtLog *__restrict log,
+	EvtLogRecord *__restrict record);
+
+/** Check whether there is an EOF record at an address.
+ *  @param[in] p  The address, not necessarily aligned, with at least
+ *  	sizeof(EvtEOF) bytes following it.
+ *  @return Non-zero if there is one.
+ */
+int evtLogIsEofRecord (const void *p);
+
+/** Compute a hash of the raw bytes of a record, see hash.h.
+ *  @param[in] record  A record.
+ *  @return The hash.
+ */
+uint64_t evtLogHashRecord (const EvtLogRecord *record);
+
+/** Close an .evt file.
+ *  @param[in,out] log  An opened log.
+ */
+void evtLogClose (EvtLog *log);
+
+#endif /* ! EVTLOG_H_INCLUDED */
@@ -0,0 +1,219 @@
+/**
+ *  @file evtprobe.c
+ *  @brief Selection of event logs that might contain given records
+ *
+ *  Copyright Přemysl Janouch 2010. All rights reserved.
+ *  See the file LICENSE for licensing information.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "configure.h"
+
+#include "xalloc.h"
+#include "datastruct.h"
+#include "bloom.h"
+#include "summary.h"
+#include "token.h"
+#include "options.h"
+#include "timeconv.h"
+
+
+/** A condition on the values of a record. */
+typedef struct
+{
+	/** Which filter of the summary to test. */
+	int filter;
+	/** The value to look for. */
+	const char *value;
+}
+Criterion;
+
+/** What we are looking for. */
+typedef struct
+{
+	/** Values that all have to be present in a log. */
+	Criterion *criteria;
+	/** The number of @a criteria. */
+	int nCriteria;
+	/** Records have to be generated at this time or later. */
+	time_t after;
+	/** Records have to be generated at this time or earlier. */
+	time_t before;
+	/** Storage for tokens. */
+	Buffer token;
+}
+Query;
+
+
+/** Print usage information. */
+static void printUsage (FILE *stream);
+
+/** Find out whether a log might contain records matching the query. */
+static int summaryMatches (const Summary *__restrict summary,
+	Query *__restrict query);
+
+
+/** Command line options. */
+static const OptionSpec optionSpecs[] =
+{
+	{'e', "event-id", 1},
+	{'s', "source", 1},
+	{'u', "sid", 1},
+	{'t', "text", 1},
+	{'a', "after", 1},
+	{'B', "before", 1},
+	{'h', "help", 0},
+	{0, NULL, 0}
+};
+
+
+int main (int argc, char *argv[])
+{
+	OptionsState opts = OPTIONS_INITIALIZER;
+	Query query;
+	Summary summary;
+	FILE *input;
+	int opt, i;
+
+#ifdef HAVE_GETTEXT
+    /* All we want is localized messages. */
+    setlocale(LC_MESSAGES, "");
+
+    bindtextdomain(GETTEXT_DOMAIN, GETTEXT_DIRNAME);
+    textdomain(GETTEXT_DOMAIN);
+#endif
+
+#ifndef HAVE__MKGMTIME
+	setutctimezone();
+#endif
+
+	query.criteria = xmalloc(argc * sizeof(Criterion));
+	query.nCriteria = 0;
+	query.after = query.before = -1;
+	bufferInit(&query.token);
+
+	while ((opt = optionsNext(&opts, argc, argv, optionSpecs)) != OPTIONS_END)
+	{
+		Criterion *c = &query.criteria[query.nCriteria];
+
+		switch (opt)
+		{
+		case 'e':
+			c->filter = SUMMARY_EVENT_IDS;
+			break;
+		case 's':
+			c->filter = SUMMARY_SOURCES;
+			break;
+		case 'u':
+			c->filter = SUMMARY_SIDS;
+			break;
+		case 't':
+			c->filter = SUMMARY_TOKENS;
+			break;
+		case 'a':
+		case 'B':
+			if (parseTime(opts.arg) == -1)
+			{
+				fprintf(stderr, _("Error: Invalid time: %s\n"), opts.arg);
+				exit(EXIT_FAILURE);
+			}
+			if (opt == 'a')
+				query.after = parseTime(opts.arg);
+			else
+				query.before = parseTime(opts.arg);
+			continue;
+		case 'h':
+			printUsage(stdout);
+			exit(EXIT_SUCCESS);
+		default:
+			printUsage(stderr);
+			exit(EXIT_FAILURE);
+		}
+
+		c->value = opts.arg;
+		query.nCriteria++;
+	}
+	argc -= opts.index;
+	argv += opts.index;
+
+	if (argc < 1)
+	{
+		printUsage(stderr);
+		exit(EXIT_FAILURE);
+	}
+
+	for (i = 0; i < argc; i++)
+	{
+		/* When in doubt, the log has to be searched. */
+		if (!(input = fopen(argv[i], "rb")))
+		{
+			fprintf(stderr, _("Warning: Failed to open %s for reading.\n"),
+				argv[i]);
+			puts(argv[i]);
+			continue;
+		}
+		if (summaryRead(&summary, input))
+		{
+			fprintf(stderr, _("Warning: %s is not a valid summary.\n"),
+				argv[i]);
+			puts(argv[i]);
+			fclose(input);
+			continue;
+		}
+		fclose(input);
+
+		if (summaryMatches(&summary, &query))
+			puts(argv[i]);
+		summaryDestroy(&summary);
+	}
+
+	bufferDestroy(&query.token);
+	free(query.criteria);
+	return 0;
+}
+
+static void printUsage (FILE *stream)
+{
+	fputs(_("Usage: evtprobe [-e event-id] [-s source] [-u sid] [-t text]\n"
+		"                [-a after] [-B before] summary-file...\n"), stream);
+}
+
+static int summaryMatches (const Summary *__restrict summary,
+	Query *__restrict query)
+{
+	const char *cursor;
+	int i;
+
+	if (!summary->hdr.recordCount)
+		return 0;
+	if (query->after != -1
+		&& (time_t) summary->hdr.maxTimeGenerated < query->after)
+		return 0;
+	if (query->before != -1
+		&& (time_t) summary->hdr.minTimeGenerated > query->before)
+		return 0;
+
+	for (i = 0; i < query->nCriteria; i++)
+	{
+		const Criterion *c = &query->criteria[i];
+
+		if (c->filter != SUMMARY_TOKENS)
+		{
+			if (!summaryMayContain(summary, c->filter, c->value))
+				return 0;
+			continue;
+		}
+
+		/* Text must have all of its tokens present. */
+		for (cursor = c->value; tokenNext(&cursor, &query->token); )
+			if (!summaryMayContain(summary, SUMMARY_TOKENS,
+				query->token.data))
+				return 0;
+	}
+	return 1;
+}
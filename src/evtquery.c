@@ -0,0 +1,885 @@
+/**
+ *  @file evtquery.c
+ *  @brief A server answering queries over catalogued event logs
+ *
+ *  Copyright Přemysl Janouch 2010. All rights reserved.
+ *  See the file LICENSE for licensing information.
+ *
+ *  The catalog, the summaries of logs and optionally an index are loaded
+ *  and the logs are mapped into memory once, at startup. Queries are then
+ *  answered by skipping logs that can't contain any matching record and,
+ *  where the index can be used, by going right to the records that do.
+ *  Only records that pass the checks on their fixed part get decoded.
+ *
+ *  The protocol follows that of evtd: a query is a line of evtprobe
+ *  options separated by tabs. The reply is either a line with "OK",
+ *  the number of records and the length of the CSV that follows,
+ *  or a line with "ERROR" and a description of the problem.
+ *
+ */
+
+/* fdopen, sigaction */
+#define _XOPEN_SOURCE 700
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include "configure.h"
+
+#include "xalloc.h"
+#include "datastruct.h"
+#include "evt.h"
+#include "mapfile.h"
+#include "evtlog.h"
+#include "bloom.h"
+#include "summary.h"
+#include "catalog.h"
+#include "invindex.h"
+#include "token.h"
+#include "options.h"
+#include "timeconv.h"
+#include "record.h"
+#include "sink.h"
+#include "workers.h"
+#include "listener.h"
+
+
+/** The maximum number of arguments of a query. */
+#define EVTQUERY_MAX_ARGS 64
+/** What is appended to the path of a log to get the path of its summary. */
+#define EVTQUERY_SUMMARY_SUFFIX ".sum"
+
+/** A log being served. */
+typedef struct
+{
+	/** The log, mapped for as long as the server runs. */
+	EvtLog log;
+	/** Whether @a log has been opened. */
+	int open;
+	/** The summary of the log. */
+	Summary summary;
+	/** Whether @a summary has been loaded. */
+	int summarized;
+	/** Whether the log is covered by the index. */
+	int inIndex;
+}
+ServedLog;
+
+/** Data shared by the workers. */
+typedef struct
+{
+	/** The listening socket. */
+	int listener;
+	/** The catalog of logs. */
+	Catalog catalog;
+	/** The logs, in the order of the catalog. */
+	ServedLog *logs;
+	/** The index, if there is one. */
+	Index index;
+	/** Whether @a index has been opened. */
+	int indexed;
+	/** For each file of the index, the number of the log plus one,
+	 *  or zero if the file isn't in the catalog. */
+	uint32_t *indexLogs;
+}
+Server;
+
+/** A condition on the values of a record. */
+typedef struct
+{
+	/** Which filter of the summary corresponds to it. */
+	int filter;
+	/** The value to look for. */
+	const char *value;
+}
+Criterion;
+
+/** What we are looking for. */
+typedef struct
+{
+	/** Values that all have to be present in a record. */
+	Criterion criteria[EVTQUERY_MAX_ARGS];
+	/** The number of @a criteria. */
+	int nCriteria;
+	/** Records have to be generated at this time or later. */
+	time_t after;
+	/** Records have to be generated at this time or earlier. */
+	time_t before;
+	/** The description of a malformed query. */
+	char error[OPTIONS_MESSAGE_SIZE];
+}
+Query;
+
+/** A record found in the index. */
+typedef struct
+{
+	/** The number of the log. */
+	uint32_t log;
+	/** The offset of the record. */
+	uint32_t offset;
+	/** How far the record is from the oldest one, in bytes. */
+	uint32_t age;
+}
+Hit;
+
+/** The state a worker keeps between queries. */
+typedef struct
+{
+	/** The server. */
+	const Server *server;
+	/** The query being answered. */
+	Query query;
+	/** The record being checked, decoded. */
+	RecordFields fields;
+	/** The request being read. */
+	Buffer line;
+	/** Storage for a token. */
+	Buffer token;
+	/** Tokens of the record being checked, each terminated by a NULL char. */
+	Buffer tokens;
+	/** Storage for a token of the query being checked against a record. */
+	Buffer wanted;
+	/** Where the CSV is put together before it's sent. */
+	FILE *body;
+	/** The sink writing into @a body. */
+	Sink *sink;
+	/** The log whose records are being written, or -1. */
+	long current;
+	/** The number of records written. */
+	unsigned long records;
+}
+Worker;
+
+
+/** Print usage information. */
+static void printUsage (FILE *stream);
+
+/** Remove the socket and exit on a signal. */
+static void onTerminate (int sig);
+
+/** Load the catalog, the summaries, the index and map the logs.
+ *  @return 0 on success, -1 on failure. An error message is printed.
+ */
+static int loadServer (Server *__restrict server,
+	const char *__restrict catalogPath, const char *__restrict indexPath);
+
+/** Serve connections until the process exits, to be run by workersRun(). */
+static void serveJob (void *server, size_t index);
+
+/** Serve queries sent over a connection. */
+static void serveConnection (Worker *worker, int fd);
+
+/** Parse a query.
+ *  @return NULL on success, otherwise a message describing the problem.
+ */
+static const char *parseQuery (Query *__restrict query,
+	int argc, char *argv[]);
+
+/** Write records matching the current query into the body.
+ *  @return NULL on success, otherwise a message describing the problem.
+ */
+static const char *runQuery (Worker *worker);
+
+/** Find records of the current query in the index.
+ *  @param[in,out] worker  The worker.
+ *  @param[out] hits  Where to store the records. Free it afterwards.
+ *  @param[out] nHits  The number of records.
+ *  @return 1 if the index has been used, 0 if the query doesn't contain
+ *  	any text, -1 if the index is corrupted.
+ */
+static int findInIndex (Worker *__restrict worker,
+	Hit **__restrict hits, size_t *__restrict nHits);
+
+/** Find out whether a log might contain records matching the query. */
+static int logMayMatch (Worker *__restrict worker,
+	const ServedLog *__restrict log, const CatalogEntry *__restrict entry);
+
+/** Check a record and write it if it matches the query.
+ *  @return 0 on success, -1 if the record couldn't be written.
+ */
+static int checkRecord (Worker *__restrict worker, long logIndex,
+	const EvtLogRecord *__restrict record);
+
+/** Find out whether all tokens of a text are among those of a record. */
+static int hasTokens (Worker *__restrict worker, const char *__restrict text);
+
+/** Compare two hits by the log and the offset, for qsort(). */
+static int compareHitOffsets (const void *a, const void *b);
+/** Compare two hits by the log and the age, for qsort(). */
+static int compareHitAges (const void *a, const void *b);
+
+
+/** Options of the server. */
+static const OptionSpec optionSpecs[] =
+{
+	{'j', "jobs", 1},
+	{'i', "index", 1},
+	{'h', "help", 0},
+	{0, NULL, 0}
+};
+
+/** Options of a query, the same as those of evtprobe. */
+static const OptionSpec querySpecs[] =
+{
+	{'e', "event-id", 1},
+	{'s', "source", 1},
+	{'u', "sid", 1},
+	{'t', "text", 1},
+	{'a', "after", 1},
+	{'B', "before", 1},
+	{0, NULL, 0}
+};
+
+/** The path to the socket, to be removed on exit. */
+static const char *socketPath;
+
+
+int main (int argc, char *argv[])
+{
+	OptionsState opts = OPTIONS_INITIALIZER;
+	Server server;
+	struct sigaction sa;
+	const char *indexPath = NULL;
+	unsigned nThreads;
+	int opt;
+	char *end;
+
+#ifdef HAVE_GETTEXT
+    /* All we want is localized messages. */
+    setlocale(LC_MESSAGES, "");
+
+    bindtextdomain(GETTEXT_DOMAIN, GETTEXT_DIRNAME);
+    textdomain(GETTEXT_DOMAIN);
+#endif
+
+#ifndef HAVE__MKGMTIME
+	setutctimezone();
+#endif
+
+	nThreads = workersDefaultCount();
+	while ((opt = optionsNext(&opts, argc, argv, optionSpecs)) != OPTIONS_END)
+	{
+		switch (opt)
+		{
+		case 'j':
+			nThreads = strtoul(opts.arg, &end, 10);
+			if (!*opts.arg || *end || !nThreads)
+			{
+				fprintf(stderr, _("Error: Invalid number of jobs: %s.\n"),
+					opts.arg);
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case 'i':
+			indexPath = opts.arg;
+			break;
+		case 'h':
+			printUsage(stdout);
+			exit(EXIT_SUCCESS);
+		default:
+			printUsage(stderr);
+			exit(EXIT_FAILURE);
+		}
+	}
+	argc -= opts.index;
+	argv += opts.index;
+
+	if (argc != 2)
+	{
+		printUsage(stderr);
+		exit(EXIT_FAILURE);
+	}
+
+	if (loadServer(&server, argv[0], indexPath))
+		exit(EXIT_FAILURE);
+	if ((server.listener = listenerOpen(argv[1])) == -1)
+		exit(EXIT_FAILURE);
+	socketPath = argv[1];
+
+	/* Clients going away mustn't take the server with them. */
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = SIG_IGN;
+	sigaction(SIGPIPE, &sa, NULL);
+	sa.sa_handler = onTerminate;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+
+	/* The workers never finish. */
+	workersRun(serveJob, &server, nThreads, nThreads);
+	return 0;
+}
+
+static void printUsage (FILE *stream)
+{
+	fputs(_("Usage: evtquery [-j jobs] [-i index] catalog socket\n"
+		"Queries: [-e event-id] [-s source] [-u sid] [-t text]"
+		" [-a after] [-B before]\n"
+		"         with arguments separated by tabs\n"), stream);
+}
+
+static void onTerminate (int sig)
+{
+	(void) sig;
+
+	unlink(socketPath);
+	_exit(EXIT_SUCCESS);
+}
+
+static int loadServer (Server *__restrict server,
+	const char *__restrict catalogPath, const char *__restrict indexPath)
+{
+	ServedLog *log;
+	CatalogEntry *entry;
+	FILE *input;
+	char *path;
+	size_t i, n;
+
+	catalogInit(&server->catalog);
+	if (catalogLoad(&server->catalog, catalogPath))
+		return -1;
+
+	n = catalogCount(&server->catalog);
+	server->logs = xmalloc((n + 1) * sizeof(ServedLog));
+	for (i = 0; i < n; i++)
+	{
+		log = &server->logs[i];
+		entry = &server->catalog.entries[i];
+
+		/* Logs that can't be opened are simply never searched. */
+		log->open = !evtLogOpen(&log->log, entry->path);
+		log->inIndex = 0;
+
+		path = xmalloc(strlen(entry->path)
+			+ sizeof(EVTQUERY_SUMMARY_SUFFIX));
+		sprintf(path, "%s" EVTQUERY_SUMMARY_SUFFIX, entry->path);
+		log->summarized = 0;
+		if ((input = fopen(path, "rb")))
+		{
+			if (summaryRead(&log->summary, input))
+				fprintf(stderr, _("Warning: %s is not a valid summary.\n"),
+					path);
+			else
+				log->summarized = 1;
+			fclose(input);
+		}
+		free(path);
+	}
+
+	server->indexed = 0;
+	server->indexLogs = NULL;
+	if (!indexPath)
+		return 0;
+	if (indexOpen(&server->index, indexPath))
+		return -1;
+	server->indexed = 1;
+
+	n = server->index.hdr->nFiles;
+	server->indexLogs = xmalloc((n + 1) * sizeof(uint32_t));
+	for (i = 0; i < n; i++)
+	{
+		entry = catalogFind(&server->catalog,
+			indexFilePath(&server->index, i));
+		server->indexLogs[i] = entry
+			? entry - server->catalog.entries + 1 : 0;
+		if (entry)
+			server->logs[entry - server->catalog.entries].inIndex = 1;
+	}
+	return 0;
+}
+
+static void serveJob (void *server, size_t index)
+{
+	Worker worker;
+	int fd;
+
+	(void) index;
+
+	memset(&worker, 0, sizeof(worker));
+	worker.server = server;
+	recordFieldsInit(&worker.fields);
+	bufferInit(&worker.line);
+	bufferInit(&worker.token);
+	bufferInit(&worker.tokens);
+	bufferInit(&worker.wanted);
+	if (!(worker.body = tmpfile()))
+	{
+		fprintf(stderr, _("Error: Failed to create a temporary file.\n"));
+		return;
+	}
+
+	while (1)
+		if ((fd = listenerAccept(worker.server->listener)) != -1)
+			serveConnection(&worker, fd);
+}
+
+static void serveConnection (Worker *worker, int fd)
+{
+	FILE *in, *out;
+	char *args[EVTQUERY_MAX_ARGS], *p;
+	const char *error;
+	char buff[BUFSIZ];
+	long length, left;
+	size_t chunk;
+	int argc, status;
+
+	if (!(in = fdopen(fd, "rb")))
+	{
+		close(fd);
+		return;
+	}
+	if ((fd = dup(fd)) == -1 || !(out = fdopen(fd, "wb")))
+	{
+		if (fd != -1)
+			close(fd);
+		fclose(in);
+		return;
+	}
+
+	while (!(status = listenerReadLine(in, &worker->line)))
+	{
+		/* The first argument is skipped by the option parser. */
+		args[0] = "evtquery";
+		argc = 1;
+		p = *(char *) worker->line.data ? worker->line.data : NULL;
+		for (; p && argc < EVTQUERY_MAX_ARGS; argc++)
+		{
+			args[argc] = p;
+			if ((p = strchr(p, '\t')))
+				*p++ = '\0';
+		}
+
+		rewind(worker->body);
+		if (p)
+			error = "Too many arguments";
+		else if (!(error = parseQuery(&worker->query, argc, args)))
+			error = runQuery(worker);
+		if (error)
+		{
+			fprintf(out, "ERROR\t%s\n", error);
+			if (fflush(out))
+				break;
+			continue;
+		}
+
+		/* The length goes first, since records may span several lines. */
+		length = ftell(worker->body);
+		fprintf(out, "OK\t%lu\t%ld\n", worker->records, length);
+		rewind(worker->body);
+		for (left = length; left; left -= chunk)
+		{
+			chunk = left < (long) sizeof(buff) ? (size_t) left : sizeof(buff);
+			if (fread(buff, 1, chunk, worker->body) != chunk)
+				break;
+			fwrite(buff, 1, chunk, out);
+		}
+		if (left || fflush(out))
+			break;
+	}
+
+	/* There's no telling where the next line would begin. */
+	if (status == 1)
+		fputs("ERROR\tLine too long\n", out);
+
+	fclose(out);
+	fclose(in);
+}
+
+static const char *parseQuery (Query *__restrict query,
+	int argc, char *argv[])
+{
+	OptionsState opts = OPTIONS_INITIALIZER;
+	Criterion *c;
+	int opt;
+
+	query->nCriteria = 0;
+	query->after = query->before = -1;
+
+	/* Problems with the query are the client's to know about. */
+	opts.quiet = 1;
+	while ((opt = optionsNext(&opts, argc, argv, querySpecs)) != OPTIONS_END)
+	{
+		c = &query->criteria[query->nCriteria];
+		switch (opt)
+		{
+		case 'e':
+			c->filter = SUMMARY_EVENT_IDS;
+			break;
+		case 's':
+			c->filter = SUMMARY_SOURCES;
+			break;
+		case 'u':
+			c->filter = SUMMARY_SIDS;
+			break;
+		case 't':
+			c->filter = SUMMARY_TOKENS;
+			break;
+		case 'a':
+			if ((query->after = parseTime(opts.arg)) == -1)
+				return "Invalid time";
+			continue;
+		case 'B':
+			if ((query->before = parseTime(opts.arg)) == -1)
+				return "Invalid time";
+			continue;
+		case OPTIONS_ERROR:
+			strcpy(query->error, opts.message);
+			return query->error;
+		default:
+			return "Invalid options";
+		}
+
+		c->value = opts.arg;
+		query->nCriteria++;
+	}
+	if (opts.index != argc)
+		return "Unexpected arguments";
+	return NULL;
+}
+
+static const char *runQuery (Worker *worker)
+{
+	const Server *server = worker->server;
+	ServedLog *logs = server->logs;
+	EvtLog log;
+	EvtLogRecord record;
+	EvtLogStatus status;
+	Hit *hits = NULL;
+	size_t nHits = 0, n, i;
+	const char *error = NULL;
+	int used;
+
+	worker->sink = sinkCreateCsv(worker->body, NULL);
+	worker->current = -1;
+	worker->records = 0;
+
+	if ((used = findInIndex(worker, &hits, &nHits)) == -1)
+	{
+		error = "The index is corrupted";
+		goto runQuery_end;
+	}
+
+	/* Indexed logs are searched through their postings. The postings
+	 * don't say anything about logs the index doesn't know of, though. */
+	for (i = 0; i < nHits && !error; i++)
+	{
+		if (worker->current != (long) hits[i].log
+			&& !logMayMatch(worker, &logs[hits[i].log],
+				&server->catalog.entries[hits[i].log]))
+			continue;
+
+		log = logs[hits[i].log].log;
+		bufferInit(&log.scratch);
+		evtLogSeek(&log, hits[i].offset);
+		if (evtLogNext(&log, &record) != EVT_LOG_RECORD
+			|| record.rec->reserved != EVT_SIGNATURE)
+			error = "The index is out of date";
+		else if (checkRecord(worker, hits[i].log, &record))
+			error = "Failed to write records";
+		bufferDestroy(&log.scratch);
+	}
+
+	n = catalogCount(&server->catalog);
+	for (i = 0; i < n && !error; i++)
+	{
+		if ((used && logs[i].inIndex) || !logs[i].open
+			|| !logMayMatch(worker, &logs[i], &server->catalog.entries[i]))
+			continue;
+
+		/* The mapping is shared, the position and scratch space are not. */
+		log = logs[i].log;
+		bufferInit(&log.scratch);
+		evtLogRewind(&log);
+		while ((status = evtLogNext(&log, &record)) == EVT_LOG_RECORD)
+			if (checkRecord(worker, i, &record))
+			{
+				error = "Failed to write records";
+				break;
+			}
+		if (status == EVT_LOG_ERROR)
+			error = "Failed to read a log";
+		bufferDestroy(&log.scratch);
+	}
+
+runQuery_end:
+	free(hits);
+
+	if (worker->sink->close(worker->sink) && !error)
+		error = "Failed to write records";
+	return error;
+}
+
+static int findInIndex (Worker *__restrict worker,
+	Hit **__restrict hits, size_t *__restrict nHits)
+{
+	const Server *server = worker->server;
+	const Index *index = &server->index;
+	const IndexToken *entry;
+	IndexPosting *postings;
+	Hit *result = NULL, *h;
+	const char *cursor;
+	size_t nResult = 0, i, k, n;
+	int c, first = 1, cmp;
+	uint32_t logIndex;
+
+	*hits = NULL;
+	*nHits = 0;
+	if (!server->indexed)
+		return 0;
+
+	for (c = 0; c < worker->query.nCriteria; c++)
+	{
+		if (worker->query.criteria[c].filter != SUMMARY_TOKENS)
+			continue;
+
+		for (cursor = worker->query.criteria[c].value;
+			tokenNext(&cursor, &worker->token); )
+		{
+			if (!(entry = indexFind(index, worker->token.data)))
+			{
+				nResult = 0;
+				first = 0;
+				break;
+			}
+
+			postings = xmalloc((entry->count + 1) * sizeof(IndexPosting));
+			if (indexDecode(index, entry, postings))
+			{
+				free(postings);
+				free(result);
+				return -1;
+			}
+
+			/* Postings of files that aren't in the catalog are dropped. */
+			h = xmalloc((entry->count + 1) * sizeof(Hit));
+			for (i = n = 0; i < entry->count; i++)
+			{
+				if (postings[i].file >= index->hdr->nFiles
+					|| !(logIndex = server->indexLogs[postings[i].file]))
+					continue;
+				h[n].log = logIndex - 1;
+				h[n].offset = postings[i].offset;
+				n++;
+			}
+			free(postings);
+			qsort(h, n, sizeof(Hit), compareHitOffsets);
+
+			if (first)
+			{
+				result = h;
+				nResult = n;
+				first = 0;
+				continue;
+			}
+
+			/* Intersect the result with these postings. */
+			for (i = k = 0; i < nResult && k < n; )
+			{
+				if (!(cmp = compareHitOffsets(&result[i], &h[k])))
+				{
+					result[*nHits] = result[i++];
+					++*nHits;
+					k++;
+				}
+				else if (cmp < 0)
+					i++;
+				else
+					k++;
+			}
+			nResult = *nHits;
+			*nHits = 0;
+			free(h);
+			if (!nResult)
+				break;
+		}
+		if (!first && !nResult)
+			break;
+	}
+	if (first)
+		return 0;
+
+	/* Records in a wrapped log start in the middle of the file. */
+	for (i = 0; i < nResult; i++)
+	{
+		const EvtLog *log = &server->logs[result[i].log].log;
+
+		if (!server->logs[result[i].log].open)
+			result[i].age = 0;
+		else
+			result[i].age = result[i].offset >= log->hdr->startOffset
+				? result[i].offset - log->hdr->startOffset
+				: result[i].offset
+					+ (log->file.length - log->hdr->startOffset);
+	}
+	qsort(result, nResult, sizeof(Hit), compareHitAges);
+
+	/* Hits in logs that couldn't be opened are left out. */
+	for (i = n = 0; i < nResult; i++)
+		if (server->logs[result[i].log].open)
+			result[n++] = result[i];
+
+	*hits = result;
+	*nHits = n;
+	return 1;
+}
+
+static int logMayMatch (Worker *__restrict worker,
+	const ServedLog *__restrict log, const CatalogEntry *__restrict entry)
+{
+	const Query *query = &worker->query;
+	const char *cursor;
+	int i;
+
+	/* The time range of a log is in the catalog as well as its summary. */
+	if (!entry->recordCount)
+		return 0;
+	if (query->after != -1
+		&& (time_t) entry->maxTimeGenerated < query->after)
+		return 0;
+	if (query->before != -1
+		&& (time_t) entry->minTimeGenerated > query->before)
+		return 0;
+	if (!log->summarized)
+		return 1;
+
+	for (i = 0; i < query->nCriteria; i++)
+	{
+		const Criterion *c = &query->criteria[i];
+
+		if (c->filter != SUMMARY_TOKENS)
+		{
+			if (!summaryMayContain(&log->summary, c->filter, c->value))
+				return 0;
+			continue;
+		}
+
+		for (cursor = c->value; tokenNext(&cursor, &worker->token); )
+			if (!summaryMayContain(&log->summary, SUMMARY_TOKENS,
+				worker->token.data))
+				return 0;
+	}
+	return 1;
+}
+
+static int checkRecord (Worker *__restrict worker, long logIndex,
+	const EvtLogRecord *__restrict record)
+{
+	const Query *query = &worker->query;
+	const EvtRecord *rec = record->rec;
+	const char *cursor;
+	char buff[16];
+	int i, decoded = 0;
+
+	/* The fixed part is checked before anything gets decoded. */
+	if (query->after != -1 && (time_t) rec->timeGenerated < query->after)
+		return 0;
+	if (query->before != -1 && (time_t) rec->timeGenerated > query->before)
+		return 0;
+
+	snprintf(buff, sizeof(buff), "%u", rec->eventID);
+	for (i = 0; i < query->nCriteria; i++)
+		if (query->criteria[i].filter == SUMMARY_EVENT_IDS
+			&& strcmp(buff, query->criteria[i].value))
+			return 0;
+
+	for (i = 0; i < query->nCriteria; i++)
+	{
+		const Criterion *c = &query->criteria[i];
+
+		if (c->filter == SUMMARY_EVENT_IDS)
+			continue;
+		if (!decoded)
+		{
+			recordDecode(&worker->fields, rec,
+				record->nonFixed, record->nonFixedLength);
+			bufferClear(&worker->tokens);
+			decoded = 1;
+		}
+
+		switch (c->filter)
+		{
+		case SUMMARY_SOURCES:
+			if (!worker->fields.sourceName
+				|| strcmp(worker->fields.sourceName, c->value))
+				return 0;
+			break;
+		case SUMMARY_SIDS:
+			if (!worker->fields.sid || strcmp(worker->fields.sid, c->value))
+				return 0;
+			break;
+		case SUMMARY_TOKENS:
+			if (!worker->tokens.used)
+			{
+				/* An empty string keeps the list from being empty. */
+				bufferAppendChar(&worker->tokens, '\0');
+				for (cursor = worker->fields.strings;
+					tokenNext(&cursor, &worker->token); )
+					bufferAppend(&worker->tokens, worker->token.data,
+						worker->token.used, 0);
+			}
+			if (!hasTokens(worker, c->value))
+				return 0;
+			break;
+		}
+	}
+
+	if (!decoded)
+		recordDecode(&worker->fields, rec,
+			record->nonFixed, record->nonFixedLength);
+
+	/* Each log is preceded by its header, as with evt2csv. */
+	if (worker->current != logIndex)
+	{
+		const EvtLog *log = &worker->server->logs[logIndex].log;
+
+		worker->current = logIndex;
+		if (worker->sink->begin(worker->sink, log->hdr, log->file.length))
+			return -1;
+	}
+	if (worker->sink->write(worker->sink, &worker->fields))
+		return -1;
+	worker->records++;
+	return 0;
+}
+
+static int hasTokens (Worker *__restrict worker, const char *__restrict text)
+{
+	const char *cursor, *p, *end;
+
+	for (cursor = text; tokenNext(&cursor, &worker->wanted); )
+	{
+		p = worker->tokens.data;
+		end = p + worker->tokens.used;
+		for (; p < end; p += strlen(p) + 1)
+			if (!strcmp(p, worker->wanted.data))
+				break;
+		if (p >= end)
+			return 0;
+	}
+	return 1;
+}
+
+static int compareHitOffsets (const void *a, const void *b)
+{
+	const Hit *ha = a, *hb = b;
+
+	if (ha->log != hb->log)
+		return ha->log < hb->log ? -1 : 1;
+	if (ha->offset != hb->offset)
+		return ha->offset < hb->offset ? -1 : 1;
+	return 0;
+}
+
+static int compareHitAges (const void *a, const void *b)
+{
+	const Hit *ha = a, *hb = b;
+
+	if (ha->log != hb->log)
+		return ha->log < hb->log ? -1 : 1;
+	if (ha->age != hb->age)
+		return ha->age < hb->age ? -1 : 1;
+	return 0;
+}
@@ -0,0 +1,379 @@
+/**
+ *  @file evtrepair.c
+ *  @brief Repairing headers of .evt files in place
+ *
+ *  Copyright Přemysl Janouch 2010. All rights reserved.
+ *  See the file LICENSE for licensing information.
+ *
+ *  The EOF record is rewritten with every record that is added to a log,
+ *  while the header is only updated once the log is closed properly.
+ *  The true state of the log is therefore recovered from the EOF record
+ *  and the records preceding it, and only the header and the EOF record
+ *  are written back.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "configure.h"
+
+#include "xalloc.h"
+#include "datastruct.h"
+#include "evt.h"
+#include "mapfile.h"
+#include "evtlog.h"
+#include "options.h"
+
+
+/** The size of blocks the file is read in when looking for the EOF record. */
+#define SCAN_BLOCK_SIZE (1 << 20)
+
+/** The state of a log as found by walking its records. */
+typedef struct
+{
+	/** The open file. */
+	FILE *fp;
+	/** The length of the file. */
+	long length;
+	/** The header as it is in the file. */
+	EvtHeader hdr;
+	/** The EOF record as it is in the file. */
+	EvtEOF eof;
+	/** The offset of the EOF record. */
+	long eofOffset;
+	/** The offset of the oldest record. */
+	long startOffset;
+	/** The number of the oldest record, zero if there are no records. */
+	uint32_t oldest;
+	/** The number of the next record to be added. */
+	uint32_t current;
+}
+RepairCtx;
+
+
+/** Print usage information. */
+static void printUsage (FILE *stream);
+
+/** Repair a single file.
+ *  @return -1 on error, 0 if the file is fine, 1 if it has been repaired.
+ */
+static int repairFile (const char *path, int dryRun);
+
+/** Read a part of the file.
+ *  @return 0 on success, -1 if the part couldn't be read.
+ */
+static int readAt (FILE *__restrict fp, long offset,
+	void *__restrict buff, size_t length);
+
+/** Find the EOF record, either where the header says it is,
+ *  or by scanning the whole file.
+ *  @return 0 on success, -1 if no EOF record could be found.
+ */
+static int findEof (RepairCtx *ctx);
+
+/** Check whether the record at an offset has the given number.
+ *  @param[out] rec  The fixed part of the record.
+ */
+static int isRecordAt (RepairCtx *__restrict ctx, long offset,
+	uint32_t recordNumber, EvtRecord *__restrict rec);
+
+/** Find the oldest record. The EOF record is trusted if it points
+ *  to a record with the right number, otherwise the log is walked
+ *  backwards from the EOF record for as long as records follow each other.
+ */
+static void findStart (RepairCtx *ctx);
+
+/** Print a field that is about to be changed. */
+static void reportChange (const char *__restrict path,
+	const char *__restrict field, uint32_t from, uint32_t to);
+
+
+/** Command line options. */
+static const OptionSpec optionSpecs[] =
+{
+	{'n', "dry-run", 0},
+	{'h', "help", 0},
+	{0, NULL, 0}
+};
+
+
+int main (int argc, char *argv[])
+{
+	OptionsState opts = OPTIONS_INITIALIZER;
+	int opt, dryRun = 0, ret = EXIT_SUCCESS, i;
+
+#ifdef HAVE_GETTEXT
+    /* All we want is localized messages. */
+    setlocale(LC_MESSAGES, "");
+
+    bindtextdomain(GETTEXT_DOMAIN, GETTEXT_DIRNAME);
+    textdomain(GETTEXT_DOMAIN);
+#endif
+
+	while ((opt = optionsNext(&opts, argc, argv, optionSpecs)) != OPTIONS_END)
+	{
+		switch (opt)
+		{
+		case 'n':
+			dryRun = 1;
+			break;
+		case 'h':
+			printUsage(stdout);
+			exit(EXIT_SUCCESS);
+		default:
+			printUsage(stderr);
+			exit(EXIT_FAILURE);
+		}
+	}
+	argc -= opts.index;
+	argv += opts.index;
+
+	if (argc < 1)
+	{
+		printUsage(stderr);
+		exit(EXIT_FAILURE);
+	}
+
+	for (i = 0; i < argc; i++)
+		if (repairFile(argv[i], dryRun) == -1)
+			ret = EXIT_FAILURE;
+	return ret;
+}
+
+static void printUsage (FILE *stream)
+{
+	fputs(_("Usage: evtrepair [-n] file...\n"), stream);
+}
+
+static int readAt (FILE *__restrict fp, long offset,
+	void *__restrict buff, size_t length)
+{
+	if (offset < 0 || fseek(fp, offset, SEEK_SET)
+		|| fread(buff, 1, length, fp) != length)
+		return -1;
+	return 0;
+}
+
+static int findEof (RepairCtx *ctx)
+{
+	EvtEOF eof;
+	char *buff;
+	long offset, found = 0;
+	size_t length, i;
+
+	if (ctx->hdr.endOffset >= ctx->hdr.headerSize
+		&& !readAt(ctx->fp, ctx->hdr.endOffset, &ctx->eof, sizeof(EvtEOF))
+		&& evtLogIsEofRecord(&ctx->eof))
+	{
+		ctx->eofOffset = ctx->hdr.endOffset;
+		return 0;
+	}
+
+	/* The EOF record is never split and it's always aligned like records.
+	 * Blocks overlap so that a record lying across their boundary is found,
+	 * and if there are several, the most recent one is taken. */
+	buff = xmalloc(SCAN_BLOCK_SIZE);
+	for (offset = ctx->hdr.headerSize; offset + (long) sizeof(EvtEOF)
+		<= ctx->length; offset += length - sizeof(EvtEOF) + 4)
+	{
+		length = SCAN_BLOCK_SIZE;
+		if (ctx->length - offset < (long) length)
+			length = ctx->length - offset;
+		if (readAt(ctx->fp, offset, buff, length))
+			break;
+
+		for (i = 0; i + sizeof(EvtEOF) <= length; i += 4)
+		{
+			if (!evtLogIsEofRecord(buff + i))
+				continue;
+			memcpy(&eof, buff + i, sizeof(eof));
+			if (!found || eof.currentRecordNumber
+				> ctx->eof.currentRecordNumber)
+			{
+				ctx->eof = eof;
+				found = offset + i;
+			}
+		}
+		if (offset + (long) length == ctx->length)
+			break;
+	}
+	free(buff);
+
+	if (!found)
+		return -1;
+	ctx->eofOffset = found;
+	return 0;
+}
+
+static int isRecordAt (RepairCtx *__restrict ctx, long offset,
+	uint32_t recordNumber, EvtRecord *__restrict rec)
+{
+	uint32_t trailing;
+	long trailer;
+
+	/* The fixed part of a record never gets split. */
+	if (offset < (long) ctx->hdr.headerSize
+		|| offset + (long) sizeof(EvtRecord) > ctx->length
+		|| readAt(ctx->fp, offset, rec, sizeof(EvtRecord))
+		|| rec->reserved != EVT_SIGNATURE
+		|| rec->recordNumber != recordNumber
+		|| rec->length < sizeof(EvtRecord) + sizeof(trailing)
+		|| rec->length % sizeof(trailing)
+		|| rec->length > ctx->length - ctx->hdr.headerSize)
+		return 0;
+
+	trailer = offset + rec->length - sizeof(trailing);
+	if (trailer >= ctx->length)
+		trailer = trailer - ctx->length + ctx->hdr.headerSize;
+	return !readAt(ctx->fp, trailer, &trailing, sizeof(trailing))
+		&& trailing == rec->length;
+}
+
+static void findStart (RepairCtx *ctx)
+{
+	EvtRecord rec;
+	uint32_t length, expected;
+	long offset, start, space;
+
+	ctx->current = ctx->eof.currentRecordNumber;
+	if (ctx->eof.oldestRecordNumber
+		&& ctx->eof.oldestRecordNumber < ctx->current
+		&& isRecordAt(ctx, ctx->eof.beginRecord,
+			ctx->eof.oldestRecordNumber, &rec))
+	{
+		ctx->startOffset = ctx->eof.beginRecord;
+		ctx->oldest = ctx->eof.oldestRecordNumber;
+		return;
+	}
+
+	ctx->startOffset = ctx->eofOffset;
+	ctx->oldest = 0;
+
+	/* Records may take all of the file but the header and the EOF record. */
+	space = ctx->length - ctx->hdr.headerSize - sizeof(EvtEOF);
+	offset = ctx->eofOffset;
+	for (expected = ctx->current - 1; expected; expected--)
+	{
+		/* Before the first record after the header, there's the end
+		 * of the file, possibly with some padding. */
+		if (offset == (long) ctx->hdr.headerSize)
+		{
+			offset = ctx->length;
+			while (offset - 4 > ctx->eofOffset
+				&& !readAt(ctx->fp, offset - 4, &length, sizeof(length))
+				&& length == 0x27)
+				offset -= 4;
+			space -= ctx->length - offset;
+		}
+
+		if (readAt(ctx->fp, offset - sizeof(length), &length, sizeof(length))
+			|| length > space)
+			break;
+
+		start = offset - length;
+		if (start < (long) ctx->hdr.headerSize)
+			start += ctx->length - ctx->hdr.headerSize;
+		if (!isRecordAt(ctx, start, expected, &rec) || rec.length != length)
+			break;
+
+		space -= length;
+		ctx->startOffset = offset = start;
+		ctx->oldest = expected;
+	}
+}
+
+static void reportChange (const char *__restrict path,
+	const char *__restrict field, uint32_t from, uint32_t to)
+{
+	if (from != to)
+		printf(_("%s: %s %lu -> %lu\n"), path, field,
+			(unsigned long) from, (unsigned long) to);
+}
+
+static int repairFile (const char *path, int dryRun)
+{
+	RepairCtx ctx;
+	EvtHeader hdr;
+	EvtEOF eof;
+	int ret = -1;
+
+	if (!(ctx.fp = fopen(path, dryRun ? "rb" : "r+b")))
+	{
+		fprintf(stderr, _("Error: Failed to open %s.\n"), path);
+		return -1;
+	}
+
+	if (fseek(ctx.fp, 0, SEEK_END) == -1 || (ctx.length = ftell(ctx.fp)) == -1
+		|| readAt(ctx.fp, 0, &ctx.hdr, sizeof(EvtHeader))
+		|| ctx.hdr.signature != EVT_SIGNATURE
+		|| ctx.hdr.headerSize != sizeof(EvtHeader)
+		|| ctx.hdr.endHeaderSize != sizeof(EvtHeader)
+		|| ctx.hdr.majorVersion != 1 || ctx.hdr.minorVersion != 1)
+	{
+		fprintf(stderr, _("Error: %s is not a valid event log.\n"), path);
+		goto repairFile_end;
+	}
+	if (findEof(&ctx))
+	{
+		fprintf(stderr, _("Error: No EOF record found in %s.\n"), path);
+		goto repairFile_end;
+	}
+	findStart(&ctx);
+
+	hdr = ctx.hdr;
+	hdr.startOffset = ctx.startOffset;
+	hdr.endOffset = ctx.eofOffset;
+	hdr.currentRecordNumber = ctx.current;
+	hdr.oldestRecordNumber = ctx.oldest;
+	hdr.flags &= ~EVT_HEADER_DIRTY;
+	if (ctx.startOffset > ctx.eofOffset)
+		hdr.flags |= EVT_HEADER_WRAP;
+
+	eof = ctx.eof;
+	eof.beginRecord = ctx.startOffset;
+	eof.endRecord = ctx.eofOffset;
+	eof.currentRecordNumber = ctx.current;
+	eof.oldestRecordNumber = ctx.oldest;
+
+	ret = 0;
+	if (!memcmp(&hdr, &ctx.hdr, sizeof(hdr))
+		&& !memcmp(&eof, &ctx.eof, sizeof(eof)))
+		goto repairFile_end;
+
+	reportChange(path, "startOffset", ctx.hdr.startOffset, hdr.startOffset);
+	reportChange(path, "endOffset", ctx.hdr.endOffset, hdr.endOffset);
+	reportChange(path, "currentRecordNumber",
+		ctx.hdr.currentRecordNumber, hdr.currentRecordNumber);
+	reportChange(path, "oldestRecordNumber",
+		ctx.hdr.oldestRecordNumber, hdr.oldestRecordNumber);
+	reportChange(path, "flags", ctx.hdr.flags, hdr.flags);
+	if (memcmp(&eof, &ctx.eof, sizeof(eof)))
+		printf(_("%s: the EOF record at offset %lu is rewritten\n"),
+			path, (unsigned long) ctx.eofOffset);
+
+	ret = 1;
+	if (dryRun)
+		goto repairFile_end;
+
+	/* The header goes last, so that it's only clean when all is done. */
+	if (fseek(ctx.fp, ctx.eofOffset, SEEK_SET)
+		|| fwrite(&eof, sizeof(eof), 1, ctx.fp) != 1
+		|| fflush(ctx.fp)
+		|| fseek(ctx.fp, 0, SEEK_SET)
+		|| fwrite(&hdr, sizeof(hdr), 1, ctx.fp) != 1
+		|| fflush(ctx.fp))
+	{
+		fprintf(stderr, _("Error: Failed to write to %s.\n"), path);
+		ret = -1;
+	}
+
+repairFile_end:
+	if (fclose(ctx.fp) && ret == 1 && !dryRun)
+	{
+		fprintf(stderr, _("Error: Failed to write to %s.\n"), path);
+		ret = -1;
+	}
+	return ret;
+}
@@ -0,0 +1,563 @@
+/**
+ *  @file evtverify.c
+ *  @brief Verifying that .evt files survive conversion to CSV and back
+ *
+ *  Copyright Přemysl Janouch 2010. All rights reserved.
+ *  See the file LICENSE for licensing information.
+ *
+ *  Records are converted to CSV the way evt2csv does it, parsed back
+ *  the way csv2evt does it, and compared with the originals. Both
+ *  conversions run in memory, a batch of records at a time.
+ *
+ */
+
+/* open_memstream, fmemopen */
+#define _XOPEN_SOURCE 700
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <time.h>
+
+#include "configure.h"
+
+#include "xalloc.h"
+#include "datastruct.h"
+#include "evt.h"
+#include "csv.h"
+#include "mapfile.h"
+#include "evtlog.h"
+#include "options.h"
+#include "encode.h"
+#include "record.h"
+#include "sink.h"
+#include "workers.h"
+
+
+/** How many records are converted at once. */
+#define VERIFY_BATCH_SIZE 1024
+
+/** The result of verifying a file. */
+typedef struct
+{
+	/** The path to the file. */
+	const char *path;
+	/** Whether the records have survived. */
+	int ok;
+	/** The number of records verified. */
+	unsigned long records;
+	/** What has gone wrong. */
+	char problem[256];
+}
+VerifyResult;
+
+/** An in-memory stream the CSV is written to and read back from. */
+typedef struct
+{
+	/** The stream. */
+	FILE *fp;
+	/** The contents of the stream. */
+	char *data;
+	/** The length of @a data. */
+	size_t length;
+}
+MemStream;
+
+/** Where the variable parts of a record lie. Parts that don't fit
+ *  in the record are empty. */
+typedef struct
+{
+	/** The source name, including the terminating null character. */
+	const char *source;
+	size_t sourceLength;
+	/** The computer name, including the terminating null character. */
+	const char *computer;
+	size_t computerLength;
+	/** The user SID. */
+	const char *sid;
+	size_t sidLength;
+	/** All of the description strings. */
+	const char *strings;
+	size_t stringsLength;
+	/** Event-specific data. */
+	const char *data;
+	size_t dataLength;
+}
+RecordParts;
+
+
+/** Print usage information. */
+static void printUsage (FILE *stream);
+
+/** Verify a file, to be run by workersRun(). */
+static void verifyJob (void *results, size_t index);
+/** Verify the records of a log.
+ *  @return 0 if all of them have survived, -1 otherwise.
+ */
+static int verifyLog (EvtLog *__restrict log,
+	VerifyResult *__restrict result);
+/** Parse a batch of records back from CSV and compare them with
+ *  the originals, which are read again from @a log.
+ *  @return 0 if all of them have survived, -1 otherwise.
+ */
+static int compareBatch (EvtLog *__restrict log, FILE *__restrict csv,
+	int first, VerifyResult *__restrict result);
+/** Describe what has gone wrong.
+ *  @return -1, so that it may simply be returned.
+ */
+static int fail (VerifyResult *__restrict result,
+	const char *__restrict format, ...) ATTRIBUTE_FORMAT(printf, 2, 3);
+
+/** Open a stream for writing. */
+static int memStreamOpen (MemStream *ms);
+/** Reopen a stream for reading what has been written. */
+static int memStreamRewind (MemStream *ms);
+/** Close a stream and free its contents. */
+static void memStreamClose (MemStream *ms);
+
+/** Get the length of a wide string, including the terminating null
+ *  character, but at most @a length bytes. */
+static size_t wideLength (const char *p, size_t length);
+/** Find the variable parts of a record. */
+static void findParts (const EvtRecord *__restrict rec,
+	const char *__restrict nonFixed, size_t nonFixedLength,
+	RecordParts *__restrict parts);
+/** Check whether two parts of records are the same. */
+static int samePart (const char *a, size_t aLength,
+	const char *b, size_t bLength);
+/** Compare a record with its converted version.
+ *  @return NULL if they are the same, otherwise the name of the first
+ *  	field that differs.
+ */
+static const char *compareRecords (const EvtLogRecord *__restrict original,
+	const EvtRecord *__restrict rec, const Buffer *__restrict nonFixed);
+
+
+/** Command line options. */
+static const OptionSpec optionSpecs[] =
+{
+	{'j', "jobs", 1},
+	{'q', "quiet", 0},
+	{'h', "help", 0},
+	{0, NULL, 0}
+};
+
+
+int main (int argc, char *argv[])
+{
+	OptionsState opts = OPTIONS_INITIALIZER;
+	VerifyResult *results;
+	unsigned nThreads;
+	int opt, quiet = 0, ret = EXIT_SUCCESS, i;
+	char *end;
+
+#ifdef HAVE_GETTEXT
+    /* All we want is localized messages. */
+    setlocale(LC_MESSAGES, "");
+
+    bindtextdomain(GETTEXT_DOMAIN, GETTEXT_DIRNAME);
+    textdomain(GETTEXT_DOMAIN);
+#endif
+
+#ifndef HAVE__MKGMTIME
+	/* Times are parsed back as UTC, like in csv2evt. */
+	setutctimezone();
+#endif /* ! HAVE__MKGMTIME */
+
+	nThreads = workersDefaultCount();
+	while ((opt = optionsNext(&opts, argc, argv, optionSpecs)) != OPTIONS_END)
+	{
+		switch (opt)
+		{
+		case 'j':
+			nThreads = strtoul(opts.arg, &end, 10);
+			if (!*opts.arg || *end || !nThreads)
+			{
+				fprintf(stderr, _("Error: Invalid number of jobs: %s.\n"),
+					opts.arg);
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case 'q':
+			quiet = 1;
+			break;
+		case 'h':
+			printUsage(stdout);
+			exit(EXIT_SUCCESS);
+		default:
+			printUsage(stderr);
+			exit(EXIT_FAILURE);
+		}
+	}
+	argc -= opts.index;
+	argv += opts.index;
+
+	if (argc < 1)
+	{
+		printUsage(stderr);
+		exit(EXIT_FAILURE);
+	}
+
+	results = xmalloc(argc * sizeof(VerifyResult));
+	for (i = 0; i < argc; i++)
+		results[i].path = argv[i];
+	workersRun(verifyJob, results, argc, nThreads);
+
+	for (i = 0; i < argc; i++)
+	{
+		if (!results[i].ok)
+		{
+			printf(_("%s: %s\n"), results[i].path, results[i].problem);
+			ret = EXIT_FAILURE;
+		}
+		else if (!quiet)
+			printf(N_("%s: OK, %lu record\n", "%s: OK, %lu records\n",
+				results[i].records), results[i].path, results[i].records);
+	}
+
+	free(results);
+	return ret;
+}
+
+static void printUsage (FILE *stream)
+{
+	fputs(_("Usage: evtverify [-q] [-j jobs] file...\n"), stream);
+}
+
+static void verifyJob (void *results, size_t index)
+{
+	VerifyResult *result = (VerifyResult *) results + index;
+	EvtLog log;
+
+	result->ok = 0;
+	result->records = 0;
+	if (evtLogOpen(&log, result->path))
+	{
+		fail(result, _("failed to open the log"));
+		return;
+	}
+
+	result->ok = !verifyLog(&log, result);
+	evtLogClose(&log);
+}
+
+static int fail (VerifyResult *__restrict result,
+	const char *__restrict format, ...)
+{
+	va_list ap;
+
+	va_start(ap, format);
+	vsnprintf(result->problem, sizeof(result->problem), format, ap);
+	va_end(ap);
+	result->ok = 0;
+	return -1;
+}
+
+static int verifyLog (EvtLog *__restrict log,
+	VerifyResult *__restrict result)
+{
+	EvtLogRecord record;
+	EvtLogStatus status;
+	RecordFields fields;
+	MemStream ms;
+	Sink *sink;
+	size_t offset, walked;
+	unsigned long count;
+	int ret = 0, first = 1;
+
+	recordFieldsInit(&fields);
+	do
+	{
+		if (memStreamOpen(&ms))
+		{
+			ret = fail(result, _("failed to create a memory stream"));
+			break;
+		}
+
+		/* The file size record is only written at the beginning. */
+		sink = sinkCreateCsv(ms.fp, NULL);
+		if (first)
+			sink->begin(sink, log->hdr, log->file.length);
+
+		offset = log->offset;
+		walked = log->walked;
+		for (count = 0; count < VERIFY_BATCH_SIZE
+			&& (status = evtLogNext(log, &record)) == EVT_LOG_RECORD; count++)
+		{
+			recordDecode(&fields, record.rec,
+				record.nonFixed, record.nonFixedLength);
+			sink->write(sink, &fields);
+		}
+		sink->close(sink);
+
+		if (status == EVT_LOG_ERROR)
+			ret = fail(result, _("failed to read the log"));
+		else if (memStreamRewind(&ms))
+			ret = fail(result, _("failed to read a memory stream"));
+		else if (count || first)
+		{
+			/* Go through the same records again to compare them,
+			 * keeping track of how far we've got in the log. */
+			evtLogSeek(log, offset);
+			ret = compareBatch(log, ms.fp, first, result);
+			log->walked += walked;
+		}
+
+		memStreamClose(&ms);
+		first = 0;
+	}
+	while (!ret && status == EVT_LOG_RECORD);
+
+	recordFieldsDestroy(&fields);
+	return ret;
+}
+
+static int compareBatch (EvtLog *__restrict log, FILE *__restrict csv,
+	int first, VerifyResult *__restrict result)
+{
+	EvtLogRecord record;
+	EvtRecord rec;
+	Buffer nonFixed = BUFFER_INITIALIZER;
+	CsvReader rdr;
+	const char *error;
+	char *token, *end;
+	int field, ret = -1;
+
+	rdr = csvCreateReader(csv);
+	recordEncodeBegin(&rec, &nonFixed);
+	for (field = first ? -1 : 0; ; )
+	{
+		switch (csvRead(rdr, &token))
+		{
+		case CSV_FIELD:
+			if (field == -1)
+			{
+				if (strtoul(token, &end, 10) != log->file.length || *end)
+				{
+					fail(result, _("the file size doesn't match"));
+					free(token);
+					goto compareBatch_end;
+				}
+			}
+			else if (field == RECORD_FIELD_COUNT)
+			{
+				fail(result, _("record %lu: too many fields"),
+					result->records + 1);
+				free(token);
+				goto compareBatch_end;
+			}
+			else if (!field && !*token)
+			{
+				/* Empty lines are scanned as a single empty field. */
+				free(token);
+				break;
+			}
+			else if ((error = recordEncodeField(&rec, &nonFixed,
+				field, token, NULL)))
+			{
+				fail(result, _("record %lu: %s"), result->records + 1, error);
+				free(token);
+				goto compareBatch_end;
+			}
+			field++;
+			free(token);
+			break;
+		case CSV_EOR:
+			if (!field)
+				break;
+			if (field != RECORD_FIELD_COUNT)
+			{
+				fail(result, _("record %lu: missing fields"),
+					result->records + 1);
+				goto compareBatch_end;
+			}
+			field = 0;
+
+			recordEncodeEnd(&rec, &nonFixed);
+			if (evtLogNext(log, &record) != EVT_LOG_RECORD)
+			{
+				fail(result, _("there are more records in the CSV"));
+				goto compareBatch_end;
+			}
+			if ((error = compareRecords(&record, &rec, &nonFixed)))
+			{
+				fail(result, _("record %u differs in the %s"),
+					record.rec->recordNumber, error);
+				goto compareBatch_end;
+			}
+			result->records++;
+			recordEncodeBegin(&rec, &nonFixed);
+			break;
+		case CSV_EOF:
+			ret = 0;
+			goto compareBatch_end;
+		case CSV_ERROR:
+			fail(result, _("failed to parse the CSV"));
+			goto compareBatch_end;
+		}
+	}
+
+compareBatch_end:
+	csvDestroyReader(rdr);
+	bufferDestroy(&nonFixed);
+	return ret;
+}
+
+#if defined(HAVE_OPEN_MEMSTREAM) && defined(HAVE_FMEMOPEN)
+static int memStreamOpen (MemStream *ms)
+{
+	ms->data = NULL;
+	ms->length = 0;
+	return !(ms->fp = open_memstream(&ms->data, &ms->length)) ? -1 : 0;
+}
+
+static int memStreamRewind (MemStream *ms)
+{
+	if (fclose(ms->fp))
+	{
+		ms->fp = NULL;
+		return -1;
+	}
+	return !(ms->fp = fmemopen(ms->data, ms->length, "r")) ? -1 : 0;
+}
+
+static void memStreamClose (MemStream *ms)
+{
+	if (ms->fp)
+		fclose(ms->fp);
+	free(ms->data);
+}
+#else /* ! HAVE_OPEN_MEMSTREAM || ! HAVE_FMEMOPEN */
+/* A temporary file is the closest thing there is. */
+static int memStreamOpen (MemStream *ms)
+{
+	ms->data = NULL;
+	ms->length = 0;
+	return !(ms->fp = tmpfile()) ? -1 : 0;
+}
+
+static int memStreamRewind (MemStream *ms)
+{
+	return fflush(ms->fp) || fseek(ms->fp, 0, SEEK_SET) ? -1 : 0;
+}
+
+static void memStreamClose (MemStream *ms)
+{
+	fclose(ms->fp);
+}
+#endif /* ! HAVE_OPEN_MEMSTREAM || ! HAVE_FMEMOPEN */
+
+static size_t wideLength (const char *p, size_t length)
+{
+	size_t i;
+
+	for (i = 0; i + 1 < length; i += 2)
+		if (!p[i] && !p[i + 1])
+			return i + 2;
+	return length;
+}
+
+static void findParts (const EvtRecord *__restrict rec,
+	const char *__restrict nonFixed, size_t nonFixedLength,
+	RecordParts *__restrict parts)
+{
+	size_t offset, i;
+
+	parts->source = nonFixed;
+	parts->sourceLength = wideLength(nonFixed, nonFixedLength);
+	parts->computer = nonFixed + parts->sourceLength;
+	parts->computerLength = wideLength(parts->computer,
+		nonFixedLength - parts->sourceLength);
+
+	parts->sid = NULL;
+	parts->sidLength = 0;
+	offset = rec->userSidOffset - sizeof(EvtRecord);
+	if (rec->userSidLength && rec->userSidOffset >= sizeof(EvtRecord)
+		&& offset <= nonFixedLength
+		&& rec->userSidLength <= nonFixedLength - offset)
+	{
+		parts->sid = nonFixed + offset;
+		parts->sidLength = rec->userSidLength;
+	}
+
+	parts->strings = NULL;
+	parts->stringsLength = 0;
+	offset = rec->stringOffset - sizeof(EvtRecord);
+	if (rec->numStrings && rec->stringOffset >= sizeof(EvtRecord)
+		&& offset <= nonFixedLength)
+	{
+		parts->strings = nonFixed + offset;
+		for (i = 0; i < rec->numStrings; i++)
+			parts->stringsLength += wideLength(parts->strings
+				+ parts->stringsLength, nonFixedLength - offset
+				- parts->stringsLength);
+	}
+
+	parts->data = NULL;
+	parts->dataLength = 0;
+	offset = rec->dataOffset - sizeof(EvtRecord);
+	if (rec->dataLength && rec->dataOffset >= sizeof(EvtRecord)
+		&& offset <= nonFixedLength
+		&& rec->dataLength <= nonFixedLength - offset)
+	{
+		parts->data = nonFixed + offset;
+		parts->dataLength = rec->dataLength;
+	}
+}
+
+static int samePart (const char *a, size_t aLength,
+	const char *b, size_t bLength)
+{
+	return aLength == bLength && (!aLength || !memcmp(a, b, aLength));
+}
+
+static const char *compareRecords (const EvtLogRecord *__restrict original,
+	const EvtRecord *__restrict rec, const Buffer *__restrict nonFixed)
+{
+	const EvtRecord *orig = original->rec;
+	RecordParts a, b;
+
+	/* The fields go in the order of the CSV. */
+	if (orig->recordNumber != rec->recordNumber)
+		return _("record number");
+	if (orig->timeGenerated != rec->timeGenerated)
+		return _("time generated");
+	if (orig->timeWritten != rec->timeWritten)
+		return _("time written");
+	if (orig->eventID != rec->eventID)
+		return _("event ID");
+	if (orig->eventType != rec->eventType)
+		return _("event type");
+	if (orig->eventCategory != rec->eventCategory)
+		return _("event category");
+
+	findParts(orig, original->nonFixed, original->nonFixedLength, &a);
+	findParts(rec, nonFixed->data, nonFixed->used, &b);
+	if (!samePart(a.source, a.sourceLength, b.source, b.sourceLength))
+		return _("source name");
+	if (!samePart(a.computer, a.computerLength,
+		b.computer, b.computerLength))
+		return _("computer name");
+	if (!samePart(a.sid, a.sidLength, b.sid, b.sidLength))
+		return _("SID");
+	if (orig->numStrings != rec->numStrings
+		|| !samePart(a.strings, a.stringsLength, b.strings, b.stringsLength))
+		return _("strings");
+	if (!samePart(a.data, a.dataLength, b.data, b.dataLength))
+		return _("data");
+
+	/* These aren't stored in the CSV at all. */
+	if (orig->reservedFlags != rec->reservedFlags)
+		return _("reserved flags");
+	if (orig->closingRecordNumber != rec->closingRecordNumber)
+		return _("closing record number");
+
+	/* Everything else is about where the parts are put. */
+	if (orig->length != rec->length
+		|| original->nonFixedLength != nonFixed->used
+		|| memcmp(orig, rec, sizeof(EvtRecord))
+		|| memcmp(original->nonFixed, nonFixed->data, nonFixed->used))
+		return _("layout");
+	return NULL;
+}
@@ -0,0 +1,487 @@
+/**
+ *  @file evtwatch.c
+ *  @brief Converting .evt files to CSV as they arrive in a directory
+ *
+ *  Copyright Přemysl Janouch 2010. All rights reserved.
+ *  See the file LICENSE for licensing information.
+ *
+ *  Files are picked up once they've been closed after writing or moved
+ *  into the directory. Whatever has arrived in the meantime is converted
+ *  as a batch on a limited number of threads. Converted files are recorded
+ *  in a state file along with their size and modification time, so that
+ *  they aren't converted again after a restart unless they change.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+
+#include "configure.h"
+
+#include "xalloc.h"
+#include "datastruct.h"
+#include "evt.h"
+#include "mapfile.h"
+#include "evtlog.h"
+#include "acmatch.h"
+#include "fpset.h"
+#include "options.h"
+#include "record.h"
+#include "sink.h"
+#include "scan.h"
+#include "filter.h"
+#include "convert.h"
+#include "workers.h"
+
+
+/** The default name of the state file within the output directory. */
+#define EVTWATCH_STATE_NAME ".evtwatch"
+/** The size of the buffer for inotify events. */
+#define EVTWATCH_EVENT_BUFFER_SIZE 65536
+
+/** A file waiting to be converted. */
+typedef struct
+{
+	/** The name of the file within the watched directory. */
+	char *name;
+	/** The checkpoint to be recorded once the file has been converted. */
+	char *checkpoint;
+	/** Whether the conversion has succeeded. */
+	int ok;
+}
+WatchFile;
+
+/** The state of the watcher. */
+typedef struct
+{
+	/** The watched directory. */
+	const char *dir;
+	/** The directory to write CSV files to. */
+	const char *outputDir;
+	/** Checkpoints of files that have been converted. */
+	StringTable done;
+	/** The state file, open for appending. */
+	FILE *state;
+	/** Files waiting to be converted. */
+	WatchFile *queue;
+	/** The number of files in the queue. */
+	size_t queued;
+	/** The number of files the queue has space for. */
+	size_t queueAlloc;
+}
+Watcher;
+
+
+/** Print usage information. */
+static void printUsage (FILE *stream);
+
+/** Join a directory and a file name.
+ *  @return A newly allocated path.
+ */
+static char *joinPath (const char *__restrict dir, const char *__restrict name);
+
+/** Check whether a file name ends with ".evt", ignoring case. */
+static int isLogName (const char *name);
+
+/** Load checkpoints from the state file and open it for appending.
+ *  @return 0 on success, -1 on failure. An error message is printed.
+ */
+static int loadState (Watcher *__restrict w, const char *__restrict path);
+
+/** Queue a file to be converted unless it has been converted already
+ *  or is queued already.
+ */
+static void enqueue (Watcher *__restrict w, const char *__restrict name);
+
+/** Queue all files in the directory.
+ *  @return 0 on success, -1 on failure. An error message is printed.
+ */
+static int scanDirectory (Watcher *w);
+
+/** Convert the queued files and record their checkpoints.
+ *  @return 0 on success, -1 if the state file couldn't be written.
+ */
+static int processQueue (Watcher *w, unsigned nThreads);
+
+/** Convert a file, to be run by workersRun(). */
+static void convertJob (void *watcher, size_t index);
+
+/** Convert a log to a CSV file.
+ *  @return 0 on success, -1 on failure. An error message is printed.
+ */
+static int convertLog (const char *__restrict inputPath,
+	const char *__restrict outputPath);
+
+
+/** Command line options. */
+static const OptionSpec optionSpecs[] =
+{
+	{'j', "jobs", 1},
+	{'o', "output", 1},
+	{'s', "state", 1},
+	{'1', "once", 0},
+	{'h', "help", 0},
+	{0, NULL, 0}
+};
+
+
+int main (int argc, char *argv[])
+{
+	OptionsState opts = OPTIONS_INITIALIZER;
+	Watcher w;
+	const char *statePath = NULL;
+	char *defaultStatePath = NULL, *events, *p, *end;
+	struct inotify_event *event;
+	unsigned nThreads;
+	int opt, once = 0, fd = -1;
+	ssize_t length;
+
+#ifdef HAVE_GETTEXT
+    /* All we want is localized messages. */
+    setlocale(LC_MESSAGES, "");
+
+    bindtextdomain(GETTEXT_DOMAIN, GETTEXT_DIRNAME);
+    textdomain(GETTEXT_DOMAIN);
+#endif
+
+	memset(&w, 0, sizeof(w));
+	stringTableInit(&w.done);
+
+	nThreads = workersDefaultCount();
+	while ((opt = optionsNext(&opts, argc, argv, optionSpecs)) != OPTIONS_END)
+	{
+		switch (opt)
+		{
+		case 'j':
+			nThreads = strtoul(opts.arg, &end, 10);
+			if (!*opts.arg || *end || !nThreads)
+			{
+				fprintf(stderr, _("Error: Invalid number of jobs: %s.\n"),
+					opts.arg);
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case 'o':
+			w.outputDir = opts.arg;
+			break;
+		case 's':
+			statePath = opts.arg;
+			break;
+		case '1':
+			once = 1;
+			break;
+		case 'h':
+			printUsage(stdout);
+			exit(EXIT_SUCCESS);
+		default:
+			printUsage(stderr);
+			exit(EXIT_FAILURE);
+		}
+	}
+	argc -= opts.index;
+	argv += opts.index;
+
+	if (argc != 1)
+	{
+		printUsage(stderr);
+		exit(EXIT_FAILURE);
+	}
+
+	w.dir = argv[0];
+	if (!w.outputDir)
+		w.outputDir = w.dir;
+	if (!statePath)
+		statePath = defaultStatePath
+			= joinPath(w.outputDir, EVTWATCH_STATE_NAME);
+	if (loadState(&w, statePath))
+		exit(EXIT_FAILURE);
+
+	/* Start watching before the scan so that nothing slips through. */
+	if (!once && ((fd = inotify_init()) == -1
+		|| inotify_add_watch(fd, w.dir, IN_CLOSE_WRITE | IN_MOVED_TO) == -1))
+	{
+		fprintf(stderr, _("Error: Failed to watch %s: %s.\n"),
+			w.dir, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	if (scanDirectory(&w) || processQueue(&w, nThreads))
+		exit(EXIT_FAILURE);
+
+	/* Events that arrive during a batch wait in the kernel for the next one.
+	 * The buffer has to be suitably aligned for struct inotify_event. */
+	events = xmalloc(EVTWATCH_EVENT_BUFFER_SIZE);
+	while (!once)
+	{
+		if ((length = read(fd, events, EVTWATCH_EVENT_BUFFER_SIZE)) == -1)
+		{
+			if (errno == EINTR)
+				continue;
+			fprintf(stderr, _("Error: Failed to read events: %s.\n"),
+				strerror(errno));
+			exit(EXIT_FAILURE);
+		}
+
+		for (p = events; p < events + length;
+			p += sizeof(struct inotify_event) + event->len)
+		{
+			event = (struct inotify_event *) p;
+			if (event->mask & IN_Q_OVERFLOW)
+			{
+				/* Some events have been lost, look at everything. */
+				if (scanDirectory(&w))
+					exit(EXIT_FAILURE);
+			}
+			else if (event->len && !(event->mask & IN_ISDIR))
+				enqueue(&w, event->name);
+		}
+		if (processQueue(&w, nThreads))
+			exit(EXIT_FAILURE);
+	}
+
+	if (fd != -1)
+		close(fd);
+	free(events);
+	free(w.queue);
+	free(defaultStatePath);
+	stringTableDestroy(&w.done);
+	if (fclose(w.state))
+	{
+		fprintf(stderr, _("Error: Failed to write to %s.\n"), statePath);
+		exit(EXIT_FAILURE);
+	}
+	return 0;
+}
+
+static void printUsage (FILE *stream)
+{
+	fputs(_("Usage: evtwatch [-1] [-j jobs] [-o output-dir] [-s state-file] "
+		"directory\n"), stream);
+}
+
+static char *joinPath (const char *__restrict dir, const char *__restrict name)
+{
+	char *path;
+
+	path = xmalloc(strlen(dir) + strlen(name) + 2);
+	sprintf(path, "%s/%s", dir, name);
+	return path;
+}
+
+static int isLogName (const char *name)
+{
+	size_t length;
+
+	length = strlen(name);
+	return length > 4 && name[length - 4] == '.'
+		&& (name[length - 3] == 'e' || name[length - 3] == 'E')
+		&& (name[length - 2] == 'v' || name[length - 2] == 'V')
+		&& (name[length - 1] == 't' || name[length - 1] == 'T');
+}
+
+static int loadState (Watcher *__restrict w, const char *__restrict path)
+{
+	FILE *fp;
+	Buffer line;
+	int c;
+
+	/* The state file doesn't have to exist yet. */
+	if ((fp = fopen(path, "rb")))
+	{
+		bufferInit(&line);
+		do
+		{
+			if ((c = getc(fp)) != EOF && c != '\n')
+			{
+				bufferAppendChar(&line, c);
+				continue;
+			}
+			if (line.used)
+			{
+				bufferAppendChar(&line, '\0');
+				stringTableIntern(&w->done, line.data, NULL);
+				bufferClear(&line);
+			}
+		}
+		while (c != EOF);
+		bufferDestroy(&line);
+		fclose(fp);
+	}
+
+	if (!(w->state = fopen(path, "ab")))
+	{
+		fprintf(stderr, _("Error: Failed to open %s for writing.\n"), path);
+		return -1;
+	}
+	return 0;
+}
+
+static void enqueue (Watcher *__restrict w, const char *__restrict name)
+{
+	struct stat st;
+	char *path, *checkpoint;
+	size_t i;
+
+	if (!isLogName(name))
+		return;
+
+	path = joinPath(w->dir, name);
+	if (stat(path, &st) || !S_ISREG(st.st_mode))
+	{
+		free(path);
+		return;
+	}
+	free(path);
+
+	/* Files are told apart by their name, size and modification time. */
+	checkpoint = xmalloc(strlen(name) + 48);
+	sprintf(checkpoint, "%llu\t%lld\t%s", (unsigned long long) st.st_size,
+		(long long) st.st_mtime, name);
+	if (stringTableFind(&w->done, checkpoint))
+	{
+		free(checkpoint);
+		return;
+	}
+
+	for (i = 0; i < w->queued; i++)
+	{
+		if (!strcmp(w->queue[i].name, name))
+		{
+			free(w->queue[i].checkpoint);
+			w->queue[i].checkpoint = checkpoint;
+			return;
+		}
+	}
+
+	if (w->queued == w->queueAlloc)
+	{
+		w->queueAlloc = w->queueAlloc ? w->queueAlloc * 2 : 16;
+		w->queue = xrealloc(w->queue, w->queueAlloc * sizeof(WatchFile));
+	}
+	w->queue[w->queued].name = xmalloc(strlen(name) + 1);
+	strcpy(w->queue[w->queued].name, name);
+	w->queue[w->queued].checkpoint = checkpoint;
+	w->queue[w->queued].ok = 0;
+	w->queued++;
+}
+
+static int scanDirectory (Watcher *w)
+{
+	DIR *dir;
+	struct dirent *entry;
+
+	if (!(dir = opendir(w->dir)))
+	{
+		fprintf(stderr, _("Error: Failed to open %s: %s.\n"),
+			w->dir, strerror(errno));
+		return -1;
+	}
+	while ((entry = readdir(dir)))
+		enqueue(w, entry->d_name);
+	closedir(dir);
+	return 0;
+}
+
+static int processQueue (Watcher *w, unsigned nThreads)
+{
+	WatchFile *file;
+	size_t i;
+
+	if (!w->queued)
+		return 0;
+	workersRun(convertJob, w, w->queued, nThreads);
+
+	for (i = 0; i < w->queued; i++)
+	{
+		file = &w->queue[i];
+		if (file->ok)
+		{
+			fprintf(w->state, "%s\n", file->checkpoint);
+			stringTableIntern(&w->done, file->checkpoint, NULL);
+			printf("%s\n", file->name);
+		}
+		free(file->name);
+		free(file->checkpoint);
+	}
+	w->queued = 0;
+	fflush(stdout);
+
+	if (fflush(w->state))
+	{
+		fprintf(stderr, _("Error: Failed to write the state file.\n"));
+		return -1;
+	}
+	return 0;
+}
+
+static void convertJob (void *watcher, size_t index)
+{
+	Watcher *w = watcher;
+	WatchFile *file = &w->queue[index];
+	char *inputPath, *outputPath, *partPath;
+	size_t length;
+
+	inputPath = joinPath(w->dir, file->name);
+	outputPath = joinPath(w->outputDir, file->name);
+	length = strlen(outputPath);
+	strcpy(outputPath + length - 4, ".csv");
+
+	/* Readers never see a partially written output. */
+	partPath = xmalloc(length + sizeof(".part"));
+	sprintf(partPath, "%s.part", outputPath);
+	if (!convertLog(inputPath, partPath))
+	{
+		if (rename(partPath, outputPath))
+			fprintf(stderr, _("Error: Failed to rename %s to %s: %s.\n"),
+				partPath, outputPath, strerror(errno));
+		else
+			file->ok = 1;
+	}
+	if (!file->ok)
+		remove(partPath);
+
+	free(inputPath);
+	free(outputPath);
+	free(partPath);
+}
+
+static int convertLog (const char *__restrict inputPath,
+	const char *__restrict outputPath)
+{
+	Conversion conv;
+	EvtLog log;
+	FILE *output;
+	int ret;
+
+	if (evtLogOpen(&log, inputPath))
+		return -1;
+	if (!(output = fopen(outputPath, "wb")))
+	{
+		fprintf(stderr, _("Error: Failed to open %s for writing.\n"),
+			outputPath);
+		evtLogClose(&log);
+		return -1;
+	}
+
+	conversionInit(&conv);
+	conv.sink = sinkCreateCsv(output, NULL);
+	ret = conversionRun(&conv, &log);
+	conversionDestroy(&conv);
+	if (conv.sink->close(conv.sink))
+		ret = -1;
+	evtLogClose(&log);
+
+	if (fclose(output))
+	{
+		fprintf(stderr, _("Error: Failed to write to %s.\n"), outputPath);
+		ret = -1;
+	}
+	return ret;
+}
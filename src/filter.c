@@ -0,0 +1,961 @@
+/**
+ *  @file filter.c
+ *  @brief Compiled filter expressions.
+ *
+ *  Copyright Přemysl Janouch 2010. All rights reserved.
+ *  See the file LICENSE for licensing information.
+ *
+ */
+
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "configure.h"
+
+#include "xalloc.h"
+#include "datastruct.h"
+#include "evt.h"
+#include "widechar.h"
+#include "mapfile.h"
+#include "evtlog.h"
+#include "acmatch.h"
+#include "timeconv.h"
+#include "record.h"
+#include "scan.h"
+#include "filter.h"
+
+
+/** Characters that end a word. */
+#define FILTER_DELIMITERS " \t\r\n(){},=!<>~'\""
+
+/** Kinds of nodes of an expression. */
+typedef enum
+{
+	NODE_AND,
+	NODE_OR,
+	NODE_NOT,
+	/** A test of a fixed field. */
+	NODE_FIXED,
+	/** A test of a variable field. */
+	NODE_TEXT
+}
+NodeKind;
+
+/** Variable fields that may be tested, from the cheapest one. */
+typedef enum
+{
+	TEXT_SOURCE,
+	TEXT_COMPUTER,
+	TEXT_STRINGS,
+	TEXT_FIELD_COUNT
+}
+TextField;
+
+/** How expensive it is to evaluate a node. */
+enum
+{
+	COST_FIXED,
+	COST_NAMES,
+	COST_STRINGS
+};
+
+/** A node of an expression. */
+typedef struct FilterNode FilterNode;
+
+struct FilterNode
+{
+	/** What the node does. */
+	NodeKind kind;
+	/** How expensive it is to evaluate the node. */
+	int cost;
+
+	/** Operands of a logical operator. */
+	FilterNode **children;
+	/** The number of @a children. */
+	size_t nChildren;
+
+	/** The fixed field to test. */
+	ScanField field;
+	/** How to compare the fixed field. */
+	ScanCompare compare;
+	/** The value to compare the fixed field with. */
+	uint32_t value;
+
+	/** The variable field to test. */
+	TextField text;
+	/** The value in UTF-16, to be compared with the whole field. */
+	uint16_t *pattern;
+	/** The length of @a pattern in characters. */
+	size_t length;
+	/** Whether the field has to contain the value rather than equal it. */
+	int contains;
+	/** Searches for @a pattern, unless it's empty. */
+	AcMatcher matcher;
+};
+
+struct FilterPlan
+{
+	/** What's left to test record by record, or NULL if nothing. */
+	FilterNode *root;
+	/** Whether the expression depends on the time it's compiled at. */
+	int relative;
+};
+
+/** A field that may appear in expressions. */
+typedef struct
+{
+	/** The name of the field. */
+	const char *name;
+	/** Whether it's a fixed field. */
+	int fixed;
+	/** Which field it is. */
+	int field;
+}
+FieldName;
+
+/** The state of the parser. */
+typedef struct
+{
+	/** Where we are in the expression. */
+	const char *p;
+	/** A description of the problem, or NULL. */
+	const char *error;
+	/** Where the problem has been found. */
+	const char *errorAt;
+	/** Where the last value starts. */
+	const char *valueAt;
+	/** The time the expression is compiled at. */
+	time_t now;
+	/** Whether @a now has been used. */
+	int relative;
+	/** Storage for values. */
+	Buffer value;
+}
+Parser;
+
+/** Variable fields being tested, located in a record. */
+typedef struct
+{
+	/** The record. */
+	const EvtLogRecord *record;
+	/** Where each field begins, or NULL if not located yet. */
+	const uint16_t *text[TEXT_FIELD_COUNT];
+	/** The length of each field in characters. */
+	size_t length[TEXT_FIELD_COUNT];
+}
+TestedRecord;
+
+
+static const FieldName fieldNames[] =
+{
+	{"record",   1, SCAN_RECORD_NUMBER},
+	{"time",     1, SCAN_TIME_GENERATED},
+	{"written",  1, SCAN_TIME_WRITTEN},
+	{"id",       1, SCAN_EVENT_ID},
+	{"eventid",  1, SCAN_EVENT_ID},
+	{"type",     1, SCAN_EVENT_TYPE},
+	{"category", 1, SCAN_EVENT_CATEGORY},
+	{"source",   0, TEXT_SOURCE},
+	{"computer", 0, TEXT_COMPUTER},
+	{"strings",  0, TEXT_STRINGS}
+};
+
+
+/** Create a node. */
+static FilterNode *createNode (NodeKind kind);
+/** Add an operand to a logical operator. */
+static void addChild (FilterNode *__restrict node,
+	FilterNode *__restrict child);
+/** Destroy a node along with its operands. */
+static void destroyNode (FilterNode *node);
+
+/** Skip whitespace and find out whether a word comes next. */
+static int isWordNext (Parser *__restrict parser,
+	const char *__restrict word);
+/** Skip whitespace and the given character if it comes next. */
+static int skipChar (Parser *parser, char c);
+/** Record a problem at the current position. */
+static FilterNode *parseError (Parser *__restrict parser,
+	const char *__restrict message);
+
+/** Parse operands of "or". */
+static FilterNode *parseOr (Parser *parser);
+/** Parse operands of "and". */
+static FilterNode *parseAnd (Parser *parser);
+/** Parse "not" and what follows. */
+static FilterNode *parseNot (Parser *parser);
+/** Parse a condition, possibly in parentheses. */
+static FilterNode *parseCondition (Parser *parser);
+/** Parse a value into @a parser->value, NUL-terminated.
+ *  @return 0 on success, -1 on failure.
+ */
+static int parseValue (Parser *parser);
+/** Parse a set of values to compare a field with. */
+static FilterNode *parseSet (Parser *__restrict parser,
+	const FieldName *__restrict field);
+/** Make a test of a field out of @a parser->value. */
+static FilterNode *makeTest (Parser *__restrict parser,
+	const FieldName *__restrict field, const char *__restrict op);
+/** Make a test of a fixed field. */
+static FilterNode *makeFixedTest (Parser *__restrict parser,
+	ScanField field, ScanCompare compare);
+/** Make a test of a variable field. */
+static FilterNode *makeTextTest (Parser *__restrict parser,
+	TextField text, int contains);
+
+/** Add the tests in a node to a ScanFilter. */
+static void emitScan (const FilterNode *__restrict node,
+	ScanFilter *__restrict scan);
+/** Add a node to a ScanFilter in conjunction with what's in it. */
+static void addToScan (const FilterNode *__restrict node,
+	ScanFilter *__restrict scan);
+/** Order the operands of logical operators from the cheapest one. */
+static void sortByCost (FilterNode *node);
+
+/** Evaluate a node for a record. */
+static int evaluate (const FilterNode *__restrict node,
+	TestedRecord *__restrict tested);
+/** Locate a variable field in a record. */
+static void locateText (TestedRecord *tested, TextField text);
+/** Compare UTF-16 strings, ignoring the case of Latin letters. */
+static int equalsFolded (const uint16_t *__restrict a,
+	const uint16_t *__restrict b, size_t length);
+/** Check whether any of the description strings equals the pattern. */
+static int anyStringEquals (const FilterNode *__restrict node,
+	const TestedRecord *__restrict tested);
+
+
+static FilterNode *createNode (NodeKind kind)
+{
+	FilterNode *node;
+
+	node = xmalloc(sizeof(FilterNode));
+	memset(node, 0, sizeof(FilterNode));
+	node->kind = kind;
+	return node;
+}
+
+static void addChild (FilterNode *__restrict node,
+	FilterNode *__restrict child)
+{
+	node->children = xrealloc(node->children,
+		(node->nChildren + 1) * sizeof(FilterNode *));
+	node->children[node->nChildren++] = child;
+	if (child->cost > node->cost)
+		node->cost = child->cost;
+}
+
+static void destroyNode (FilterNode *node)
+{
+	size_t i;
+
+	if (!node)
+		return;
+	for (i = 0; i < node->nChildren; i++)
+		destroyNode(node->children[i]);
+	free(node->children);
+	free(node->pattern);
+	if (node->matcher)
+		acDestroyMatcher(node->matcher);
+	free(node);
+}
+
+static int isWordNext (Parser *__restrict parser,
+	const char *__restrict word)
+{
+	size_t length, i;
+
+	parser->p += strspn(parser->p, " \t\r\n");
+	length = strcspn(parser->p, FILTER_DELIMITERS);
+	if (length != strlen(word))
+		return 0;
+
+	/* Keywords and field names ignore case. */
+	for (i = 0; i < length; i++)
+	{
+		char c = parser->p[i];
+
+		if (c >= 'A' && c <= 'Z')
+			c += 'a' - 'A';
+		if (c != word[i])
+			return 0;
+	}
+	return 1;
+}
+
+static int skipChar (Parser *parser, char c)
+{
+	parser->p += strspn(parser->p, " \t\r\n");
+	if (*parser->p != c)
+		return 0;
+	parser->p++;
+	return 1;
+}
+
+static FilterNode *parseError (Parser *__restrict parser,
+	const char *__restrict message)
+{
+	if (!parser->error)
+	{
+		parser->error = message;
+		parser->errorAt = parser->p;
+	}
+	return NULL;
+}
+
+FilterPlan *filterCompile (const char *__restrict expression,
+	ScanFilter *__restrict scan)
+{
+	Parser parser;
+	FilterPlan *plan;
+	FilterNode *root, *rest;
+	size_t i;
+
+	parser.p = expression;
+	parser.error = NULL;
+	parser.now = time(NULL);
+	parser.relative = 0;
+	bufferInit(&parser.value);
+
+	if ((root = parseOr(&parser)))
+	{
+		parser.p += strspn(parser.p, " \t\r\n");
+		if (*parser.p)
+		{
+			parseError(&parser, _("Unexpected input"));
+			destroyNode(root);
+			root = NULL;
+		}
+	}
+	bufferDestroy(&parser.value);
+
+	if (!root)
+	{
+		if (*parser.errorAt)
+			fprintf(stderr, _("Error: Invalid filter: %s at \"%s\".\n"),
+				parser.error, parser.errorAt);
+		else
+			fprintf(stderr, _("Error: Invalid filter: %s at the end.\n"),
+				parser.error);
+		return NULL;
+	}
+
+	/* Conditions on fixed fields that have to hold for every record
+	 * are tested on whole batches. */
+	rest = NULL;
+	if (root->cost == COST_FIXED)
+	{
+		addToScan(root, scan);
+		destroyNode(root);
+	}
+	else if (root->kind == NODE_AND)
+	{
+		rest = createNode(NODE_AND);
+		for (i = 0; i < root->nChildren; i++)
+		{
+			if (root->children[i]->cost != COST_FIXED)
+			{
+				addChild(rest, root->children[i]);
+				continue;
+			}
+			addToScan(root->children[i], scan);
+			destroyNode(root->children[i]);
+		}
+		root->nChildren = 0;
+		destroyNode(root);
+
+		if (rest->nChildren == 1)
+		{
+			root = rest;
+			rest = rest->children[0];
+			root->nChildren = 0;
+			destroyNode(root);
+		}
+	}
+	else
+		rest = root;
+
+	if (rest)
+		sortByCost(rest);
+
+	plan = xmalloc(sizeof(FilterPlan));
+	plan->root = rest;
+	plan->relative = parser.relative;
+	return plan;
+}
+
+static FilterNode *parseOr (Parser *parser)
+{
+	FilterNode *left, *right, *node;
+
+	if (!(left = parseAnd(parser)))
+		return NULL;
+	if (!isWordNext(parser, "or"))
+		return left;
+
+	node = createNode(NODE_OR);
+	addChild(node, left);
+	while (isWordNext(parser, "or"))
+	{
+		parser->p += 2;
+		if (!(right = parseAnd(parser)))
+		{
+			destroyNode(node);
+			return NULL;
+		}
+		addChild(node, right);
+	}
+	return node;
+}
+
+static FilterNode *parseAnd (Parser *parser)
+{
+	FilterNode *left, *right, *node;
+
+	if (!(left = parseNot(parser)))
+		return NULL;
+	if (!isWordNext(parser, "and"))
+		return left;
+
+	node = createNode(NODE_AND);
+	addChild(node, left);
+	while (isWordNext(parser, "and"))
+	{
+		parser->p += 3;
+		if (!(right = parseNot(parser)))
+		{
+			destroyNode(node);
+			return NULL;
+		}
+		addChild(node, right);
+	}
+	return node;
+}
+
+static FilterNode *parseNot (Parser *parser)
+{
+	FilterNode *child, *node;
+
+	if (!isWordNext(parser, "not"))
+		return parseCondition(parser);
+
+	parser->p += 3;
+	if (!(child = parseNot(parser)))
+		return NULL;
+	node = createNode(NODE_NOT);
+	addChild(node, child);
+	return node;
+}
+
+static FilterNode *parseCondition (Parser *parser)
+{
+	static const char *ops[] = {"==", "!=", "<=", ">=", "!~",
+		"=", "<", ">", "~", NULL};
+	const FieldName *field = NULL;
+	FilterNode *node;
+	size_t i;
+
+	if (skipChar(parser, '('))
+	{
+		if (!(node = parseOr(parser)))
+			return NULL;
+		if (!skipChar(parser, ')'))
+		{
+			destroyNode(node);
+			return parseError(parser, _("Expected \")\""));
+		}
+		return node;
+	}
+
+	for (i = 0; i < sizeof(fieldNames) / sizeof(fieldNames[0]); i++)
+		if (isWordNext(parser, fieldNames[i].name))
+			field = &fieldNames[i];
+	if (!field)
+		return parseError(parser, _("Expected a field name"));
+	parser->p += strlen(field->name);
+
+	if (isWordNext(parser, "in"))
+	{
+		parser->p += 2;
+		return parseSet(parser, field);
+	}
+
+	parser->p += strspn(parser->p, " \t\r\n");
+	for (i = 0; ops[i]; i++)
+		if (!strncmp(parser->p, ops[i], strlen(ops[i])))
+			break;
+	if (!ops[i])
+		return parseError(parser, _("Expected an operator"));
+	parser->p += strlen(ops[i]);
+
+	if (parseValue(parser))
+		return NULL;
+	return makeTest(parser, field, ops[i]);
+}
+
+static int parseValue (Parser *parser)
+{
+	const char *start, *end;
+	char quote;
+	size_t length;
+
+	bufferClear(&parser->value);
+	parser->p += strspn(parser->p, " \t\r\n");
+	parser->valueAt = parser->p;
+
+	if (*parser->p == '\'' || *parser->p == '"')
+	{
+		quote = *parser->p++;
+		if (!(end = strchr(parser->p, quote)))
+		{
+			parseError(parser, _("Unterminated string"));
+			return -1;
+		}
+		bufferAppend(&parser->value, parser->p, end - parser->p, 0);
+		bufferAppendChar(&parser->value, '\0');
+		parser->p = end + 1;
+		return 0;
+	}
+
+	/* A run of words up to a keyword, joined with single spaces. */
+	start = parser->p;
+	while ((length = strcspn(parser->p, FILTER_DELIMITERS))
+		&& !isWordNext(parser, "and") && !isWordNext(parser, "or"))
+	{
+		if (parser->p != start)
+			bufferAppendChar(&parser->value, ' ');
+		bufferAppend(&parser->value, parser->p, length, 0);
+		parser->p += length;
+		parser->p += strspn(parser->p, " \t\r\n");
+	}
+
+	if (!parser->value.used)
+	{
+		parseError(parser, _("Expected a value"));
+		return -1;
+	}
+	bufferAppendChar(&parser->value, '\0');
+	return 0;
+}
+
+static FilterNode *parseSet (Parser *__restrict parser,
+	const FieldName *__restrict field)
+{
+	static const char units[] = "smhdw";
+	static const unsigned long multipliers[] = {1, 60, 3600, 86400, 604800};
+	FilterNode *node, *test;
+	unsigned long length;
+	const char *unit;
+	char *end;
+
+	/* Records generated since some time ago. */
+	if (field->fixed && field->field == SCAN_TIME_GENERATED
+		&& isWordNext(parser, "last"))
+	{
+		parser->p += 4;
+		parser->p += strspn(parser->p, " \t\r\n");
+		if (*parser->p < '0' || *parser->p > '9')
+			return parseError(parser, _("Expected a duration"));
+		errno = 0;
+		length = strtoul(parser->p, &end, 10);
+		if (errno == ERANGE)
+			return parseError(parser, _("Duration too long"));
+		parser->p = end;
+		if (!*parser->p || !(unit = strchr(units, *parser->p)))
+			return parseError(parser, _("Expected a unit of time"));
+		if (length > ULONG_MAX / multipliers[unit - units])
+			return parseError(parser, _("Duration too long"));
+		length *= multipliers[unit - units];
+		parser->p++;
+
+		node = createNode(NODE_FIXED);
+		node->field = SCAN_TIME_GENERATED;
+		node->compare = SCAN_GE;
+		node->value = (unsigned long) parser->now > length
+			? parser->now - length : 0;
+		parser->relative = 1;
+		return node;
+	}
+
+	if (!skipChar(parser, '{'))
+		return parseError(parser, _("Expected \"{\""));
+
+	node = createNode(NODE_OR);
+	do
+	{
+		if (parseValue(parser) || !(test = makeTest(parser, field, "=")))
+		{
+			destroyNode(node);
+			return NULL;
+		}
+		addChild(node, test);
+	}
+	while (skipChar(parser, ','));
+
+	if (!skipChar(parser, '}'))
+	{
+		destroyNode(node);
+		return parseError(parser, _("Expected \"}\""));
+	}
+	return node;
+}
+
+static FilterNode *makeTest (Parser *__restrict parser,
+	const FieldName *__restrict field, const char *__restrict op)
+{
+	static const struct
+	{
+		const char *op;
+		ScanCompare compare;
+	}
+	compares[] =
+	{
+		{"=", SCAN_EQ}, {"==", SCAN_EQ}, {"!=", SCAN_NE},
+		{"<", SCAN_LT}, {"<=", SCAN_LE}, {">", SCAN_GT}, {">=", SCAN_GE}
+	};
+	FilterNode *node, *negated;
+	size_t i;
+
+	if (field->fixed)
+	{
+		for (i = 0; i < sizeof(compares) / sizeof(compares[0]); i++)
+			if (!strcmp(compares[i].op, op))
+				return makeFixedTest(parser, field->field,
+					compares[i].compare);
+		return parseError(parser, _("Fixed fields can't be searched"));
+	}
+
+	if (!strcmp(op, "=") || !strcmp(op, "=="))
+		return makeTextTest(parser, field->field, 0);
+	if (!strcmp(op, "~"))
+		return makeTextTest(parser, field->field, 1);
+	if (strcmp(op, "!=") && strcmp(op, "!~"))
+		return parseError(parser, _("Text can't be compared by order"));
+
+	if (!(negated = makeTextTest(parser, field->field, op[1] == '~')))
+		return NULL;
+	node = createNode(NODE_NOT);
+	addChild(node, negated);
+	return node;
+}
+
+static FilterNode *makeFixedTest (Parser *__restrict parser,
+	ScanField field, ScanCompare compare)
+{
+	const char *value = parser->value.data;
+	FilterNode *node;
+	unsigned long long number;
+	const char *name;
+	unsigned type;
+	time_t t;
+	char *end;
+
+	number = strtoull(value, &end, 10);
+	if (*end || end == value)
+	{
+		number = (unsigned long long) -1;
+		if (field == SCAN_EVENT_TYPE)
+		{
+			/* Type names ignore case, too. */
+			for (type = 1; type <= EVT_AUDIT_FAILURE; type <<= 1)
+			{
+				size_t i;
+
+				if (!(name = recordTypeName(type))
+					|| strlen(name) != strlen(value))
+					continue;
+				for (i = 0; name[i]; i++)
+					if ((name[i] | 0x20) != (value[i] | 0x20))
+						break;
+				if (!name[i])
+					number = type;
+			}
+		}
+		else if ((field == SCAN_TIME_GENERATED
+			|| field == SCAN_TIME_WRITTEN)
+			&& (t = parseTime(value)) != -1)
+			number = t;
+	}
+	if (number > UINT32_MAX)
+	{
+		parser->p = parser->valueAt;
+		return parseError(parser, _("Invalid value"));
+	}
+
+	node = createNode(NODE_FIXED);
+	node->field = field;
+	node->compare = compare;
+	node->value = number;
+	return node;
+}
+
+static FilterNode *makeTextTest (Parser *__restrict parser,
+	TextField text, int contains)
+{
+	FilterNode *node;
+	Buffer wide;
+	int offset;
+
+	bufferInit(&wide);
+	if ((offset = encodeMBStringToBuffer(parser->value.data, &wide)) == -1)
+	{
+		bufferDestroy(&wide);
+		parser->p = parser->valueAt;
+		return parseError(parser, _("Failed to convert a value"));
+	}
+
+	node = createNode(NODE_TEXT);
+	node->cost = text == TEXT_STRINGS ? COST_STRINGS : COST_NAMES;
+	node->text = text;
+	node->contains = contains;
+
+	/* Leave out the terminating NULL char. */
+	node->length = (wide.used - offset) / sizeof(uint16_t) - 1;
+	node->pattern = xmalloc((node->length + 1) * sizeof(uint16_t));
+	memcpy(node->pattern, (char *) wide.data + offset,
+		node->length * sizeof(uint16_t));
+	bufferDestroy(&wide);
+
+	if (contains && node->length)
+	{
+		node->matcher = acCreateMatcher(1);
+		acAddPattern(node->matcher, node->pattern, node->length);
+		acCompile(node->matcher);
+	}
+	return node;
+}
+
+static void emitScan (const FilterNode *__restrict node,
+	ScanFilter *__restrict scan)
+{
+	size_t i;
+
+	switch (node->kind)
+	{
+	case NODE_FIXED:
+		scanFilterTest(scan, node->field, node->compare, node->value);
+		break;
+	case NODE_NOT:
+		emitScan(node->children[0], scan);
+		scanFilterOperator(scan, SCAN_NOT);
+		break;
+	case NODE_AND:
+	case NODE_OR:
+		for (i = 0; i < node->nChildren; i++)
+		{
+			emitScan(node->children[i], scan);
+			if (i)
+				scanFilterOperator(scan,
+					node->kind == NODE_AND ? SCAN_AND : SCAN_OR);
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+static void addToScan (const FilterNode *__restrict node,
+	ScanFilter *__restrict scan)
+{
+	int conjunction = !scanFilterIsEmpty(scan);
+
+	emitScan(node, scan);
+	if (conjunction)
+		scanFilterOperator(scan, SCAN_AND);
+}
+
+static void sortByCost (FilterNode *node)
+{
+	FilterNode *child;
+	size_t i, k;
+
+	for (i = 0; i < node->nChildren; i++)
+		sortByCost(node->children[i]);
+
+	/* Insertion sort keeps the original order among equals. */
+	for (i = 1; i < node->nChildren; i++)
+	{
+		child = node->children[i];
+		for (k = i; k && node->children[k - 1]->cost > child->cost; k--)
+			node->children[k] = node->children[k - 1];
+		node->children[k] = child;
+	}
+}
+
+int filterIsEmpty (const FilterPlan *plan)
+{
+	return !plan->root;
+}
+
+int filterIsRelative (const FilterPlan *plan)
+{
+	return plan->relative;
+}
+
+int filterMatches (const FilterPlan *__restrict plan,
+	const EvtLogRecord *__restrict record)
+{
+	TestedRecord tested;
+
+	if (!plan->root)
+		return 1;
+
+	memset(&tested, 0, sizeof(tested));
+	tested.record = record;
+	return evaluate(plan->root, &tested);
+}
+
+static int evaluate (const FilterNode *__restrict node,
+	TestedRecord *__restrict tested)
+{
+	const EvtRecord *rec = tested->record->rec;
+	uint32_t value = 0;
+	size_t i;
+
+	switch (node->kind)
+	{
+	case NODE_AND:
+		for (i = 0; i < node->nChildren; i++)
+			if (!evaluate(node->children[i], tested))
+				return 0;
+		return 1;
+	case NODE_OR:
+		for (i = 0; i < node->nChildren; i++)
+			if (evaluate(node->children[i], tested))
+				return 1;
+		return 0;
+	case NODE_NOT:
+		return !evaluate(node->children[0], tested);
+	case NODE_FIXED:
+		switch (node->field)
+		{
+		case SCAN_RECORD_NUMBER:  value = rec->recordNumber;  break;
+		case SCAN_TIME_GENERATED: value = rec->timeGenerated; break;
+		case SCAN_TIME_WRITTEN:   value = rec->timeWritten;   break;
+		case SCAN_EVENT_ID:       value = rec->eventID;       break;
+		case SCAN_EVENT_TYPE:     value = rec->eventType;     break;
+		case SCAN_EVENT_CATEGORY: value = rec->eventCategory; break;
+		default:                                              break;
+		}
+		switch (node->compare)
+		{
+		case SCAN_EQ: return value == node->value;
+		case SCAN_NE: return value != node->value;
+		case SCAN_LT: return value <  node->value;
+		case SCAN_LE: return value <= node->value;
+		case SCAN_GT: return value >  node->value;
+		case SCAN_GE: return value >= node->value;
+		}
+		return 0;
+	case NODE_TEXT:
+		if (!tested->text[node->text])
+			locateText(tested, node->text);
+		if (node->contains)
+			return !node->length || acSearch(node->matcher,
+				tested->text[node->text], tested->length[node->text]);
+		if (node->text == TEXT_STRINGS)
+			return anyStringEquals(node, tested);
+		return tested->length[node->text] == node->length
+			&& equalsFolded(tested->text[node->text],
+				node->pattern, node->length);
+	}
+	return 0;
+}
+
+static void locateText (TestedRecord *tested, TextField text)
+{
+	const EvtLogRecord *record = tested->record;
+	const EvtRecord *rec = record->rec;
+	const uint16_t *p, *end;
+	size_t start, stop;
+
+	p = record->nonFixed;
+	end = p + record->nonFixedLength / sizeof(uint16_t);
+
+	switch (text)
+	{
+	case TEXT_SOURCE:
+	case TEXT_COMPUTER:
+		/* The names follow each other right after the fixed part. */
+		tested->text[TEXT_SOURCE] = p;
+		while (p < end && *p)
+			p++;
+		tested->length[TEXT_SOURCE] = p - tested->text[TEXT_SOURCE];
+
+		if (p < end)
+			p++;
+		tested->text[TEXT_COMPUTER] = p;
+		while (p < end && *p)
+			p++;
+		tested->length[TEXT_COMPUTER] = p - tested->text[TEXT_COMPUTER];
+		break;
+	case TEXT_STRINGS:
+		/* Just like when matching patterns, the strings are taken
+		 * as a single block. */
+		tested->text[TEXT_STRINGS] = p;
+		tested->length[TEXT_STRINGS] = 0;
+		if (rec->stringOffset < sizeof(EvtRecord) || !rec->numStrings
+			|| record->nonFixedLength < sizeof(uint32_t))
+			break;
+		start = rec->stringOffset - sizeof(EvtRecord);
+		stop = record->nonFixedLength - sizeof(uint32_t);
+		if (rec->dataOffset >= rec->stringOffset
+			&& rec->dataOffset - sizeof(EvtRecord) < stop)
+			stop = rec->dataOffset - sizeof(EvtRecord);
+		if (start >= stop)
+			break;
+
+		tested->text[TEXT_STRINGS] = (const uint16_t *)
+			((const char *) record->nonFixed + start);
+		tested->length[TEXT_STRINGS] = (stop - start) / sizeof(uint16_t);
+		break;
+	default:
+		break;
+	}
+}
+
+static int equalsFolded (const uint16_t *__restrict a,
+	const uint16_t *__restrict b, size_t length)
+{
+	uint16_t ca, cb;
+
+	while (length--)
+	{
+		ca = *a++;
+		cb = *b++;
+		if (ca != cb && acFoldUnit(ca) != acFoldUnit(cb))
+			return 0;
+	}
+	return 1;
+}
+
+static int anyStringEquals (const FilterNode *__restrict node,
+	const TestedRecord *__restrict tested)
+{
+	const uint16_t *p, *end, *string;
+	uint32_t i;
+
+	/* The last string may be followed by padding or cut short. */
+	p = tested->text[TEXT_STRINGS];
+	end = p + tested->length[TEXT_STRINGS];
+	for (i = 0; i < tested->record->rec->numStrings && p < end; i++)
+	{
+		for (string = p; p < end && *p; p++)
+			;
+		if ((size_t) (p - string) == node->length
+			&& equalsFolded(string, node->pattern, node->length))
+			return 1;
+		p++;
+	}
+	return 0;
+}
+
+void filterDestroy (FilterPlan *plan)
+{
+	destroyNode(plan->root);
+	free(plan);
+}
@@ -0,0 +1,81 @@
+/**
+ *  @file filter.h
+ *  @brief Compiled filter expressions.
+ *
+ *  Copyright Přemysl Janouch 2010. All rights reserved.
+ *  See the file LICENSE for licensing information.
+ *
+ *  An expression such as
+ *
+ *    id in {4624, 4625} and type = "Audit Failure"
+ *    and source ~ Security and time in last 24h
+ *
+ *  is compiled into a plan that tests records in their binary form, before
+ *  anything in them is decoded. Conditions on fixed fields that all records
+ *  have to satisfy go into a ScanFilter and are tested on whole batches
+ *  of records, see scan.h. The rest is tested record by record, with
+ *  the operands of every "and" and "or" reordered so that the cheap ones
+ *  go first: fixed fields, then the source and computer names, then
+ *  the description strings.
+ *
+ *  Fields are "record", "time", "written", "id", "type", "category",
+ *  "source", "computer" and "strings", with "eventid" standing for "id".
+ *  Fixed fields are compared with =, !=, <, <=, > and >=, or tested for
+ *  membership in a set with "in {...}". Times are given as
+ *  "YYYY-MM-DD HH:MM:SS" in UTC, and "time in last N" with a required
+ *  "s", "m", "h", "d" or "w" unit selects records generated since
+ *  N units ago. Names are compared with = and != as a whole, strings
+ *  one by one, and both with ~ and !~ for containing the value;
+ *  all ignore the case of Latin letters. Conditions are combined with
+ *  "and", "or", "not" and parentheses. Values that contain spaces
+ *  or special characters may be quoted with ' or ", yet a run of plain
+ *  words is taken as a single value, too.
+ *
+ */
+
+#ifndef FILTER_H_INCLUDED
+#define FILTER_H_INCLUDED
+
+/** The part of a compiled expression tested record by record. */
+typedef struct FilterPlan FilterPlan;
+
+
+/** Compile a filter expression. Unless _mkgmtime() is available,
+ *  setutctimezone() has to be called beforehand, see timeconv.h.
+ *  @param[in] expression  The expression.
+ *  @param[in,out] scan  Conditions on fixed fields that all records
+ *  	have to satisfy are added to this filter, in conjunction with
+ *  	whatever it already contains.
+ *  @return The plan for the rest of the conditions, or NULL on failure.
+ *  	An error message is printed.
+ */
+FilterPlan *filterCompile (const char *__restrict expression,
+	ScanFilter *__restrict scan);
+
+/** Find out whether the whole expression has gone into the ScanFilter.
+ *  @param[in] plan  A compiled plan.
+ *  @return Non-zero if there's nothing left to test record by record.
+ */
+int filterIsEmpty (const FilterPlan *plan);
+
+/** Find out whether an expression selects records relative to the time
+ *  it has been compiled at, as with "time in last 24h".
+ *  @param[in] plan  A compiled plan.
+ *  @return Non-zero if it does.
+ */
+int filterIsRelative (const FilterPlan *plan);
+
+/** Test a record against a plan.
+ *  @param[in] plan  A compiled plan.
+ *  @param[in] record  The record.
+ *  @return Non-zero if the record matches.
+ */
+int filterMatches (const FilterPlan *__restrict plan,
+	const EvtLogRecord *__restrict record);
+
+/** Destroy a plan.
+ *  @param[in,out] plan  A compiled plan.
+ */
+void filterDestroy (FilterPlan *plan);
+
+#endif /* ! FILTER_H_INCLUDED */
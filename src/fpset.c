@@ -0,0 +1,284 @@
+/**
+ *  @file fpset.c
+ *  @brief A memory bounded set of record fingerprints.
+ *
+ *  Copyright Přemysl Janouch 2010. All rights reserved.
+ *  See the file LICENSE for licensing information.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "configure.h"
+
+#include "xalloc.h"
+#include "bloom.h"
+#include "fpset.h"
+
+
+/** How many runs of the same level are merged into one. */
+#define FPSET_FAN_IN 8
+
+/** A sorted run of fingerprints spilled into a file. */
+typedef struct
+{
+	/** The file. */
+	FILE *fp;
+	/** The number of fingerprints in it. */
+	size_t count;
+	/** How many times the fingerprints have been merged. */
+	unsigned level;
+}
+Run;
+
+struct FingerprintSet
+{
+	/** An open addressing hash table. Empty slots are all zeros. */
+	Fingerprint *slots;
+	/** The number of slots, a power of two. */
+	size_t nSlots;
+	/** The number of used slots. */
+	size_t count;
+
+	/** Spilled runs. */
+	Run *runs;
+	/** The number of runs. */
+	size_t nRuns;
+	/** A filter over fingerprints in all of the runs. */
+	BloomFilter spilled;
+};
+
+
+/** Whether two fingerprints are equal. */
+static inline int fpEqual (const Fingerprint *a, const Fingerprint *b);
+/** Compare two fingerprints for qsort(). */
+static int fpCompare (const void *a, const void *b);
+/** Write the contents of the hash table into a new run and empty it. */
+static int spill (FingerprintSet set);
+/** Merge runs from @a first to the last one into a single run. */
+static int mergeRuns (FingerprintSet set, size_t first);
+/** Search for a fingerprint in a run. */
+static int searchRun (const Run *__restrict run,
+	const Fingerprint *__restrict fp);
+
+
+FingerprintSet fpSetCreate (size_t memoryLimit)
+{
+	FingerprintSet set;
+
+	set = xmalloc(sizeof(struct FingerprintSet));
+
+	/* Give three quarters of the memory to the table. */
+	for (set->nSlots = 1024; set->nSlots * sizeof(Fingerprint) * 2
+		<= memoryLimit / 4 * 3; set->nSlots <<= 1)
+		;
+	set->slots = xmalloc(set->nSlots * sizeof(Fingerprint));
+	memset(set->slots, 0, set->nSlots * sizeof(Fingerprint));
+	set->count = 0;
+
+	set->runs = NULL;
+	set->nRuns = 0;
+	bloomInit(&set->spilled, memoryLimit / 4 * 8 / BLOOM_BITS_PER_KEY);
+	return set;
+}
+
+static inline int fpEqual (const Fingerprint *a, const Fingerprint *b)
+{
+	return a->hash == b->hash && a->recordNumber == b->recordNumber
+		&& a->timeGenerated == b->timeGenerated;
+}
+
+static int fpCompare (const void *a, const void *b)
+{
+	const Fingerprint *fa = a, *fb = b;
+
+	if (fa->hash != fb->hash)
+		return fa->hash < fb->hash ? -1 : 1;
+	if (fa->recordNumber != fb->recordNumber)
+		return fa->recordNumber < fb->recordNumber ? -1 : 1;
+	if (fa->timeGenerated != fb->timeGenerated)
+		return fa->timeGenerated < fb->timeGenerated ? -1 : 1;
+	return 0;
+}
+
+static int spill (FingerprintSet set)
+{
+	Run *run;
+	size_t i, n = 0;
+
+	set->runs = xrealloc(set->runs, (set->nRuns + 1) * sizeof(Run));
+	run = &set->runs[set->nRuns];
+	if (!(run->fp = tmpfile()))
+	{
+		fprintf(stderr, _("Error: Failed to create a temporary file: %s.\n"),
+			strerror(errno));
+		return -1;
+	}
+
+	/* Move used slots to the beginning of the table and sort them. */
+	for (i = 0; i < set->nSlots; i++)
+		if (set->slots[i].hash)
+			set->slots[n++] = set->slots[i];
+	qsort(set->slots, n, sizeof(Fingerprint), fpCompare);
+
+	if (fwrite(set->slots, sizeof(Fingerprint), n, run->fp) != n
+		|| fflush(run->fp))
+	{
+		fputs(_("Error: Failed to write to a temporary file.\n"), stderr);
+		fclose(run->fp);
+		return -1;
+	}
+	for (i = 0; i < n; i++)
+		bloomAdd(&set->spilled, &set->slots[i], sizeof(Fingerprint));
+
+	run->count = n;
+	run->level = 0;
+	set->nRuns++;
+
+	memset(set->slots, 0, set->nSlots * sizeof(Fingerprint));
+	set->count = 0;
+
+	/* Levels only decrease towards the end, so the last runs are of the same
+	 * level if the outer ones are. This way the number of open files only
+	 * grows with the logarithm of the number of fingerprints. */
+	while (set->nRuns >= FPSET_FAN_IN
+		&& set->runs[set->nRuns - FPSET_FAN_IN].level
+		== set->runs[set->nRuns - 1].level)
+		if (mergeRuns(set, set->nRuns - FPSET_FAN_IN))
+			return -1;
+	return 0;
+}
+
+static int mergeRuns (FingerprintSet set, size_t first)
+{
+	Fingerprint heads[FPSET_FAN_IN];
+	size_t left[FPSET_FAN_IN], n = set->nRuns - first, best, k;
+	Run merged;
+
+	if (!(merged.fp = tmpfile()))
+	{
+		fprintf(stderr, _("Error: Failed to create a temporary file: %s.\n"),
+			strerror(errno));
+		return -1;
+	}
+	merged.count = 0;
+	merged.level = set->runs[first].level + 1;
+
+	for (k = 0; k < n; k++)
+	{
+		const Run *run = &set->runs[first + k];
+
+		left[k] = run->count;
+		if (fseek(run->fp, 0, SEEK_SET) || (left[k]
+			&& !fread(&heads[k], sizeof(Fingerprint), 1, run->fp)))
+			goto mergeRuns_fail;
+	}
+
+	/* The runs never have a fingerprint in common. */
+	while (1)
+	{
+		for (best = n, k = 0; k < n; k++)
+			if (left[k] && (best == n
+				|| fpCompare(&heads[k], &heads[best]) < 0))
+				best = k;
+		if (best == n)
+			break;
+
+		if (!fwrite(&heads[best], sizeof(Fingerprint), 1, merged.fp))
+			goto mergeRuns_fail;
+		merged.count++;
+		if (--left[best] && !fread(&heads[best], sizeof(Fingerprint), 1,
+			set->runs[first + best].fp))
+			goto mergeRuns_fail;
+	}
+	if (fflush(merged.fp))
+		goto mergeRuns_fail;
+
+	for (k = first; k < set->nRuns; k++)
+		fclose(set->runs[k].fp);
+	set->runs[first] = merged;
+	set->nRuns = first + 1;
+	return 0;
+
+mergeRuns_fail:
+	fputs(_("Error: Failed to merge temporary files.\n"), stderr);
+	fclose(merged.fp);
+	return -1;
+}
+
+static int searchRun (const Run *__restrict run,
+	const Fingerprint *__restrict fp)
+{
+	Fingerprint middle;
+	size_t low = 0, high = run->count, i;
+	int cmp;
+
+	while (low < high)
+	{
+		i = low + (high - low) / 2;
+		if (fseek(run->fp, (long) (i * sizeof(Fingerprint)), SEEK_SET)
+			|| !fread(&middle, sizeof(middle), 1, run->fp))
+			return -1;
+
+		if (!(cmp = fpCompare(fp, &middle)))
+			return 1;
+		if (cmp < 0)
+			high = i;
+		else
+			low = i + 1;
+	}
+	return 0;
+}
+
+int fpSetAdd (FingerprintSet __restrict set, const Fingerprint *__restrict fp)
+{
+	Fingerprint key = *fp;
+	size_t i, mask = set->nSlots - 1;
+	int found;
+
+	/* A zero hash marks empty slots. */
+	if (!key.hash)
+		key.hash = 1;
+
+	for (i = key.hash & mask; set->slots[i].hash; i = (i + 1) & mask)
+		if (fpEqual(&set->slots[i], &key))
+			return 1;
+
+	if (set->nRuns && bloomTest(&set->spilled, &key, sizeof(key)))
+	{
+		size_t k;
+
+		for (k = 0; k < set->nRuns; k++)
+		{
+			if ((found = searchRun(&set->runs[k], &key)) == -1)
+			{
+				fputs(_("Error: Failed to read a temporary file.\n"), stderr);
+				return -1;
+			}
+			if (found)
+				return 1;
+		}
+	}
+
+	set->slots[i] = key;
+
+	/* Keep the table at most half full. */
+	if (++set->count >= set->nSlots / 2 && spill(set))
+		return -1;
+	return 0;
+}
+
+void fpSetDestroy (FingerprintSet set)
+{
+	size_t i;
+
+	for (i = 0; i < set->nRuns; i++)
+		fclose(set->runs[i].fp);
+	free(set->runs);
+	free(set->slots);
+	bloomDestroy(&set->spilled);
+	free(set);
+}
@@ -0,0 +1,55 @@
+/**
+ *  @file fpset.h
+ *  @brief A memory bounded set of record fingerprints.
+ *
+ *  Copyright Přemysl Janouch 2010. All rights reserved.
+ *  See the file LICENSE for licensing information.
+ *
+ *  Fingerprints are kept in a hash table until it fills up. Then they're
+ *  sorted and spilled into a temporary file as a run, and a Bloom filter
+ *  over all spilled fingerprints is updated. Runs only need to be searched
+ *  for fingerprints that the filter lets through, which is rare unless
+ *  the fingerprint really is a duplicate.
+ *
+ */
+
+#ifndef FPSET_H_INCLUDED
+#define FPSET_H_INCLUDED
+
+/** Identifies a record. */
+typedef struct
+{
+	/** A hash of the raw bytes of the record, see hash.h. */
+	uint64_t hash;
+	/** The number of the record. */
+	uint32_t recordNumber;
+	/** The time the record has been generated at. */
+	uint32_t timeGenerated;
+}
+Fingerprint;
+
+/** A set of fingerprints. */
+typedef struct FingerprintSet *FingerprintSet;
+
+
+/** Create an empty set.
+ *  @param[in] memoryLimit  Roughly how many bytes of memory the set
+ *  	may use for its hash table and Bloom filter.
+ *  @return A new set.
+ */
+FingerprintSet fpSetCreate (size_t memoryLimit);
+
+/** Add a fingerprint to the set.
+ *  @param[in,out] set  A set.
+ *  @param[in] fp  The fingerprint.
+ *  @return 1 if the fingerprint has already been present, 0 if it has
+ *  	been added, -1 on failure. An error message is printed.
+ */
+int fpSetAdd (FingerprintSet __restrict set, const Fingerprint *__restrict fp);
+
+/** Destroy a set.
+ *  @param[in] set  A set.
+ */
+void fpSetDestroy (FingerprintSet set);
+
+#endif /* ! FPSET_H_INCLUDED */
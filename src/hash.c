@@ -0,0 +1,100 @@
+/**
+ *  @file hash.c
+ *  @brief A fast non-cryptographic hash function.
+ *
+ *  Copyright Přemysl Janouch 2010. All rights reserved.
+ *  See the file LICENSE for licensing information.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "configure.h"
+
+#include "hash.h"
+
+
+uint64_t hash64 (const void *data, size_t length, uint64_t seed)
+{
+	const uint64_t m = 0xC6A4A7935BD1E995ULL;
+	const int r = 47;
+
+	const unsigned char *p = data;
+	const unsigned char *end = p + (length & ~(size_t) 7);
+	uint64_t h = seed ^ (length * m), k;
+
+	for (; p != end; p += 8)
+	{
+		memcpy(&k, p, sizeof(k));
+
+		k *= m;
+		k ^= k >> r;
+		k *= m;
+
+		h ^= k;
+		h *= m;
+	}
+
+	switch (length & 7)
+	{
+	case 7: h ^= (uint64_t) p[6] << 48;
+		/* Fall through. */
+	case 6: h ^= (uint64_t) p[5] << 40;
+		/* Fall through. */
+	case 5: h ^= (uint64_t) p[4] << 32;
+		/* Fall through. */
+	case 4: h ^= (uint64_t) p[3] << 24;
+		/* Fall through. */
+	case 3: h ^= (uint64_t) p[2] << 16;
+		/* Fall through. */
+	case 2: h ^= (uint64_t) p[1] << 8;
+		/* Fall through. */
+	case 1: h ^= (uint64_t) p[0];
+		h *= m;
+	}
+
+	h ^= h >> r;
+	h *= m;
+	h ^= h >> r;
+	return h;
+}
+
+/** Mix a word into a lane of hash64Wide(). This is the round of xxHash64. */
+static inline uint64_t wideRound (uint64_t h, const unsigned char *p)
+{
+	uint64_t k;
+
+	memcpy(&k, p, sizeof(k));
+	h += k * 0xC2B2AE3D27D4EB4FULL;
+	h = (h << 31) | (h >> 33);
+	return h * 0x9E3779B185EBCA87ULL;
+}
+
+uint64_t hash64Wide (const void *data, size_t length, uint64_t seed)
+{
+	const unsigned char *p = data;
+	const unsigned char *end = p + (length & ~(size_t) 31);
+	uint64_t h[4], a, b, c, d;
+
+	/* The lanes are kept in separate variables and don't depend on each
+	 * other, so that their multiplications may all be in flight at once. */
+	a = seed;
+	b = seed + 0x9E3779B185EBCA87ULL;
+	c = seed + 0x3C6EF3630BD7950EULL;
+	d = seed + 0xDAA66D2C91C45F95ULL;
+	for (; p != end; p += 32)
+	{
+		a = wideRound(a, p);
+		b = wideRound(b, p + 8);
+		c = wideRound(c, p + 16);
+		d = wideRound(d, p + 24);
+	}
+
+	/* The lanes seed the hash of whatever is left over. */
+	h[0] = a;
+	h[1] = b;
+	h[2] = c;
+	h[3] = d;
+	return hash64(p, length & 31, hash64(h, sizeof(h), seed ^ length));
+}
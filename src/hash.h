@@ -0,0 +1,36 @@
+/**
+ *  @file hash.h
+ *  @brief A fast non-cryptographic hash function.
+ *
+ *  Copyright Přemysl Janouch 2010. All rights reserved.
+ *  See the file LICENSE for licensing information.
+ *
+ */
+
+#ifndef HASH_H_INCLUDED
+#define HASH_H_INCLUDED
+
+/** Compute a 64-bit hash of a block of memory. This is MurmurHash64A,
+ *  which is fast and mixes well, but offers no security whatsoever.
+ *  The result doesn't depend on the alignment of the data, however
+ *  it does depend on the byte order of the machine.
+ *  @param[in] data  The data to be hashed.
+ *  @param[in] length  The length of @a data in bytes.
+ *  @param[in] seed  A seed, for obtaining independent hashes.
+ *  @return The hash.
+ */
+uint64_t hash64 (const void *data, size_t length, uint64_t seed);
+
+/** Compute a 64-bit hash of a large block of memory. The data is split
+ *  into four interleaved lanes of 8-byte words that are mixed independently
+ *  and only combined at the end, which makes this about twice as fast as
+ *  hash64() on long inputs, e.g. whole files. The results differ from
+ *  those of hash64() and are just as dependent on the byte order.
+ *  @param[in] data  The data to be hashed.
+ *  @param[in] length  The length of @a data in bytes.
+ *  @param[in] seed  A seed, for obtaining independent hashes.
+ *  @return The hash.
+ */
+uint64_t hash64Wide (const void *data, size_t length, uint64_t seed);
+
+#endif /* ! HASH_H_INCLUDED */
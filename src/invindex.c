@@ -0,0 +1,373 @@
+/**
+ *  @file invindex.c
+ *  @brief An inverted index of tokens in event log records.
+ *
+ *  Copyright Přemysl Janouch 2010. All rights reserved.
+ *  See the file LICENSE for licensing information.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "configure.h"
+
+#include "xalloc.h"
+#include "datastruct.h"
+#include "mapfile.h"
+#include "invindex.h"
+
+
+/** Postings of a token being collected. */
+typedef struct
+{
+	/** The encoded postings. */
+	Buffer data;
+	/** The number of postings. */
+	uint32_t count;
+	/** The file of the last posting. */
+	uint32_t lastFile;
+	/** The record offset of the last posting. */
+	uint32_t lastOffset;
+}
+PostingList;
+
+struct IndexBuilder
+{
+	/** Tokens, identifying posting lists. */
+	StringTable tokens;
+	/** Posting lists, indexed by token identifiers minus one. */
+	PostingList *lists;
+	/** How many posting lists have been allocated. */
+	size_t alloc;
+	/** Paths of files. */
+	StringTable paths;
+	/** The number of the current file. */
+	uint32_t file;
+};
+
+/** A token to be sorted. */
+typedef struct
+{
+	/** The token. */
+	const char *s;
+	/** Its identifier. */
+	unsigned int id;
+}
+SortedToken;
+
+
+/** Append a number to a buffer in the variable length encoding. */
+static void appendVarint (Buffer *buf, uint32_t value);
+/** Read a number in the variable length encoding.
+ *  @return The position following the number, or NULL on failure. */
+static const unsigned char *readVarint (const unsigned char *p,
+	const unsigned char *end, uint32_t *value);
+/** Map a signed difference to an unsigned number. */
+static inline uint32_t zigzag (uint32_t from, uint32_t to);
+/** Compare two tokens for qsort(). */
+static int compareTokens (const void *a, const void *b);
+
+
+IndexBuilder indexCreateBuilder (void)
+{
+	IndexBuilder builder;
+
+	builder = xmalloc(sizeof(struct IndexBuilder));
+	stringTableInit(&builder->tokens);
+	stringTableInit(&builder->paths);
+	builder->lists = NULL;
+	builder->alloc = 0;
+	builder->file = 0;
+	return builder;
+}
+
+int indexAddFile (IndexBuilder __restrict builder,
+	const char *__restrict path)
+{
+	int added;
+
+	builder->file = stringTableIntern(&builder->paths, path, &added) - 1;
+	return added ? 0 : -1;
+}
+
+static void appendVarint (Buffer *buf, uint32_t value)
+{
+	while (value >= 0x80)
+	{
+		bufferAppendChar(buf, (char) (value | 0x80));
+		value >>= 7;
+	}
+	bufferAppendChar(buf, (char) value);
+}
+
+static inline uint32_t zigzag (uint32_t from, uint32_t to)
+{
+	return to >= from ? (to - from) << 1 : ((from - to) << 1) - 1;
+}
+
+void indexAddToken (IndexBuilder __restrict builder,
+	const char *__restrict token, uint32_t offset)
+{
+	PostingList *list;
+	uint32_t file;
+	unsigned int id;
+	int added;
+
+	file = builder->file;
+	id = stringTableIntern(&builder->tokens, token, &added);
+	if (added && builder->tokens.count > builder->alloc)
+	{
+		builder->alloc = builder->alloc ? builder->alloc << 1 : 256;
+		builder->lists = xrealloc(builder->lists,
+			builder->alloc * sizeof(PostingList));
+	}
+
+	list = &builder->lists[id - 1];
+	if (added)
+	{
+		bufferInit(&list->data);
+		list->count = 0;
+		list->lastFile = 0;
+		list->lastOffset = 0;
+	}
+	/* The token has already occured in this record. */
+	else if (list->lastFile == file && list->lastOffset == offset)
+		return;
+
+	appendVarint(&list->data, file - list->lastFile);
+	if (file != list->lastFile)
+		list->lastOffset = 0;
+	appendVarint(&list->data, zigzag(list->lastOffset, offset));
+
+	list->lastFile = file;
+	list->lastOffset = offset;
+	list->count++;
+}
+
+static int compareTokens (const void *a, const void *b)
+{
+	return strcmp(((const SortedToken *) a)->s, ((const SortedToken *) b)->s);
+}
+
+int indexWrite (IndexBuilder __restrict builder, FILE *__restrict output)
+{
+	IndexHeader hdr;
+	IndexToken entry;
+	SortedToken *sorted;
+	uint32_t string = 0;
+	uint64_t postings = 0;
+	size_t i, nTokens = builder->tokens.count;
+	int ret = -1;
+
+	sorted = xmalloc((nTokens + 1) * sizeof(SortedToken));
+	for (i = 0; i < nTokens; i++)
+	{
+		sorted[i].id = i + 1;
+		sorted[i].s = stringTableGet(&builder->tokens, i + 1);
+	}
+	qsort(sorted, nTokens, sizeof(SortedToken), compareTokens);
+
+	hdr.magic = INDEX_MAGIC;
+	hdr.version = INDEX_VERSION;
+	hdr.nFiles = builder->paths.count;
+	hdr.nTokens = nTokens;
+	hdr.filesOffset = sizeof(hdr) + nTokens * sizeof(IndexToken);
+	hdr.stringsOffset = hdr.filesOffset + hdr.nFiles * sizeof(uint32_t);
+
+	/* Lay out the string pool and postings in the order of tokens. */
+	for (i = 0; i < nTokens; i++)
+		string += strlen(sorted[i].s) + 1;
+	for (i = 0; i < hdr.nFiles; i++)
+		string += strlen(stringTableGet(&builder->paths, i + 1)) + 1;
+	hdr.postingsOffset = hdr.stringsOffset + string;
+	for (i = 0; i < nTokens; i++)
+		postings += builder->lists[sorted[i].id - 1].data.used;
+	hdr.length = hdr.postingsOffset + postings;
+
+	if (!fwrite(&hdr, sizeof(hdr), 1, output))
+		goto indexWrite_end;
+
+	string = postings = 0;
+	for (i = 0; i < nTokens; i++)
+	{
+		const PostingList *list = &builder->lists[sorted[i].id - 1];
+
+		entry.string = string;
+		entry.count = list->count;
+		entry.postings = postings;
+		if (!fwrite(&entry, sizeof(entry), 1, output))
+			goto indexWrite_end;
+
+		string += strlen(sorted[i].s) + 1;
+		postings += list->data.used;
+	}
+	for (i = 0; i < hdr.nFiles; i++)
+	{
+		if (!fwrite(&string, sizeof(string), 1, output))
+			goto indexWrite_end;
+		string += strlen(stringTableGet(&builder->paths, i + 1)) + 1;
+	}
+
+	for (i = 0; i < nTokens; i++)
+		if (fputs(sorted[i].s, output) == EOF || putc('\0', output) == EOF)
+			goto indexWrite_end;
+	for (i = 0; i < hdr.nFiles; i++)
+		if (fputs(stringTableGet(&builder->paths, i + 1), output) == EOF
+			|| putc('\0', output) == EOF)
+			goto indexWrite_end;
+
+	for (i = 0; i < nTokens; i++)
+	{
+		const Buffer *data = &builder->lists[sorted[i].id - 1].data;
+
+		if (data->used && !fwrite(data->data, data->used, 1, output))
+			goto indexWrite_end;
+	}
+	ret = 0;
+
+indexWrite_end:
+	free(sorted);
+	return ret;
+}
+
+void indexDestroyBuilder (IndexBuilder builder)
+{
+	size_t i;
+
+	for (i = 0; i < builder->tokens.count; i++)
+		bufferDestroy(&builder->lists[i].data);
+	free(builder->lists);
+	stringTableDestroy(&builder->tokens);
+	stringTableDestroy(&builder->paths);
+	free(builder);
+}
+
+int indexOpen (Index *__restrict index, const char *__restrict path)
+{
+	const IndexHeader *hdr;
+	size_t length;
+	uint32_t i;
+
+	if (mapFileOpen(&index->file, path))
+	{
+		fprintf(stderr, _("Error: Failed to open %s for reading.\n"), path);
+		return -1;
+	}
+
+	length = index->file.length;
+	hdr = index->hdr = index->file.data;
+	if (length < sizeof(IndexHeader) || hdr->magic != INDEX_MAGIC
+		|| hdr->version != INDEX_VERSION || hdr->length != length
+		|| hdr->filesOffset != sizeof(IndexHeader)
+			+ (uint64_t) hdr->nTokens * sizeof(IndexToken)
+		|| hdr->stringsOffset != hdr->filesOffset
+			+ (uint64_t) hdr->nFiles * sizeof(uint32_t)
+		|| hdr->postingsOffset < hdr->stringsOffset
+		|| hdr->postingsOffset > length)
+		goto indexOpen_fail;
+
+	index->tokens = (const IndexToken *) (hdr + 1);
+	index->files = (const uint32_t *)
+		((const char *) index->file.data + hdr->filesOffset);
+	index->strings = (const char *) index->file.data + hdr->stringsOffset;
+	index->postings = (const unsigned char *)
+		index->file.data + hdr->postingsOffset;
+
+	/* The string pool has to end with a NULL char, so that we don't need
+	 * to check strings one by one, and so do offsets have to fit in it. */
+	if (hdr->postingsOffset == hdr->stringsOffset
+		|| index->strings[hdr->postingsOffset - hdr->stringsOffset - 1])
+		goto indexOpen_fail;
+	for (i = 0; i < hdr->nFiles; i++)
+		if (index->files[i] >= hdr->postingsOffset - hdr->stringsOffset)
+			goto indexOpen_fail;
+	/* Each posting takes at least two bytes, which also bounds how much
+	 * memory decoding them may need. */
+	for (i = 0; i < hdr->nTokens; i++)
+		if (index->tokens[i].string
+				>= hdr->postingsOffset - hdr->stringsOffset
+			|| index->tokens[i].postings > length - hdr->postingsOffset
+			|| (uint64_t) index->tokens[i].count * 2 > length
+				- hdr->postingsOffset - index->tokens[i].postings)
+			goto indexOpen_fail;
+	return 0;
+
+indexOpen_fail:
+	fprintf(stderr, _("Error: %s is not a valid index.\n"), path);
+	mapFileClose(&index->file);
+	return -1;
+}
+
+const IndexToken *indexFind (const Index *__restrict index,
+	const char *__restrict token)
+{
+	size_t low = 0, high = index->hdr->nTokens, middle;
+	int cmp;
+
+	while (low < high)
+	{
+		middle = low + (high - low) / 2;
+		cmp = strcmp(token, index->strings + index->tokens[middle].string);
+		if (!cmp)
+			return &index->tokens[middle];
+		if (cmp < 0)
+			high = middle;
+		else
+			low = middle + 1;
+	}
+	return NULL;
+}
+
+static const unsigned char *readVarint (const unsigned char *p,
+	const unsigned char *end, uint32_t *value)
+{
+	int shift;
+
+	*value = 0;
+	for (shift = 0; p < end && shift < 32; shift += 7)
+	{
+		*value |= (uint32_t) (*p & 0x7F) << shift;
+		if (!(*p++ & 0x80))
+			return p;
+	}
+	return NULL;
+}
+
+int indexDecode (const Index *__restrict index,
+	const IndexToken *__restrict token, IndexPosting *__restrict postings)
+{
+	const unsigned char *p, *end;
+	uint32_t i, delta, file = 0, offset = 0;
+
+	p = index->postings + token->postings;
+	end = (const unsigned char *) index->file.data + index->file.length;
+
+	for (i = 0; i < token->count; i++)
+	{
+		if (!(p = readVarint(p, end, &delta)))
+			return -1;
+		if (delta)
+			offset = 0;
+		file += delta;
+
+		if (!(p = readVarint(p, end, &delta)))
+			return -1;
+		if (delta & 1)
+			offset -= (delta >> 1) + 1;
+		else
+			offset += delta >> 1;
+
+		if (file >= index->hdr->nFiles)
+			return -1;
+		postings[i].file = file;
+		postings[i].offset = offset;
+	}
+	return 0;
+}
+
+void indexClose (Index *index)
+{
+	mapFileClose(&index->file);
+}
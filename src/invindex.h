@@ -0,0 +1,184 @@
+/**
+ *  @file invindex.h
+ *  @brief An inverted index of tokens in event log records.
+ *
+ *  Copyright Přemysl Janouch 2010. All rights reserved.
+ *  See the file LICENSE for licensing information.
+ *
+ *  The index maps tokens (see token.h) to postings, i.e. .evt files and
+ *  offsets of records within them. It's meant to be mapped into memory
+ *  and used right away, so the file is laid out as follows:
+ *
+ *  - an @a IndexHeader,
+ *  - @a nTokens of @a IndexToken structures, sorted by the tokens,
+ *  - @a nFiles of 32-bit offsets of file paths into the string pool,
+ *  - the string pool with tokens and paths, each terminated by a NULL char,
+ *  - the postings.
+ *
+ *  Numbers in the header and the tables are in the byte order of the host
+ *  that has written the index, so that they can be used without any
+ *  conversion. An index written on a host with the other byte order
+ *  has a different magic number and is rejected.
+ *
+ *  The postings of each token are a sequence of pairs of numbers, the file
+ *  and the record offset, ordered by file. Each number is stored as the
+ *  difference from its previous value in the list, the record offset
+ *  starting from zero with each new file. Since records in a wrapped log
+ *  are not ordered by their offsets, these differences are signed and
+ *  mapped to unsigned numbers as 0, -1, 1, -2, 2... Finally, the numbers
+ *  are encoded in 7 bits per byte, the lowest bits first, with the top bit
+ *  set in all but the last byte.
+ *
+ */
+
+#ifndef INVINDEX_H_INCLUDED
+#define INVINDEX_H_INCLUDED
+
+/** The magic number at the beginning of index files, "EIDX". */
+#define INDEX_MAGIC 0x58444945
+/** The current version of the file format. */
+#define INDEX_VERSION 1
+
+/** The header of an index file. */
+typedef struct
+{
+	/** @a INDEX_MAGIC */
+	uint32_t magic;
+	/** @a INDEX_VERSION */
+	uint32_t version;
+	/** The number of .evt files. */
+	uint32_t nFiles;
+	/** The number of distinct tokens. */
+	uint32_t nTokens;
+	/** The offset of the file table. */
+	uint64_t filesOffset;
+	/** The offset of the string pool. */
+	uint64_t stringsOffset;
+	/** The offset of postings. */
+	uint64_t postingsOffset;
+	/** The length of the whole index file. */
+	uint64_t length;
+}
+IndexHeader;
+
+/** A token in the index. */
+typedef struct
+{
+	/** The offset of the token in the string pool. */
+	uint32_t string;
+	/** The number of postings. */
+	uint32_t count;
+	/** The offset of the postings, relative to where they start. */
+	uint64_t postings;
+}
+IndexToken;
+
+/** A record containing a token. */
+typedef struct
+{
+	/** The number of the file. */
+	uint32_t file;
+	/** The offset of the record within the file. */
+	uint32_t offset;
+}
+IndexPosting;
+
+
+/** An index being built. */
+typedef struct IndexBuilder *IndexBuilder;
+
+/** Create an empty index.
+ *  @return A new index builder.
+ */
+IndexBuilder indexCreateBuilder (void);
+
+/** Add a file to the index. Tokens added from now on belong to it.
+ *  @param[in,out] builder  An index builder.
+ *  @param[in] path  The path to the file, as it will be opened
+ *  	when querying the index.
+ *  @return 0 on success, -1 if the file has already been added,
+ *  	in which case its records mustn't be added again.
+ */
+int indexAddFile (IndexBuilder __restrict builder,
+	const char *__restrict path);
+
+/** Add a token contained in a record of the current file.
+ *  Records have to be added one after another.
+ *  @param[in,out] builder  An index builder.
+ *  @param[in] token  The token.
+ *  @param[in] offset  The offset of the record.
+ */
+void indexAddToken (IndexBuilder __restrict builder,
+	const char *__restrict token, uint32_t offset);
+
+/** Write out the index.
+ *  @param[in] builder  An index builder.
+ *  @param[in] output  The file stream to write to.
+ *  @return 0 on success, -1 on failure.
+ */
+int indexWrite (IndexBuilder __restrict builder, FILE *__restrict output);
+
+/** Destroy an index builder.
+ *  @param[in] builder  An index builder.
+ */
+void indexDestroyBuilder (IndexBuilder builder);
+
+
+/** An index opened for querying. */
+typedef struct
+{
+	/** The mapped index file. */
+	MappedFile file;
+	/** The header. */
+	const IndexHeader *hdr;
+	/** The token table. */
+	const IndexToken *tokens;
+	/** The file table. */
+	const uint32_t *files;
+	/** The string pool. */
+	const char *strings;
+	/** The postings. */
+	const unsigned char *postings;
+}
+Index;
+
+/** Open an index file.
+ *  @param[out] index  An Index structure to be filled.
+ *  @param[in] path  The path to the index file.
+ *  @return 0 on success, -1 on failure. An error message is printed.
+ */
+int indexOpen (Index *__restrict index, const char *__restrict path);
+
+/** Get the path to a file in the index.
+ *  @param[in] index  An opened index.
+ *  @param[in] file  The number of a file.
+ *  @return The path.
+ */
+static inline const char *indexFilePath (const Index *index, uint32_t file)
+{
+	return index->strings + index->files[file];
+}
+
+/** Find a token in the index.
+ *  @param[in] index  An opened index.
+ *  @param[in] token  The token.
+ *  @return The token entry, or NULL if the token is not in the index.
+ */
+const IndexToken *indexFind (const Index *__restrict index,
+	const char *__restrict token);
+
+/** Decode the postings of a token.
+ *  @param[in] index  An opened index.
+ *  @param[in] token  A token entry.
+ *  @param[out] postings  Where to store @a token->count postings.
+ *  @return 0 on success, -1 if the postings are corrupted.
+ */
+int indexDecode (const Index *__restrict index,
+	const IndexToken *__restrict token, IndexPosting *__restrict postings);
+
+/** Close an index.
+ *  @param[in,out] index  An opened index.
+ */
+void indexClose (Index *index);
+
+#endif /* ! INVINDEX_H_INCLUDED */
@@ -0,0 +1,196 @@
+/**
+ *  @file jsonsink.c
+ *  @brief A sink writing records as JSON objects.
+ *
+ *  Copyright Přemysl Janouch 2010. All rights reserved.
+ *  See the file LICENSE for licensing information.
+ *
+ *  Every record is written as a single line holding one object, so that
+ *  the output can be processed by line-oriented tools and read as a stream.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "configure.h"
+
+#include "xalloc.h"
+#include "datastruct.h"
+#include "evt.h"
+#include "base64.h"
+#include "escape.h"
+#include "record.h"
+#include "sink.h"
+
+
+/** A sink writing records as JSON objects. */
+typedef struct
+{
+	/** The methods. */
+	Sink sink;
+	/** The output file stream. */
+	FILE *output;
+	/** Storage for the description strings as they're being cut. */
+	Buffer strings;
+}
+JsonSink;
+
+
+static int jsonSinkBegin (Sink *__restrict self,
+	const EvtHeader *__restrict hdr, unsigned long fileSize);
+static int jsonSinkWrite (Sink *__restrict self,
+	const RecordFields *__restrict fields);
+static int jsonSinkClose (Sink *self);
+
+/** Write a JSON string, or null if @a s is NULL. */
+static void writeString (FILE *__restrict output, const char *__restrict s);
+/** Write a time as a JSON string. */
+static void writeTime (FILE *output, time_t t);
+
+
+Sink *sinkCreateJson (FILE *output)
+{
+	JsonSink *self;
+
+	self = xmalloc(sizeof(JsonSink));
+	self->sink.begin = jsonSinkBegin;
+	self->sink.write = jsonSinkWrite;
+	self->sink.close = jsonSinkClose;
+
+	self->output = output;
+	bufferInit(&self->strings);
+	return &self->sink;
+}
+
+static int jsonSinkBegin (Sink *__restrict self,
+	const EvtHeader *__restrict hdr, unsigned long fileSize)
+{
+	(void) self;
+	(void) hdr;
+	(void) fileSize;
+	return 0;
+}
+
+static int jsonSinkWrite (Sink *__restrict self,
+	const RecordFields *__restrict fields)
+{
+	JsonSink *sink = (JsonSink *) self;
+	FILE *output = sink->output;
+	const EvtRecord *rec = fields->rec;
+	const char *typeName;
+	char *cursor, *s;
+
+	fprintf(output, "{\"record\":%u,\"timeGenerated\":", rec->recordNumber);
+	writeTime(output, rec->timeGenerated);
+	fputs(",\"timeWritten\":", output);
+	writeTime(output, rec->timeWritten);
+	fprintf(output, ",\"eventID\":%u,\"type\":", rec->eventID);
+
+	/* Unknown types are expressed with a number. */
+	if ((typeName = recordTypeName(rec->eventType)))
+		writeString(output, typeName);
+	else
+		fprintf(output, "%u", rec->eventType);
+
+	fprintf(output, ",\"category\":%u,\"source\":", rec->eventCategory);
+	writeString(output, fields->sourceName);
+	fputs(",\"computer\":", output);
+	writeString(output, fields->computerName);
+	fputs(",\"sid\":", output);
+	writeString(output, fields->sid);
+
+	/* The strings have to be unescaped, which is done in place. */
+	fputs(",\"strings\":[", output);
+	if (*fields->strings)
+	{
+		bufferClear(&sink->strings);
+		bufferAppend(&sink->strings, fields->strings,
+			strlen(fields->strings) + 1, 0);
+		for (cursor = sink->strings.data; cursor; )
+		{
+			if ((s = escapeCutNext(&cursor)) != sink->strings.data)
+				fputc(',', output);
+			writeString(output, s);
+		}
+	}
+
+	fputs("],\"data\":", output);
+	if (!fields->data)
+		fputs("null", output);
+	else
+	{
+		base64_encodestate state;
+		char *buff;
+		int offset;
+
+		base64_init_encodestate(&state);
+		buff = xmalloc(BASE64_ENCODED_BUFFER_SIZE(fields->dataLength));
+		offset = base64_encode_block(fields->data, fields->dataLength,
+			buff, &state);
+		base64_encode_blockend(buff + offset, &state);
+		writeString(output, buff);
+		free(buff);
+	}
+
+	fputs("}\n", output);
+	return 0;
+}
+
+static int jsonSinkClose (Sink *self)
+{
+	JsonSink *sink = (JsonSink *) self;
+
+	bufferDestroy(&sink->strings);
+	free(sink);
+	return 0;
+}
+
+static void writeString (FILE *__restrict output, const char *__restrict s)
+{
+	if (!s)
+	{
+		fputs("null", output);
+		return;
+	}
+
+	fputc('"', output);
+	for (; *s; s++)
+	{
+		switch (*s)
+		{
+		case '"':
+			fputs("\\\"", output);
+			break;
+		case '\\':
+			fputs("\\\\", output);
+			break;
+		case '\n':
+			fputs("\\n", output);
+			break;
+		case '\r':
+			fputs("\\r", output);
+			break;
+		case '\t':
+			fputs("\\t", output);
+			break;
+		default:
+			if ((unsigned char) *s < 0x20)
+				fprintf(output, "\\u%04x", (unsigned char) *s);
+			else
+				fputc(*s, output);
+		}
+	}
+	fputc('"', output);
+}
+
+static void writeTime (FILE *output, time_t t)
+{
+	/* Yes, the buffer is large enough. */
+	char buff[40];
+
+	strftime(buff, sizeof(buff), "\"%Y-%m-%dT%H:%M:%SZ\"", gmtime(&t));
+	fputs(buff, output);
+}
@@ -0,0 +1,116 @@
+/**
+ *  @file listener.c
+ *  @brief Serving clients on a Unix domain socket.
+ *
+ *  Copyright Přemysl Janouch 2010. All rights reserved.
+ *  See the file LICENSE for licensing information.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "configure.h"
+
+#include "datastruct.h"
+#include "listener.h"
+
+
+/** How many connections may wait to be accepted. */
+#define LISTENER_BACKLOG 64
+/** How many seconds to wait after failing to accept a connection. */
+#define LISTENER_RETRY_DELAY 1
+/** The longest line accepted from a client, without the newline. */
+#define LISTENER_MAX_LINE 65536
+
+
+int listenerOpen (const char *path)
+{
+	struct sockaddr_un addr;
+	struct stat st;
+	int fd, probe;
+
+	if (strlen(path) >= sizeof(addr.sun_path))
+	{
+		fprintf(stderr, _("Error: The path %s is too long.\n"), path);
+		return -1;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+
+	/* Only replace a socket that nobody listens on anymore. */
+	if (!lstat(path, &st) && S_ISSOCK(st.st_mode)
+		&& (probe = socket(AF_UNIX, SOCK_STREAM, 0)) != -1)
+	{
+		if (!connect(probe, (struct sockaddr *) &addr, sizeof(addr)))
+		{
+			fprintf(stderr, _("Error: Another server is listening on %s.\n"),
+				path);
+			close(probe);
+			return -1;
+		}
+		if (errno == ECONNREFUSED)
+			unlink(path);
+		close(probe);
+	}
+
+	if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1
+		|| bind(fd, (struct sockaddr *) &addr, sizeof(addr))
+		|| listen(fd, LISTENER_BACKLOG))
+	{
+		fprintf(stderr, _("Error: Failed to listen on %s: %s.\n"),
+			path, strerror(errno));
+		if (fd != -1)
+			close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+int listenerAccept (int listener)
+{
+	int fd;
+
+	while ((fd = accept(listener, NULL, NULL)) == -1)
+	{
+		if (errno != EINTR && errno != ECONNABORTED)
+		{
+			fprintf(stderr, _("Error: Failed to accept a connection: %s.\n"),
+				strerror(errno));
+
+			/* Errors such as running out of descriptors don't go away
+			 * at once, and the workers would just spin trying again. */
+			sleep(LISTENER_RETRY_DELAY);
+			return -1;
+		}
+	}
+	return fd;
+}
+
+int listenerReadLine (FILE *__restrict stream, Buffer *__restrict line)
+{
+	int c;
+
+	bufferClear(line);
+	while ((c = getc(stream)) != EOF && c != '\n')
+	{
+		if (line->used == LISTENER_MAX_LINE)
+			return 1;
+		bufferAppendChar(line, c);
+	}
+	if (c == EOF && !line->used)
+		return -1;
+
+	if (line->used && ((char *) line->data)[line->used - 1] == '\r')
+		bufferShrink(line, 1);
+	bufferAppendChar(line, '\0');
+	return 0;
+}
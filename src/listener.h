@@ -0,0 +1,38 @@
+/**
+ *  @file listener.h
+ *  @brief Serving clients on a Unix domain socket.
+ *
+ *  Copyright Přemysl Janouch 2010. All rights reserved.
+ *  See the file LICENSE for licensing information.
+ *
+ */
+
+#ifndef LISTENER_H_INCLUDED
+#define LISTENER_H_INCLUDED
+
+/** Create a listening socket. A socket left behind at the path
+ *  by a previous instance is replaced, unless it's still being listened on.
+ *  @param[in] path  The path to the socket.
+ *  @return The socket, or -1 on failure. An error message is printed.
+ */
+int listenerOpen (const char *path);
+
+/** Accept a connection, retrying if interrupted or if the client
+ *  has gone away in the meantime.
+ *  @param[in] listener  A listening socket.
+ *  @return The connection, or -1 on failure. An error message is printed
+ *  	and the call waits for a while, so that the caller may simply
+ *  	try again.
+ */
+int listenerAccept (int listener);
+
+/** Read a line from a client, without the newline.
+ *  @param[in] stream  The stream to read from.
+ *  @param[out] line  Where to store the line, including a NULL char.
+ *  	The buffer is cleared beforehand.
+ *  @return 0 on success, -1 at the end of the stream, 1 if the line
+ *  	is too long, in which case the rest of it is left unread.
+ */
+int listenerReadLine (FILE *__restrict stream, Buffer *__restrict line);
+
+#endif /* ! LISTENER_H_INCLUDED */
@@ -0,0 +1,163 @@
+/**
+ *  @file mapfile.c
+ *  @brief Read-only mapping of whole files into memory.
+ *
+ *  Copyright Přemysl Janouch 2010. All rights reserved.
+ *  See the file LICENSE for licensing information.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+
+#include "configure.h"
+
+#ifdef _WIN32
+	#include <windows.h>
+#elif defined(HAVE_MMAP)
+	#include <sys/types.h>
+	#include <sys/stat.h>
+	#include <sys/mman.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif /* HAVE_MMAP */
+
+#include "xalloc.h"
+#include "mapfile.h"
+
+
+/** Read the whole file into memory when it cannot be mapped. */
+static int readWholeFile (MappedFile *__restrict map,
+	const char *__restrict path);
+
+
+int mapFileOpen (MappedFile *__restrict map, const char *__restrict path)
+{
+#ifdef _WIN32
+	HANDLE file;
+	DWORD high;
+
+	map->data = NULL;
+	map->mapped = 1;
+	map->mapping = NULL;
+
+	file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+		OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return readWholeFile(map, path);
+
+	map->length = GetFileSize(file, &high);
+	if (sizeof(size_t) <= 4 && high)
+	{
+		CloseHandle(file);
+		errno = EFBIG;
+		return -1;
+	}
+	map->length |= (size_t) high << 16 << 16;
+
+	if (map->length)
+	{
+		map->mapping = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (map->mapping)
+			map->data = MapViewOfFile(map->mapping, FILE_MAP_READ, 0, 0, 0);
+		if (!map->data)
+		{
+			if (map->mapping)
+				CloseHandle(map->mapping);
+			CloseHandle(file);
+			return readWholeFile(map, path);
+		}
+	}
+	CloseHandle(file);
+	return 0;
+#elif defined(HAVE_MMAP)
+	struct stat s;
+	void *data;
+	int fd;
+
+	if ((fd = open(path, O_RDONLY)) == -1)
+		return -1;
+	if (fstat(fd, &s))
+	{
+		close(fd);
+		return -1;
+	}
+
+	map->data = NULL;
+	map->length = s.st_size;
+	map->mapped = 1;
+
+	if (map->length)
+	{
+		data = mmap(NULL, map->length, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data == MAP_FAILED)
+		{
+			/* Pipes and some special files cannot be mapped. */
+			close(fd);
+			return readWholeFile(map, path);
+		}
+		map->data = data;
+	}
+	close(fd);
+	return 0;
+#else /* ! HAVE_MMAP */
+	return readWholeFile(map, path);
+#endif /* ! HAVE_MMAP */
+}
+
+static int readWholeFile (MappedFile *__restrict map,
+	const char *__restrict path)
+{
+	FILE *fp;
+	char *data = NULL;
+	size_t allocated = 0, length = 0, got;
+
+	if (!(fp = fopen(path, "rb")))
+		return -1;
+
+	/* The size of the file may be unknown, so let's just read it all. */
+	do
+	{
+		if (length == allocated)
+			data = xrealloc(data, allocated = allocated ? allocated << 1 : 65536);
+		got = fread(data + length, 1, allocated - length, fp);
+		length += got;
+	}
+	while (got);
+
+	if (ferror(fp))
+	{
+		fclose(fp);
+		free(data);
+		errno = EIO;
+		return -1;
+	}
+	fclose(fp);
+
+	map->data = data;
+	map->length = length;
+	map->mapped = 0;
+#ifdef _WIN32
+	map->mapping = NULL;
+#endif /* _WIN32 */
+	return 0;
+}
+
+void mapFileClose (MappedFile *map)
+{
+	if (!map->mapped)
+		free((void *) map->data);
+#ifdef _WIN32
+	else if (map->data)
+	{
+		UnmapViewOfFile(map->data);
+		CloseHandle(map->mapping);
+	}
+#elif defined(HAVE_MMAP)
+	else if (map->data)
+		munmap((void *) map->data, map->length);
+#endif /* HAVE_MMAP */
+	map->data = NULL;
+	map->length = 0;
+}
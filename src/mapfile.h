@@ -0,0 +1,45 @@
+/**
+ *  @file mapfile.h
+ *  @brief Read-only mapping of whole files into memory.
+ *
+ *  Copyright Přemysl Janouch 2010. All rights reserved.
+ *  See the file LICENSE for licensing information.
+ *
+ *  Where memory mapping is not available, the file is simply read
+ *  into a dynamically allocated buffer.
+ *
+ */
+
+#ifndef MAPFILE_H_INCLUDED
+#define MAPFILE_H_INCLUDED
+
+/** A file mapped into memory. */
+typedef struct
+{
+	/** The contents of the file. NULL if the file is empty. */
+	const void *data;
+	/** The length of the file in bytes. */
+	size_t length;
+	/** Whether @a data is really mapped and not just read in. */
+	int mapped;
+#ifdef _WIN32
+	/** The file mapping object. */
+	void *mapping;
+#endif /* _WIN32 */
+}
+MappedFile;
+
+
+/** Map a file into memory.
+ *  @param[out] map  A MappedFile structure to be filled.
+ *  @param[in] path  The path to the file.
+ *  @return 0 on success, -1 on failure, in which case errno is set.
+ */
+int mapFileOpen (MappedFile *__restrict map, const char *__restrict path);
+
+/** Unmap a file from memory.
+ *  @param[in,out] map  A mapped file.
+ */
+void mapFileClose (MappedFile *map);
+
+#endif /* ! MAPFILE_H_INCLUDED */
@@ -0,0 +1,141 @@
+/**
+ *  @file options.c
+ *  @brief Command line option parsing.
+ *
+ *  Copyright Přemysl Janouch 2010. All rights reserved.
+ *  See the file LICENSE for licensing information.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+#include "configure.h"
+
+#include "options.h"
+
+
+/** Describe an error, printing the description unless parsing quietly.
+ *  @return @a OPTIONS_ERROR.
+ */
+static int fail (OptionsState *__restrict state,
+	const char *__restrict format, ...) ATTRIBUTE_FORMAT(printf, 2, 3);
+/** Parse a long option. @a name points right after the two dashes. */
+static int parseLong (OptionsState *__restrict state, int argc, char *argv[],
+	const OptionSpec *__restrict spec, char *name);
+
+/** Parse the next short option in the current cluster. */
+static int parseShort (OptionsState *__restrict state, int argc, char *argv[],
+	const OptionSpec *__restrict spec);
+
+
+static int fail (OptionsState *__restrict state,
+	const char *__restrict format, ...)
+{
+	va_list ap;
+
+	va_start(ap, format);
+	vsnprintf(state->message, sizeof(state->message), format, ap);
+	va_end(ap);
+
+	if (!state->quiet)
+		fprintf(stderr, _("Error: %s.\n"), state->message);
+	return OPTIONS_ERROR;
+}
+
+int optionsNext (OptionsState *__restrict state, int argc, char *argv[],
+	const OptionSpec *__restrict spec)
+{
+	char *arg;
+
+	state->arg = NULL;
+	if (state->cluster && *state->cluster)
+		return parseShort(state, argc, argv, spec);
+
+	state->cluster = NULL;
+	if (state->index >= argc)
+		return OPTIONS_END;
+
+	/* A lone dash usually stands for the standard input or output. */
+	arg = argv[state->index];
+	if (arg[0] != '-' || !arg[1])
+		return OPTIONS_END;
+
+	state->index++;
+	if (arg[1] == '-')
+	{
+		if (!arg[2])
+			return OPTIONS_END;
+		return parseLong(state, argc, argv, spec, arg + 2);
+	}
+
+	state->cluster = arg + 1;
+	return parseShort(state, argc, argv, spec);
+}
+
+static int parseLong (OptionsState *__restrict state, int argc, char *argv[],
+	const OptionSpec *__restrict spec, char *name)
+{
+	char *value;
+	size_t nameLen;
+
+	if ((value = strchr(name, '=')))
+		nameLen = value++ - name;
+	else
+		nameLen = strlen(name);
+
+	for (; spec->id; spec++)
+	{
+		if (!spec->longName || strlen(spec->longName) != nameLen
+			|| strncmp(spec->longName, name, nameLen))
+			continue;
+
+		if (!spec->hasArg)
+		{
+			if (!value)
+				return spec->id;
+			return fail(state, _("Option --%s takes no argument"),
+				spec->longName);
+		}
+		if (!value && state->index < argc)
+			value = argv[state->index++];
+		if (!value)
+		{
+			return fail(state, _("Option --%s requires an argument"),
+				spec->longName);
+		}
+		state->arg = value;
+		return spec->id;
+	}
+
+	return fail(state, _("Unknown option --%.*s"), (int) nameLen, name);
+}
+
+static int parseShort (OptionsState *__restrict state, int argc, char *argv[],
+	const OptionSpec *__restrict spec)
+{
+	char c;
+
+	c = *state->cluster++;
+	for (; spec->id; spec++)
+	{
+		if (spec->id >= OPTIONS_LONG_ONLY || spec->id != c)
+			continue;
+		if (!spec->hasArg)
+			return spec->id;
+
+		/* The argument either follows immediately or is the next one. */
+		if (*state->cluster)
+			state->arg = state->cluster;
+		else if (state->index < argc)
+			state->arg = argv[state->index++];
+		else
+			return fail(state, _("Option -%c requires an argument"), c);
+		state->cluster = NULL;
+		return spec->id;
+	}
+
+	return fail(state, _("Unknown option -%c"), c);
+}
@@ -0,0 +1,74 @@
+/**
+ *  @file options.h
+ *  @brief Command line option parsing.
+ *
+ *  Copyright Přemysl Janouch 2010. All rights reserved.
+ *  See the file LICENSE for licensing information.
+ *
+ *  getopt() is not available everywhere and getopt_long() even less so.
+ *  This is a small replacement supporting both short options, which may
+ *  be clustered, and long options, which may be given their argument
+ *  after an equals sign. Parsing stops at the first operand or at "--".
+ *
+ */
+
+#ifndef OPTIONS_H_INCLUDED
+#define OPTIONS_H_INCLUDED
+
+/** The first identifier free to be used for options without a short name. */
+#define OPTIONS_LONG_ONLY 0x100
+
+/** There are no more options, the state points to the first operand. */
+#define OPTIONS_END -1
+/** An unknown option or a missing argument. A message has been printed
+ *  unless the parsing is quiet, and it's kept in the state anyway. */
+#define OPTIONS_ERROR -2
+
+/** The size of the buffer for the description of an error. */
+#define OPTIONS_MESSAGE_SIZE 128
+
+/** You can initialize the OptionsState structure with this. */
+#define OPTIONS_INITIALIZER {1, NULL, NULL, 0, ""}
+
+
+/** Describes an option. An array of these is terminated with a zero id. */
+typedef struct
+{
+	/** The value returned for the option. If it's less than
+	 *  @a OPTIONS_LONG_ONLY, it is also the short name of the option. */
+	int id;
+	/** The long name of the option without leading dashes, or NULL. */
+	const char *longName;
+	/** Whether the option takes an argument. */
+	int hasArg;
+}
+OptionSpec;
+
+/** The state of parsing. */
+typedef struct
+{
+	/** The index of the next argument to be processed. */
+	int index;
+	/** The argument of the last option returned if it takes one. */
+	char *arg;
+	/** Where we are inside a cluster of short options. */
+	char *cluster;
+	/** If non-zero, errors are only described in @a message. */
+	int quiet;
+	/** The description of the last error. */
+	char message[OPTIONS_MESSAGE_SIZE];
+}
+OptionsState;
+
+
+/** Get the next option from the command line.
+ *  @param[in,out] state  The state of parsing.
+ *  @param[in] argc  The number of arguments.
+ *  @param[in] argv  The arguments, the first of which is skipped.
+ *  @param[in] spec  The accepted options.
+ *  @return The id of the option, @a OPTIONS_END or @a OPTIONS_ERROR.
+ */
+int optionsNext (OptionsState *__restrict state, int argc, char *argv[],
+	const OptionSpec *__restrict spec);
+
+#endif /* ! OPTIONS_H_INCLUDED */
@@ -0,0 +1,144 @@
+/**
+ *  @file record.c
+ *  @brief Decoding of event log records.
+ *
+ *  Copyright Přemysl Janouch 2010. All rights reserved.
+ *  See the file LICENSE for licensing information.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "configure.h"
+
+#include "xalloc.h"
+#include "datastruct.h"
+#include "evt.h"
+#include "widechar.h"
+#include "sid.h"
+#include "escape.h"
+#include "record.h"
+
+
+/** Free the decoded strings of a record, keeping the storage. */
+static void clearFields (RecordFields *fields);
+
+
+void recordFieldsInit (RecordFields *fields)
+{
+	fields->rec = NULL;
+	fields->sourceName = fields->computerName = fields->sid = NULL;
+	fields->strings = NULL;
+	fields->data = NULL;
+	fields->dataLength = 0;
+	bufferInit(&fields->stringsBuf);
+}
+
+static void clearFields (RecordFields *fields)
+{
+	free(fields->sourceName);
+	free(fields->computerName);
+	free(fields->sid);
+	fields->sourceName = fields->computerName = fields->sid = NULL;
+	bufferClear(&fields->stringsBuf);
+}
+
+void recordFieldsDestroy (RecordFields *fields)
+{
+	clearFields(fields);
+	bufferDestroy(&fields->stringsBuf);
+}
+
+void recordDecode (RecordFields *__restrict fields,
+	const EvtRecord *__restrict rec,
+	const void *__restrict nonFixed, size_t nonFixedLength)
+{
+	char *s;
+	int offset, len;
+	unsigned int n;
+
+	clearFields(fields);
+	fields->rec = rec;
+
+	/* Source name. */
+	if (!(offset = decodeWideString((uint16_t *) nonFixed,
+		nonFixedLength, &fields->sourceName)))
+	{
+		fprintf(stderr, _("Warning: Failed to decode the source name string "
+			"in record %u.\n"), rec->recordNumber);
+		fields->sourceName = NULL;
+	}
+
+	/* Computer name. */
+	if (!decodeWideString((uint16_t *) ((char *) nonFixed + offset),
+		nonFixedLength - offset, &fields->computerName))
+	{
+		fprintf(stderr, _("Warning: Failed to decode the computer name string "
+			"in record %u.\n"), rec->recordNumber);
+		fields->computerName = NULL;
+	}
+
+	/* SID. */
+	if (rec->userSidOffset + rec->userSidLength > rec->length)
+		fprintf(stderr, _("Warning: Record %u has overflowing SID field. "
+			"I'm not reading it.\n"), rec->recordNumber);
+	else if (rec->userSidLength && !(fields->sid = sidToString((char *)
+		nonFixed + rec->userSidOffset - sizeof(EvtRecord), rec->userSidLength)))
+		fprintf(stderr, _("Error: SID decoding failed in record %u.\n"),
+			rec->recordNumber);
+
+	/* Strings. */
+	offset = rec->stringOffset - sizeof(EvtRecord);
+	for (n = rec->numStrings; n--; )
+	{
+		if (!(len = decodeWideString((uint16_t *) ((char *) nonFixed + offset),
+			nonFixedLength - offset, &s)))
+		{
+			fprintf(stderr, _("Error: String decoding failed in record %u.\n"),
+				rec->recordNumber);
+			break;
+		}
+		offset += len;
+
+		escapeAppend(&fields->stringsBuf, s);
+		if (n)
+			bufferAppendChar(&fields->stringsBuf, ESCAPE_SEPARATOR);
+		free(s);
+	}
+	bufferAppendChar(&fields->stringsBuf, '\0');
+	fields->strings = fields->stringsBuf.data;
+
+	/* Data. */
+	if (rec->dataOffset + rec->dataLength > rec->length)
+	{
+		fprintf(stderr, _("Warning: Record %u has overflowing data field. "
+			"I'm not reading it.\n"), rec->recordNumber);
+		fields->data = NULL;
+		fields->dataLength = 0;
+	}
+	else
+	{
+		fields->data = (char *) nonFixed + rec->dataOffset - sizeof(EvtRecord);
+		fields->dataLength = rec->dataLength;
+	}
+}
+
+const char *recordTypeName (unsigned int type)
+{
+	switch (type)
+	{
+	case EVT_INFORMATION_TYPE:
+		return "Information";
+	case EVT_WARNING_TYPE:
+		return "Warning";
+	case EVT_ERROR_TYPE:
+		return "Error";
+	case EVT_AUDIT_SUCCESS:
+		return "Audit Success";
+	case EVT_AUDIT_FAILURE:
+		return "Audit Failure";
+	default:
+		return NULL;
+	}
+}
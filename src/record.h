@@ -0,0 +1,66 @@
+/**
+ *  @file record.h
+ *  @brief Decoding of event log records.
+ *
+ *  Copyright Přemysl Janouch 2010. All rights reserved.
+ *  See the file LICENSE for licensing information.
+ *
+ */
+
+#ifndef RECORD_H_INCLUDED
+#define RECORD_H_INCLUDED
+
+/** The variable-length fields of a record decoded into text. */
+typedef struct
+{
+	/** The fixed-length part of the record. */
+	const EvtRecord *rec;
+	/** The source name in UTF-8, or NULL if it couldn't be decoded. */
+	char *sourceName;
+	/** The computer name in UTF-8, or NULL if it couldn't be decoded. */
+	char *computerName;
+	/** The user SID in the string format, or NULL if there is none. */
+	char *sid;
+	/** The description strings in UTF-8, escaped and separated
+	 *  as described in escape.h. */
+	const char *strings;
+	/** Event-specific data, or NULL if they overflow the record. */
+	const void *data;
+	/** The length of @a data in bytes. */
+	size_t dataLength;
+
+	/** Storage for @a strings. */
+	Buffer stringsBuf;
+}
+RecordFields;
+
+
+/** Initialize a @a RecordFields object.
+ *  @param[out] fields  A RecordFields object.
+ */
+void recordFieldsInit (RecordFields *fields);
+
+/** Decode a record. Any problems with the record are reported
+ *  on the standard error output.
+ *  @param[in,out] fields  A RecordFields object. The previous contents
+ *  	are discarded.
+ *  @param[in] rec  The fixed-length part of the record.
+ *  @param[in] nonFixed  The rest of the record.
+ *  @param[in] nonFixedLength  The length of @a nonFixed in bytes.
+ */
+void recordDecode (RecordFields *__restrict fields,
+	const EvtRecord *__restrict rec,
+	const void *__restrict nonFixed, size_t nonFixedLength);
+
+/** Destroy a @a RecordFields object.
+ *  @param[in,out] fields  A RecordFields object.
+ */
+void recordFieldsDestroy (RecordFields *fields);
+
+/** Get the name of an event type.
+ *  @param[in] type  The type of event, see EvtEventType.
+ *  @return The name, or NULL if the type is not known.
+ */
+const char *recordTypeName (unsigned int type);
+
+#endif /* ! RECORD_H_INCLUDED */
@@ -0,0 +1,225 @@
+/**
+ *  @file scan.c
+ *  @brief Filtering records by their fixed fields in batches.
+ *
+ *  Copyright Přemysl Janouch 2010. All rights reserved.
+ *  See the file LICENSE for licensing information.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "configure.h"
+
+#include "xalloc.h"
+#include "datastruct.h"
+#include "evt.h"
+#include "mapfile.h"
+#include "evtlog.h"
+#include "scan.h"
+
+
+/** Add a step to a filter. */
+static void addStep (ScanFilter *filter, const ScanStep *step);
+/** Compare a column with a value, storing the results. */
+static void compareColumn (uint8_t *__restrict out,
+	const uint32_t *__restrict column, size_t count,
+	ScanCompare compare, uint32_t value);
+
+
+void scanFilterInit (ScanFilter *filter)
+{
+	filter->steps = NULL;
+	filter->count = 0;
+	filter->alloc = 0;
+	filter->depth = 0;
+	filter->maxDepth = 0;
+}
+
+static void addStep (ScanFilter *filter, const ScanStep *step)
+{
+	if (filter->count == filter->alloc)
+	{
+		filter->alloc = filter->alloc ? filter->alloc << 1 : 8;
+		filter->steps = xrealloc(filter->steps,
+			filter->alloc * sizeof(ScanStep));
+	}
+	filter->steps[filter->count++] = *step;
+}
+
+void scanFilterTest (ScanFilter *filter,
+	ScanField field, ScanCompare compare, uint32_t value)
+{
+	ScanStep step;
+
+	step.op = SCAN_TEST;
+	step.field = field;
+	step.compare = compare;
+	step.value = value;
+	addStep(filter, &step);
+
+	if (++filter->depth > filter->maxDepth)
+		filter->maxDepth = filter->depth;
+}
+
+void scanFilterOperator (ScanFilter *filter, ScanOp op)
+{
+	ScanStep step;
+
+	memset(&step, 0, sizeof(step));
+	step.op = op;
+	addStep(filter, &step);
+
+	if (op != SCAN_NOT)
+		filter->depth--;
+}
+
+void scanFilterDestroy (ScanFilter *filter)
+{
+	free(filter->steps);
+}
+
+ScanBatch *scanBatchCreate (void)
+{
+	ScanBatch *batch;
+
+	batch = xmalloc(sizeof(ScanBatch));
+	batch->count = 0;
+	batch->stack = NULL;
+	batch->stackSize = 0;
+	return batch;
+}
+
+EvtLogStatus scanBatchRead (ScanBatch *__restrict batch,
+	EvtLog *__restrict log, EvtLogStatus (*next)
+	(EvtLog *__restrict, EvtLogRecord *__restrict), size_t limit)
+{
+	EvtLogRecord *record;
+	EvtLogStatus status = EVT_LOG_RECORD;
+	size_t i;
+
+	if (limit > SCAN_BATCH_SIZE)
+		limit = SCAN_BATCH_SIZE;
+
+	for (i = 0; i < limit; i++)
+	{
+		record = &batch->records[i];
+		if ((status = next(log, record)) != EVT_LOG_RECORD)
+			break;
+
+		batch->columns[SCAN_RECORD_NUMBER][i]  = record->rec->recordNumber;
+		batch->columns[SCAN_TIME_GENERATED][i] = record->rec->timeGenerated;
+		batch->columns[SCAN_TIME_WRITTEN][i]   = record->rec->timeWritten;
+		batch->columns[SCAN_EVENT_ID][i]       = record->rec->eventID;
+		batch->columns[SCAN_EVENT_TYPE][i]     = record->rec->eventType;
+		batch->columns[SCAN_EVENT_CATEGORY][i] = record->rec->eventCategory;
+
+		/* A record put together from both ends of the file lives
+		 * in storage that the next read reuses. */
+		if (record->nonFixed == log->scratch.data)
+		{
+			i++;
+			break;
+		}
+	}
+
+	batch->count = i;
+	return status;
+}
+
+static void compareColumn (uint8_t *__restrict out,
+	const uint32_t *__restrict column, size_t count,
+	ScanCompare compare, uint32_t value)
+{
+	size_t i;
+
+	/* Keeping the comparison out of the loops lets them be vectorized. */
+	switch (compare)
+	{
+	case SCAN_EQ:
+		for (i = 0; i < count; i++)
+			out[i] = column[i] == value;
+		break;
+	case SCAN_NE:
+		for (i = 0; i < count; i++)
+			out[i] = column[i] != value;
+		break;
+	case SCAN_LT:
+		for (i = 0; i < count; i++)
+			out[i] = column[i] < value;
+		break;
+	case SCAN_LE:
+		for (i = 0; i < count; i++)
+			out[i] = column[i] <= value;
+		break;
+	case SCAN_GT:
+		for (i = 0; i < count; i++)
+			out[i] = column[i] > value;
+		break;
+	case SCAN_GE:
+		for (i = 0; i < count; i++)
+			out[i] = column[i] >= value;
+		break;
+	}
+}
+
+void scanBatchSelect (ScanBatch *__restrict batch,
+	const ScanFilter *__restrict filter)
+{
+	uint8_t *top = NULL, *below;
+	size_t i, k;
+
+	if (scanFilterIsEmpty(filter))
+	{
+		memset(batch->selected, 1, batch->count);
+		return;
+	}
+
+	if (batch->stackSize < filter->maxDepth)
+	{
+		batch->stackSize = filter->maxDepth;
+		batch->stack = xrealloc(batch->stack,
+			batch->stackSize * SCAN_BATCH_SIZE);
+	}
+
+	for (i = 0; i < filter->count; i++)
+	{
+		const ScanStep *step = &filter->steps[i];
+
+		switch (step->op)
+		{
+		case SCAN_TEST:
+			top = top ? top + SCAN_BATCH_SIZE : batch->stack;
+			compareColumn(top, batch->columns[step->field], batch->count,
+				step->compare, step->value);
+			break;
+		case SCAN_AND:
+			below = top - SCAN_BATCH_SIZE;
+			for (k = 0; k < batch->count; k++)
+				below[k] &= top[k];
+			top = below;
+			break;
+		case SCAN_OR:
+			below = top - SCAN_BATCH_SIZE;
+			for (k = 0; k < batch->count; k++)
+				below[k] |= top[k];
+			top = below;
+			break;
+		case SCAN_NOT:
+			for (k = 0; k < batch->count; k++)
+				top[k] ^= 1;
+			break;
+		}
+	}
+
+	/* What's left on the stack is the result. */
+	memcpy(batch->selected, batch->stack, batch->count);
+}
+
+void scanBatchDestroy (ScanBatch *batch)
+{
+	free(batch->stack);
+	free(batch);
+}
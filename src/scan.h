@@ -0,0 +1,182 @@
+/**
+ *  @file scan.h
+ *  @brief Filtering records by their fixed fields in batches.
+ *
+ *  Copyright Přemysl Janouch 2010. All rights reserved.
+ *  See the file LICENSE for licensing information.
+ *
+ *  Records are read in batches whose fixed fields are gathered into
+ *  columns, one array per field. A filter is then evaluated a whole column
+ *  at a time, each comparison being a tight loop that the compiler turns
+ *  into vector instructions, and yields a selection of the records
+ *  in the batch. Nothing but the fixed part of a record that isn't
+ *  selected is ever looked at.
+ *
+ *  Filters are programs in postfix notation: tests push the selection
+ *  of records for which they hold, the logical operators combine
+ *  the selections on top of the stack.
+ *
+ */
+
+#ifndef SCAN_H_INCLUDED
+#define SCAN_H_INCLUDED
+
+/** How many records are there in a batch at most. */
+#define SCAN_BATCH_SIZE 256
+
+/** Fixed fields of records that may be tested. */
+typedef enum
+{
+	SCAN_RECORD_NUMBER,
+	SCAN_TIME_GENERATED,
+	SCAN_TIME_WRITTEN,
+	SCAN_EVENT_ID,
+	SCAN_EVENT_TYPE,
+	SCAN_EVENT_CATEGORY,
+	SCAN_FIELD_COUNT
+}
+ScanField;
+
+/** How a field is compared with a value. */
+typedef enum
+{
+	SCAN_EQ,
+	SCAN_NE,
+	SCAN_LT,
+	SCAN_LE,
+	SCAN_GT,
+	SCAN_GE
+}
+ScanCompare;
+
+/** Kinds of steps of a filter. */
+typedef enum
+{
+	/** Compare a field with a value. */
+	SCAN_TEST,
+	/** Both of the two topmost selections. */
+	SCAN_AND,
+	/** Either of the two topmost selections. */
+	SCAN_OR,
+	/** Negate the topmost selection. */
+	SCAN_NOT
+}
+ScanOp;
+
+/** A step of a filter. */
+typedef struct
+{
+	/** What the step does. */
+	ScanOp op;
+	/** The field to test. */
+	ScanField field;
+	/** How to compare the field. */
+	ScanCompare compare;
+	/** The value to compare the field with. */
+	uint32_t value;
+}
+ScanStep;
+
+/** A filter on fixed fields of records. */
+typedef struct
+{
+	/** The steps of the filter. */
+	ScanStep *steps;
+	/** The number of @a steps. */
+	size_t count;
+	/** How many steps have been allocated. */
+	size_t alloc;
+	/** The number of selections on the stack at the moment. */
+	size_t depth;
+	/** The largest number of selections on the stack at once. */
+	size_t maxDepth;
+}
+ScanFilter;
+
+/** A batch of records. */
+typedef struct
+{
+	/** The records. */
+	EvtLogRecord records[SCAN_BATCH_SIZE];
+	/** The number of @a records. */
+	size_t count;
+	/** The fixed fields of the records, gathered by field. */
+	uint32_t columns[SCAN_FIELD_COUNT][SCAN_BATCH_SIZE];
+	/** Non-zero for records that have passed the filter. */
+	uint8_t selected[SCAN_BATCH_SIZE];
+	/** The stack of selections for evaluating filters. */
+	uint8_t *stack;
+	/** How many selections fit in @a stack. */
+	size_t stackSize;
+}
+ScanBatch;
+
+
+/** Initialize a filter that lets every record through.
+ *  @param[out] filter  A ScanFilter structure.
+ */
+void scanFilterInit (ScanFilter *filter);
+
+/** Add a test of a field to a filter.
+ *  @param[in,out] filter  A filter.
+ *  @param[in] field  The field to test.
+ *  @param[in] compare  How to compare the field.
+ *  @param[in] value  The value to compare the field with.
+ */
+void scanFilterTest (ScanFilter *filter,
+	ScanField field, ScanCompare compare, uint32_t value);
+
+/** Add a logical operator to a filter. The operator has to have
+ *  enough operands on the stack.
+ *  @param[in,out] filter  A filter.
+ *  @param[in] op  SCAN_AND, SCAN_OR or SCAN_NOT.
+ */
+void scanFilterOperator (ScanFilter *filter, ScanOp op);
+
+/** Find out whether a filter tests anything at all.
+ *  @param[in] filter  A filter.
+ *  @return Non-zero if the filter lets every record through.
+ */
+static inline int scanFilterIsEmpty (const ScanFilter *filter)
+{
+	return !filter->count;
+}
+
+/** Destroy a filter.
+ *  @param[in,out] filter  A filter.
+ */
+void scanFilterDestroy (ScanFilter *filter);
+
+/** Create an empty batch.
+ *  @return The batch.
+ */
+ScanBatch *scanBatchCreate (void);
+
+/** Read a batch of records. Records are read until the batch is full,
+ *  the limit is reached or a record is read that won't stay valid after
+ *  the next one is read, i.e. one that wraps around the end of the file.
+ *  @param[in,out] batch  A batch. The previous contents are discarded.
+ *  @param[in,out] log  An opened log.
+ *  @param[in] next  evtLogNext() or evtLogPrev().
+ *  @param[in] limit  How many records to read at most.
+ *  @return EVT_LOG_END when there are no more records, otherwise
+ *  	the status of the last read. There may be records in the batch
+ *  	even at the end.
+ */
+EvtLogStatus scanBatchRead (ScanBatch *__restrict batch,
+	EvtLog *__restrict log, EvtLogStatus (*next)
+	(EvtLog *__restrict, EvtLogRecord *__restrict), size_t limit);
+
+/** Evaluate a filter over a batch, filling in @a batch->selected.
+ *  @param[in,out] batch  A batch of records.
+ *  @param[in] filter  A filter.
+ */
+void scanBatchSelect (ScanBatch *__restrict batch,
+	const ScanFilter *__restrict filter);
+
+/** Destroy a batch.
+ *  @param[in,out] batch  A batch.
+ */
+void scanBatchDestroy (ScanBatch *batch);
+
+#endif /* ! SCAN_H_INCLUDED */
@@ -0,0 +1,418 @@
+/**
+ *  @file shardsink.c
+ *  @brief A sink distributing records into several CSV files.
+ *
+ *  Copyright Přemysl Janouch 2010. All rights reserved.
+ *  See the file LICENSE for licensing information.
+ *
+ *  Every shard is a complete CSV file, file size record included, that
+ *  can be processed on its own. Only a limited number of the files is kept
+ *  open at a time; when another one is needed, the least recently used one
+ *  is closed and later reopened for appending.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "configure.h"
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif /* HAVE_ZLIB */
+
+#include "xalloc.h"
+#include "datastruct.h"
+#include "evt.h"
+#include "record.h"
+#include "sink.h"
+
+
+/** How many shard files may be open at once. */
+#define SHARD_MAX_OPEN 64
+/** The size of the stream buffer of each shard file. */
+#define SHARD_BUFFER_SIZE (64 << 10)
+/** Marks the end of the list of open shards. */
+#define SHARD_NONE ((size_t) -1)
+
+/** A single output file. */
+typedef struct
+{
+	/** The path to the file. */
+	char *path;
+	/** The open file, or NULL. */
+	FILE *fp;
+	/** The CSV sink writing into @a fp, or NULL. */
+	Sink *csv;
+	/** Whether the file has already been created. */
+	int created;
+	/** Whether the file has been completed and mustn't be written to. */
+	int finished;
+	/** Links in the list of open shards, most recently used first. */
+	size_t prev, next;
+}
+Shard;
+
+/** A sink distributing records into several CSV files. */
+typedef struct
+{
+	/** The methods. */
+	Sink sink;
+	/** The beginning of paths to the files. */
+	char *prefix;
+	/** What decides about the shard of a record. */
+	ShardKey key;
+	/** The length of time buckets or the maximum size of a file. */
+	unsigned long param;
+	/** Whether to compress the files once they're finished. */
+	int compress;
+
+	/** The header of the current log. */
+	EvtHeader hdr;
+	/** The size of the first log file, for the file size records. */
+	unsigned long fileSize;
+	/** Whether @a fileSize has been set. */
+	int begun;
+
+	/** Names of the shards, their identifiers are indexes to @a shards
+	 *  plus one. */
+	StringTable names;
+	/** The shards. */
+	Shard *shards;
+	/** How many shards have been allocated. */
+	size_t alloc;
+	/** The most and least recently used open shards. */
+	size_t mru, lru;
+	/** How many shards are open. */
+	size_t nOpen;
+	/** The number of the current file when rotating by size. */
+	unsigned long sequence;
+	/** Storage for the name of a shard. */
+	Buffer name;
+}
+ShardSink;
+
+
+static int shardSinkBegin (Sink *__restrict self,
+	const EvtHeader *__restrict hdr, unsigned long fileSize);
+static int shardSinkWrite (Sink *__restrict self,
+	const RecordFields *__restrict fields);
+static int shardSinkClose (Sink *self);
+
+/** Put the name of the shard for a record in @a sink->name. */
+static void makeShardName (ShardSink *__restrict sink,
+	const RecordFields *__restrict fields);
+/** Find the shard for a record, opening its file if necessary. */
+static Shard *getShard (ShardSink *__restrict sink,
+	const RecordFields *__restrict fields);
+/** Remove a shard from the list of open shards. */
+static void unlinkShard (ShardSink *sink, size_t index);
+/** Close the file of a shard. */
+static int closeShard (ShardSink *sink, size_t index);
+/** Close the file of a shard for good and compress it if requested. */
+static int finishShard (ShardSink *sink, size_t index);
+
+#ifdef HAVE_ZLIB
+/** Compress a file with gzip, replacing it with one with a .gz suffix. */
+static int compressFile (const char *path);
+#endif /* HAVE_ZLIB */
+
+
+Sink *sinkCreateShard (const char *prefix, ShardKey key,
+	unsigned long param, int compress)
+{
+	ShardSink *self;
+
+	self = xmalloc(sizeof(ShardSink));
+	self->sink.begin = shardSinkBegin;
+	self->sink.write = shardSinkWrite;
+	self->sink.close = shardSinkClose;
+
+	self->prefix = xmalloc(strlen(prefix) + 1);
+	strcpy(self->prefix, prefix);
+	self->key = key;
+	self->param = param;
+	self->compress = compress;
+
+	self->fileSize = 0;
+	self->begun = 0;
+
+	stringTableInit(&self->names);
+	self->shards = NULL;
+	self->alloc = 0;
+	self->mru = self->lru = SHARD_NONE;
+	self->nOpen = 0;
+	self->sequence = 0;
+	bufferInit(&self->name);
+	return &self->sink;
+}
+
+static int shardSinkBegin (Sink *__restrict self,
+	const EvtHeader *__restrict hdr, unsigned long fileSize)
+{
+	ShardSink *sink = (ShardSink *) self;
+
+	/* Like with a single CSV file, the size of the first log is used. */
+	sink->hdr = *hdr;
+	if (!sink->begun)
+		sink->fileSize = fileSize;
+	sink->begun = 1;
+	return 0;
+}
+
+static int shardSinkWrite (Sink *__restrict self,
+	const RecordFields *__restrict fields)
+{
+	ShardSink *sink = (ShardSink *) self;
+	Shard *shard;
+
+	if (!(shard = getShard(sink, fields))
+		|| shard->csv->write(shard->csv, fields))
+		return 1;
+
+	if (sink->key == SHARD_BY_SIZE
+		&& (unsigned long) ftell(shard->fp) >= sink->param)
+	{
+		sink->sequence++;
+		return finishShard(sink, shard - sink->shards);
+	}
+	return 0;
+}
+
+static int shardSinkClose (Sink *self)
+{
+	ShardSink *sink = (ShardSink *) self;
+	size_t i, count;
+	int ret = 0;
+
+	count = sink->names.count;
+	for (i = 0; i < count; i++)
+	{
+		if (!sink->shards[i].finished)
+			ret |= finishShard(sink, i);
+		free(sink->shards[i].path);
+	}
+
+	free(sink->shards);
+	stringTableDestroy(&sink->names);
+	bufferDestroy(&sink->name);
+	free(sink->prefix);
+	free(sink);
+	return ret;
+}
+
+static void makeShardName (ShardSink *__restrict sink,
+	const RecordFields *__restrict fields)
+{
+	const EvtRecord *rec = fields->rec;
+	const char *name = NULL;
+	char *p;
+	time_t bucket;
+	/* Yes, the buffer is large enough. */
+	char buff[40];
+
+	switch (sink->key)
+	{
+	case SHARD_BY_SOURCE:
+		name = fields->sourceName;
+		break;
+	case SHARD_BY_EVENT_ID:
+		snprintf(buff, sizeof(buff), "%u", rec->eventID);
+		name = buff;
+		break;
+	case SHARD_BY_TYPE:
+		if (!(name = recordTypeName(rec->eventType)))
+		{
+			snprintf(buff, sizeof(buff), "%u", rec->eventType);
+			name = buff;
+		}
+		break;
+	case SHARD_BY_TIME:
+		bucket = rec->timeGenerated - rec->timeGenerated % sink->param;
+		strftime(buff, sizeof(buff), "%Y%m%d-%H%M%S", gmtime(&bucket));
+		name = buff;
+		break;
+	case SHARD_BY_SIZE:
+		snprintf(buff, sizeof(buff), "%05lu", sink->sequence);
+		name = buff;
+	}
+	if (!name || !*name)
+		name = "unknown";
+
+	/* The name mustn't change the directory the file goes to. */
+	bufferClear(&sink->name);
+	bufferAppend(&sink->name, name, strlen(name) + 1, 0);
+	for (p = sink->name.data; *p; p++)
+	{
+		if ((*p < 'a' || *p > 'z') && (*p < 'A' || *p > 'Z')
+			&& (*p < '0' || *p > '9') && *p != '-' && *p != '.')
+			*p = '_';
+	}
+}
+
+static Shard *getShard (ShardSink *__restrict sink,
+	const RecordFields *__restrict fields)
+{
+	Shard *shard;
+	size_t index;
+	int added;
+
+	makeShardName(sink, fields);
+	index = stringTableIntern(&sink->names, sink->name.data, &added) - 1;
+	if (added)
+	{
+		if (index >= sink->alloc)
+		{
+			sink->alloc = sink->alloc ? sink->alloc << 1 : 16;
+			sink->shards = xrealloc(sink->shards,
+				sink->alloc * sizeof(Shard));
+		}
+
+		shard = &sink->shards[index];
+		shard->path = xmalloc(strlen(sink->prefix)
+			+ sink->name.used + sizeof(".csv"));
+		sprintf(shard->path, "%s%s.csv", sink->prefix,
+			(const char *) sink->name.data);
+		shard->fp = NULL;
+		shard->csv = NULL;
+		shard->created = 0;
+		shard->finished = 0;
+	}
+
+	shard = &sink->shards[index];
+	if (shard->fp)
+	{
+		/* Move the shard to the front of the list. */
+		unlinkShard(sink, index);
+	}
+	else
+	{
+		if (sink->nOpen == SHARD_MAX_OPEN && closeShard(sink, sink->lru))
+			return NULL;
+
+		if (!(shard->fp = fopen(shard->path, shard->created ? "ab" : "wb")))
+		{
+			fprintf(stderr, _("Error: Failed to open %s for writing.\n"),
+				shard->path);
+			return NULL;
+		}
+		setvbuf(shard->fp, NULL, _IOFBF, SHARD_BUFFER_SIZE);
+		shard->csv = sinkCreateCsv(shard->fp, NULL);
+
+		/* A reopened file already has its file size record. */
+		if (!shard->created)
+			shard->csv->begin(shard->csv, &sink->hdr, sink->fileSize);
+		shard->created = 1;
+		sink->nOpen++;
+	}
+
+	shard->prev = SHARD_NONE;
+	shard->next = sink->mru;
+	if (sink->mru != SHARD_NONE)
+		sink->shards[sink->mru].prev = index;
+	else
+		sink->lru = index;
+	sink->mru = index;
+	return shard;
+}
+
+static void unlinkShard (ShardSink *sink, size_t index)
+{
+	Shard *shard = &sink->shards[index];
+
+	if (shard->prev != SHARD_NONE)
+		sink->shards[shard->prev].next = shard->next;
+	else
+		sink->mru = shard->next;
+
+	if (shard->next != SHARD_NONE)
+		sink->shards[shard->next].prev = shard->prev;
+	else
+		sink->lru = shard->prev;
+}
+
+static int closeShard (ShardSink *sink, size_t index)
+{
+	Shard *shard = &sink->shards[index];
+	int ret;
+
+	unlinkShard(sink, index);
+	sink->nOpen--;
+
+	ret = shard->csv->close(shard->csv);
+	if (fclose(shard->fp))
+	{
+		fprintf(stderr, _("Error: Failed to write to %s.\n"), shard->path);
+		ret = 1;
+	}
+	shard->fp = NULL;
+	shard->csv = NULL;
+	return ret;
+}
+
+static int finishShard (ShardSink *sink, size_t index)
+{
+	Shard *shard = &sink->shards[index];
+
+	shard->finished = 1;
+	if (shard->fp && closeShard(sink, index))
+		return 1;
+
+#ifdef HAVE_ZLIB
+	if (sink->compress)
+		return compressFile(shard->path);
+#endif /* HAVE_ZLIB */
+	return 0;
+}
+
+#ifdef HAVE_ZLIB
+static int compressFile (const char *path)
+{
+	FILE *in;
+	gzFile out;
+	char *buff, *gzPath;
+	size_t length;
+	int ret = 1;
+
+	gzPath = xmalloc(strlen(path) + sizeof(".gz"));
+	sprintf(gzPath, "%s.gz", path);
+
+	if (!(in = fopen(path, "rb")))
+	{
+		fprintf(stderr, _("Error: Failed to open %s for reading.\n"), path);
+		free(gzPath);
+		return 1;
+	}
+	if (!(out = gzopen(gzPath, "wb")))
+	{
+		fprintf(stderr, _("Error: Failed to open %s for writing.\n"), gzPath);
+		fclose(in);
+		free(gzPath);
+		return 1;
+	}
+
+	buff = xmalloc(SHARD_BUFFER_SIZE);
+	while ((length = fread(buff, 1, SHARD_BUFFER_SIZE, in)))
+	{
+		if (gzwrite(out, buff, length) != (int) length)
+			goto compressFile_end;
+	}
+	if (!ferror(in))
+		ret = 0;
+
+compressFile_end:
+	if (gzclose(out) != Z_OK)
+		ret = 1;
+	fclose(in);
+	if (ret)
+		fprintf(stderr, _("Error: Failed to compress %s.\n"), path);
+	else
+		remove(path);
+
+	free(buff);
+	free(gzPath);
+	return ret;
+}
+#endif /* HAVE_ZLIB */
@@ -122,55 +122,89 @@ char *sidToString (const void *sid, size_t length)
 	return buff;
 }
 
+void *sidToBinary (const char *__restrict sid, size_t *__restrict length)
+{
+	Buffer buf = BUFFER_INITIALIZER;
+
+	if (sidToBinaryBuffer(sid, &buf, 0) == -1)
+	{
+		bufferDestroy(&buf);
+		return NULL;
+	}
+	*length = buf.used;
+	return buf.data;
+}
+
 /* This function accepts a little bit wider range of inputs than those
  * which are really valid (thanks to those strtol-class functions).
  * This might be restricted, however it's not that important.
  */
-void *sidToBinary (const char *__restrict sid, size_t *__restrict length)
+int sidToBinaryBuffer (const char *__restrict sid, Buffer *__restrict buf,
+	size_t align)
 {
-	Buffer buf = BUFFER_INITIALIZER;
-	Sid head;
+	Sid *head;
+	uint32_t *subAuths;
+	const char *p;
 	char *cur;
 	long num;
 	long long auth;
+	size_t before, reserved;
+	int offset, maxSubAuths = -2;
 
 	if (sid[0] != 'S' || sid[1] != '-')
-		return NULL;
+		return -1;
+
+	/* Every subauthority is preceded by a dash and there are two more
+	 * of them in front of the identifier authority. This gives us an upper
+	 * bound on the size of the result, so that we can write it in place.
+	 */
+	for (p = sid; *p; p++)
+		if (*p == '-')
+			maxSubAuths++;
+	if (maxSubAuths < 0)
+		maxSubAuths = 0;
+
+	before = buf->used;
+	reserved = sizeof(Sid) + maxSubAuths * sizeof(uint32_t);
+	offset = bufferAppend(buf, NULL, reserved, align);
+	head = (Sid *) ((char *) buf->data + offset);
+	subAuths = (uint32_t *) ((char *) head + sizeof(Sid));
 
 	num = strtol(sid + 2, &cur, 10);
 	if (*cur != '-' || num < 0 || num > UINT8_MAX)
-		return NULL;
-	head.revision = (uint8_t) num;
+		goto sidToBinaryBuffer_fail;
+	head->revision = (uint8_t) num;
 
 	auth = strtoll(cur + 1, &cur, 10);
 	if (*cur && *cur != '-')
-		return NULL;
+		goto sidToBinaryBuffer_fail;
 
 	/* Put that value into the array in big-endian format. */
-	head.identifierAuthority[0] = (auth >> 40) & 0xFF;
-	head.identifierAuthority[1] = (auth >> 32) & 0xFF;
-	head.identifierAuthority[2] = (auth >> 24) & 0xFF;
-	head.identifierAuthority[3] = (auth >> 16) & 0xFF;
-	head.identifierAuthority[4] = (auth >> 8)  & 0xFF;
-	head.identifierAuthority[5] = (auth)       & 0xFF;
-
-	head.subAuthorityCnt = 0;
-	bufferAppend(&buf, &head, sizeof(head), 0);
-
+	head->identifierAuthority[0] = (auth >> 40) & 0xFF;
+	head->identifierAuthority[1] = (auth >> 32) & 0xFF;
+	head->identifierAuthority[2] = (auth >> 24) & 0xFF;
+	head->identifierAuthority[3] = (auth >> 16) & 0xFF;
+	head->identifierAuthority[4] = (auth >> 8)  & 0xFF;
+	head->identifierAuthority[5] = (auth)       & 0xFF;
+
+	head->subAuthorityCnt = 0;
 	while (*cur)
 	{
 		uint32_t sa;
 
 		sa = strtol(cur + 1, &cur, 10);
 		if (*cur && *cur != '-')
-		{
-			bufferDestroy(&buf);
-			return NULL;
-		}
-		((Sid *) buf.data)->subAuthorityCnt++;
-		bufferAppend(&buf, &sa, sizeof(uint32_t), 0);
+			goto sidToBinaryBuffer_fail;
+		if (head->subAuthorityCnt == UINT8_MAX)
+			goto sidToBinaryBuffer_fail;
+		subAuths[head->subAuthorityCnt++] = sa;
 	}
-	*length = buf.used;
-	return buf.data;
-}
 
+	bufferShrink(buf, (maxSubAuths - head->subAuthorityCnt)
+		* sizeof(uint32_t));
+	return offset;
+
+sidToBinaryBuffer_fail:
+	bufferShrink(buf, buf->used - before);
+	return -1;
+}
@@ -26,5 +26,17 @@ char *sidToString (const void *sid, size_t length);
  */
 void *sidToBinary (const char *__restrict sid, size_t *__restrict length);
 
+/** Convert a string SID to a binary SID right into a buffer.
+ *  @param[in] sid  A SID in the string format.
+ *  @param[in,out] buf  The buffer to append the binary SID to.
+ *  @param[in] align  If non-zero, align the SID in the buffer
+ *                    on the specified boundary.
+ *  @return On success, the offset at which the binary SID has been placed
+ *  	into the buffer. On failure the buffer is left as it was
+ *  	and the function returns -1.
+ */
+int sidToBinaryBuffer (const char *__restrict sid, Buffer *__restrict buf,
+	size_t align);
+
 #endif /* ! SID_H_INCLUDED */
 
@@ -0,0 +1,111 @@
+/**
+ *  @file sink.h
+ *  @brief Outputs for decoded event log records.
+ *
+ *  Copyright Přemysl Janouch 2010. All rights reserved.
+ *  See the file LICENSE for licensing information.
+ *
+ */
+
+#ifndef SINK_H_INCLUDED
+#define SINK_H_INCLUDED
+
+/** An output for decoded records. Particular sinks embed this structure
+ *  at their beginning and fill in the methods. The methods return zero
+ *  on success and non-zero on failure, having printed an error message.
+ */
+typedef struct Sink Sink;
+
+struct Sink
+{
+	/** Start a new log. This is called before any of its records
+	 *  is written, and may be called again for another log.
+	 *  @param[in] hdr  The header of the log.
+	 *  @param[in] fileSize  The size of the log file in bytes.
+	 */
+	int (*begin) (Sink *__restrict self, const EvtHeader *__restrict hdr,
+		unsigned long fileSize);
+	/** Write a record.
+	 *  @param[in] fields  The decoded record.
+	 */
+	int (*write) (Sink *__restrict self,
+		const RecordFields *__restrict fields);
+	/** Finish the output and destroy the sink. */
+	int (*close) (Sink *self);
+};
+
+
+/** Create a sink writing CSV.
+ *  @param[in] output  The file stream to write the CSV into.
+ *  @param[in] blob  If not NULL, event data are written into this file
+ *  	and the CSV only contains references to them.
+ *  @return A new sink.
+ */
+Sink *sinkCreateCsv (FILE *__restrict output, FILE *__restrict blob);
+
+/** Create a sink writing a summary of the records, see summary.h.
+ *  The summary is only written when the sink is closed.
+ *  @param[in] output  The file stream to write the summary into.
+ *  @return A new sink.
+ */
+Sink *sinkCreateSummary (FILE *output);
+
+/** Create a sink writing records as JSON objects, one per line.
+ *  @param[in] output  The file stream to write the objects into.
+ *  @return A new sink.
+ */
+Sink *sinkCreateJson (FILE *output);
+
+/** Create a sink counting records by their type, source name and event
+ *  identifier. The counts are written in CSV when the sink is closed.
+ *  @param[in] output  The file stream to write the counts into.
+ *  @return A new sink.
+ */
+Sink *sinkCreateStats (FILE *output);
+
+/** Create a sink passing records on to several other sinks, in order.
+ *  The records are only decoded once, no matter how many sinks there are.
+ *  @param[in] sinks  The sinks.
+ *  @param[in] count  The number of @a sinks.
+ *  @return A new sink that owns all of the sinks.
+ */
+Sink *sinkCreateTee (Sink *const *sinks, size_t count);
+
+/** What decides about the shard a record goes to. */
+typedef enum
+{
+	/** The source name. */
+	SHARD_BY_SOURCE,
+	/** The event identifier. */
+	SHARD_BY_EVENT_ID,
+	/** The type of event. */
+	SHARD_BY_TYPE,
+	/** The time generated, in buckets of a given length. */
+	SHARD_BY_TIME,
+	/** Nothing, a new shard is started once a given size is reached. */
+	SHARD_BY_SIZE
+}
+ShardKey;
+
+/** Create a sink distributing records into several CSV files.
+ *  @param[in] prefix  The beginning of paths to the files. The name of
+ *  	the shard and a ".csv" suffix are appended to it.
+ *  @param[in] key  What decides about the shard a record goes to.
+ *  @param[in] param  The length of time buckets in seconds for
+ *  	@a SHARD_BY_TIME, or the size of files in bytes for @a SHARD_BY_SIZE.
+ *  @param[in] compress  Whether to compress the files with gzip once
+ *  	they're complete. This requires zlib support.
+ *  @return A new sink.
+ */
+Sink *sinkCreateShard (const char *prefix, ShardKey key,
+	unsigned long param, int compress);
+
+#ifdef HAVE_SQLITE3
+/** Create a sink loading records into a new SQLite database.
+ *  @param[in] path  The path to the database file.
+ *  @return A new sink, or NULL on failure. An error message is printed.
+ */
+Sink *sinkCreateSqlite (const char *path);
+#endif /* HAVE_SQLITE3 */
+
+#endif /* ! SINK_H_INCLUDED */
@@ -0,0 +1,297 @@
+/**
+ *  @file sqlsink.c
+ *  @brief A sink loading records into an SQLite database.
+ *
+ *  Copyright Přemysl Janouch 2010. All rights reserved.
+ *  See the file LICENSE for licensing information.
+ *
+ *  The database is set up for a bulk load: there's no journal, no syncing,
+ *  records go in large transactions through a single prepared statement
+ *  and indexes are only created once everything has been loaded.
+ *  Source names, computer names and SIDs repeat a lot, so they are
+ *  interned in memory and stored in separate lookup tables.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <sqlite3.h>
+
+#include "configure.h"
+
+#include "xalloc.h"
+#include "datastruct.h"
+#include "evt.h"
+#include "record.h"
+#include "sink.h"
+
+
+/** How many records to insert in a single transaction. */
+#define SQLITE_SINK_BATCH 100000
+
+
+/** Lookup tables. */
+typedef enum
+{
+	LOOKUP_SOURCES,
+	LOOKUP_COMPUTERS,
+	LOOKUP_SIDS,
+	/* The number of lookup tables. */
+	LOOKUP_COUNT
+}
+LookupTable;
+
+/** A sink loading records into an SQLite database. */
+typedef struct
+{
+	/** The methods. */
+	Sink sink;
+	/** The database connection. */
+	sqlite3 *db;
+	/** Statement inserting a record. */
+	sqlite3_stmt *insertRecord;
+	/** Statements inserting into lookup tables, see @a LookupTable. */
+	sqlite3_stmt *insertLookup[LOOKUP_COUNT];
+	/** In-memory copies of the lookup tables. */
+	StringTable lookup[LOOKUP_COUNT];
+	/** How many records have been inserted in the current transaction. */
+	unsigned long pending;
+}
+SqliteSink;
+
+
+/** Set up the database for a bulk load and create the tables. */
+static const char schemaSql[] =
+	"PRAGMA journal_mode = OFF;"
+	"PRAGMA synchronous = OFF;"
+	"PRAGMA locking_mode = EXCLUSIVE;"
+	"PRAGMA temp_store = MEMORY;"
+	"PRAGMA cache_size = -65536;"
+	"CREATE TABLE sources (id INTEGER PRIMARY KEY, name TEXT NOT NULL);"
+	"CREATE TABLE computers (id INTEGER PRIMARY KEY, name TEXT NOT NULL);"
+	"CREATE TABLE sids (id INTEGER PRIMARY KEY, sid TEXT NOT NULL);"
+	"CREATE TABLE records ("
+		"recordNumber INTEGER NOT NULL, "
+		"timeGenerated INTEGER NOT NULL, "
+		"timeWritten INTEGER NOT NULL, "
+		"eventID INTEGER NOT NULL, "
+		"eventType INTEGER NOT NULL, "
+		"eventCategory INTEGER NOT NULL, "
+		"source INTEGER REFERENCES sources (id), "
+		"computer INTEGER REFERENCES computers (id), "
+		"sid INTEGER REFERENCES sids (id), "
+		"strings TEXT NOT NULL, "
+		"data BLOB);"
+	"CREATE VIEW events AS SELECT "
+		"r.recordNumber AS recordNumber, "
+		"datetime(r.timeGenerated, 'unixepoch') AS timeGenerated, "
+		"datetime(r.timeWritten, 'unixepoch') AS timeWritten, "
+		"r.eventID AS eventID, "
+		"CASE r.eventType "
+			"WHEN 1 THEN 'Error' WHEN 2 THEN 'Warning' "
+			"WHEN 4 THEN 'Information' WHEN 8 THEN 'Audit Success' "
+			"WHEN 16 THEN 'Audit Failure' ELSE r.eventType END AS eventType, "
+		"r.eventCategory AS eventCategory, "
+		"so.name AS source, co.name AS computer, si.sid AS sid, "
+		"r.strings AS strings, r.data AS data "
+		"FROM records r "
+		"LEFT JOIN sources so ON so.id = r.source "
+		"LEFT JOIN computers co ON co.id = r.computer "
+		"LEFT JOIN sids si ON si.id = r.sid;"
+	"BEGIN;";
+
+/** Finish the load. */
+static const char indexSql[] =
+	"COMMIT;"
+	"CREATE UNIQUE INDEX sources_name ON sources (name);"
+	"CREATE UNIQUE INDEX computers_name ON computers (name);"
+	"CREATE UNIQUE INDEX sids_sid ON sids (sid);"
+	"CREATE INDEX records_time ON records (timeGenerated);"
+	"CREATE INDEX records_event ON records (eventID);"
+	"CREATE INDEX records_source ON records (source);"
+	"CREATE INDEX records_sid ON records (sid);";
+
+static const char insertRecordSql[] =
+	"INSERT INTO records VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)";
+
+static const char *insertLookupSql[LOOKUP_COUNT] =
+{
+	"INSERT INTO sources VALUES (?, ?)",
+	"INSERT INTO computers VALUES (?, ?)",
+	"INSERT INTO sids VALUES (?, ?)"
+};
+
+
+static int sqliteSinkBegin (Sink *__restrict self,
+	const EvtHeader *__restrict hdr, unsigned long fileSize);
+static int sqliteSinkWrite (Sink *__restrict self,
+	const RecordFields *__restrict fields);
+static int sqliteSinkClose (Sink *self);
+
+/** Print the last error of the database connection. */
+static void printError (sqlite3 *db);
+
+/** Bind the identifier of a string in a lookup table to a statement
+ *  parameter, adding the string to the table first if needed.
+ */
+static int bindLookup (SqliteSink *__restrict sink, LookupTable table,
+	int param, const char *__restrict s);
+
+/** Destroy the sink without finishing the load. */
+static void destroy (SqliteSink *sink);
+
+
+Sink *sinkCreateSqlite (const char *path)
+{
+	SqliteSink *self;
+	int i;
+
+	self = xmalloc(sizeof(SqliteSink));
+	self->sink.begin = sqliteSinkBegin;
+	self->sink.write = sqliteSinkWrite;
+	self->sink.close = sqliteSinkClose;
+
+	self->db = NULL;
+	self->insertRecord = NULL;
+	self->pending = 0;
+	for (i = 0; i < LOOKUP_COUNT; i++)
+	{
+		self->insertLookup[i] = NULL;
+		stringTableInit(&self->lookup[i]);
+	}
+
+	if (sqlite3_open(path, &self->db) != SQLITE_OK
+		|| sqlite3_exec(self->db, schemaSql, NULL, NULL, NULL) != SQLITE_OK
+		|| sqlite3_prepare_v2(self->db, insertRecordSql, -1,
+			&self->insertRecord, NULL) != SQLITE_OK)
+		goto sinkCreateSqlite_fail;
+
+	for (i = 0; i < LOOKUP_COUNT; i++)
+		if (sqlite3_prepare_v2(self->db, insertLookupSql[i], -1,
+			&self->insertLookup[i], NULL) != SQLITE_OK)
+			goto sinkCreateSqlite_fail;
+	return &self->sink;
+
+sinkCreateSqlite_fail:
+	printError(self->db);
+	destroy(self);
+	return NULL;
+}
+
+static int sqliteSinkBegin (Sink *__restrict self,
+	const EvtHeader *__restrict hdr, unsigned long fileSize)
+{
+	(void) self;
+	(void) hdr;
+	(void) fileSize;
+	return 0;
+}
+
+static int sqliteSinkWrite (Sink *__restrict self,
+	const RecordFields *__restrict fields)
+{
+	SqliteSink *sink = (SqliteSink *) self;
+	sqlite3_stmt *stmt = sink->insertRecord;
+	const EvtRecord *rec = fields->rec;
+
+	sqlite3_bind_int64(stmt, 1, rec->recordNumber);
+	sqlite3_bind_int64(stmt, 2, rec->timeGenerated);
+	sqlite3_bind_int64(stmt, 3, rec->timeWritten);
+	sqlite3_bind_int64(stmt, 4, rec->eventID);
+	sqlite3_bind_int(stmt, 5, rec->eventType);
+	sqlite3_bind_int(stmt, 6, rec->eventCategory);
+
+	if (bindLookup(sink, LOOKUP_SOURCES, 7, fields->sourceName)
+		|| bindLookup(sink, LOOKUP_COMPUTERS, 8, fields->computerName)
+		|| bindLookup(sink, LOOKUP_SIDS, 9, fields->sid))
+		return 1;
+
+	/* The record outlives the statement execution. */
+	sqlite3_bind_text(stmt, 10, fields->strings, -1, SQLITE_STATIC);
+	if (fields->data)
+		sqlite3_bind_blob(stmt, 11, fields->data, fields->dataLength,
+			SQLITE_STATIC);
+	else
+		sqlite3_bind_null(stmt, 11);
+
+	if (sqlite3_step(stmt) != SQLITE_DONE)
+	{
+		printError(sink->db);
+		sqlite3_reset(stmt);
+		return 1;
+	}
+	sqlite3_reset(stmt);
+
+	if (++sink->pending == SQLITE_SINK_BATCH)
+	{
+		if (sqlite3_exec(sink->db, "COMMIT; BEGIN;", NULL, NULL, NULL)
+			!= SQLITE_OK)
+		{
+			printError(sink->db);
+			return 1;
+		}
+		sink->pending = 0;
+	}
+	return 0;
+}
+
+static int sqliteSinkClose (Sink *self)
+{
+	SqliteSink *sink = (SqliteSink *) self;
+	int ret = 0;
+
+	if (sqlite3_exec(sink->db, indexSql, NULL, NULL, NULL) != SQLITE_OK)
+	{
+		printError(sink->db);
+		ret = 1;
+	}
+	destroy(sink);
+	return ret;
+}
+
+static void printError (sqlite3 *db)
+{
+	fprintf(stderr, _("Error: SQLite: %s.\n"),
+		db ? sqlite3_errmsg(db) : _("Out of memory"));
+}
+
+static int bindLookup (SqliteSink *__restrict sink, LookupTable table,
+	int param, const char *__restrict s)
+{
+	sqlite3_stmt *stmt = sink->insertLookup[table];
+	unsigned int id;
+	int added;
+
+	if (!s)
+		return sqlite3_bind_null(sink->insertRecord, param) != SQLITE_OK;
+
+	id = stringTableIntern(&sink->lookup[table], s, &added);
+	if (added)
+	{
+		sqlite3_bind_int(stmt, 1, id);
+		sqlite3_bind_text(stmt, 2, s, -1, SQLITE_STATIC);
+		if (sqlite3_step(stmt) != SQLITE_DONE)
+		{
+			printError(sink->db);
+			sqlite3_reset(stmt);
+			return 1;
+		}
+		sqlite3_reset(stmt);
+	}
+	return sqlite3_bind_int(sink->insertRecord, param, id) != SQLITE_OK;
+}
+
+static void destroy (SqliteSink *sink)
+{
+	int i;
+
+	for (i = 0; i < LOOKUP_COUNT; i++)
+	{
+		sqlite3_finalize(sink->insertLookup[i]);
+		stringTableDestroy(&sink->lookup[i]);
+	}
+	sqlite3_finalize(sink->insertRecord);
+	sqlite3_close(sink->db);
+	free(sink);
+}
@@ -0,0 +1,251 @@
+/**
+ *  @file statssink.c
+ *  @brief A sink counting records.
+ *
+ *  Copyright Přemysl Janouch 2010. All rights reserved.
+ *  See the file LICENSE for licensing information.
+ *
+ *  The output is a CSV file with three fields in each record: what is
+ *  being counted, its value and the count. Records are counted in total
+ *  and by their type, source name and event identifier, the most frequent
+ *  values going first. The first and last times generated are also given.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "configure.h"
+
+#include "xalloc.h"
+#include "datastruct.h"
+#include "evt.h"
+#include "csv.h"
+#include "record.h"
+#include "sink.h"
+
+
+/** What records are counted by. */
+enum
+{
+	STATS_TYPES,
+	STATS_SOURCES,
+	STATS_EVENT_IDS,
+	STATS_KIND_COUNT
+};
+
+/** Names of the kinds of counts in the output. */
+static const char *statsKindNames[STATS_KIND_COUNT] =
+	{"type", "source", "event-id"};
+
+/** A value and how many times it's been seen. */
+typedef struct
+{
+	/** The value. */
+	const char *value;
+	/** The count. */
+	unsigned long long count;
+}
+StatsCount;
+
+/** A sink counting records. */
+typedef struct
+{
+	/** The methods. */
+	Sink sink;
+	/** The output file stream. */
+	FILE *output;
+	/** The total number of records. */
+	unsigned long long records;
+	/** The range of times generated. */
+	time_t minTimeGenerated, maxTimeGenerated;
+	/** Distinct values for each kind of counts. */
+	StringTable values[STATS_KIND_COUNT];
+	/** Counts of the values, indexed by their identifiers minus one. */
+	unsigned long long *counts[STATS_KIND_COUNT];
+	/** How many counts have been allocated. */
+	size_t alloc[STATS_KIND_COUNT];
+}
+StatsSink;
+
+
+static int statsSinkBegin (Sink *__restrict self,
+	const EvtHeader *__restrict hdr, unsigned long fileSize);
+static int statsSinkWrite (Sink *__restrict self,
+	const RecordFields *__restrict fields);
+static int statsSinkClose (Sink *self);
+
+/** Count a value. */
+static void countValue (StatsSink *__restrict sink, int kind,
+	const char *__restrict value);
+/** Write the counts of one kind, the most frequent values first. */
+static void writeCounts (StatsSink *__restrict sink, CsvWriter wrt, int kind);
+/** Compare counts so that they go from the highest to the lowest. */
+static int compareCounts (const void *a, const void *b);
+
+
+Sink *sinkCreateStats (FILE *output)
+{
+	StatsSink *self;
+	int i;
+
+	self = xmalloc(sizeof(StatsSink));
+	self->sink.begin = statsSinkBegin;
+	self->sink.write = statsSinkWrite;
+	self->sink.close = statsSinkClose;
+
+	self->output = output;
+	self->records = 0;
+	self->minTimeGenerated = self->maxTimeGenerated = 0;
+	for (i = 0; i < STATS_KIND_COUNT; i++)
+	{
+		stringTableInit(&self->values[i]);
+		self->counts[i] = NULL;
+		self->alloc[i] = 0;
+	}
+	return &self->sink;
+}
+
+static int statsSinkBegin (Sink *__restrict self,
+	const EvtHeader *__restrict hdr, unsigned long fileSize)
+{
+	(void) self;
+	(void) hdr;
+	(void) fileSize;
+	return 0;
+}
+
+static int statsSinkWrite (Sink *__restrict self,
+	const RecordFields *__restrict fields)
+{
+	StatsSink *sink = (StatsSink *) self;
+	const EvtRecord *rec = fields->rec;
+	const char *typeName;
+	/* Yes, the buffer is large enough. */
+	char buff[16];
+
+	if (!sink->records++)
+		sink->minTimeGenerated = sink->maxTimeGenerated
+			= rec->timeGenerated;
+	else if (rec->timeGenerated < sink->minTimeGenerated)
+		sink->minTimeGenerated = rec->timeGenerated;
+	else if (rec->timeGenerated > sink->maxTimeGenerated)
+		sink->maxTimeGenerated = rec->timeGenerated;
+
+	if (!(typeName = recordTypeName(rec->eventType)))
+	{
+		snprintf(buff, sizeof(buff), "%u", rec->eventType);
+		typeName = buff;
+	}
+	countValue(sink, STATS_TYPES, typeName);
+	countValue(sink, STATS_SOURCES,
+		fields->sourceName ? fields->sourceName : "");
+	snprintf(buff, sizeof(buff), "%u", rec->eventID);
+	countValue(sink, STATS_EVENT_IDS, buff);
+	return 0;
+}
+
+static int statsSinkClose (Sink *self)
+{
+	StatsSink *sink = (StatsSink *) self;
+	CsvWriter wrt;
+	/* Yes, the buffer is large enough. */
+	char buff[40];
+	int i;
+
+	wrt = csvCreateWriter(sink->output);
+	csvWrite(wrt, "records");
+	csvWrite(wrt, "");
+	snprintf(buff, sizeof(buff), "%llu", sink->records);
+	csvWrite(wrt, buff);
+	csvWrite(wrt, NULL);
+
+	if (sink->records)
+	{
+		strftime(buff, sizeof(buff), "%Y-%m-%d %H:%M:%S",
+			gmtime(&sink->minTimeGenerated));
+		csvWrite(wrt, "first");
+		csvWrite(wrt, buff);
+		csvWrite(wrt, "");
+		csvWrite(wrt, NULL);
+
+		strftime(buff, sizeof(buff), "%Y-%m-%d %H:%M:%S",
+			gmtime(&sink->maxTimeGenerated));
+		csvWrite(wrt, "last");
+		csvWrite(wrt, buff);
+		csvWrite(wrt, "");
+		csvWrite(wrt, NULL);
+	}
+
+	for (i = 0; i < STATS_KIND_COUNT; i++)
+	{
+		writeCounts(sink, wrt, i);
+		stringTableDestroy(&sink->values[i]);
+		free(sink->counts[i]);
+	}
+
+	csvDestroyWriter(wrt);
+	free(sink);
+	return 0;
+}
+
+static void countValue (StatsSink *__restrict sink, int kind,
+	const char *__restrict value)
+{
+	size_t index;
+	int added;
+
+	index = stringTableIntern(&sink->values[kind], value, &added) - 1;
+	if (added)
+	{
+		if (index >= sink->alloc[kind])
+		{
+			sink->alloc[kind] = sink->alloc[kind]
+				? sink->alloc[kind] << 1 : 16;
+			sink->counts[kind] = xrealloc(sink->counts[kind],
+				sink->alloc[kind] * sizeof(unsigned long long));
+		}
+		sink->counts[kind][index] = 0;
+	}
+	sink->counts[kind][index]++;
+}
+
+static void writeCounts (StatsSink *__restrict sink, CsvWriter wrt, int kind)
+{
+	StatsCount *counts;
+	size_t i, count;
+	/* Yes, the buffer is large enough. */
+	char buff[24];
+
+	if (!(count = sink->values[kind].count))
+		return;
+
+	counts = xmalloc(count * sizeof(StatsCount));
+	for (i = 0; i < count; i++)
+	{
+		counts[i].value = stringTableGet(&sink->values[kind], i + 1);
+		counts[i].count = sink->counts[kind][i];
+	}
+	qsort(counts, count, sizeof(StatsCount), compareCounts);
+
+	for (i = 0; i < count; i++)
+	{
+		csvWrite(wrt, statsKindNames[kind]);
+		csvWrite(wrt, counts[i].value);
+		snprintf(buff, sizeof(buff), "%llu", counts[i].count);
+		csvWrite(wrt, buff);
+		csvWrite(wrt, NULL);
+	}
+	free(counts);
+}
+
+static int compareCounts (const void *a, const void *b)
+{
+	const StatsCount *x = a, *y = b;
+
+	if (x->count != y->count)
+		return x->count < y->count ? 1 : -1;
+	return strcmp(x->value, y->value);
+}
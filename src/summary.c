@@ -0,0 +1,124 @@
+/**
+ *  @file summary.c
+ *  @brief Summaries of event logs for skipping them in searches.
+ *
+ *  Copyright Přemysl Janouch 2010. All rights reserved.
+ *  See the file LICENSE for licensing information.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "configure.h"
+
+#include "xalloc.h"
+#include "bloom.h"
+#include "summary.h"
+
+
+/** Write a number in little endian.
+ *  @return 0 on success, -1 on failure.
+ */
+static int writeLE32 (FILE *output, uint32_t value);
+/** Read a number in little endian.
+ *  @return 0 on success, -1 on failure.
+ */
+static int readLE32 (FILE *__restrict input, uint32_t *__restrict value);
+
+
+static int writeLE32 (FILE *output, uint32_t value)
+{
+	unsigned char bytes[4];
+
+	bytes[0] = value;
+	bytes[1] = value >> 8;
+	bytes[2] = value >> 16;
+	bytes[3] = value >> 24;
+	return fwrite(bytes, sizeof(bytes), 1, output) ? 0 : -1;
+}
+
+static int readLE32 (FILE *__restrict input, uint32_t *__restrict value)
+{
+	unsigned char bytes[4];
+
+	if (!fread(bytes, sizeof(bytes), 1, input))
+		return -1;
+	*value = bytes[0] | (uint32_t) bytes[1] << 8
+		| (uint32_t) bytes[2] << 16 | (uint32_t) bytes[3] << 24;
+	return 0;
+}
+
+int summaryWrite (const Summary *__restrict summary, FILE *__restrict output)
+{
+	const SummaryHeader *hdr = &summary->hdr;
+	int i;
+
+	if (writeLE32(output, hdr->magic)
+		|| writeLE32(output, hdr->version)
+		|| writeLE32(output, hdr->recordCount)
+		|| writeLE32(output, hdr->minTimeGenerated)
+		|| writeLE32(output, hdr->maxTimeGenerated))
+		return -1;
+
+	/* The bits are stored as bytes, which need no conversion. */
+	for (i = 0; i < SUMMARY_FILTER_COUNT; i++)
+	{
+		const BloomFilter *filter = &summary->filters[i];
+
+		if (writeLE32(output, filter->nBits)
+			|| writeLE32(output, filter->nHashes)
+			|| !fwrite(filter->bits, filter->nBits / 8, 1, output))
+			return -1;
+	}
+	return 0;
+}
+
+int summaryRead (Summary *__restrict summary, FILE *__restrict input)
+{
+	SummaryHeader *hdr = &summary->hdr;
+	int i;
+
+	if (readLE32(input, &hdr->magic)
+		|| readLE32(input, &hdr->version)
+		|| readLE32(input, &hdr->recordCount)
+		|| readLE32(input, &hdr->minTimeGenerated)
+		|| readLE32(input, &hdr->maxTimeGenerated)
+		|| hdr->magic != SUMMARY_MAGIC
+		|| hdr->version != SUMMARY_VERSION)
+		return -1;
+
+	for (i = 0; i < SUMMARY_FILTER_COUNT; i++)
+		summary->filters[i].bits = NULL;
+
+	for (i = 0; i < SUMMARY_FILTER_COUNT; i++)
+	{
+		BloomFilter *filter = &summary->filters[i];
+
+		if (readLE32(input, &filter->nBits)
+			|| readLE32(input, &filter->nHashes))
+			goto summaryRead_fail;
+
+		/* The size must be a power of two for masking to work. */
+		if (filter->nBits < 8 || (filter->nBits & (filter->nBits - 1)))
+			goto summaryRead_fail;
+
+		filter->bits = xmalloc(filter->nBits / 8);
+		if (!fread(filter->bits, filter->nBits / 8, 1, input))
+			goto summaryRead_fail;
+	}
+	return 0;
+
+summaryRead_fail:
+	summaryDestroy(summary);
+	return -1;
+}
+
+void summaryDestroy (Summary *summary)
+{
+	int i;
+
+	for (i = 0; i < SUMMARY_FILTER_COUNT; i++)
+		bloomDestroy(&summary->filters[i]);
+}
@@ -0,0 +1,100 @@
+/**
+ *  @file summary.h
+ *  @brief Summaries of event logs for skipping them in searches.
+ *
+ *  Copyright Přemysl Janouch 2010. All rights reserved.
+ *  See the file LICENSE for licensing information.
+ *
+ *  A summary holds the range of times at which events in a log have been
+ *  generated and Bloom filters over values of some of the record fields,
+ *  so that one can tell without reading the log that it can't contain
+ *  any record of interest.
+ *
+ *  The file starts with a @a SummaryHeader, which is followed by
+ *  @a SUMMARY_FILTER_COUNT filters, each stored as two 32-bit words,
+ *  the number of bits and the number of hashes, and the bit array.
+ *  All the numbers are little endian.
+ *
+ */
+
+#ifndef SUMMARY_H_INCLUDED
+#define SUMMARY_H_INCLUDED
+
+/** The magic number at the beginning of summary files, "ESUM". */
+#define SUMMARY_MAGIC 0x4D555345
+/** The current version of the file format. */
+#define SUMMARY_VERSION 1
+
+/** The filters contained in a summary. */
+enum
+{
+	/** Event IDs in decimal. */
+	SUMMARY_EVENT_IDS,
+	/** Source names, exactly. */
+	SUMMARY_SOURCES,
+	/** SIDs in their string form. */
+	SUMMARY_SIDS,
+	/** Tokens of description strings, see token.h. */
+	SUMMARY_TOKENS,
+	SUMMARY_FILTER_COUNT
+};
+
+/** The header of a summary file. */
+typedef struct
+{
+	/** @a SUMMARY_MAGIC */
+	uint32_t magic;
+	/** @a SUMMARY_VERSION */
+	uint32_t version;
+	/** The number of records in the log. */
+	uint32_t recordCount;
+	/** The earliest time generated among the records. */
+	uint32_t minTimeGenerated;
+	/** The latest time generated among the records. */
+	uint32_t maxTimeGenerated;
+}
+SummaryHeader;
+
+/** A summary of an event log. */
+typedef struct
+{
+	/** The header. */
+	SummaryHeader hdr;
+	/** The filters. */
+	BloomFilter filters[SUMMARY_FILTER_COUNT];
+}
+Summary;
+
+
+/** Write a summary into a file.
+ *  @param[in] summary  The summary.
+ *  @param[in] output  The file stream to write to.
+ *  @return 0 on success, -1 on failure.
+ */
+int summaryWrite (const Summary *__restrict summary, FILE *__restrict output);
+
+/** Read a summary from a file.
+ *  @param[out] summary  Where to store the summary.
+ *  @param[in] input  The file stream to read from.
+ *  @return 0 on success, -1 on failure. Nothing needs to be destroyed then.
+ */
+int summaryRead (Summary *__restrict summary, FILE *__restrict input);
+
+/** Test whether a log might contain a value.
+ *  @param[in] summary  The summary of the log.
+ *  @param[in] filter  One of the @a SUMMARY_FILTER_COUNT filters.
+ *  @param[in] value  The value to look for.
+ *  @return Zero if the log certainly doesn't contain the value.
+ */
+static inline int summaryMayContain (const Summary *__restrict summary,
+	int filter, const char *__restrict value)
+{
+	return bloomTest(&summary->filters[filter], value, strlen(value));
+}
+
+/** Destroy a summary.
+ *  @param[in,out] summary  A summary read by summaryRead().
+ */
+void summaryDestroy (Summary *summary);
+
+#endif /* ! SUMMARY_H_INCLUDED */
@@ -0,0 +1,144 @@
+/**
+ *  @file sumsink.c
+ *  @brief A sink writing a summary of records.
+ *
+ *  Copyright Přemysl Janouch 2010. All rights reserved.
+ *  See the file LICENSE for licensing information.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "configure.h"
+
+#include "xalloc.h"
+#include "datastruct.h"
+#include "evt.h"
+#include "bloom.h"
+#include "summary.h"
+#include "token.h"
+#include "record.h"
+#include "sink.h"
+
+
+/** A sink writing a summary of records. */
+typedef struct
+{
+	/** The methods. */
+	Sink sink;
+	/** The output file stream. */
+	FILE *output;
+	/** The header of the summary being built. */
+	SummaryHeader hdr;
+	/** Distinct values for each of the filters. The filters can only be
+	 *  sized properly once we know how many there are. */
+	StringTable values[SUMMARY_FILTER_COUNT];
+	/** Storage for tokens. */
+	Buffer token;
+}
+SummarySink;
+
+
+static int summarySinkBegin (Sink *__restrict self,
+	const EvtHeader *__restrict hdr, unsigned long fileSize);
+static int summarySinkWrite (Sink *__restrict self,
+	const RecordFields *__restrict fields);
+static int summarySinkClose (Sink *self);
+
+
+Sink *sinkCreateSummary (FILE *output)
+{
+	SummarySink *self;
+	int i;
+
+	self = xmalloc(sizeof(SummarySink));
+	self->sink.begin = summarySinkBegin;
+	self->sink.write = summarySinkWrite;
+	self->sink.close = summarySinkClose;
+
+	self->output = output;
+	self->hdr.magic = SUMMARY_MAGIC;
+	self->hdr.version = SUMMARY_VERSION;
+	self->hdr.recordCount = 0;
+	self->hdr.minTimeGenerated = self->hdr.maxTimeGenerated = 0;
+	for (i = 0; i < SUMMARY_FILTER_COUNT; i++)
+		stringTableInit(&self->values[i]);
+	bufferInit(&self->token);
+	return &self->sink;
+}
+
+static int summarySinkBegin (Sink *__restrict self,
+	const EvtHeader *__restrict hdr, unsigned long fileSize)
+{
+	(void) self;
+	(void) hdr;
+	(void) fileSize;
+	return 0;
+}
+
+static int summarySinkWrite (Sink *__restrict self,
+	const RecordFields *__restrict fields)
+{
+	SummarySink *sink = (SummarySink *) self;
+	const EvtRecord *rec = fields->rec;
+	const char *cursor;
+	/* Yes, the buffer is large enough. */
+	char buff[16];
+
+	if (!sink->hdr.recordCount++)
+		sink->hdr.minTimeGenerated = sink->hdr.maxTimeGenerated
+			= rec->timeGenerated;
+	else if (rec->timeGenerated < sink->hdr.minTimeGenerated)
+		sink->hdr.minTimeGenerated = rec->timeGenerated;
+	else if (rec->timeGenerated > sink->hdr.maxTimeGenerated)
+		sink->hdr.maxTimeGenerated = rec->timeGenerated;
+
+	snprintf(buff, sizeof(buff), "%u", rec->eventID);
+	stringTableIntern(&sink->values[SUMMARY_EVENT_IDS], buff, NULL);
+	if (fields->sourceName)
+		stringTableIntern(&sink->values[SUMMARY_SOURCES],
+			fields->sourceName, NULL);
+	if (fields->sid)
+		stringTableIntern(&sink->values[SUMMARY_SIDS], fields->sid, NULL);
+
+	for (cursor = fields->strings; tokenNext(&cursor, &sink->token); )
+		stringTableIntern(&sink->values[SUMMARY_TOKENS],
+			sink->token.data, NULL);
+	return 0;
+}
+
+static int summarySinkClose (Sink *self)
+{
+	SummarySink *sink = (SummarySink *) self;
+	Summary summary;
+	size_t k;
+	int i, ret = 0;
+
+	summary.hdr = sink->hdr;
+	for (i = 0; i < SUMMARY_FILTER_COUNT; i++)
+	{
+		StringTable *values = &sink->values[i];
+
+		bloomInit(&summary.filters[i], values->count);
+		for (k = 1; k <= values->count; k++)
+		{
+			const char *value = stringTableGet(values, k);
+			bloomAdd(&summary.filters[i], value, strlen(value));
+		}
+		stringTableDestroy(values);
+	}
+
+	if (summaryWrite(&summary, sink->output))
+	{
+		fputs(_("Error: Failed to write the summary.\n"), stderr);
+		ret = 1;
+	}
+
+	for (i = 0; i < SUMMARY_FILTER_COUNT; i++)
+		bloomDestroy(&summary.filters[i]);
+	bufferDestroy(&sink->token);
+	free(sink);
+	return ret;
+}
@@ -0,0 +1,94 @@
+/**
+ *  @file teesink.c
+ *  @brief A sink passing records on to several other sinks.
+ *
+ *  Copyright Přemysl Janouch 2010. All rights reserved.
+ *  See the file LICENSE for licensing information.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "configure.h"
+
+#include "xalloc.h"
+#include "datastruct.h"
+#include "evt.h"
+#include "record.h"
+#include "sink.h"
+
+
+/** A sink passing records on to several other sinks. */
+typedef struct
+{
+	/** The methods. */
+	Sink sink;
+	/** The sinks to pass records on to. */
+	Sink **sinks;
+	/** The number of @a sinks. */
+	size_t count;
+}
+TeeSink;
+
+
+static int teeSinkBegin (Sink *__restrict self,
+	const EvtHeader *__restrict hdr, unsigned long fileSize);
+static int teeSinkWrite (Sink *__restrict self,
+	const RecordFields *__restrict fields);
+static int teeSinkClose (Sink *self);
+
+
+Sink *sinkCreateTee (Sink *const *sinks, size_t count)
+{
+	TeeSink *self;
+
+	self = xmalloc(sizeof(TeeSink));
+	self->sink.begin = teeSinkBegin;
+	self->sink.write = teeSinkWrite;
+	self->sink.close = teeSinkClose;
+
+	self->sinks = xmalloc(count * sizeof(Sink *));
+	memcpy(self->sinks, sinks, count * sizeof(Sink *));
+	self->count = count;
+	return &self->sink;
+}
+
+static int teeSinkBegin (Sink *__restrict self,
+	const EvtHeader *__restrict hdr, unsigned long fileSize)
+{
+	TeeSink *sink = (TeeSink *) self;
+	size_t i;
+
+	for (i = 0; i < sink->count; i++)
+		if (sink->sinks[i]->begin(sink->sinks[i], hdr, fileSize))
+			return 1;
+	return 0;
+}
+
+static int teeSinkWrite (Sink *__restrict self,
+	const RecordFields *__restrict fields)
+{
+	TeeSink *sink = (TeeSink *) self;
+	size_t i;
+
+	for (i = 0; i < sink->count; i++)
+		if (sink->sinks[i]->write(sink->sinks[i], fields))
+			return 1;
+	return 0;
+}
+
+static int teeSinkClose (Sink *self)
+{
+	TeeSink *sink = (TeeSink *) self;
+	size_t i;
+	int ret = 0;
+
+	/* All sinks have to be closed, even if some of them fail. */
+	for (i = 0; i < sink->count; i++)
+		ret |= sink->sinks[i]->close(sink->sinks[i]);
+	free(sink->sinks);
+	free(sink);
+	return ret;
+}
@@ -0,0 +1,87 @@
+/**
+ *  @file testacmatch.c
+ *  @brief Test multiple pattern matching.
+ *
+ *  This file is in the public domain.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "configure.h"
+#include "acmatch.h"
+
+/** Widen an ASCII or Latin-1 string into a static buffer. */
+static size_t widen (const char *s, uint16_t *out)
+{
+	size_t i;
+
+	for (i = 0; s[i]; i++)
+		out[i] = (unsigned char) s[i];
+	return i;
+}
+
+/** Match a few texts against a set of patterns, including overlapping ones
+ *  that require following the failure links. */
+int src_testacmatch (int argc, char *argv[])
+{
+	const char *patterns[] =
+	{
+		"he", "she", "hers", "\\\\EVIL\\", "10.0.0.1", "\xC9T\xC9"
+	};
+	const int n_patterns = sizeof(patterns) / sizeof(patterns[0]);
+
+	const struct
+	{
+		const char *text;
+		int matches, matchesFolded;
+	}
+	texts[] =
+	{
+		{"", 0, 0},
+		{"ushers", 1, 1},
+		{"shx", 0, 0},
+		{"xxhhhhe", 1, 1},
+		{"SHE", 0, 1},
+		{"c:\\\\evil\\x", 0, 1},
+		{"10.0.0.", 0, 0},
+		{"host 10.0.0.12", 1, 1},
+		{"\xE9t\xE9", 0, 1},
+		{"\xE9t\xD7", 0, 0}
+	};
+	const int n_texts = sizeof(texts) / sizeof(texts[0]);
+
+	uint16_t wide[64];
+	int fold, i, result, fail = 0;
+
+	for (fold = 0; fold < 2; fold++)
+	{
+		AcMatcher m = acCreateMatcher(fold);
+
+		for (i = 0; i < n_patterns; i++)
+			acAddPattern(m, wide, widen(patterns[i], wide));
+		/* Empty patterns must not match everything. */
+		acAddPattern(m, wide, 0);
+		acCompile(m);
+
+		for (i = 0; i < n_texts; i++)
+		{
+			result = acSearch(m, wide, widen(texts[i].text, wide));
+			if (result != (fold ? texts[i].matchesFolded : texts[i].matches))
+			{
+				printf("acmatch test failed on \"%s\", folding %s\n",
+					texts[i].text, fold ? "on" : "off");
+				fail = 1;
+			}
+		}
+		acDestroyMatcher(m);
+	}
+
+	if (fail)
+		puts("acmatch test failed");
+	else
+		puts("acmatch test passed");
+	return fail;
+}
@@ -0,0 +1,343 @@
+/**
+ *  @file testarchive.c
+ *  @brief Test reading of archives.
+ *
+ *  This file is in the public domain.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "configure.h"
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif /* HAVE_ZLIB */
+
+#include "datastruct.h"
+#include "mapfile.h"
+#include "archive.h"
+
+/** Write a tar header followed by the padded contents of a member. */
+static void writeTarMember (FILE *fp, const char *name, char type,
+	const char *contents)
+{
+	unsigned char block[512];
+	size_t length = strlen(contents);
+	unsigned sum = 0;
+	int i;
+
+	memset(block, 0, sizeof(block));
+	strncpy((char *) block, name, 100);
+	sprintf((char *) block + 100, "%07o", 0644);
+	sprintf((char *) block + 124, "%011lo", (unsigned long) length);
+	block[156] = type;
+	memcpy(block + 257, "ustar", 6);
+	memcpy(block + 263, "00", 2);
+
+	memset(block + 148, ' ', 8);
+	for (i = 0; i < 512; i++)
+		sum += block[i];
+	sprintf((char *) block + 148, "%06o", sum);
+
+	fwrite(block, 1, sizeof(block), fp);
+	memset(block, 0, sizeof(block));
+	memcpy(block, contents, length);
+	fwrite(block, 1, (length + 511) / 512 * 512, fp);
+}
+
+/** Write a little endian number. */
+static void writeLE (FILE *fp, unsigned long value, int bytes)
+{
+	while (bytes--)
+	{
+		putc(value & 0xff, fp);
+		value >>= 8;
+	}
+}
+
+/** Write a zip archive with a single member, stored or deflated. */
+static void writeZip (FILE *fp, const char *name, const char *contents,
+	int deflated)
+{
+	size_t nameLength = strlen(name), length = strlen(contents);
+	size_t storedLength = length;
+	const void *data = contents;
+	int method = 0;
+	long central;
+#ifdef HAVE_ZLIB
+	unsigned char stored[256];
+	z_stream z;
+
+	if (deflated)
+	{
+		memset(&z, 0, sizeof(z));
+		deflateInit2(&z, Z_BEST_COMPRESSION, Z_DEFLATED,
+			-MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+		z.next_in = (Bytef *) contents;
+		z.avail_in = length;
+		z.next_out = stored;
+		z.avail_out = sizeof(stored);
+		deflate(&z, Z_FINISH);
+		storedLength = z.total_out;
+		deflateEnd(&z);
+		data = stored;
+		method = Z_DEFLATED;
+	}
+#endif /* HAVE_ZLIB */
+
+	writeLE(fp, 0x04034b50, 4);
+	writeLE(fp, 20, 2);
+	writeLE(fp, 0, 2);
+	writeLE(fp, method, 2);
+	writeLE(fp, 0, 4);
+	writeLE(fp, 0, 4);
+	writeLE(fp, storedLength, 4);
+	writeLE(fp, length, 4);
+	writeLE(fp, nameLength, 2);
+	writeLE(fp, 0, 2);
+	fputs(name, fp);
+	fwrite(data, 1, storedLength, fp);
+
+	central = ftell(fp);
+	writeLE(fp, 0x02014b50, 4);
+	writeLE(fp, 20, 2);
+	writeLE(fp, 20, 2);
+	writeLE(fp, 0, 2);
+	writeLE(fp, method, 2);
+	writeLE(fp, 0, 4);
+	writeLE(fp, 0, 4);
+	writeLE(fp, storedLength, 4);
+	writeLE(fp, length, 4);
+	writeLE(fp, nameLength, 2);
+	writeLE(fp, 0, 2);
+	writeLE(fp, 0, 2);
+	writeLE(fp, 0, 2);
+	writeLE(fp, 0, 2);
+	writeLE(fp, 0, 4);
+	writeLE(fp, 0, 4);
+	fputs(name, fp);
+
+	writeLE(fp, 0x06054b50, 4);
+	writeLE(fp, 0, 2);
+	writeLE(fp, 0, 2);
+	writeLE(fp, 1, 2);
+	writeLE(fp, 1, 2);
+	writeLE(fp, ftell(fp) - 12 - central, 4);
+	writeLE(fp, central, 4);
+	writeLE(fp, 0, 2);
+}
+
+/** Cut a file short.
+ *  @return 0 on success, -1 on failure.
+ */
+static int truncateFile (const char *path, size_t length)
+{
+	char *data;
+	FILE *fp;
+	int ret = -1;
+
+	data = malloc(length);
+	if ((fp = fopen(path, "rb")))
+	{
+		if (fread(data, 1, length, fp) == length)
+			ret = 0;
+		fclose(fp);
+	}
+	if (!ret && (!(fp = fopen(path, "wb"))
+		|| fwrite(data, 1, length, fp) != length || fclose(fp)))
+		ret = -1;
+	free(data);
+	return ret;
+}
+
+#ifdef HAVE_ZLIB
+/** Compress a file with gzip in place.
+ *  @return 0 on success, -1 on failure.
+ */
+static int gzipFile (const char *path)
+{
+	char data[4096];
+	size_t length;
+	gzFile gz;
+	FILE *fp;
+
+	if (!(fp = fopen(path, "rb")))
+		return -1;
+	length = fread(data, 1, sizeof(data), fp);
+	fclose(fp);
+
+	if (!(gz = gzopen(path, "wb")))
+		return -1;
+	if (gzwrite(gz, data, length) != (int) length)
+	{
+		gzclose(gz);
+		return -1;
+	}
+	return gzclose(gz) == Z_OK ? 0 : -1;
+}
+#endif /* HAVE_ZLIB */
+
+/** Check that a member has the expected name and contents. */
+static int isMember (const ArchiveMember *member,
+	const char *name, const char *contents)
+{
+	return !strcmp(member->name, name)
+		&& member->length == strlen(contents)
+		&& !memcmp(member->data, contents, member->length);
+}
+
+/** Read back the .evt members of a tar and a zip archive. */
+int src_testarchive (int argc, char *argv[])
+{
+	const char *path = "testarchive.tmp";
+	char longName[160];
+	Archive ar;
+	ArchiveMember member;
+	Buffer storage;
+	FILE *fp;
+	int fail = 0;
+
+	memset(longName, 'x', sizeof(longName));
+	strcpy(longName + sizeof(longName) - 5, ".evt");
+
+	if (!(fp = fopen(path, "wb")))
+	{
+		puts("archive test failed to write the archive");
+		return 1;
+	}
+	writeTarMember(fp, "notes.txt", '0', "not a log");
+	writeTarMember(fp, "././@LongLink", 'L', longName);
+	writeTarMember(fp, "truncated", '0', "first log");
+	writeTarMember(fp, "dir/", '5', "");
+	writeTarMember(fp, "dir/second.EVT", '0', "second log");
+	fclose(fp);
+
+	if (archiveOpen(&ar, path))
+		fail = 1;
+	else
+	{
+		if (ar.format != ARCHIVE_TAR || !archiveIsSeekable(&ar)
+			|| ar.count != 2
+			|| archiveNext(&ar, &member) != 1
+			|| !isMember(&member, longName, "first log")
+			|| archiveNext(&ar, &member) != 1
+			|| !isMember(&member, "dir/second.EVT", "second log")
+			|| archiveNext(&ar, &member) != 0)
+			fail = 1;
+		archiveClose(&ar);
+	}
+
+	/* The odd length of the name leaves the member unaligned. */
+	if (!(fp = fopen(path, "wb")))
+	{
+		puts("archive test failed to write the archive");
+		return 1;
+	}
+	writeZip(fp, "log.evt", "zipped log", 0);
+	fclose(fp);
+
+	bufferInit(&storage);
+	if (archiveOpen(&ar, path))
+		fail = 1;
+	else
+	{
+		if (ar.format != ARCHIVE_ZIP || ar.count != 1
+			|| archiveExtract(&ar, 0, &member, &storage)
+			|| !isMember(&member, "log.evt", "zipped log"))
+			fail = 1;
+		archiveClose(&ar);
+	}
+
+#ifdef HAVE_ZLIB
+	if (!(fp = fopen(path, "wb")))
+	{
+		puts("archive test failed to write the archive");
+		return 1;
+	}
+	writeZip(fp, "log.evt", "deflated log, deflated log, deflated log", 1);
+	fclose(fp);
+
+	if (archiveOpen(&ar, path))
+		fail = 1;
+	else
+	{
+		if (ar.format != ARCHIVE_ZIP || ar.count != 1
+			|| archiveExtract(&ar, 0, &member, &storage)
+			|| !isMember(&member, "log.evt",
+				"deflated log, deflated log, deflated log"))
+			fail = 1;
+		archiveClose(&ar);
+	}
+
+	/* Gzipped tar archives are read as a stream. */
+	if (!(fp = fopen(path, "wb")))
+	{
+		puts("archive test failed to write the archive");
+		return 1;
+	}
+	writeTarMember(fp, "notes.txt", '0', "not a log");
+	writeTarMember(fp, "././@LongLink", 'L', longName);
+	writeTarMember(fp, "truncated", '0', "first log");
+	writeTarMember(fp, "second.evt", '0', "second log");
+	fclose(fp);
+
+	if (gzipFile(path) || archiveOpen(&ar, path))
+		fail = 1;
+	else
+	{
+		if (ar.format != ARCHIVE_TAR_GZ || archiveIsSeekable(&ar)
+			|| archiveNext(&ar, &member) != 1
+			|| !isMember(&member, longName, "first log")
+			|| archiveNext(&ar, &member) != 1
+			|| !isMember(&member, "second.evt", "second log")
+			|| archiveNext(&ar, &member) != 0)
+			fail = 1;
+		archiveClose(&ar);
+	}
+#endif /* HAVE_ZLIB */
+	bufferDestroy(&storage);
+
+	/* Archives that have been cut short are corrupted, however short. */
+	if (!(fp = fopen(path, "wb")))
+	{
+		puts("archive test failed to write the archive");
+		return 1;
+	}
+	fputs("PK\x05\x06", fp);
+	fclose(fp);
+	if (archiveOpen(&ar, path) != -1)
+		fail = 1;
+
+	if (!(fp = fopen(path, "wb")))
+	{
+		puts("archive test failed to write the archive");
+		return 1;
+	}
+	writeTarMember(fp, "first.evt", '0', "first log");
+	writeTarMember(fp, "second.evt", '0', "second log");
+	fclose(fp);
+	if (truncateFile(path, 512 * 3 + 4) || archiveOpen(&ar, path) != -1)
+		fail = 1;
+
+	/* Anything else isn't an archive. */
+	if (!(fp = fopen(path, "wb")))
+	{
+		puts("archive test failed to write the archive");
+		return 1;
+	}
+	fputs("LfLe", fp);
+	fclose(fp);
+	if (archiveOpen(&ar, path) != 1)
+		fail = 1;
+
+	remove(path);
+
+	if (fail)
+		puts("archive test failed");
+	else
+		puts("archive test passed");
+	return fail;
+}
@@ -0,0 +1,72 @@
+/**
+ *  @file testbloom.c
+ *  @brief Test Bloom filters.
+ *
+ *  This file is in the public domain.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "configure.h"
+#include "hash.h"
+#include "bloom.h"
+
+/** Check that there are no false negatives and only a few false positives. */
+int src_testbloom (int argc, char *argv[])
+{
+	const int n_keys = 1000;
+
+	BloomFilter filter;
+	char key[16];
+	int i, falsePositives = 0, fail = 0;
+
+	/* The hash mustn't depend on alignment. */
+	memcpy(key + 1, "unaligned", 10);
+	if (hash64(key + 1, 9, 0) != hash64("unaligned", 9, 0)
+		|| hash64("a", 1, 0) == hash64("a", 1, 1))
+	{
+		puts("bloom test failed on hash64()");
+		fail = 1;
+	}
+
+	bloomInit(&filter, n_keys);
+	for (i = 0; i < n_keys; i++)
+	{
+		snprintf(key, sizeof(key), "key%d", i);
+		bloomAdd(&filter, key, strlen(key));
+	}
+
+	for (i = 0; i < n_keys; i++)
+	{
+		snprintf(key, sizeof(key), "key%d", i);
+		if (!bloomTest(&filter, key, strlen(key)))
+			fail = 1;
+
+		snprintf(key, sizeof(key), "other%d", i);
+		if (bloomTest(&filter, key, strlen(key)))
+			falsePositives++;
+	}
+
+	/* We should be getting about one percent. */
+	if (falsePositives > n_keys / 20)
+	{
+		printf("bloom test got %d false positives\n", falsePositives);
+		fail = 1;
+	}
+	bloomDestroy(&filter);
+
+	/* An empty filter doesn't contain anything. */
+	bloomInit(&filter, 0);
+	if (bloomTest(&filter, "", 0))
+		fail = 1;
+	bloomDestroy(&filter);
+
+	if (fail)
+		puts("bloom test failed");
+	else
+		puts("bloom test passed");
+	return fail;
+}
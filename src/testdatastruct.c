@@ -18,7 +18,9 @@
 int src_testdatastruct (int argc, char *argv[])
 {
 	Buffer buf;
-	int fail = 0;
+	StringTable table = STRING_TABLE_INITIALIZER;
+	char name[16];
+	int i, added, fail = 0;
 
 	bufferInit(&buf);
 	bufferAppend(&buf, "abc", 3, 0);
@@ -48,7 +50,39 @@ int src_testdatastruct (int argc, char *argv[])
 		fail = 1;
 	}
 
+	bufferClear(&buf);
+	bufferAppend(&buf, "xy", 2, 0);
+	bufferAppend(&buf, NULL, 16, 4);
+	bufferShrink(&buf, 14);
+
+	if (buf.used != 6 || buf.cursor != 6
+		|| memcmp(buf.data, "xy\0\0", 4))
+	{
+		puts("Third part of datastruct test failed.");
+		fail = 1;
+	}
+
 	bufferDestroy(&buf);
+
+	/* Enough strings to make the table grow a few times. */
+	for (i = 0; i < 1000; i++)
+	{
+		snprintf(name, sizeof(name), "s%d", i);
+		if (stringTableIntern(&table, name, &added) != (unsigned) i + 1
+			|| !added)
+			break;
+	}
+	if (i != 1000
+		|| stringTableIntern(&table, "s500", &added) != 501 || added
+		|| stringTableFind(&table, "s999") != 1000
+		|| stringTableFind(&table, "s1000")
+		|| strcmp(stringTableGet(&table, 42), "s41"))
+	{
+		puts("String table part of datastruct test failed.");
+		fail = 1;
+	}
+
+	stringTableDestroy(&table);
 	return fail;
 }
 
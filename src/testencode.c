@@ -0,0 +1,109 @@
+/**
+ *  @file testencode.c
+ *  @brief Test encoding of records from text.
+ *
+ *  This file is in the public domain.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "configure.h"
+#include "datastruct.h"
+#include "evt.h"
+#include "mapfile.h"
+#include "encode.h"
+
+/** Encode a record and check where its parts have been put. */
+int src_testencode (int argc, char *argv[])
+{
+	const char *fields[RECORD_FIELD_COUNT] =
+	{
+		"42", "2010-07-09 12:00:00", "2010-07-09 12:00:01", "1000",
+		"Audit Failure", "3", "src", "pc", "S-1-5-18", "a|b", "AAEC"
+	};
+	/* "src\0pc\0", padded to 4 bytes, a SID with one subauthority,
+	 * "a\0b\0", three bytes of data, padding and the length. */
+	const uint32_t length = sizeof(EvtRecord) + 16 + 12 + 8 + 4 + 4;
+
+	EvtRecord rec;
+	Buffer nonFixed = BUFFER_INITIALIZER;
+	const char *error = NULL;
+	char buff[32];
+	int i, fail = 0;
+
+#ifndef HAVE__MKGMTIME
+	setutctimezone();
+#endif /* ! HAVE__MKGMTIME */
+
+	recordEncodeBegin(&rec, &nonFixed);
+	for (i = 0; !error && i < RECORD_FIELD_COUNT; i++)
+	{
+		strcpy(buff, fields[i]);
+		error = recordEncodeField(&rec, &nonFixed, i, buff, NULL);
+	}
+	if (error)
+	{
+		printf("encode test failed on field %d: %s\n", i - 1, error);
+		bufferDestroy(&nonFixed);
+		return 1;
+	}
+	recordEncodeEnd(&rec, &nonFixed);
+
+	if (rec.reserved != EVT_SIGNATURE || rec.recordNumber != 42
+		|| rec.timeGenerated != 1278676800 || rec.timeWritten != 1278676801
+		|| rec.eventID != 1000 || rec.eventType != EVT_AUDIT_FAILURE
+		|| rec.eventCategory != 3)
+	{
+		puts("encode test failed on the fixed fields");
+		fail = 1;
+	}
+	if (rec.userSidOffset != sizeof(EvtRecord) + 16 || rec.userSidLength != 12
+		|| rec.numStrings != 2 || rec.stringOffset != sizeof(EvtRecord) + 28
+		|| rec.dataLength != 3 || rec.dataOffset != sizeof(EvtRecord) + 36)
+	{
+		puts("encode test failed on the offsets");
+		fail = 1;
+	}
+	if (rec.length != length || nonFixed.used + sizeof(EvtRecord) != length
+		|| *(uint32_t *) ((char *) nonFixed.data + nonFixed.used - 4) != length)
+	{
+		puts("encode test failed on the length");
+		fail = 1;
+	}
+
+	/* Nothing may be left over from the previous record. */
+	recordEncodeBegin(&rec, &nonFixed);
+	strcpy(buff, "0");
+	if (nonFixed.used || rec.numStrings || !recordEncodeField(&rec, &nonFixed,
+		RECORD_FIELD_NUMBER, buff, NULL))
+	{
+		puts("encode test failed on a new record");
+		fail = 1;
+	}
+
+	/* Times have to be complete, with nothing following them. */
+	strcpy(buff, "garbage");
+	if (!recordEncodeField(&rec, &nonFixed,
+		RECORD_FIELD_TIME_GENERATED, buff, NULL))
+	{
+		puts("encode test failed on an invalid time");
+		fail = 1;
+	}
+	strcpy(buff, "2010-07-01 xx");
+	if (!recordEncodeField(&rec, &nonFixed,
+		RECORD_FIELD_TIME_WRITTEN, buff, NULL))
+	{
+		puts("encode test failed on a partial time");
+		fail = 1;
+	}
+
+	if (!fail)
+		puts("encode test passed");
+
+	bufferDestroy(&nonFixed);
+	return fail;
+}
@@ -0,0 +1,64 @@
+/**
+ *  @file testescape.c
+ *  @brief Test escaping of string lists.
+ *
+ *  This file is in the public domain.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "configure.h"
+#include "datastruct.h"
+#include "escape.h"
+
+/** Escape a list of strings and cut it back apart. */
+int src_testescape (int argc, char *argv[])
+{
+	const char *strings[] =
+	{
+		"plain", "", "a|b", "\\\\server\\share|", "|\\"
+	};
+	const int n_strings = sizeof(strings) / sizeof(strings[0]);
+	const char *expected = "plain||a\\|b|\\\\\\\\server\\\\share\\||\\|\\\\";
+
+	Buffer buf = BUFFER_INITIALIZER;
+	char *cursor, *s;
+	int i, fail = 0;
+
+	for (i = 0; i < n_strings; i++)
+	{
+		escapeAppend(&buf, strings[i]);
+		if (i + 1 < n_strings)
+			bufferAppendChar(&buf, ESCAPE_SEPARATOR);
+	}
+	bufferAppendChar(&buf, '\0');
+
+	if (strcmp(buf.data, expected))
+	{
+		puts("escape test failed on escapeAppend()");
+		printf("Expected: %s\n", expected);
+		printf("Escaped: %s\n", (char *) buf.data);
+		fail = 1;
+	}
+
+	cursor = buf.data;
+	for (i = 0; !fail && cursor; i++)
+	{
+		s = escapeCutNext(&cursor);
+		if (i >= n_strings || strcmp(s, strings[i]))
+			fail = 1;
+	}
+	if (!fail && i != n_strings)
+		fail = 1;
+
+	if (fail)
+		puts("escape test failed");
+	else
+		puts("escape test passed");
+
+	bufferDestroy(&buf);
+	return fail;
+}
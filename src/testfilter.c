@@ -0,0 +1,181 @@
+/**
+ *  @file testfilter.c
+ *  @brief Test compiled filter expressions.
+ *
+ *  This file is in the public domain.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "configure.h"
+#include "datastruct.h"
+#include "evt.h"
+#include "mapfile.h"
+#include "evtlog.h"
+#include "timeconv.h"
+#include "scan.h"
+#include "filter.h"
+
+/** The number of test records. */
+#define N_RECORDS 4
+
+/** A record along with the storage for its variable part. */
+typedef struct
+{
+	EvtRecord rec;
+	uint16_t text[64];
+}
+TestRecord;
+
+/** Store an ASCII string as UTF-16, including the terminator.
+ *  @return The number of code units stored. */
+static size_t putString (uint16_t *out, const char *str)
+{
+	size_t i = 0;
+
+	do
+		out[i] = (unsigned char) str[i];
+	while (str[i++]);
+	return i;
+}
+
+/** Fill in a record with a source, a computer and a string. */
+static void makeRecord (TestRecord *__restrict test,
+	EvtLogRecord *__restrict record, uint32_t id, uint16_t type,
+	const char *source, const char *computer, const char *str)
+{
+	uint32_t length;
+	size_t n;
+
+	memset(test, 0, sizeof(TestRecord));
+	test->rec.eventID = id;
+	test->rec.eventType = type;
+
+	n = putString(test->text, source);
+	n += putString(test->text + n, computer);
+	test->rec.stringOffset = sizeof(EvtRecord) + n * sizeof(uint16_t);
+	test->rec.numStrings = 1;
+	n += putString(test->text + n, str);
+	test->rec.dataOffset = sizeof(EvtRecord) + n * sizeof(uint16_t);
+
+	length = sizeof(EvtRecord) + n * sizeof(uint16_t) + sizeof(uint32_t);
+	test->rec.length = length;
+	memcpy(test->text + n, &length, sizeof(uint32_t));
+
+	record->offset = 0;
+	record->rec = &test->rec;
+	record->nonFixed = test->text;
+	record->nonFixedLength = length - sizeof(EvtRecord);
+}
+
+/** Compile an expression and run all the test records through it.
+ *  @return The records that pass as a bit mask, or -1 on failure. */
+static int runFilter (const char *expression,
+	TestRecord *tests, ScanBatch *batch)
+{
+	ScanFilter scan;
+	FilterPlan *plan;
+	size_t i;
+	int result = 0;
+
+	scanFilterInit(&scan);
+	if (!(plan = filterCompile(expression, &scan)))
+	{
+		scanFilterDestroy(&scan);
+		return -1;
+	}
+
+	batch->count = N_RECORDS;
+	for (i = 0; i < N_RECORDS; i++)
+	{
+		batch->columns[SCAN_EVENT_ID][i] = tests[i].rec.eventID;
+		batch->columns[SCAN_EVENT_TYPE][i] = tests[i].rec.eventType;
+	}
+	scanBatchSelect(batch, &scan);
+
+	for (i = 0; i < N_RECORDS; i++)
+		if (batch->selected[i] && filterMatches(plan, &batch->records[i]))
+			result |= 1 << i;
+
+	filterDestroy(plan);
+	scanFilterDestroy(&scan);
+	return result;
+}
+
+int src_testfilter (int argc, char *argv[])
+{
+	static const struct
+	{
+		const char *expression;
+		int result;
+	}
+	cases[] =
+	{
+		{"id = 4624", 0x3},
+		{"id in {4625, 1} and type = audit failure", 0x4},
+		{"not (id >= 4624 and id <= 4625)", 0x8},
+		{"source ~ SECUR", 0x7},
+		{"source = Security or computer = 'pc 2'", 0x7},
+		{"strings ~ admin and id != 1", 0x5},
+		{"strings !~ admin and (type = Error or id = 4624)", 0xa},
+		{"strings = administrator", 0x1},
+		{"strings = admin or strings = Spooler", 0xc},
+		{"strings != ADMIN", 0xb},
+		{"strings = \"\"", 0x0},
+		{"id = 1 and", -1},
+		{"(id = 1", -1},
+		{"colour = red", -1},
+		{"type = Unknown", -1},
+		{"time > garbage", -1},
+		{"time > 2010-07-01 xx", -1},
+		{"time in last 24", -1},
+		{"time in last 24x", -1},
+		{"time in last -1h", -1},
+		{"time in last 99999999999999999999s", -1},
+		{"time in last 9999999999999999999w", -1},
+		{"eventid = 1", 0x8},
+	};
+
+	TestRecord *tests;
+	ScanBatch *batch;
+	size_t i;
+	int result, fail = 0;
+
+#ifndef HAVE__MKGMTIME
+	setutctimezone();
+#endif /* ! HAVE__MKGMTIME */
+
+	tests = malloc(N_RECORDS * sizeof(TestRecord));
+	batch = scanBatchCreate();
+	makeRecord(&tests[0], &batch->records[0], 4624, EVT_AUDIT_SUCCESS,
+		"Security", "PC1", "Administrator");
+	makeRecord(&tests[1], &batch->records[1], 4624, EVT_AUDIT_SUCCESS,
+		"Microsoft-Windows-Security-Auditing", "PC 2", "guest");
+	makeRecord(&tests[2], &batch->records[2], 4625, EVT_AUDIT_FAILURE,
+		"SECURITY", "pc 2", "ADMIN");
+	makeRecord(&tests[3], &batch->records[3], 1, EVT_ERROR_TYPE,
+		"Service Control Manager", "PC3", "Spooler");
+
+	for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+	{
+		result = runFilter(cases[i].expression, tests, batch);
+		if (result != cases[i].result)
+		{
+			printf("filter test failed on `%s': got %d, expected %d\n",
+				cases[i].expression, result, cases[i].result);
+			fail = 1;
+		}
+	}
+
+	scanBatchDestroy(batch);
+	free(tests);
+
+	if (fail)
+		puts("filter test failed");
+	else
+		puts("filter test passed");
+	return fail;
+}
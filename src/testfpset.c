@@ -0,0 +1,58 @@
+/**
+ *  @file testfpset.c
+ *  @brief Test the fingerprint set.
+ *
+ *  This file is in the public domain.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "configure.h"
+#include "hash.h"
+#include "fpset.h"
+
+/** Add fingerprints twice with little memory, so that some get spilled
+ *  and the spilled runs get merged. */
+int src_testfpset (int argc, char *argv[])
+{
+	const uint32_t n_records = 40000;
+
+	FingerprintSet set;
+	Fingerprint fp;
+	uint32_t i;
+	int pass, ret, fail = 0;
+
+	set = fpSetCreate(0);
+	for (pass = 0; pass < 2 && !fail; pass++)
+		for (i = 0; i < n_records; i++)
+		{
+			fp.hash = hash64(&i, sizeof(i), 0);
+			fp.recordNumber = i;
+			fp.timeGenerated = 1278000000 + i;
+			if ((ret = fpSetAdd(set, &fp)) != pass)
+			{
+				printf("fpset test failed on record %u, pass %d\n", i, pass);
+				fail = 1;
+				break;
+			}
+		}
+
+	/* The same hash with a different record number is a different record. */
+	i = 0;
+	fp.hash = hash64(&i, sizeof(i), 0);
+	fp.recordNumber = n_records;
+	fp.timeGenerated = 1278000000 + i;
+	if (!fail && fpSetAdd(set, &fp))
+		fail = 1;
+
+	fpSetDestroy(set);
+
+	if (fail)
+		puts("fpset test failed");
+	else
+		puts("fpset test passed");
+	return fail;
+}
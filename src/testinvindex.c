@@ -0,0 +1,108 @@
+/**
+ *  @file testinvindex.c
+ *  @brief Test the inverted index.
+ *
+ *  This file is in the public domain.
+ *
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "configure.h"
+#include "mapfile.h"
+#include "invindex.h"
+
+/** Write an index into a file, map it back and look up its tokens. */
+int src_testinvindex (int argc, char *argv[])
+{
+	const char *path = "testinvindex.tmp";
+	/* Offsets go back as they would in a wrapped log. */
+	const IndexPosting expected[] =
+	{
+		{0, 29000}, {0, 48}, {0, 200000}, {2, 48}
+	};
+	const unsigned n_expected = sizeof(expected) / sizeof(expected[0]);
+
+	IndexBuilder builder;
+	IndexPosting postings[8];
+	const IndexToken *token;
+	Index index;
+	FILE *fp;
+	uint32_t count;
+	unsigned i;
+	int fail = 0;
+
+	builder = indexCreateBuilder();
+	indexAddFile(builder, "first.evt");
+	for (i = 0; i < 3; i++)
+	{
+		indexAddToken(builder, "user15", expected[i].offset);
+		/* Repeated occurences within a record count once. */
+		indexAddToken(builder, "user15", expected[i].offset);
+		indexAddToken(builder, "win", expected[i].offset);
+	}
+	indexAddFile(builder, "second.evt");
+	indexAddFile(builder, "third.evt");
+	indexAddToken(builder, "user15", expected[3].offset);
+	/* A file can only be added once. */
+	if (indexAddFile(builder, "first.evt") != -1)
+		fail = 1;
+
+	if (!(fp = fopen(path, "wb")) || indexWrite(builder, fp) || fclose(fp))
+	{
+		puts("invindex test failed to write the index");
+		indexDestroyBuilder(builder);
+		return 1;
+	}
+	indexDestroyBuilder(builder);
+
+	if (indexOpen(&index, path))
+	{
+		puts("invindex test failed to open the index");
+		remove(path);
+		return 1;
+	}
+
+	if (index.hdr->nFiles != 3 || index.hdr->nTokens != 2
+		|| strcmp(indexFilePath(&index, 2), "third.evt")
+		|| indexFind(&index, "user") || indexFind(&index, "zzz"))
+		fail = 1;
+
+	if (!(token = indexFind(&index, "user15")) || token->count != n_expected
+		|| indexDecode(&index, token, postings))
+		fail = 1;
+	else for (i = 0; i < n_expected; i++)
+		if (postings[i].file != expected[i].file
+			|| postings[i].offset != expected[i].offset)
+			fail = 1;
+
+	if (!(token = indexFind(&index, "win")) || token->count != 3
+		|| indexDecode(&index, token, postings)
+		|| postings[2].offset != expected[2].offset)
+		fail = 1;
+
+	indexClose(&index);
+
+	/* A count of postings that can't fit in the file is rejected. */
+	count = 0x7FFFFFFF;
+	if (!(fp = fopen(path, "r+b"))
+		|| fseek(fp, sizeof(IndexHeader) + offsetof(IndexToken, count),
+			SEEK_SET)
+		|| !fwrite(&count, sizeof(count), 1, fp) || fclose(fp))
+		fail = 1;
+	else if (!indexOpen(&index, path))
+	{
+		indexClose(&index);
+		fail = 1;
+	}
+	remove(path);
+
+	if (fail)
+		puts("invindex test failed");
+	else
+		puts("invindex test passed");
+	return fail;
+}
@@ -0,0 +1,79 @@
+/**
+ *  @file testoptions.c
+ *  @brief Test command line option parsing.
+ *
+ *  This file is in the public domain.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "configure.h"
+#include "options.h"
+
+/** Parse a made-up command line. */
+int src_testoptions (int argc, char *argv[])
+{
+	static const OptionSpec spec[] =
+	{
+		{'a', "all", 0},
+		{'b', "blob", 1},
+		{OPTIONS_LONG_ONLY, "long", 1},
+		{0, NULL, 0}
+	};
+	char arg0[] = "test", arg1[] = "-ab", arg2[] = "x", arg3[] = "--long=y",
+		arg4[] = "--blob", arg5[] = "z", arg6[] = "-bw", arg7[] = "--all",
+		arg8[] = "--", arg9[] = "-a";
+	char *args[] = {arg0, arg1, arg2, arg3, arg4, arg5, arg6, arg7, arg8,
+		arg9, NULL};
+	const struct
+	{
+		int id;
+		const char *arg;
+	}
+	expected[] =
+	{
+		{'a', NULL}, {'b', "x"}, {OPTIONS_LONG_ONLY, "y"}, {'b', "z"},
+		{'b', "w"}, {'a', NULL}, {OPTIONS_END, NULL}
+	};
+	const int n_expected = sizeof(expected) / sizeof(expected[0]);
+
+	OptionsState state = OPTIONS_INITIALIZER;
+	int i, id, fail = 0;
+
+	for (i = 0; !fail && i < n_expected; i++)
+	{
+		id = optionsNext(&state, 10, args, spec);
+		if (id != expected[i].id)
+			fail = 1;
+		else if (expected[i].arg
+			&& (!state.arg || strcmp(expected[i].arg, state.arg)))
+			fail = 1;
+	}
+
+	/* The operand after "--" has to be left alone. */
+	if (!fail && state.index != 9)
+		fail = 1;
+
+	/* Quiet parsing only describes the error. */
+	if (!fail)
+	{
+		OptionsState quiet = OPTIONS_INITIALIZER;
+		char unknown[] = "-w";
+		char *bad[] = {arg0, unknown, NULL};
+
+		quiet.quiet = 1;
+		if (optionsNext(&quiet, 2, bad, spec) != OPTIONS_ERROR
+			|| strcmp(quiet.message, "Unknown option -w"))
+			fail = 1;
+	}
+
+	if (fail)
+		printf("options test failed at option %d\n", i);
+	else
+		puts("options test passed");
+
+	return fail;
+}
@@ -0,0 +1,75 @@
+/**
+ *  @file testscan.c
+ *  @brief Test filtering of batches of records.
+ *
+ *  This file is in the public domain.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "configure.h"
+#include "datastruct.h"
+#include "evt.h"
+#include "mapfile.h"
+#include "evtlog.h"
+#include "scan.h"
+
+/** Select records by (eventID == 5 || eventID == 7) && !(time < 100)
+ *  and compare the selection with one done record by record. */
+int src_testscan (int argc, char *argv[])
+{
+	ScanFilter filter;
+	ScanBatch *batch;
+	uint32_t id, time;
+	size_t i;
+	int fail = 0;
+
+	batch = scanBatchCreate();
+	batch->count = SCAN_BATCH_SIZE - 3;
+	for (i = 0; i < batch->count; i++)
+	{
+		batch->columns[SCAN_EVENT_ID][i] = i % 9;
+		batch->columns[SCAN_TIME_GENERATED][i] = i;
+	}
+
+	/* Nothing to test means everything passes. */
+	scanFilterInit(&filter);
+	scanBatchSelect(batch, &filter);
+	for (i = 0; i < batch->count; i++)
+		if (!batch->selected[i])
+			fail = 1;
+
+	scanFilterTest(&filter, SCAN_EVENT_ID, SCAN_EQ, 5);
+	scanFilterTest(&filter, SCAN_EVENT_ID, SCAN_EQ, 7);
+	scanFilterOperator(&filter, SCAN_OR);
+	scanFilterTest(&filter, SCAN_TIME_GENERATED, SCAN_LT, 100);
+	scanFilterOperator(&filter, SCAN_NOT);
+	scanFilterOperator(&filter, SCAN_AND);
+	if (filter.maxDepth != 2 || filter.depth != 1)
+		fail = 1;
+
+	scanBatchSelect(batch, &filter);
+	for (i = 0; i < batch->count; i++)
+	{
+		id = batch->columns[SCAN_EVENT_ID][i];
+		time = batch->columns[SCAN_TIME_GENERATED][i];
+		if (!batch->selected[i] != !((id == 5 || id == 7) && time >= 100))
+		{
+			printf("scan test failed on record %u\n", (unsigned) i);
+			fail = 1;
+			break;
+		}
+	}
+
+	scanFilterDestroy(&filter);
+	scanBatchDestroy(batch);
+
+	if (fail)
+		puts("scan test failed");
+	else
+		puts("scan test passed");
+	return fail;
+}
@@ -11,6 +11,7 @@
 #include <string.h>
 
 #include "configure.h"
+#include "datastruct.h"
 #include "sid.h"
 #include "xalloc.h"
 
@@ -20,8 +21,9 @@ int src_testsid (int argc, char *argv[])
 	const char *sid = "S-1-5-21-1085031214-1563985344-725345543";
 	void *binary = NULL;
 	char *text = NULL;
+	Buffer buf = BUFFER_INITIALIZER;
 	size_t length;
-	int fail = 1;
+	int offset, fail = 1;
 
 	binary = sidToBinary(sid, &length);
 	if (!binary)
@@ -44,6 +46,22 @@ int src_testsid (int argc, char *argv[])
 		printf("Encoded & decoded: %s\n", text);
 		goto src_testsid_end;
 	}
+	/* The in-place variant has to produce the very same bytes. */
+	bufferAppend(&buf, "x", 1, 0);
+	offset = sidToBinaryBuffer(sid, &buf, 4);
+	if (offset != 4 || buf.used - offset != length
+		|| memcmp((char *) buf.data + offset, binary, length))
+	{
+		puts("SID test failed on sidToBinaryBuffer().");
+		goto src_testsid_end;
+	}
+	if (sidToBinaryBuffer("S-1-x", &buf, 4) != -1
+		|| buf.used != offset + length)
+	{
+		puts("SID test failed on sidToBinaryBuffer() rollback.");
+		goto src_testsid_end;
+	}
+
 	puts("SID test passed");
 	fail = 0;
 
@@ -52,6 +70,7 @@ src_testsid_end:
 		free(binary);
 	if (text)
 		free(text);
+	bufferDestroy(&buf);
 
 	return fail;
 }
@@ -0,0 +1,58 @@
+/**
+ *  @file testtoken.c
+ *  @brief Test splitting of text into tokens.
+ *
+ *  This file is in the public domain.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "configure.h"
+#include "datastruct.h"
+#include "token.h"
+
+/** Split escaped description strings into tokens. */
+int src_testtoken (int argc, char *argv[])
+{
+	const char *text = "User15|C:\\\\Win\\|dows||h\xC3\xA9llo, 10.0.0.1 ";
+	const char *expected[] =
+	{
+		"user15", "c", "win", "dows", "h\xC3\xA9llo", "10", "0", "0", "1"
+	};
+	const int n_expected = sizeof(expected) / sizeof(expected[0]);
+
+	Buffer token = BUFFER_INITIALIZER;
+	const char *cursor = text;
+	char longText[TOKEN_MAX_LENGTH + 10];
+	int i, fail = 0;
+
+	for (i = 0; tokenNext(&cursor, &token); i++)
+		if (i >= n_expected || strcmp(token.data, expected[i]))
+		{
+			printf("token test failed on token %d: %s\n",
+				i, (char *) token.data);
+			fail = 1;
+			break;
+		}
+	if (!fail && i != n_expected)
+		fail = 1;
+
+	/* Overlong tokens are cut short and the rest is skipped. */
+	memset(longText, 'x', sizeof(longText) - 1);
+	longText[sizeof(longText) - 1] = '\0';
+	cursor = longText;
+	if (!tokenNext(&cursor, &token) || strlen(token.data) != TOKEN_MAX_LENGTH
+		|| tokenNext(&cursor, &token))
+		fail = 1;
+
+	if (fail)
+		puts("token test failed");
+	else
+		puts("token test passed");
+
+	bufferDestroy(&token);
+	return fail;
+}
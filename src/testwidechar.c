@@ -11,6 +11,7 @@
 #include <string.h>
 
 #include "configure.h"
+#include "datastruct.h"
 #include "widechar.h"
 #include "xalloc.h"
 
@@ -0,0 +1,59 @@
+/**
+ *  @file testworkers.c
+ *  @brief Test running jobs on several threads.
+ *
+ *  This file is in the public domain.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "configure.h"
+#include "workers.h"
+
+/** Count how many times a job has been done. */
+static void countJob (void *data, size_t index)
+{
+	((int *) data)[index]++;
+}
+
+/** Check that every job is done exactly once. */
+int src_testworkers (int argc, char *argv[])
+{
+	const size_t n_jobs = 1000;
+
+	int *done;
+	size_t i;
+	unsigned threads;
+	int fail = 0;
+
+	done = calloc(n_jobs, sizeof(int));
+	for (threads = 1; threads <= 8; threads *= 2)
+	{
+		workersRun(countJob, done, n_jobs, threads);
+		for (i = 0; i < n_jobs; i++)
+		{
+			if (done[i] != (int) threads)
+			{
+				printf("workers test failed with %u threads on job %lu\n",
+					threads, (unsigned long) i);
+				fail = 1;
+				break;
+			}
+			/* The next round starts from the current count. */
+			done[i] = threads * 2 - 1;
+		}
+	}
+
+	/* No jobs at all. */
+	workersRun(countJob, NULL, 0, 4);
+
+	free(done);
+
+	if (fail)
+		puts("workers test failed");
+	else
+		puts("workers test passed");
+	return fail;
+}
@@ -0,0 +1,54 @@
+/**
+ *  @file timeconv.c
+ *  @brief Conversion of event times from text.
+ *
+ *  Copyright Přemysl Janouch 2010. All rights reserved.
+ *  See the file LICENSE for licensing information.
+ *
+ */
+
+/* strptime */
+#define _XOPEN_SOURCE 700
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "configure.h"
+
+#include "timeconv.h"
+
+
+time_t parseTime (const char *token)
+{
+	struct tm tm;
+#ifdef HAVE_STRPTIME
+	const char *end;
+#else /* ! HAVE_STRPTIME */
+	int end = 0;
+#endif /* ! HAVE_STRPTIME */
+
+	/* Initialize the structure. */
+	memset(&tm, 0, sizeof(struct tm));
+
+	/* The whole token has to be a time, not just its beginning. */
+#ifdef HAVE_STRPTIME
+	end = strptime(token, "%Y-%m-%d %H:%M:%S", &tm);
+	if (!end || *end)
+		return -1;
+#else /* ! HAVE_STRPTIME */
+	if (sscanf(token, "%4d-%2d-%2d %2d:%2d:%2d%n",
+		&tm.tm_year, &tm.tm_mon, &tm.tm_mday,
+		&tm.tm_hour, &tm.tm_min, &tm.tm_sec, &end) != 6 || token[end])
+		return -1;
+	tm.tm_year -= 1900;
+	tm.tm_mon--;
+#endif /* ! HAVE_STRPTIME */
+
+#ifdef HAVE__MKGMTIME
+	return _mkgmtime(&tm);
+#else /* ! HAVE__MKGMTIME */
+	return mktime(&tm);
+#endif /* ! HAVE__MKGMTIME */
+}
@@ -0,0 +1,21 @@
+/**
+ *  @file timeconv.h
+ *  @brief Conversion of event times from text.
+ *
+ *  Copyright Přemysl Janouch 2010. All rights reserved.
+ *  See the file LICENSE for licensing information.
+ *
+ */
+
+#ifndef TIMECONV_H_INCLUDED
+#define TIMECONV_H_INCLUDED
+
+/** Parse a time in the format used in CSV output, i.e. "%Y-%m-%d %H:%M:%S".
+ *  Unless _mkgmtime() is available, setutctimezone() has to be called
+ *  beforehand so that the time is taken as UTC.
+ *  @param[in] token  The string to parse.
+ *  @return The time, or -1 on failure.
+ */
+time_t parseTime (const char *token);
+
+#endif /* ! TIMECONV_H_INCLUDED */
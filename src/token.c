@@ -0,0 +1,53 @@
+/**
+ *  @file token.c
+ *  @brief Splitting of text into search tokens.
+ *
+ *  Copyright Přemysl Janouch 2010. All rights reserved.
+ *  See the file LICENSE for licensing information.
+ *
+ */
+
+#include <stdlib.h>
+
+#include "configure.h"
+
+#include "datastruct.h"
+#include "token.h"
+
+
+/** Whether a byte is part of a token. */
+static inline int isTokenChar (unsigned char c)
+{
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')
+		|| (c >= '0' && c <= '9') || c >= 0x80;
+}
+
+int tokenNext (const char **__restrict cursor, Buffer *__restrict token)
+{
+	const unsigned char *p = (const unsigned char *) *cursor;
+	size_t length;
+
+	while (*p && !isTokenChar(*p))
+		p++;
+	if (!*p)
+	{
+		*cursor = (const char *) p;
+		return 0;
+	}
+
+	bufferClear(token);
+	for (length = 0; isTokenChar(*p); p++, length++)
+	{
+		/* Don't cut UTF-8 sequences in half. */
+		if (length >= TOKEN_MAX_LENGTH && (*p & 0xC0) != 0x80)
+			break;
+		bufferAppendChar(token, (*p >= 'A' && *p <= 'Z') ? *p + 32 : *p);
+	}
+	bufferAppendChar(token, '\0');
+
+	/* Skip the rest of an overlong token. */
+	while (isTokenChar(*p))
+		p++;
+	*cursor = (const char *) p;
+	return 1;
+}
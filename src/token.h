@@ -0,0 +1,29 @@
+/**
+ *  @file token.h
+ *  @brief Splitting of text into search tokens.
+ *
+ *  Copyright Přemysl Janouch 2010. All rights reserved.
+ *  See the file LICENSE for licensing information.
+ *
+ *  Tokens are maximal runs of ASCII letters and digits and any non-ASCII
+ *  characters, with ASCII letters converted to lower case. Anything else,
+ *  including the separator and escape characters of description strings,
+ *  splits tokens, so escaped text yields the same tokens as the original.
+ *
+ */
+
+#ifndef TOKEN_H_INCLUDED
+#define TOKEN_H_INCLUDED
+
+/** Tokens longer than this are cut short. */
+#define TOKEN_MAX_LENGTH 64
+
+/** Cut the next token out of a UTF-8 string.
+ *  @param[in,out] cursor  Where to continue. Gets advanced past the token.
+ *  @param[out] token  Where to store the token, including a NULL char.
+ *  	The buffer is cleared beforehand.
+ *  @return Non-zero if a token has been found.
+ */
+int tokenNext (const char **__restrict cursor, Buffer *__restrict token);
+
+#endif /* ! TOKEN_H_INCLUDED */
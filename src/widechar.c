@@ -17,21 +17,62 @@
 
 #include "configure.h"
 #include "xalloc.h"
+#include "datastruct.h"
+#include "widechar.h"
 
 #ifndef _WIN32
-/** A simple wrapper for iconv() that allocates the output buffer
- *  and creates the conversion object itself.
+/** Which conversion object to use. */
+enum
+{
+	WIDECHAR_DECODER,
+	WIDECHAR_ENCODER,
+	WIDECHAR_COUNT
+};
+
+#ifdef THREAD_LOCAL
+/** Conversion objects are expensive to create, so they're kept for further
+ *  use, one set per thread. They last until the process exits. */
+static THREAD_LOCAL iconv_t converters[WIDECHAR_COUNT] =
+	{(iconv_t) -1, (iconv_t) -1};
+#endif /* THREAD_LOCAL */
+
+/** Get a conversion object.
+ *  @param[in] which  WIDECHAR_DECODER or WIDECHAR_ENCODER.
+ *  @return The object, or (iconv_t) -1 on failure.
  */
-static size_t iconvWrapper (char *__restrict from, char *__restrict to,
+static iconv_t openConverter (int which)
+{
+	static const char *const codesets[WIDECHAR_COUNT][2] =
+		{{"UTF-8", "UTF-16LE"}, {"UTF-16LE", "UTF-8"}};
+
+#ifdef THREAD_LOCAL
+	if (converters[which] == (iconv_t) -1)
+		converters[which] = iconv_open
+			(codesets[which][0], codesets[which][1]);
+	return converters[which];
+#else /* ! THREAD_LOCAL */
+	return iconv_open(codesets[which][0], codesets[which][1]);
+#endif /* ! THREAD_LOCAL */
+}
+
+/** Give back a conversion object obtained from openConverter(). */
+static void closeConverter (iconv_t obj)
+{
+#ifdef THREAD_LOCAL
+	/* Reset the shift state, the conversion may have failed midway. */
+	iconv(obj, NULL, NULL, NULL, NULL);
+#else /* ! THREAD_LOCAL */
+	iconv_close(obj);
+#endif /* ! THREAD_LOCAL */
+}
+
+/** A simple wrapper for iconv() that allocates the output buffer. */
+static size_t iconvWrapper (iconv_t obj,
 	char *__restrict in, size_t inLen, char **__restrict out)
 {
-	iconv_t obj;
 	char *buff;
 	size_t outLeft, buffAlloc;
 
-	if ((obj = iconv_open(to, from)) == (iconv_t) -1)
-		return 0;
-
 	outLeft = buffAlloc = 64;
 	*out = buff = xmalloc(buffAlloc);
 
@@ -49,10 +90,8 @@ static size_t iconvWrapper (char *__restrict from, char *__restrict to,
 			continue;
 		}
 		free(*out);
-		iconv_close(obj);
 		return 0;
 	}
-	iconv_close(obj);
 	return buffAlloc - outLeft;
 }
 #endif /* ! _WIN32 */
@@ -64,7 +103,10 @@ int decodeWideString (const uint16_t *__restrict in, int maxLength,
 	int inLen;
 #ifdef _WIN32
 	int req;
-#endif /* _WIN32 */
+#else /* ! _WIN32 */
+	iconv_t obj;
+	size_t outLen;
+#endif /* ! _WIN32 */
 
 	if (maxLength <= 0)
 		return 0;
@@ -87,37 +129,76 @@ int decodeWideString (const uint16_t *__restrict in, int maxLength,
 		return 0;
 	}
 #else /* ! _WIN32 */
-	if (!iconvWrapper("UTF-16LE", "UTF-8",
-		(char *) in, inLen, out))
+	if ((obj = openConverter(WIDECHAR_DECODER)) == (iconv_t) -1)
+		return 0;
+	outLen = iconvWrapper(obj, (char *) in, inLen, out);
+	closeConverter(obj);
+	if (!outLen)
 		return 0;
 #endif /* ! _WIN32 */
 	return inLen;
 }
 
 int encodeMBString (char *__restrict in, uint16_t **__restrict out)
+{
+	Buffer buf = BUFFER_INITIALIZER;
+
+	if (encodeMBStringToBuffer(in, &buf) == -1)
+	{
+		bufferDestroy(&buf);
+		return 0;
+	}
+	*out = buf.data;
+	return buf.used;
+}
+
+int encodeMBStringToBuffer (char *__restrict in, Buffer *__restrict buf)
 {
 	const char *i;
-	int inLen;
+	size_t inLen, reserved;
+	int offset;
 #ifdef _WIN32
 	int req;
-#endif /* _WIN32 */
+#else /* ! _WIN32 */
+	iconv_t obj;
+	char *out;
+	size_t outLeft;
+#endif /* ! _WIN32 */
 
 	for (i = in; *i++;);
 	inLen = i - in;
 
+	/* No UTF-8 sequence makes for more UTF-16 code units
+	 * than it has bytes, so this is enough for the whole string.
+	 */
+	reserved = inLen * sizeof(uint16_t);
+	offset = bufferAppend(buf, NULL, reserved, 0);
+
 #ifdef _WIN32
-	if (!(req = MultiByteToWideChar(CP_UTF8, 0, in, inLen, NULL, 0)))
-		return 0;
-	*out = xmalloc(req * sizeof(uint16_t));
-	if (!MultiByteToWideChar(CP_UTF8, 0, in, inLen, *out, req))
+	if (!(req = MultiByteToWideChar(CP_UTF8, 0, in, inLen,
+		(LPWSTR) ((char *) buf->data + offset), inLen)))
 	{
-		free(*out);
-		return 0;
+		bufferShrink(buf, reserved);
+		return -1;
 	}
-	return req * sizeof(uint16_t);
+	bufferShrink(buf, reserved - req * sizeof(uint16_t));
 #else /* ! _WIN32 */
-	return iconvWrapper("UTF-8", "UTF-16LE",
-		in, inLen, (char **) out);
+	if ((obj = openConverter(WIDECHAR_ENCODER)) == (iconv_t) -1)
+	{
+		bufferShrink(buf, reserved);
+		return -1;
+	}
+
+	out = (char *) buf->data + offset;
+	outLeft = reserved;
+	if (iconv(obj, (char **) &in, &inLen, &out, &outLeft) == (size_t) -1)
+	{
+		closeConverter(obj);
+		bufferShrink(buf, reserved);
+		return -1;
+	}
+	closeConverter(obj);
+	bufferShrink(buf, outLeft);
 #endif /* ! _WIN32 */
+	return offset;
 }
-
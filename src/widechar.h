@@ -28,5 +28,14 @@ int decodeWideString (const uint16_t *__restrict in, int maxLength,
  */
 int encodeMBString (char *__restrict in, uint16_t **__restrict out);
 
+/** UTF-8 to Windows WCHAR (UTF-16LE) conversion right into a buffer.
+ *  @param[in]     in   A UTF-8 string.
+ *  @param[in,out] buf  The buffer to append the wide string to.
+ *  @return On success, the offset at which the wide string, including
+ *  	the NULL char, has been placed into the buffer. On failure the buffer
+ *  	is left as it was and the function returns -1.
+ */
+int encodeMBStringToBuffer (char *__restrict in, Buffer *__restrict buf);
+
 #endif /* ! WIDECHAR_H_INCLUDED */
 
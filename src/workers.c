@@ -0,0 +1,122 @@
+/**
+ *  @file workers.c
+ *  @brief Running independent jobs on several threads.
+ *
+ *  Copyright Přemysl Janouch 2010. All rights reserved.
+ *  See the file LICENSE for licensing information.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "configure.h"
+
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif /* HAVE_PTHREAD */
+#ifdef HAVE_SYSCONF
+#include <unistd.h>
+#endif /* HAVE_SYSCONF */
+
+#include "xalloc.h"
+#include "workers.h"
+
+
+/** Jobs shared by the threads. */
+typedef struct
+{
+	/** The function doing the jobs. */
+	WorkerJob job;
+	/** Data to be passed to @a job. */
+	void *data;
+	/** The number of jobs. */
+	size_t nJobs;
+	/** The next job to be handed out. */
+	size_t next;
+#ifdef HAVE_PTHREAD
+	/** Protects @a next. */
+	pthread_mutex_t lock;
+#endif /* HAVE_PTHREAD */
+}
+WorkerQueue;
+
+
+#ifdef HAVE_PTHREAD
+/** Do jobs from the queue until there are none left. */
+static void *workerMain (void *queue);
+#endif /* HAVE_PTHREAD */
+
+
+unsigned workersDefaultCount (void)
+{
+#if defined(HAVE_SYSCONF) && defined(_SC_NPROCESSORS_ONLN)
+	long count;
+
+	if ((count = sysconf(_SC_NPROCESSORS_ONLN)) > 1)
+		return count;
+#endif /* HAVE_SYSCONF && _SC_NPROCESSORS_ONLN */
+	return 1;
+}
+
+void workersRun (WorkerJob job, void *data, size_t nJobs, unsigned nThreads)
+{
+	WorkerQueue queue;
+#ifdef HAVE_PTHREAD
+	pthread_t *threads;
+	unsigned i, nStarted;
+#endif /* HAVE_PTHREAD */
+
+	queue.job = job;
+	queue.data = data;
+	queue.nJobs = nJobs;
+	queue.next = 0;
+
+#ifdef HAVE_PTHREAD
+	if (nThreads > nJobs)
+		nThreads = nJobs;
+	if (nThreads > 1)
+	{
+		pthread_mutex_init(&queue.lock, NULL);
+		threads = xmalloc((nThreads - 1) * sizeof(pthread_t));
+
+		/* If a thread can't be started, the others just do more work. */
+		for (nStarted = 0; nStarted < nThreads - 1; nStarted++)
+			if (pthread_create(&threads[nStarted], NULL, workerMain, &queue))
+				break;
+
+		workerMain(&queue);
+		for (i = 0; i < nStarted; i++)
+			pthread_join(threads[i], NULL);
+
+		free(threads);
+		pthread_mutex_destroy(&queue.lock);
+		return;
+	}
+#else /* ! HAVE_PTHREAD */
+	(void) nThreads;
+#endif /* ! HAVE_PTHREAD */
+
+	/* There's nobody to synchronize with. */
+	for (; queue.next < nJobs; queue.next++)
+		job(data, queue.next);
+}
+
+#ifdef HAVE_PTHREAD
+static void *workerMain (void *queue)
+{
+	WorkerQueue *q = queue;
+	size_t index;
+
+	while (1)
+	{
+		pthread_mutex_lock(&q->lock);
+		index = q->next++;
+		pthread_mutex_unlock(&q->lock);
+
+		if (index >= q->nJobs)
+			return NULL;
+		q->job(q->data, index);
+	}
+}
+#endif /* HAVE_PTHREAD */
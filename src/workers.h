@@ -0,0 +1,37 @@
+/**
+ *  @file workers.h
+ *  @brief Running independent jobs on several threads.
+ *
+ *  Copyright Přemysl Janouch 2010. All rights reserved.
+ *  See the file LICENSE for licensing information.
+ *
+ *  Without thread support, the jobs are simply run one after another.
+ *
+ */
+
+#ifndef WORKERS_H_INCLUDED
+#define WORKERS_H_INCLUDED
+
+/** A function doing a single job.
+ *  @param[in] data  The data passed to workersRun().
+ *  @param[in] index  The number of the job.
+ */
+typedef void (*WorkerJob) (void *data, size_t index);
+
+
+/** Get the number of threads worth running, one per processor.
+ *  @return The number of threads, at least one.
+ */
+unsigned workersDefaultCount (void);
+
+/** Run jobs on several threads and wait for them to finish. The jobs are
+ *  handed out in order to threads as they become free. The calling thread
+ *  takes part in the work.
+ *  @param[in] job  The function doing the jobs.
+ *  @param[in] data  Data to be passed to @a job.
+ *  @param[in] nJobs  The number of jobs.
+ *  @param[in] nThreads  The maximum number of threads to use.
+ */
+void workersRun (WorkerJob job, void *data, size_t nJobs, unsigned nThreads);
+
+#endif /* ! WORKERS_H_INCLUDED */